@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+
+// Timing helpers for the benchmarks. Each benchmark prints a table and takes
+// its sizes from the command line, so results can be compared across machines.
+
+namespace ptf_bench {
+
+// Fastest of `runs` calls of `fn`, in milliseconds.
+template <typename Fn>
+double BestMs(int runs, Fn&& fn) {
+  double best = 0;
+  for (int i = 0; i < runs; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || elapsed.count() < best) best = elapsed.count();
+  }
+  return best;
+}
+
+inline double MegabytesPerSecond(size_t bytes, double ms) {
+  return ms > 0 ? bytes / (ms * 1000.0) : 0;
+}
+
+// argv[index] as a positive number, or `fallback`.
+inline unsigned long ArgOr(int argc, char** argv, int index, unsigned long fallback) {
+  if (index >= argc) return fallback;
+  const unsigned long value = std::strtoul(argv[index], nullptr, 10);
+  return value > 0 ? value : fallback;
+}
+
+} // namespace ptf_bench
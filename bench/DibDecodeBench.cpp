@@ -0,0 +1,174 @@
+// DibDecoder throughput per layout: the whole image read in bands, as the
+// PNG encoder pulls it.
+//
+//   dib_decode_bench [runs] [width] [height] [band rows]
+//
+// Every layout is built from the same synthetic screenshot: palettized
+// (3-3-2 color table) uncompressed and BI_RLE8, 16-bit 5-6-5 bitfields,
+// 24-bit, 32-bit with all-zero alpha (the scan, then opaque), a V5 header with
+// BGRA masks, and 2-10-10-10 masks, which take the generic unpacker.
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "DibDecode.h"
+#include "TestDibs.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+struct Layout {
+  const char* name;
+  std::vector<uint8_t> dib;
+};
+
+uint32_t Index332(uint32_t argb) {
+  return ((argb >> 16) & 0xE0) | ((argb >> 11) & 0x1C) | ((argb >> 6) & 3);
+}
+
+std::vector<uint32_t> Palette332() {
+  std::vector<uint32_t> palette(256);
+  for (uint32_t i = 0; i < 256; i++) {
+    palette[i] = ((i & 0xE0) << 16) | ((i & 0x1C) << 11) | ((i & 3) << 6);
+  }
+  return palette;
+}
+
+// Rows bottom-up, each padded to whole words, one 32-bit word per pixel from
+// `pack`.
+std::vector<uint8_t> PackRows(const std::vector<uint32_t>& argb, uint32_t width, uint32_t height,
+                              int bitCount, uint32_t (*pack)(uint32_t)) {
+  const size_t stride = DibStride(width, bitCount);
+  std::vector<uint8_t> bits(stride * height);
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t* row = bits.data() + (height - 1 - y) * stride;
+    for (uint32_t x = 0; x < width; x++) {
+      const uint32_t v = pack(argb[static_cast<size_t>(y) * width + x]);
+      const int bytes = bitCount / 8;
+      for (int b = 0; b < bytes; b++) row[x * bytes + b] = static_cast<uint8_t>(v >> (8 * b));
+    }
+  }
+  return bits;
+}
+
+// BI_RLE8: encoded runs only, which is what GDI writes for flat UI colors.
+std::vector<uint8_t> EncodeRle8(const std::vector<uint32_t>& argb, uint32_t width,
+                                uint32_t height) {
+  std::vector<uint8_t> bits;
+  for (uint32_t y = height; y-- > 0;) {
+    const uint32_t* row = argb.data() + static_cast<size_t>(y) * width;
+    for (uint32_t x = 0; x < width;) {
+      const uint32_t index = Index332(row[x]);
+      uint32_t run = 1;
+      while (run < 255 && x + run < width && Index332(row[x + run]) == index) run++;
+      bits.push_back(static_cast<uint8_t>(run));
+      bits.push_back(static_cast<uint8_t>(index));
+      x += run;
+    }
+    bits.push_back(0);
+    bits.push_back(y == 0 ? 1 : 0);  // end of bitmap / end of line
+  }
+  return bits;
+}
+
+uint32_t Same(uint32_t argb) { return argb; }
+uint32_t ZeroAlpha(uint32_t argb) { return argb & 0xFFFFFF; }
+
+uint32_t Pack565(uint32_t argb) {
+  return ((argb >> 8) & 0xF800) | ((argb >> 5) & 0x07E0) | ((argb >> 3) & 0x001F);
+}
+
+uint32_t Pack2101010(uint32_t argb) {
+  return 0xC0000000u | ((argb & 0xFF0000) << 6) | ((argb & 0xFF00) << 4) | ((argb & 0xFF) << 2);
+}
+
+void SetMasks(DibSpec* spec, uint32_t red, uint32_t green, uint32_t blue, uint32_t alpha) {
+  spec->masks[0] = red;
+  spec->masks[1] = green;
+  spec->masks[2] = blue;
+  spec->masks[3] = alpha;
+}
+
+std::vector<Layout> MakeLayouts(const std::vector<uint32_t>& argb, uint32_t width,
+                                uint32_t height) {
+  std::vector<Layout> layouts;
+  DibSpec spec;
+  spec.width = static_cast<int32_t>(width);
+  spec.height = static_cast<int32_t>(height);
+  const auto add = [&](const char* name, const std::vector<uint32_t>& palette,
+                       const std::vector<uint8_t>& bits) {
+    layouts.push_back({name, MakeDib(spec, palette, bits)});
+  };
+
+  spec.bitCount = 8;
+  add("8-bit palette", Palette332(), PackRows(argb, width, height, 8, Index332));
+  spec.compression = kBiRle8;
+  const std::vector<uint8_t> rle = EncodeRle8(argb, width, height);
+  spec.imageSize = static_cast<uint32_t>(rle.size());
+  add("BI_RLE8", Palette332(), rle);
+  spec.imageSize = 0;
+
+  spec.bitCount = 16;
+  spec.compression = kBiBitfields;
+  SetMasks(&spec, 0xF800, 0x07E0, 0x001F, 0);
+  add("16-bit 5-6-5", {}, PackRows(argb, width, height, 16, Pack565));
+
+  spec.bitCount = 24;
+  spec.compression = kBiRgb;
+  add("24-bit", {}, PackRows(argb, width, height, 24, Same));
+  spec.bitCount = 32;
+  add("32-bit, alpha 0", {}, PackRows(argb, width, height, 32, ZeroAlpha));
+
+  spec.headerSize = 124;
+  spec.compression = kBiBitfields;
+  SetMasks(&spec, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+  add("V5 BGRA", {}, PackRows(argb, width, height, 32, Same));
+  SetMasks(&spec, 0x3FF00000, 0x000FFC00, 0x000003FF, 0xC0000000);
+  add("V5 2-10-10-10", {}, PackRows(argb, width, height, 32, Pack2101010));
+  return layouts;
+}
+
+// Opens `dib` and reads every band; returns a checksum so the work is kept.
+uint32_t DecodeAll(const std::vector<uint8_t>& dib, uint32_t bandRows) {
+  DibDecoder decoder;
+  if (!decoder.Open(dib.data(), dib.size())) return 0;
+  uint32_t sum = 0;
+  PixelSource band;
+  for (uint32_t y = 0; y < decoder.Height(); y += bandRows) {
+    const uint32_t rows = std::min(bandRows, decoder.Height() - y);
+    if (!decoder.ReadBand(y, rows, &band)) return 0;
+    sum += band.pixels[0] + band.pixels[band.stride * rows - 1];
+  }
+  return sum + 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 5));
+  const uint32_t width = static_cast<uint32_t>(ptf_bench::ArgOr(argc, argv, 2, 3840));
+  const uint32_t height = static_cast<uint32_t>(ptf_bench::ArgOr(argc, argv, 3, 2160));
+  const uint32_t bandRows = static_cast<uint32_t>(ptf_bench::ArgOr(argc, argv, 4, 64));
+  const std::vector<uint32_t> argb =
+      ToArgb(MakeScreenshot(width, height, PixelFormat::Bgra8, 1));
+  const double megapixels = static_cast<double>(width) * height / 1e6;
+
+  std::printf("%ux%u screenshot, bands of %u rows\n\n", width, height, bandRows);
+  std::printf("%-16s %10s %10s %10s\n", "layout", "DIB MB", "ms", "MP/s");
+  for (const Layout& layout : MakeLayouts(argb, width, height)) {
+    uint32_t sum = 0;
+    const double ms = ptf_bench::BestMs(runs, [&] { sum = DecodeAll(layout.dib, bandRows); });
+    if (sum == 0) {
+      std::printf("%-16s failed to decode\n", layout.name);
+      return 1;
+    }
+    std::printf("%-16s %10.1f %10.2f %10.1f\n", layout.name, layout.dib.size() / 1e6, ms,
+                megapixels / (ms / 1000.0));
+  }
+  return 0;
+}
@@ -0,0 +1,71 @@
+// Save latency per durability mode (--durability fast|safe|paranoid): what
+// each flush adds to one save.
+//
+//   durability_bench [saves] [kilobytes] [directory]
+//
+// Every save runs RunSave as the helper does (temp file, flushes where the
+// mode puts them, rename to a free name), through TestSaveFolder: fsync
+// stands in for FlushFileBuffers. Run it against the disk you care about:
+// the default, the system temp folder, may be a RAM disk (tmpfs), where
+// flushes cost nothing.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "SaveFlow.h"
+#include "TestImages.h"
+#include "TestSaveFolder.h"
+
+using namespace ptf_helper;
+
+int main(int argc, char** argv) {
+  const int saves = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 50));
+  const size_t bytes = ptf_bench::ArgOr(argc, argv, 2, 256) * 1024;
+  const std::filesystem::path base =
+      argc > 3 ? std::filesystem::path(argv[3]) : std::filesystem::temp_directory_path();
+  const std::filesystem::path dir = base / "ptf_durability_bench";
+
+  ptf_test::Random random(1);
+  std::vector<uint8_t> content(bytes);
+  for (uint8_t& b : content) b = static_cast<uint8_t>(random.Next());
+
+  std::printf("%d saves of %zu KiB in %s\n\n", saves, bytes / 1024, dir.string().c_str());
+  std::printf("%-10s %10s %10s %10s\n", "mode", "median ms", "p90 ms", "max ms");
+  struct Mode {
+    const char* name;
+    WriteDurability durability;
+  };
+  const Mode modes[] = {{"fast", WriteDurability::Fast},
+                        {"safe", WriteDurability::Safe},
+                        {"paranoid", WriteDurability::Paranoid}};
+  for (const Mode& mode : modes) {
+    std::filesystem::remove_all(dir);
+    ptf_test::TestSaveFolder folder(dir);
+    SaveSettings settings;
+    settings.durability = mode.durability;
+    settings.extension = L".bin";
+    std::vector<double> ms;
+    for (int i = 0; i < saves; i++) {
+      SaveResult result = SaveResult::NoTempFile;
+      ms.push_back(ptf_bench::BestMs(1, [&] {
+        result = RunSave(&folder, settings, [&](ByteSink* sink) {
+                   return sink->Write(content.data(), content.size());
+                 }).result;
+      }));
+      if (result != SaveResult::Written) {
+        std::printf("%-10s save failed\n", mode.name);
+        return 1;
+      }
+    }
+    std::sort(ms.begin(), ms.end());
+    std::printf("%-10s %10.2f %10.2f %10.2f\n", mode.name, ms[ms.size() / 2],
+                ms[ms.size() * 9 / 10], ms.back());
+  }
+  std::filesystem::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,115 @@
+// End-to-end text save time, plain and gzip (--gzip-above-mb), to a local
+// file and to a throttled one standing in for a network folder.
+//
+//   gzip_save_bench [runs] [megabytes] [throttled MB/s]
+//
+// A save is what the helper does with clipboard text: EncodeUtf8Text into
+// the sink, through GzipSink when compressing, and the file flushed at the
+// end. The throttled target lets bytes through no faster than the given rate,
+// as a share on a slow link does; there, writing less beats compressing
+// faster. Local files show what compression costs where the disk keeps up.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "BenchUtil.h"
+#include "ByteSink.h"
+#include "GzipSink.h"
+#include "TestImages.h"
+#include "TextEncode.h"
+#include "ThreadPool.h"
+
+using namespace ptf_helper;
+
+namespace {
+
+// Writes through to `out` no faster than `bytesPerSecond`.
+class ThrottledSink : public ByteSink {
+ public:
+  ThrottledSink(ByteSink* out, double bytesPerSecond)
+      : out_(out), bytesPerSecond_(bytesPerSecond), start_(std::chrono::steady_clock::now()) {}
+
+  bool Write(const uint8_t* data, size_t size) override {
+    written_ += size;
+    std::this_thread::sleep_until(start_ + std::chrono::duration<double>(written_ /
+                                                                         bytesPerSecond_));
+    return out_->Write(data, size);
+  }
+
+ private:
+  ByteSink* out_;
+  double bytesPerSecond_;
+  std::chrono::steady_clock::time_point start_;
+  double written_ = 0;
+};
+
+// Log-like text of about `bytes` characters.
+std::wstring MakeLog(size_t bytes) {
+  static const wchar_t* const kWords[] = {L"INFO", L"WARN", L"request", L"served", L"cache",
+                                          L"miss", L"GET", L"/api/items", L"in", L"ms"};
+  ptf_test::Random random(11);
+  std::wstring text;
+  while (text.size() < bytes) {
+    text += std::to_wstring(random.Below(1000000)) + L' ';
+    for (uint32_t n = 3 + random.Below(6); n > 0; n--) {
+      text += kWords[random.Below(10)];
+      text += L' ';
+    }
+    text += L"\r\n";
+  }
+  return text;
+}
+
+// One save of `text`; returns the bytes written to the file.
+size_t Save(const std::wstring& text, unsigned gzipThreads, double throttle) {
+  FILE* f = std::tmpfile();
+  if (!f) return 0;
+  StdioSink file(f);
+  ThrottledSink throttled(&file, throttle);
+  ByteSink* target = throttle > 0 ? static_cast<ByteSink*>(&throttled) : &file;
+  TextEncodeOptions options;
+  bool ok;
+  if (gzipThreads == 0) {
+    ok = EncodeUtf8Text(text, options, target);
+  } else {
+    GzipOptions gzipOptions;
+    gzipOptions.threads = gzipThreads;
+    GzipSink gzip(target, gzipOptions);
+    ok = EncodeUtf8Text(text, options, &gzip) && gzip.Finish();
+  }
+  ok = ok && std::fflush(f) == 0;
+  const long size = std::ftell(f);
+  std::fclose(f);
+  return ok && size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 3));
+  const size_t bytes = ptf_bench::ArgOr(argc, argv, 2, 64) << 20;
+  const double throttle = ptf_bench::ArgOr(argc, argv, 3, 20) * 1e6;
+  const std::wstring text = MakeLog(bytes);
+  const unsigned cores = ThreadPool::DefaultThreadCount();
+
+  std::printf("%zu MiB of text, throttled target at %.0f MB/s, %u cores\n\n", bytes >> 20,
+              throttle / 1e6, cores);
+  std::printf("%-16s %10s %12s %14s\n", "save", "file MB", "local ms", "throttled ms");
+  struct Mode {
+    const char* name;
+    unsigned threads;  // 0 = plain
+  };
+  const Mode modes[] = {{"plain", 0}, {"gzip, 1 thread", 1}, {"gzip, all cores", cores}};
+  for (const Mode& mode : modes) {
+    size_t written = 0;
+    const double localMs =
+        ptf_bench::BestMs(runs, [&] { written = Save(text, mode.threads, 0); });
+    // One run: the throttle makes it slow and steady.
+    const double throttledMs = ptf_bench::BestMs(1, [&] { Save(text, mode.threads, throttle); });
+    std::printf("%-16s %10.1f %12.1f %14.1f\n", mode.name, written / 1e6, localMs, throttledMs);
+  }
+  return 0;
+}
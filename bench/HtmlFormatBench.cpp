@@ -0,0 +1,114 @@
+// CF_HTML header parsing: time per clipboard block against the size of the
+// HTML behind the header. ParseHtmlFormat reads only the header and returns
+// views, so its time should not move with the payload; the helper's old
+// ExtractHtmlPayloadOrOriginal, kept here as the baseline, copied the block
+// to a string, searched it for each key and copied the payload out again.
+//
+//   html_format_bench [runs] [largest megabytes]
+//
+// Blocks are laid out as Chrome writes them: Version, the four offsets and
+// SourceURL, then a page with the fragment in the middle.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "HtmlFormat.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+
+namespace {
+
+std::string Offset(size_t value) {
+  char digits[16];
+  std::snprintf(digits, sizeof(digits), "%010zu", value);
+  return digits;
+}
+
+// A CF_HTML block with about `bytes` of HTML.
+std::vector<uint8_t> MakeBlock(size_t bytes) {
+  ptf_test::Random random(1);
+  std::string filler;
+  while (filler.size() < bytes / 2) {
+    filler += "<p>" + std::to_string(random.Next()) + " lorem ipsum dolor sit amet</p>\r\n";
+  }
+  const std::string before = "<html><body>\r\n" + filler + "<!--StartFragment-->";
+  const std::string fragment = "<p>Hello <b>world</b></p>";
+  const std::string after = "<!--EndFragment-->\r\n" + filler + "</body>\r\n</html>";
+  const std::string url = "SourceURL:https://example.com/page\r\n";
+
+  // Every offset is 10 digits, so the header length is known up front.
+  const std::string sample = "Version:0.9\r\nStartHTML:" + Offset(0) + "\r\nEndHTML:" + Offset(0) +
+                             "\r\nStartFragment:" + Offset(0) + "\r\nEndFragment:" + Offset(0) +
+                             "\r\n" + url;
+  const size_t startHtml = sample.size();
+  const size_t startFragment = startHtml + before.size();
+  const size_t endFragment = startFragment + fragment.size();
+  const size_t endHtml = endFragment + after.size();
+  const std::string block = "Version:0.9\r\nStartHTML:" + Offset(startHtml) +
+                            "\r\nEndHTML:" + Offset(endHtml) + "\r\nStartFragment:" +
+                            Offset(startFragment) + "\r\nEndFragment:" + Offset(endFragment) +
+                            "\r\n" + url + before + fragment + after;
+  return std::vector<uint8_t>(block.begin(), block.end());
+}
+
+// The helper's old parser, as it was.
+std::vector<uint8_t> OldExtract(const std::vector<uint8_t>& bytes) {
+  auto asString = std::string(bytes.begin(), bytes.end());
+  auto findNum = [&](const char* key) -> int {
+    size_t pos = asString.find(key);
+    if (pos == std::string::npos) return -1;
+    pos += std::strlen(key);
+    while (pos < asString.size() && (asString[pos] == ' ')) pos++;
+    int val = 0;
+    bool any = false;
+    while (pos < asString.size() && asString[pos] >= '0' && asString[pos] <= '9') {
+      any = true;
+      val = (val * 10) + (asString[pos] - '0');
+      pos++;
+    }
+    return any ? val : -1;
+  };
+  int startHtml = findNum("StartHTML:");
+  int endHtml = findNum("EndHTML:");
+  if (startHtml >= 0 && endHtml > startHtml && endHtml <= static_cast<int>(bytes.size())) {
+    return std::vector<uint8_t>(bytes.begin() + startHtml, bytes.begin() + endHtml);
+  }
+  return bytes;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 20));
+  const size_t largest = ptf_bench::ArgOr(argc, argv, 2, 64) << 20;
+
+  std::printf("best of %d; microseconds per block\n", runs);
+  std::printf("%12s %12s %12s %12s\n", "html bytes", "document", "fragment", "old (copy)");
+  for (size_t bytes = 4096; bytes <= largest; bytes *= 16) {
+    const std::vector<uint8_t> block = MakeBlock(bytes);
+    const std::string_view data(reinterpret_cast<const char*>(block.data()), block.size());
+    if (SelectHtmlPart(data, HtmlPart::Fragment) != "<p>Hello <b>world</b></p>") {
+      std::printf("the fragment was not found\n");
+      return 1;
+    }
+    size_t sink = 0;
+    // Many calls per timing: one parse is too short for the clock.
+    const int calls = 1000;
+    const double documentMs = ptf_bench::BestMs(runs, [&] {
+      for (int i = 0; i < calls; i++) sink += SelectHtmlPart(data, HtmlPart::Document).size();
+    });
+    const double fragmentMs = ptf_bench::BestMs(runs, [&] {
+      for (int i = 0; i < calls; i++) sink += SelectHtmlPart(data, HtmlPart::Fragment).size();
+    });
+    const double oldMs = ptf_bench::BestMs(runs, [&] { sink += OldExtract(block).size(); });
+    std::printf("%12zu %12.3f %12.3f %12.1f\n", block.size(), documentMs * 1000 / calls,
+                fragmentMs * 1000 / calls, oldMs * 1000);
+    if (sink == 0) std::printf("(nothing found)\n");
+  }
+  return 0;
+}
@@ -0,0 +1,163 @@
+// HTML to Markdown throughput in MB/s of HTML, per kind of page, converted in
+// one call and fed in 64 KiB pieces as a streaming reader would.
+//
+//   html_markdown_bench [runs] [megabytes]
+//
+// The pages are generated: an article (paragraphs, headings, links and
+// emphasis), a long table, code blocks, Word's markup (styles, spans and list
+// paragraphs), and a page that is mostly a data: image and a script, which
+// are dropped. Output goes to a sink that only counts it, so the figures are
+// the converter's alone.
+
+#include <cstdio>
+#include <string>
+
+#include "BenchUtil.h"
+#include "ByteSink.h"
+#include "HtmlMarkdown.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+
+namespace {
+
+class CountingSink : public ByteSink {
+ public:
+  bool Write(const uint8_t*, size_t size) override {
+    bytes += size;
+    return true;
+  }
+  size_t bytes = 0;
+};
+
+std::string Word(ptf_test::Random* random) {
+  static const char* const kWords[] = {"clipboard", "paste", "file", "the", "a",   "of",
+                                       "markdown",  "link",  "table", "and", "to", "image"};
+  return kWords[random->Below(sizeof(kWords) / sizeof(kWords[0]))];
+}
+
+std::string Words(ptf_test::Random* random, uint32_t count) {
+  std::string text;
+  for (uint32_t i = 0; i < count; i++) text += (i ? " " : "") + Word(random);
+  return text;
+}
+
+// Repeats `block` (called with a counter) until the page holds `bytes`.
+template <typename Block>
+std::string MakePage(size_t bytes, Block block) {
+  std::string html = "<html><head><style>p { margin: 0 }</style></head><body>\n";
+  for (uint32_t i = 0; html.size() < bytes; i++) html += block(i);
+  return html + "</body></html>\n";
+}
+
+std::string Article(size_t bytes) {
+  ptf_test::Random random(1);
+  return MakePage(bytes, [&](uint32_t i) {
+    std::string html;
+    if (i % 8 == 0) html += "<h2>" + Words(&random, 4) + "</h2>\n";
+    html += "<p>" + Words(&random, 20) + " <a href=\"https://example.com/" +
+            std::to_string(i) + "\">" + Words(&random, 2) + "</a> <b>" + Words(&random, 3) +
+            "</b> &amp; <em>" + Words(&random, 2) + "</em> [1] *2* " + Words(&random, 12) +
+            "</p>\n";
+    if (i % 5 == 0) {
+      html += "<ul><li>" + Words(&random, 5) + "</li><li>" + Words(&random, 6) + "<ol><li>" +
+              Words(&random, 4) + "</li></ol></li></ul>\n";
+    }
+    return html;
+  });
+}
+
+std::string Table(size_t bytes) {
+  ptf_test::Random random(2);
+  std::string html = "<table><tr><th>id</th><th>name</th><th>notes</th><th>total</th></tr>\n";
+  while (html.size() < bytes) {
+    html += "<tr><td>" + std::to_string(random.Below(100000)) + "</td><td>" +
+            Words(&random, 2) + "</td><td>" + Words(&random, 6) + " | x</td><td>" +
+            std::to_string(random.Below(1000)) + ".00</td></tr>\n";
+  }
+  return "<html><body>" + html + "</table></body></html>\n";
+}
+
+std::string Code(size_t bytes) {
+  ptf_test::Random random(3);
+  return MakePage(bytes, [&](uint32_t i) {
+    std::string html = "<p>" + Words(&random, 10) + " <code>f(" + std::to_string(i) +
+                       ")</code></p>\n<pre><code class=\"language-cpp\">";
+    for (int line = 0; line < 12; line++) {
+      html += "  if (a &lt; b &amp;&amp; " + Word(&random) + ") return `" + Word(&random) +
+              "`;   \n";
+    }
+    return html + "</code></pre>\n";
+  });
+}
+
+std::string WordMarkup(size_t bytes) {
+  ptf_test::Random random(4);
+  return MakePage(bytes, [&](uint32_t i) {
+    if (i % 3 == 0) {
+      return "<p class=MsoListParagraphCxSpMiddle style='text-indent:-.25in;mso-list:l0 "
+             "level1 lfo1'><![if !supportLists]><span style='font-family:Symbol'>&#183;<span "
+             "style='font:7.0pt \"Times New Roman\"'>&nbsp;&nbsp;&nbsp; </span></span>"
+             "<![endif]>" +
+             Words(&random, 8) + "</p>\n";
+    }
+    return "<p class=MsoNormal><span lang=EN-US style='font-size:11.0pt;font-family:"
+           "\"Calibri\",sans-serif;mso-fareast-language:EN-US'>" +
+           Words(&random, 14) + "<o:p></o:p></span></p>\n";
+  });
+}
+
+std::string DataImage(size_t bytes) {
+  ptf_test::Random random(5);
+  std::string html = "<html><body><p>" + Words(&random, 10) + "</p><img alt=\"chart\" src=\"data:"
+                     "image/png;base64,";
+  static const char kBase64[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const size_t imageEnd = bytes / 2;
+  while (html.size() < imageEnd) html += kBase64[random.Below(64)];
+  html += "\"><script>var x = '<p>not text</p>';";
+  while (html.size() < bytes) html += "x += " + std::to_string(random.Below(1000)) + ";\n";
+  return html + "</script><p>" + Words(&random, 10) + "</p></body></html>\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 5));
+  const size_t bytes = ptf_bench::ArgOr(argc, argv, 2, 8) << 20;
+  const size_t piece = 64 * 1024;
+
+  struct Kind {
+    const char* name;
+    std::string html;
+  };
+  const Kind kinds[] = {
+      {"article", Article(bytes)}, {"table", Table(bytes)},          {"code", Code(bytes)},
+      {"word", WordMarkup(bytes)}, {"data-image", DataImage(bytes)},
+  };
+
+  TextEncodeOptions options;
+  std::printf("best of %d over %zu MB of HTML; MB/s of HTML\n", runs, bytes >> 20);
+  std::printf("%-12s %10s %10s %10s\n", "page", "one call", "64K feeds", "md/html");
+  for (const Kind& kind : kinds) {
+    CountingSink sink;
+    const double wholeMs = ptf_bench::BestMs(runs, [&] {
+      sink.bytes = 0;
+      ConvertHtmlToMarkdown(kind.html, options, &sink);
+    });
+    const double piecesMs = ptf_bench::BestMs(runs, [&] {
+      sink.bytes = 0;
+      HtmlToMarkdown converter(options, &sink);
+      for (size_t pos = 0; pos < kind.html.size(); pos += piece) {
+        const size_t n = kind.html.size() - pos < piece ? kind.html.size() - pos : piece;
+        converter.Feed(kind.html.data() + pos, n);
+      }
+      converter.Finish();
+    });
+    std::printf("%-12s %10.1f %10.1f %10.2f\n", kind.name,
+                ptf_bench::MegabytesPerSecond(kind.html.size(), wholeMs),
+                ptf_bench::MegabytesPerSecond(kind.html.size(), piecesMs),
+                static_cast<double>(sink.bytes) / kind.html.size());
+  }
+  return 0;
+}
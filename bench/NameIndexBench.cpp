@@ -0,0 +1,97 @@
+// Picking a free name in a directory that already holds many of the day's
+// files: one listing into a NameIndex against probing each candidate name, as
+// the helper did before. A temporary directory is filled with `files` names
+// from the default template; every run starts cold, as each paste does.
+//
+//   name_index_bench [files] [runs]
+//
+// On a local disk a probe is a cached metadata lookup; on a network share
+// each one is a round trip, so the gap there is far wider than shown here.
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "BenchUtil.h"
+
+#include "PasteToFileCommon/NameIndex.h"
+#include "PasteToFileCommon/NameTemplate.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+ptf::NameFields Today() {
+  ptf::NameFields fields;
+  fields.year = 2026;
+  fields.month = 2;
+  fields.day = 23;
+  return fields;
+}
+
+// The portable form of IndexDirectory (Filename.cpp): one listing, filtered
+// by the template's prefix.
+int IndexedPick(const fs::path& dir, const ptf::NameTemplate& name) {
+  std::wstring prefix;
+  name.AppendListingPrefix(Today(), &prefix);
+  ptf::NameIndex index;
+  for (const fs::directory_entry& entry : fs::directory_iterator(dir)) {
+    const std::wstring file = entry.path().filename().wstring();
+    if (file.compare(0, prefix.size(), prefix) == 0) index.Add(file);
+  }
+  return index.NextFree(name, Today(), L".txt");
+}
+
+int ProbedPick(const fs::path& dir, const ptf::NameTemplate& name) {
+  std::wstring candidate;
+  for (int seq = name.FirstSeq(); seq < name.FirstSeq() + ptf::NameIndex::kMaxSuffix; seq++) {
+    candidate.clear();
+    name.Append(Today(), seq, L".txt", &candidate);
+    if (!fs::exists(dir / candidate)) return seq;
+  }
+  return -1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int files = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 900));
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 2, 20));
+  if (files >= ptf::NameIndex::kMaxSuffix) {
+    std::fprintf(stderr, "files must be below %d\n", ptf::NameIndex::kMaxSuffix);
+    return 1;
+  }
+
+  const fs::path dir = fs::temp_directory_path() / "ptf_name_index_bench";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  const ptf::NameTemplate name;
+  std::wstring fileName;
+  for (int seq = 0; seq < files; seq++) {
+    fileName.clear();
+    name.Append(Today(), seq, L".txt", &fileName);
+    std::ofstream(dir / fileName).put('x');
+    fileName.clear();
+    name.Append(Today(), seq, L".png", &fileName);  // listed, but another name
+    std::ofstream(dir / fileName).put('x');
+  }
+
+  int indexed = 0, probed = 0;
+  const double indexedMs = ptf_bench::BestMs(runs, [&] { indexed = IndexedPick(dir, name); });
+  const double probedMs = ptf_bench::BestMs(runs, [&] { probed = ProbedPick(dir, name); });
+  fs::remove_all(dir);
+
+  std::printf("%d taken names (and as many .png); best of %d\n", files, runs);
+  std::printf("%-28s %9s %6s\n", "", "ms", "seq");
+  std::printf("%-28s %9.3f %6d\n", "one listing + NameIndex", indexedMs, indexed);
+  std::printf("%-28s %9.3f %6d\n", "probe each candidate", probedMs, probed);
+  if (indexed != probed) {
+    std::printf("the two disagree\n");
+    return 1;
+  }
+  if (indexedMs > 0) {
+    std::printf("probing takes %.2fx the time of the index\n", probedMs / indexedMs);
+  }
+  return 0;
+}
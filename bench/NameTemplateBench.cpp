@@ -0,0 +1,148 @@
+// File naming: compiling a NameTemplate, rendering one name, and naming
+// thousands of files in turn with a NameIndex against rendering and looking
+// up every candidate from the first sequence number, as probing does.
+//
+//   name_template_bench [files] [already in the folder] [runs]
+//
+// Files are a history export's mix: eight name families (plain saves and
+// history items 1-7) in .txt and .png, with the plain .txt family already
+// holding `existing` names from earlier saves. Everything is in memory, so
+// the figures are the naming code's own; name_index_bench covers the
+// directory listing.
+
+#include <cstdio>
+#include <string>
+#include <unordered_set>
+
+#include "BenchUtil.h"
+
+#include "PasteToFileCommon/NameIndex.h"
+#include "PasteToFileCommon/NameTemplate.h"
+
+namespace {
+
+// The example from the template docs, plus {hist} so history items get
+// names of their own, as both templates must for a history export.
+const wchar_t kCustom[] = L"{date:%Y%m%d}-{time}{hist}-{seq:03}-{fmt}{ext}";
+
+ptf::NameFields Fields(int item) {
+  ptf::NameFields fields;
+  fields.year = 2026;
+  fields.month = 2;
+  fields.day = 23;
+  fields.hour = 14;
+  fields.minute = 5;
+  fields.second = 9;
+  fields.item = item;
+  return fields;
+}
+
+const wchar_t* Ext(int i) { return i % 2 ? L".png" : L".txt"; }
+
+// The first `existing` names of the plain .txt family.
+void AddExisting(const ptf::NameTemplate& name, int existing, ptf::NameIndex* index,
+                 std::unordered_set<std::wstring>* taken) {
+  std::wstring file;
+  for (int seq = name.FirstSeq(); seq < name.FirstSeq() + existing; seq++) {
+    file.clear();
+    name.Append(Fields(0), seq, L".txt", &file);
+    if (index) index->Add(file);
+    if (taken) taken->insert(file);
+  }
+}
+
+// Names `files` files with NextFree; returns the last sequence number.
+int NameIndexed(const ptf::NameTemplate& name, int files, int existing) {
+  ptf::NameIndex index;
+  AddExisting(name, existing, &index, nullptr);
+  std::wstring file;
+  int seq = 0;
+  for (int i = 0; i < files; i++) {
+    const ptf::NameFields fields = Fields(i / 2 % 8);
+    seq = index.NextFree(name, fields, Ext(i));
+    file.clear();
+    name.Append(fields, seq, Ext(i), &file);
+    index.MarkUsed(file);
+  }
+  return seq;
+}
+
+// The same, trying every candidate from the first sequence number.
+int NameProbed(const ptf::NameTemplate& name, int files, int existing) {
+  std::unordered_set<std::wstring> taken;
+  AddExisting(name, existing, nullptr, &taken);
+  std::wstring file;
+  int seq = 0;
+  for (int i = 0; i < files; i++) {
+    const ptf::NameFields fields = Fields(i / 2 % 8);
+    for (seq = name.FirstSeq();; seq++) {
+      file.clear();
+      name.Append(fields, seq, Ext(i), &file);
+      if (taken.count(file) == 0) break;
+    }
+    taken.insert(file);
+  }
+  return seq;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int files = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 5000));
+  const int existing = static_cast<int>(ptf_bench::ArgOr(argc, argv, 2, 500));
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 3, 5));
+  // Each family of 16 takes files / 16 names, the plain .txt one `existing` more.
+  if (files / 16 + 1 + existing >= ptf::NameIndex::kMaxSuffix) {
+    std::fprintf(stderr, "files / 16 + existing must be below %d\n", ptf::NameIndex::kMaxSuffix);
+    return 1;
+  }
+
+  struct Pattern {
+    const char* name;
+    ptf::NameTemplate compiled;
+  };
+  Pattern patterns[] = {{"default", {}}, {"custom", {}}};
+  std::wstring error;
+  if (!patterns[1].compiled.Compile(kCustom, &error)) {
+    std::fprintf(stderr, "template rejected\n");
+    return 1;
+  }
+
+  std::printf("%d files, %d already in the folder; best of %d\n\n", files, existing, runs);
+  std::printf("%-9s %12s %12s %15s %14s\n", "template", "compile us", "render ns",
+              "indexed ns/file", "probed ns/file");
+  for (Pattern& pattern : patterns) {
+    const std::wstring source = &pattern == &patterns[0] ? ptf::NameTemplate::kDefault : kCustom;
+    const int compiles = 10000;
+    ptf::NameTemplate scratch;
+    const double compileMs = ptf_bench::BestMs(runs, [&] {
+      for (int i = 0; i < compiles; i++) scratch.Compile(source, &error);
+    });
+
+    const int renders = 100000;
+    std::wstring file;
+    file.reserve(128);
+    size_t sink = 0;
+    const double renderMs = ptf_bench::BestMs(runs, [&] {
+      for (int i = 0; i < renders; i++) {
+        file.clear();
+        pattern.compiled.Append(Fields(i % 8), i % 1000, Ext(i), &file);
+        sink += file.size();
+      }
+    });
+
+    int indexed = 0, probed = 0;
+    const double indexedMs = ptf_bench::BestMs(
+        runs, [&] { indexed = NameIndexed(pattern.compiled, files, existing); });
+    const double probedMs = ptf_bench::BestMs(
+        runs, [&] { probed = NameProbed(pattern.compiled, files, existing); });
+    std::printf("%-9s %12.3f %12.1f %15.1f %14.1f\n", pattern.name, compileMs * 1000 / compiles,
+                renderMs * 1e6 / renders, indexedMs * 1e6 / files, probedMs * 1e6 / files);
+    if (indexed != probed) {
+      std::printf("the two disagree\n");
+      return 1;
+    }
+    if (sink == 0) std::printf("(nothing rendered)\n");
+  }
+  return 0;
+}
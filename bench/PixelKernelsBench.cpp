@@ -0,0 +1,139 @@
+// Pixel kernels: throughput of each row kernel in MB/s of input with the
+// scalar reference and with every vector set this CPU has (SetKernelIsa), and
+// the best one's speedup over scalar.
+//
+//   pixel_kernels_bench [width] [height] [runs]    (default 3840 x 2160, 5 runs)
+//
+// The input is a screenshot-like BGRA image. AnyAlpha32 gets it with every
+// alpha byte zero and ScanOpaqueGray32 an opaque gray copy, so both scan the
+// whole image rather than stopping at the first pixel. Kernels without an
+// AVX2 version run their SSE2 one in the AVX2 column.
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "PixelKernels.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+
+namespace {
+
+const char* IsaName(KernelIsa isa) {
+  switch (isa) {
+    case KernelIsa::Scalar:
+      return "scalar";
+    case KernelIsa::Sse2:
+      return "sse2";
+    case KernelIsa::Avx2:
+      return "avx2";
+  }
+  return "?";
+}
+
+struct Kernel {
+  const char* name;
+  size_t inputBytes;
+  std::function<void()> run;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const uint32_t width = static_cast<uint32_t>(ptf_bench::ArgOr(argc, argv, 1, 3840));
+  const uint32_t height = static_cast<uint32_t>(ptf_bench::ArgOr(argc, argv, 2, 2160));
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 3, 5));
+  const ptf_test::TestImage image = ptf_test::MakeScreenshot(width, height, PixelFormat::Bgra8);
+  const size_t pixels = size_t{width} * height;
+  const size_t stride = size_t{width} * 4;
+  const size_t bytes = image.pixels.size();
+  const uint8_t* bgra = image.pixels.data();
+
+  std::vector<uint8_t> noAlpha = image.pixels;
+  for (size_t i = 0; i < pixels; i++) noAlpha[i * 4 + 3] = 0;
+  std::vector<uint8_t> gray = image.pixels;
+  for (size_t i = 0; i < pixels; i++) {
+    gray[i * 4 + 1] = gray[i * 4 + 2] = gray[i * 4];
+    gray[i * 4 + 3] = 0xFF;
+  }
+  std::vector<uint8_t> rgb(pixels * 3);
+  std::vector<uint8_t> out(bytes);
+  std::vector<uint8_t> scratch(5 * (stride + 1));
+  std::vector<uint8_t> zeroRow(stride, 0);
+  volatile uint64_t sink = 0;  // keeps results the compiler could drop
+
+  // Filter kernels run over every row, with the row above as `prev`.
+  auto row = [&](uint32_t y) { return bgra + y * stride; };
+  auto prev = [&](uint32_t y) { return y > 0 ? row(y - 1) : zeroRow.data(); };
+  const Kernel kernels[] = {
+      {"SwapRedBlue32", bytes, [&] { SwapRedBlue32(bgra, out.data(), pixels); }},
+      {"Bgrx32ToRgb24", bytes, [&] { Bgrx32ToRgb24(bgra, rgb.data(), pixels); }},
+      {"SwapRedBlue24", rgb.size(), [&] { SwapRedBlue24(rgb.data(), out.data(), pixels); }},
+      {"AnyAlpha32", bytes, [&] { sink = sink + AnyAlpha32(noAlpha.data(), pixels); }},
+      {"ScanOpaqueGray32", bytes,
+       [&] {
+         bool opaque = true;
+         bool allGray = true;
+         ScanOpaqueGray32(gray.data(), pixels, &opaque, &allGray);
+         sink = sink + opaque + allGray;
+       }},
+      {"FlipRowsInPlace", bytes, [&] { FlipRowsInPlace(out.data(), stride, height); }},
+      {"PngFilterSub", bytes,
+       [&] {
+         for (uint32_t y = 0; y < height; y++) PngFilterSub(row(y), stride, 4, out.data());
+       }},
+      {"PngFilterUp", bytes,
+       [&] {
+         for (uint32_t y = 0; y < height; y++) PngFilterUp(row(y), prev(y), stride, out.data());
+       }},
+      {"PngFilterAverage", bytes,
+       [&] {
+         for (uint32_t y = 0; y < height; y++) {
+           PngFilterAverage(row(y), prev(y), stride, 4, out.data());
+         }
+       }},
+      {"PngFilterPaeth", bytes,
+       [&] {
+         for (uint32_t y = 0; y < height; y++) {
+           PngFilterPaeth(row(y), prev(y), stride, 4, out.data());
+         }
+       }},
+      {"SumAbsSigned", bytes, [&] { sink = sink + SumAbsSigned(bgra, bytes); }},
+      {"PngFilterRowAdaptive", bytes,
+       [&] {
+         for (uint32_t y = 0; y < height; y++) {
+           sink = sink + PngFilterRowAdaptive(row(y), prev(y), stride, 4, scratch.data())[0];
+         }
+       }},
+  };
+
+  const KernelIsa detected = DetectKernelIsa();
+  const KernelIsa saved = GetKernelIsa();
+  std::vector<KernelIsa> isas = {KernelIsa::Scalar};
+  if (detected != KernelIsa::Scalar) isas.push_back(KernelIsa::Sse2);
+  if (detected == KernelIsa::Avx2) isas.push_back(KernelIsa::Avx2);
+
+  std::printf("%ux%u BGRA (%.1f MB), best of %d, MB/s of input\n\n", width, height,
+              bytes / 1e6, runs);
+  std::printf("%-22s", "kernel");
+  for (KernelIsa isa : isas) std::printf(" %10s", IsaName(isa));
+  std::printf(" %9s\n", "speedup");
+  for (const Kernel& kernel : kernels) {
+    std::printf("%-22s", kernel.name);
+    double scalarMs = 0;
+    double bestMs = 0;
+    for (KernelIsa isa : isas) {
+      SetKernelIsa(isa);
+      kernel.run();  // warm up
+      const double ms = ptf_bench::BestMs(runs, kernel.run);
+      if (isa == KernelIsa::Scalar) scalarMs = ms;
+      if (bestMs == 0 || ms < bestMs) bestMs = ms;
+      std::printf(" %10.0f", ptf_bench::MegabytesPerSecond(kernel.inputBytes, ms));
+    }
+    std::printf(" %8.2fx\n", bestMs > 0 ? scalarMs / bestMs : 0);
+  }
+  SetKernelIsa(saved);
+  return 0;
+}
@@ -0,0 +1,47 @@
+// Parallel PNG compression: encode time of a screenshot-like image against the
+// number of deflate threads.
+//
+//   png_threads_bench [width] [height] [runs]    (default 3840 x 2160, 3 runs)
+
+#include <cstdio>
+#include <thread>
+
+#include "BenchUtil.h"
+#include "ByteSink.h"
+#include "PngEncoder.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+
+int main(int argc, char** argv) {
+  const uint32_t width = static_cast<uint32_t>(ptf_bench::ArgOr(argc, argv, 1, 3840));
+  const uint32_t height = static_cast<uint32_t>(ptf_bench::ArgOr(argc, argv, 2, 2160));
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 3, 3));
+  const ptf_test::TestImage image = ptf_test::MakeScreenshot(width, height, PixelFormat::Bgra8);
+  const size_t inputBytes = image.pixels.size();
+
+  unsigned cores = std::thread::hardware_concurrency();
+  if (cores == 0) cores = 1;
+  std::printf("%ux%u BGRA (%.1f MB), %u hardware threads, best of %d\n", width, height,
+              inputBytes / 1e6, cores, runs);
+  std::printf("%8s %10s %10s %9s %12s\n", "threads", "ms", "MB/s", "speedup", "png bytes");
+
+  double serialMs = 0;
+  for (unsigned threads = 1; threads <= cores * 2; threads *= 2) {
+    PngEncodeOptions options;
+    options.threads = threads;
+    options.reduceColors = false;
+    PngEncodeSession session(options);
+    size_t pngBytes = 0;
+    const double ms = ptf_bench::BestMs(runs, [&] {
+      MemorySink sink;
+      sink.bytes.reserve(inputBytes / 4);
+      session.Encode(image.Source(), &sink);
+      pngBytes = sink.bytes.size();
+    });
+    if (threads == 1) serialMs = ms;
+    std::printf("%8u %10.1f %10.1f %8.2fx %12zu\n", threads, ms,
+                ptf_bench::MegabytesPerSecond(inputBytes, ms), serialMs / ms, pngBytes);
+  }
+  return 0;
+}
@@ -0,0 +1,128 @@
+// QOI against PNG: encode time and output size over a screenshot corpus.
+//
+//   qoi_png_bench [runs] [file.bmp ...]
+//
+// Without files the corpus is synthetic (screenshots at common monitor sizes
+// and a photo-like image). Files are 24- or 32-bit BMPs, e.g. screenshots
+// saved from Paint. PNG is timed single-threaded at levels 1 and 6, the fair
+// comparison with QOI's single pass, and with one thread per core at level 6.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "ByteSink.h"
+#include "DibParse.h"
+#include "PngEncoder.h"
+#include "QoiEncoder.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+
+namespace {
+
+struct CorpusImage {
+  std::string name;
+  std::vector<uint8_t> bytes;  // owns the pixels `source` points at
+  PixelSource source;
+};
+
+bool LoadBmp(const char* path, CorpusImage* image) {
+  FILE* f = std::fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buffer[1 << 16];
+  size_t n = 0;
+  while ((n = std::fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    image->bytes.insert(image->bytes.end(), buffer, buffer + n);
+  }
+  std::fclose(f);
+  // BITMAPFILEHEADER (14 bytes), then a packed DIB.
+  constexpr size_t kFileHeader = 14;
+  if (image->bytes.size() < kFileHeader || image->bytes[0] != 'B' || image->bytes[1] != 'M') {
+    return false;
+  }
+  image->name = path;
+  return ParsePackedDib(image->bytes.data() + kFileHeader, image->bytes.size() - kFileHeader,
+                        &image->source);
+}
+
+CorpusImage Synthetic(const char* name, ptf_test::TestImage image) {
+  CorpusImage corpus;
+  corpus.name = name;
+  corpus.bytes = std::move(image.pixels);
+  corpus.source = image.Source();
+  corpus.source.pixels = corpus.bytes.data();
+  return corpus;
+}
+
+double TimePng(const PixelSource& source, int level, unsigned threads, int runs,
+               size_t* outBytes) {
+  PngEncodeOptions options;
+  options.compressionLevel = level;
+  options.threads = threads;
+  PngEncodeSession session(options);
+  return ptf_bench::BestMs(runs, [&] {
+    MemorySink sink;
+    session.Encode(source, &sink);
+    *outBytes = sink.bytes.size();
+  });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 3));
+  std::vector<CorpusImage> corpus;
+  for (int i = 2; i < argc; i++) {
+    CorpusImage image;
+    if (LoadBmp(argv[i], &image)) {
+      corpus.push_back(std::move(image));
+    } else {
+      std::fprintf(stderr, "skipping %s: not a 24- or 32-bit BMP\n", argv[i]);
+    }
+  }
+  if (corpus.empty()) {
+    using ptf_test::MakeScreenshot;
+    corpus.push_back(
+        Synthetic("screen 1920x1080", MakeScreenshot(1920, 1080, PixelFormat::Bgrx8, 1)));
+    corpus.push_back(
+        Synthetic("screen 2560x1440", MakeScreenshot(2560, 1440, PixelFormat::Bgrx8, 2)));
+    corpus.push_back(
+        Synthetic("screen 3840x2160", MakeScreenshot(3840, 2160, PixelFormat::Bgra8, 3)));
+    corpus.push_back(
+        Synthetic("photo 1920x1080", ptf_test::MakePhoto(1920, 1080, PixelFormat::Bgrx8)));
+  }
+
+  std::printf("best of %d; times in ms, sizes in KB\n", runs);
+  std::printf("%-24s %7s | %7s %7s | %7s %7s | %7s %7s | %7s\n", "image", "MB", "qoi", "size",
+              "png-1", "size", "png-6", "size", "png-6mt");
+  double qoiTotal = 0, png1Total = 0, png6Total = 0;
+  size_t qoiBytesTotal = 0, png1BytesTotal = 0, png6BytesTotal = 0;
+  for (const CorpusImage& image : corpus) {
+    const PixelSource& source = image.source;
+    const size_t inputBytes = source.stride * source.height;
+    size_t qoiBytes = 0, png1Bytes = 0, png6Bytes = 0, png6MtBytes = 0;
+    const double qoiMs = ptf_bench::BestMs(runs, [&] {
+      MemorySink sink;
+      EncodeQoi(source, &sink);
+      qoiBytes = sink.bytes.size();
+    });
+    const double png1Ms = TimePng(source, 1, 1, runs, &png1Bytes);
+    const double png6Ms = TimePng(source, 6, 1, runs, &png6Bytes);
+    const double png6MtMs = TimePng(source, 6, 0, runs, &png6MtBytes);
+    std::printf("%-24s %7.1f | %7.1f %7zu | %7.1f %7zu | %7.1f %7zu | %7.1f\n",
+                image.name.c_str(), inputBytes / 1e6, qoiMs, qoiBytes / 1024, png1Ms,
+                png1Bytes / 1024, png6Ms, png6Bytes / 1024, png6MtMs);
+    qoiTotal += qoiMs, png1Total += png1Ms, png6Total += png6Ms;
+    qoiBytesTotal += qoiBytes, png1BytesTotal += png1Bytes, png6BytesTotal += png6Bytes;
+  }
+  if (qoiTotal > 0 && qoiBytesTotal > 0) {
+    std::printf("QOI is %.1fx faster than PNG level 1 and %.1fx faster than level 6;\n",
+                png1Total / qoiTotal, png6Total / qoiTotal);
+    std::printf("its files are %.2fx and %.2fx the size.\n",
+                static_cast<double>(qoiBytesTotal) / png1BytesTotal,
+                static_cast<double>(qoiBytesTotal) / png6BytesTotal);
+  }
+  return 0;
+}
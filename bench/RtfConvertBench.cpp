@@ -0,0 +1,167 @@
+// RTF to text and to HTML throughput in MB/s of RTF, per kind of document,
+// fed in 64 KiB pieces as the converter reads the clipboard block.
+//
+//   rtf_convert_bench [runs] [megabytes]
+//
+// The documents are generated: Word-style paragraphs with formatting and a
+// font table, Cyrillic text in \'hh escapes (windows-1251), \uN escapes, a
+// long table, and a document that is mostly hex picture data and \bin
+// objects, which are skipped. Output goes to a sink that only counts it.
+
+#include <cstdio>
+#include <string>
+
+#include "BenchUtil.h"
+#include "ByteSink.h"
+#include "RtfConvert.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+
+namespace {
+
+class CountingSink : public ByteSink {
+ public:
+  bool Write(const uint8_t*, size_t size) override {
+    bytes += size;
+    return true;
+  }
+  size_t bytes = 0;
+};
+
+const char kHeader[] =
+    "{\\rtf1\\ansi\\ansicpg1252\\deff0{\\fonttbl{\\f0\\fswiss\\fcharset0 Calibri;}"
+    "{\\f1\\froman\\fcharset204 Times New Roman Cyr;}}"
+    "{\\colortbl;\\red0\\green0\\blue255;}{\\*\\generator Msftedit 5.41.21.2510;}"
+    "\\viewkind4\\uc1\\pard\\sa200\\sl276\\slmult1\\lang9\\f0\\fs22 ";
+
+std::string Words(ptf_test::Random* random, uint32_t count) {
+  static const char* const kWords[] = {"clipboard", "paste", "file",  "the", "a",    "of",
+                                       "document",  "rich",  "table", "and", "font", "text"};
+  std::string text;
+  for (uint32_t i = 0; i < count; i++) {
+    text += (i ? " " : "") + std::string(kWords[random->Below(12)]);
+  }
+  return text;
+}
+
+// Repeats `block` (called with a counter) until the document holds `bytes`.
+template <typename Block>
+std::string MakeDocument(size_t bytes, Block block) {
+  std::string rtf = kHeader;
+  for (uint32_t i = 0; rtf.size() < bytes; i++) rtf += block(i);
+  return rtf + "}";
+}
+
+std::string Formatted(size_t bytes) {
+  ptf_test::Random random(1);
+  return MakeDocument(bytes, [&](uint32_t i) {
+    return Words(&random, 12) + " {\\b " + Words(&random, 2) + "}\\i  " + Words(&random, 3) +
+           "\\i0  {\\field{\\*\\fldinst{HYPERLINK \"https://example.com/" + std::to_string(i) +
+           "\"}}{\\fldrslt{\\ul\\cf1 link}}} " + Words(&random, 8) + "\\par\n";
+  });
+}
+
+std::string Cyrillic(size_t bytes) {
+  ptf_test::Random random(2);
+  return MakeDocument(bytes, [&](uint32_t) {
+    std::string text = "{\\f1 ";
+    for (int word = 0; word < 12; word++) {
+      for (uint32_t n = random.Below(7) + 2; n > 0; n--) {
+        char hex[5];
+        std::snprintf(hex, sizeof(hex), "\\'%02x", 0xE0 + random.Below(32));
+        text += hex;
+      }
+      text += ' ';
+    }
+    return text + "}\\par\n";
+  });
+}
+
+std::string Unicode(size_t bytes) {
+  ptf_test::Random random(3);
+  return MakeDocument(bytes, [&](uint32_t) {
+    std::string text;
+    for (int word = 0; word < 12; word++) {
+      for (uint32_t n = random.Below(4) + 1; n > 0; n--) {
+        text += "\\u" + std::to_string(0x4E00 + random.Below(0x5000)) + "?";
+      }
+      text += ' ';
+    }
+    return text + "\\par\n";
+  });
+}
+
+std::string Table(size_t bytes) {
+  ptf_test::Random random(4);
+  return MakeDocument(bytes, [&](uint32_t) {
+    std::string row = "\\trowd\\trgaph108\\cellx2000\\cellx5000\\cellx9000 ";
+    for (int cell = 0; cell < 3; cell++) row += "\\pard\\intbl " + Words(&random, 3) + "\\cell ";
+    return row + "\\row\n";
+  });
+}
+
+std::string Pictures(size_t bytes) {
+  ptf_test::Random random(5);
+  return MakeDocument(bytes, [&](uint32_t i) {
+    std::string block = Words(&random, 10) + "\\par\n";
+    if (i % 2 == 0) {
+      block += "{\\*\\shppict{\\pict\\pngblip\\picw100\\pich100 ";
+      static const char kHex[] = "0123456789abcdef";
+      for (int line = 0; line < 256; line++) {
+        for (int c = 0; c < 128; c++) block += kHex[random.Below(16)];
+        block += '\n';
+      }
+      block += "}}";
+    } else {
+      block += "{\\object\\objemb{\\*\\objdata\\bin4096 " + std::string(4096, '\x7B') + "}}";
+    }
+    return block;
+  });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 5));
+  const size_t bytes = ptf_bench::ArgOr(argc, argv, 2, 8) << 20;
+  const size_t piece = 64 * 1024;
+
+  struct Kind {
+    const char* name;
+    std::string rtf;
+  };
+  const Kind kinds[] = {
+      {"formatted", Formatted(bytes)}, {"cyrillic", Cyrillic(bytes)}, {"unicode", Unicode(bytes)},
+      {"table", Table(bytes)},         {"pictures", Pictures(bytes)},
+  };
+
+  TextEncodeOptions options;
+  options.eol = EolMode::Lf;
+  std::printf("best of %d over %zu MB of RTF, 64 KiB feeds; MB/s of RTF\n", runs, bytes >> 20);
+  std::printf("%-10s %10s %10s %10s %10s\n", "document", "text", "html", "text/rtf", "html/rtf");
+  for (const Kind& kind : kinds) {
+    double ms[2] = {};
+    size_t out[2] = {};
+    const RtfOutput outputs[] = {RtfOutput::Text, RtfOutput::Html};
+    for (int i = 0; i < 2; i++) {
+      CountingSink sink;
+      ms[i] = ptf_bench::BestMs(runs, [&] {
+        sink.bytes = 0;
+        RtfConverter converter(outputs[i], options, &sink);
+        for (size_t pos = 0; pos < kind.rtf.size(); pos += piece) {
+          const size_t n = kind.rtf.size() - pos < piece ? kind.rtf.size() - pos : piece;
+          converter.Feed(kind.rtf.data() + pos, n);
+        }
+        converter.Finish();
+      });
+      out[i] = sink.bytes;
+    }
+    std::printf("%-10s %10.1f %10.1f %10.2f %10.2f\n", kind.name,
+                ptf_bench::MegabytesPerSecond(kind.rtf.size(), ms[0]),
+                ptf_bench::MegabytesPerSecond(kind.rtf.size(), ms[1]),
+                static_cast<double>(out[0]) / kind.rtf.size(),
+                static_cast<double>(out[1]) / kind.rtf.size());
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+// UTF-8 <-> wide conversion throughput in GB/s of UTF-8, per kind of text.
+//
+//   utf_bench [runs] [megabytes]
+//
+// ASCII takes the vector fast paths throughout; Latin text mixes them with
+// two-byte sequences; CJK and emoji text are all three- and four-byte
+// sequences and so show the per-character cost.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "TestImages.h"
+
+#include "PasteToFileCommon/Utf.h"
+
+namespace {
+
+// Roughly `bytes` of UTF-8 built from the characters of `alphabet`, in
+// words of 1..8 characters separated by spaces and the odd line break.
+std::string MakeText(const std::wstring& alphabet, size_t bytes) {
+  // Split by character rather than by wchar_t, which may be half a pair.
+  std::vector<std::string> chars;
+  for (char c : ptf::WideToUtf8(alphabet)) {
+    if ((static_cast<uint8_t>(c) & 0xC0) != 0x80) chars.emplace_back();
+    chars.back().push_back(c);
+  }
+  ptf_test::Random random(7);
+  std::string utf8;
+  while (utf8.size() < bytes) {
+    for (uint32_t i = random.Below(8) + 1; i > 0; i--) {
+      utf8 += chars[random.Below(static_cast<uint32_t>(chars.size()))];
+    }
+    utf8 += random.Below(12) ? ' ' : '\n';
+  }
+  return utf8;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int runs = static_cast<int>(ptf_bench::ArgOr(argc, argv, 1, 5));
+  const size_t bytes = ptf_bench::ArgOr(argc, argv, 2, 16) << 20;
+
+  struct Kind {
+    const char* name;
+    std::wstring alphabet;
+  };
+  const Kind kinds[] = {
+      {"ascii", L"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,;"},
+      {"latin", L"abcdefghijklmnopqrstuvwxyz\u00e4\u00f6\u00fc\u00df\u00e9\u00e8\u00e7"},
+      {"cjk", L"\u65e5\u672c\u8a9e\u6587\u5b57\u5217\u5909\u63db\u6f22\u5b57\uc548\ub155"},
+      {"emoji", L"\U0001f600\U0001f60e\U0001f389\U0001f680\U0001f355"},
+  };
+
+  std::printf("best of %d over %zu MB of UTF-8; GB/s of UTF-8\n", runs, bytes >> 20);
+  std::printf("%-8s %10s %10s %10s\n", "text", "to wide", "to utf8", "validate");
+  for (const Kind& kind : kinds) {
+    const std::string utf8 = MakeText(kind.alphabet, bytes);
+    const std::wstring wide = ptf::Utf8ToWide(utf8);
+    size_t sink = 0;
+    const double toWideMs = ptf_bench::BestMs(runs, [&] { sink += ptf::Utf8ToWide(utf8).size(); });
+    const double toUtf8Ms = ptf_bench::BestMs(runs, [&] { sink += ptf::WideToUtf8(wide).size(); });
+    const double validateMs = ptf_bench::BestMs(runs, [&] { sink += ptf::IsWellFormedUtf8(utf8); });
+    std::printf("%-8s %10.2f %10.2f %10.2f\n", kind.name,
+                ptf_bench::MegabytesPerSecond(utf8.size(), toWideMs) / 1000,
+                ptf_bench::MegabytesPerSecond(utf8.size(), toUtf8Ms) / 1000,
+                ptf_bench::MegabytesPerSecond(utf8.size(), validateMs) / 1000);
+    if (sink == 0) std::printf("(nothing converted)\n");
+  }
+  return 0;
+}
@@ -0,0 +1,118 @@
+// WriteQueue: a history export's time with encoding and writing run one after
+// the other, and pipelined (the caller encodes while writer threads save).
+//
+//   write_queue_bench [items] [per-file latency ms] [share MB/s] [writers]
+//
+// Each item is a 1280x720 screenshot encoded to PNG on the calling thread, as
+// the helper does with WIC and its encoder session. Files go to a simulated
+// network folder: every file costs `latency` in round trips (create, rename,
+// close) and its bytes pass at `share MB/s`, with the data landing in a temp
+// file. Waits overlap across writers, as they do on a real share. The
+// pipelined time should approach the larger of encode-only and queued
+// write-only, not their sum.
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BenchUtil.h"
+#include "ByteSink.h"
+#include "PngEncoder.h"
+#include "TestImages.h"
+#include "WriteQueue.h"
+
+using namespace ptf_helper;
+
+namespace {
+
+struct Share {
+  double latencyMs;
+  double bytesPerSecond;
+};
+
+// One file to the simulated share.
+bool WriteFile(const Share& share, const std::vector<uint8_t>& bytes) {
+  const auto wait = std::chrono::duration<double, std::milli>(
+      share.latencyMs + bytes.size() * 1000.0 / share.bytesPerSecond);
+  const auto until = std::chrono::steady_clock::now() + wait;
+  FILE* f = std::tmpfile();
+  if (!f) return false;
+  const bool ok = std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+  std::fclose(f);
+  std::this_thread::sleep_until(until);
+  return ok;
+}
+
+std::vector<ptf_test::TestImage> MakeItems(uint32_t count) {
+  std::vector<ptf_test::TestImage> items;
+  for (uint32_t i = 0; i < count; i++) {
+    items.push_back(ptf_test::MakeScreenshot(1280, 720, PixelFormat::Bgra8, i + 1));
+  }
+  return items;
+}
+
+std::vector<uint8_t> Encode(PngEncodeSession* session, const ptf_test::TestImage& image) {
+  MemorySink png;
+  session->Encode(image.Source(), &png);
+  return std::move(png.bytes);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const uint32_t count = static_cast<uint32_t>(ptf_bench::ArgOr(argc, argv, 1, 25));
+  Share share;
+  share.latencyMs = static_cast<double>(ptf_bench::ArgOr(argc, argv, 2, 30));
+  share.bytesPerSecond = ptf_bench::ArgOr(argc, argv, 3, 50) * 1e6;
+  const unsigned writers = static_cast<unsigned>(ptf_bench::ArgOr(argc, argv, 4, 4));
+  const size_t budget = size_t{128} << 20;
+
+  const std::vector<ptf_test::TestImage> items = MakeItems(count);
+  PngEncodeOptions options;
+  options.threads = 1;
+  PngEncodeSession session(options);
+
+  std::vector<std::vector<uint8_t>> files(count);
+  const double encodeMs = ptf_bench::BestMs(1, [&] {
+    for (uint32_t i = 0; i < count; i++) files[i] = Encode(&session, items[i]);
+  });
+  size_t totalBytes = 0;
+  for (const std::vector<uint8_t>& file : files) totalBytes += file.size();
+
+  const double serialWriteMs = ptf_bench::BestMs(1, [&] {
+    for (const std::vector<uint8_t>& file : files) WriteFile(share, file);
+  });
+  const double queuedWriteMs = ptf_bench::BestMs(1, [&] {
+    WriteQueue queue(writers, budget);
+    for (const std::vector<uint8_t>& file : files) {
+      queue.Submit(file.size(), [&share, &file] { return WriteFile(share, file); });
+    }
+    queue.Wait();
+  });
+  const double serialMs = ptf_bench::BestMs(1, [&] {
+    for (uint32_t i = 0; i < count; i++) WriteFile(share, Encode(&session, items[i]));
+  });
+  const double pipelinedMs = ptf_bench::BestMs(1, [&] {
+    WriteQueue queue(writers, budget);
+    for (uint32_t i = 0; i < count; i++) {
+      auto file = std::make_shared<std::vector<uint8_t>>(Encode(&session, items[i]));
+      queue.Submit(file->size(), [&share, file] { return WriteFile(share, *file); });
+    }
+    queue.Wait();
+  });
+
+  std::printf("%u items, %.1f MB of PNG; share: %.0f ms per file, %.0f MB/s; %u writers\n\n",
+              count, totalBytes / 1e6, share.latencyMs, share.bytesPerSecond / 1e6, writers);
+  std::printf("%-28s %10s\n", "", "ms");
+  std::printf("%-28s %10.1f\n", "encode only", encodeMs);
+  std::printf("%-28s %10.1f\n", "write only, one at a time", serialWriteMs);
+  std::printf("%-28s %10.1f\n", "write only, queued", queuedWriteMs);
+  std::printf("%-28s %10.1f\n", "encode, then write (serial)", serialMs);
+  std::printf("%-28s %10.1f\n", "pipelined (WriteQueue)", pipelinedMs);
+  const double bound = encodeMs > queuedWriteMs ? encodeMs : queuedWriteMs;
+  std::printf("\npipelined / max(encode, queued write) = %.2f\n", pipelinedMs / bound);
+  return 0;
+}
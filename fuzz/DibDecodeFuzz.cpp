@@ -0,0 +1,97 @@
+// Fuzz target for the DIB decoder. Whatever an app puts in CF_DIB/CF_DIBV5,
+// Open must stay inside the block, an embedded PNG/JPEG must be a view into
+// it, every band must decode the same however the image is split, and where
+// ParsePackedDib encodes the block in place both must give the same pixels.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "DibDecode.h"
+#include "DibParse.h"
+
+using namespace ptf_helper;
+
+namespace {
+
+// RLE images are expanded in Open (up to 2^28 pixels); keep runs fast.
+constexpr uint64_t kMaxRlePixels = 1u << 22;
+
+void Require(bool ok) {
+  if (!ok) std::abort();
+}
+
+uint32_t ReadLe32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool TooLargeRle(const uint8_t* data, size_t size) {
+  if (size < 20 || ReadLe32(data) < 40) return false;
+  const uint32_t compression = ReadLe32(data + 16);
+  if (compression != 1 && compression != 2) return false;
+  const int64_t width = static_cast<int32_t>(ReadLe32(data + 4));
+  const int64_t height = static_cast<int32_t>(ReadLe32(data + 8));
+  return width > 0 && height > 0 &&
+         static_cast<uint64_t>(width) * static_cast<uint64_t>(height) > kMaxRlePixels;
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (TooLargeRle(data, size)) return 0;
+  DibDecoder decoder;
+  if (!decoder.Open(data, size)) return 0;
+  Require(!decoder.Open(data, size));  // once only
+
+  if (decoder.Embedded() != ImageContainer::Unknown) {
+    const uint8_t* begin = decoder.EmbeddedData();
+    Require(begin >= data && decoder.EmbeddedSize() > 0 &&
+            decoder.EmbeddedSize() <= size - static_cast<size_t>(begin - data));
+    PixelSource band;
+    Require(!decoder.ReadBand(0, 1, &band));
+    return 0;
+  }
+
+  const uint32_t width = decoder.Width();
+  const uint32_t height = decoder.Height();
+  Require(width > 0 && height > 0 && decoder.Format() == PixelFormat::Rgba8);
+  PixelSource band;
+  Require(!decoder.ReadBand(height, 1, &band) && !decoder.ReadBand(0, height + 1, &band));
+  Require(!decoder.ReadBand(0, 0, &band));
+
+  // The whole image in one band, then again in bands of 1..7 rows.
+  const size_t stride = static_cast<size_t>(width) * 4;
+  if (stride * height > (size_t{64} << 20)) return 0;
+  Require(decoder.ReadBand(0, height, &band));
+  Require(band.width == width && band.height == height && band.stride == stride);
+  Require(band.format == PixelFormat::Rgba8 && !band.bottomUp);
+  const std::vector<uint8_t> whole(band.pixels, band.pixels + stride * height);
+  const uint32_t step = 1 + data[size - 1] % 7;
+  for (uint32_t y = 0; y < height; y += step) {
+    const uint32_t rows = std::min(step, height - y);
+    Require(decoder.ReadBand(y, rows, &band) && band.height == rows);
+    Require(std::memcmp(band.pixels, whole.data() + y * stride, stride * rows) == 0);
+  }
+
+  PixelSource inPlace;
+  if (ParsePackedDib(data, size, &inPlace)) {
+    Require(inPlace.width == width && inPlace.height == height);
+    const size_t bytes = BytesPerPixel(inPlace.format);
+    for (uint32_t y = 0; y < height; y++) {
+      const uint8_t* row =
+          inPlace.pixels + (inPlace.bottomUp ? height - 1 - y : y) * inPlace.stride;
+      const uint8_t* decoded = whole.data() + y * stride;
+      for (uint32_t x = 0; x < width; x++, row += bytes, decoded += 4) {
+        const uint32_t argb = PackArgb(row, inPlace.format);
+        const uint32_t rgba = (static_cast<uint32_t>(decoded[3]) << 24) |
+                              (decoded[0] << 16) | (decoded[1] << 8) | decoded[2];
+        Require(argb == rgba);
+      }
+    }
+  }
+  return 0;
+}
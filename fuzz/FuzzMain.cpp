@@ -0,0 +1,200 @@
+// Runs a fuzz target without libFuzzer: each file named on the command line
+// (directories are read recursively), then -runs=N inputs made by mutating
+// them with a fixed seed, so a failing run reproduces. Mutations insert tokens
+// from a libFuzzer-format -dict file, so they reach past the first check. Used
+// where the compiler has no -fsanitize=fuzzer, and by ctest as a smoke test.
+// The input being run when the target aborts or crashes is written to
+// ./fuzz-crash.
+//
+//   <target> [-runs=N] [-seed=N] [-dict=file] [file or directory ...]
+
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace {
+
+constexpr size_t kMaxInput = 256 * 1024;
+
+const std::vector<uint8_t>* g_current = nullptr;
+
+void SaveCrash(int signal) {
+  if (g_current) {
+    if (FILE* f = std::fopen("fuzz-crash", "wb")) {
+      std::fwrite(g_current->data(), 1, g_current->size(), f);
+      std::fclose(f);
+    }
+    std::fprintf(stderr, "signal %d; input written to fuzz-crash\n", signal);
+  }
+  std::signal(signal, SIG_DFL);
+  std::raise(signal);
+}
+
+// Copies into a buffer of exactly the input's size, so a sanitizer sees any
+// read past its end.
+void Run(const std::vector<uint8_t>& input) {
+  g_current = &input;
+  const std::vector<uint8_t> copy(input);
+  LLVMFuzzerTestOneInput(copy.empty() ? nullptr : copy.data(), copy.size());
+  g_current = nullptr;
+}
+
+class Random {
+ public:
+  explicit Random(uint32_t seed) : state_(seed ? seed : 1) {}
+  uint32_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+  }
+  size_t Below(size_t n) { return n ? Next() % n : 0; }
+
+ private:
+  uint32_t state_;
+};
+
+using Token = std::vector<uint8_t>;
+
+// Values that sit on size and sign boundaries, for binary fields.
+constexpr uint32_t kInteresting[] = {0, 1, 2, 0x7F, 0x80, 0xFF, 0x100, 0x7FFF, 0x8000, 0xFFFF,
+                                     0x10000, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF};
+
+void Mutate(std::vector<uint8_t>* input, const std::vector<Token>& tokens, Random* random) {
+  for (size_t edits = 1 + random->Below(4); edits > 0; edits--) {
+    const size_t pos = random->Below(input->size() + 1);
+    switch (random->Below(7)) {
+      case 0:
+        if (pos < input->size()) (*input)[pos] ^= static_cast<uint8_t>(1 << random->Below(8));
+        break;
+      case 1:
+        input->insert(input->begin() + pos, static_cast<uint8_t>(random->Next()));
+        break;
+      case 2:
+        input->erase(input->begin() + pos,
+                     input->begin() + pos + random->Below(input->size() - pos + 1));
+        break;
+      case 3:
+        if (!tokens.empty()) {
+          const Token& token = tokens[random->Below(tokens.size())];
+          input->insert(input->begin() + pos, token.begin(), token.end());
+        }
+        break;
+      case 4: {  // a decimal number, as an offset might be
+        const std::string number = std::to_string(random->Below(input->size() + 16));
+        input->insert(input->begin() + pos, number.begin(), number.end());
+        break;
+      }
+      case 5: {  // a little-endian 1-, 2- or 4-byte field, as a header holds
+        const size_t width = size_t{1} << random->Below(3);
+        const uint32_t value =
+            kInteresting[random->Below(sizeof(kInteresting) / sizeof(kInteresting[0]))];
+        for (size_t i = 0; i < width && pos + i < input->size(); i++) {
+          (*input)[pos + i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+        break;
+      }
+      default:
+        if (pos < input->size()) {
+          const size_t length = random->Below(input->size() - pos) + 1;
+          const std::vector<uint8_t> piece(input->begin() + pos, input->begin() + pos + length);
+          input->insert(input->begin() + random->Below(input->size() + 1), piece.begin(),
+                        piece.end());
+        }
+        break;
+    }
+  }
+  if (input->size() > kMaxInput) input->resize(kMaxInput);
+}
+
+// Reads a libFuzzer dictionary: one `name="value"` or `"value"` per line,
+// with \\, \" and \xNN escapes; # starts a comment.
+bool ReadDictionary(const std::string& path, std::vector<Token>* tokens) {
+  std::ifstream in(path);
+  if (!in) return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    const size_t open = line.find('"');
+    const size_t close = line.rfind('"');
+    if (line.empty() || line[0] == '#' || open == std::string::npos || close <= open) continue;
+    Token token;
+    for (size_t i = open + 1; i < close; i++) {
+      if (line[i] == '\\' && i + 1 < close) {
+        if (line[i + 1] == 'x' && i + 3 < close) {
+          token.push_back(static_cast<uint8_t>(std::stoul(line.substr(i + 2, 2), nullptr, 16)));
+          i += 3;
+        } else {
+          token.push_back(static_cast<uint8_t>(line[++i]));
+        }
+      } else {
+        token.push_back(static_cast<uint8_t>(line[i]));
+      }
+    }
+    if (!token.empty()) tokens->push_back(std::move(token));
+  }
+  return true;
+}
+
+bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>* out) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return false;
+  out->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  unsigned long runs = 0;
+  uint32_t seed = 1;
+  std::vector<std::vector<uint8_t>> corpus;
+  std::vector<Token> tokens;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg.rfind("-dict=", 0) == 0) {
+      if (!ReadDictionary(arg.substr(6), &tokens)) {
+        std::fprintf(stderr, "cannot read %s\n", arg.c_str() + 6);
+        return 1;
+      }
+    } else if (arg.rfind("-runs=", 0) == 0) {
+      runs = std::strtoul(arg.c_str() + 6, nullptr, 10);
+    } else if (arg.rfind("-seed=", 0) == 0) {
+      seed = static_cast<uint32_t>(std::strtoul(arg.c_str() + 6, nullptr, 10));
+    } else if (std::filesystem::is_directory(arg)) {
+      for (const auto& entry : std::filesystem::recursive_directory_iterator(arg)) {
+        std::vector<uint8_t> input;
+        if (entry.is_regular_file() && ReadFile(entry.path(), &input)) {
+          corpus.push_back(std::move(input));
+        }
+      }
+    } else {
+      std::vector<uint8_t> input;
+      if (!ReadFile(arg, &input)) {
+        std::fprintf(stderr, "cannot read %s\n", argv[i]);
+        return 1;
+      }
+      corpus.push_back(std::move(input));
+    }
+  }
+
+  std::signal(SIGABRT, SaveCrash);
+  std::signal(SIGSEGV, SaveCrash);
+  for (const std::vector<uint8_t>& input : corpus) Run(input);
+  if (corpus.empty()) corpus.emplace_back();
+  Random random(seed);
+  for (unsigned long i = 0; i < runs; i++) {
+    std::vector<uint8_t> input = corpus[random.Below(corpus.size())];
+    Mutate(&input, tokens, &random);
+    Run(input);
+  }
+  std::printf("%zu corpus inputs and %lu mutations ran\n", corpus.size(), runs);
+  return 0;
+}
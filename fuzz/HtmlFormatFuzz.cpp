@@ -0,0 +1,57 @@
+// Fuzz target for the CF_HTML header parser. Whatever an app puts on the
+// clipboard, parsing must stay inside the block, every part returned must be
+// a view into it, and SelectHtmlPart must follow its documented fallbacks.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#include "HtmlFormat.h"
+
+using namespace ptf_helper;
+
+namespace {
+
+void Require(bool ok) {
+  if (!ok) std::abort();
+}
+
+bool Within(std::string_view data, std::string_view part) {
+  if (part.empty()) return true;
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(data.data());
+  const uintptr_t start = reinterpret_cast<uintptr_t>(part.data());
+  return start >= begin && start - begin <= data.size() &&
+         part.size() <= data.size() - (start - begin);
+}
+
+bool Same(std::string_view a, std::string_view b) {
+  return a.data() == b.data() && a.size() == b.size();
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* bytes, size_t size) {
+  const std::string_view data(reinterpret_cast<const char*>(bytes), size);
+  HtmlFormat header;
+  const bool ok = ParseHtmlFormat(data, &header);
+  Require(Within(data, header.version) && Within(data, header.sourceUrl));
+  Require(Within(data, header.document) && Within(data, header.fragment));
+  Require(ok || (header.document.empty() && header.fragment.empty()));
+
+  for (HtmlPart part : {HtmlPart::Document, HtmlPart::Fragment}) {
+    HtmlFormat selected;
+    const std::string_view view = SelectHtmlPart(data, part, &selected);
+    Require(Same(selected.document, header.document) && Same(selected.fragment, header.fragment));
+    std::string_view expected = data;
+    if (part == HtmlPart::Fragment && !header.fragment.empty()) {
+      expected = header.fragment;
+    } else if (!header.document.empty()) {
+      expected = header.document;
+    } else if (!header.fragment.empty()) {
+      expected = header.fragment;
+    }
+    Require(Same(view, expected));
+  }
+  return 0;
+}
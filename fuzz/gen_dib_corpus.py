@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Writes corpus/dib_decode_fuzz/: small packed DIBs (CF_DIB/CF_DIBV5 blocks)
+in every layout DibDecoder reads, as seeds for dib_decode_fuzz. Rerunning
+gives the same files.
+"""
+
+import os
+import random
+import struct
+import zlib
+
+OUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "corpus", "dib_decode_fuzz")
+rng = random.Random(20261017)
+
+BI_RGB, BI_RLE8, BI_RLE4, BI_BITFIELDS, BI_JPEG, BI_PNG, BI_ALPHABITFIELDS = 0, 1, 2, 3, 4, 5, 6
+
+
+def header(size, width, height, bpp, compression=BI_RGB, image_size=0, colors=0, masks=()):
+    if size == 12:
+        return struct.pack("<IHHHH", 12, width, height, 1, bpp)
+    h = struct.pack("<IiiHHIIiiII", size, width, height, 1, bpp, compression, image_size,
+                    2835, 2835, colors, 0)
+    for m in masks:
+        if len(h) < size:
+            h += struct.pack("<I", m)
+    return h.ljust(size, b"\0")
+
+
+def palette(n, core=False):
+    out = b""
+    for i in range(n):
+        out += bytes([i * 37 % 256, i * 91 % 256, i * 53 % 256]) + (b"" if core else b"\0")
+    return out
+
+
+def rows(width, height, bpp):
+    stride = (width * bpp + 31) // 32 * 4
+    return bytes(rng.randrange(256) for _ in range(stride * height))
+
+
+def png(width, height):
+    def chunk(kind, data):
+        body = kind + data
+        return struct.pack(">I", len(data)) + body + struct.pack(">I", zlib.crc32(body))
+    raw = b"".join(b"\0" + bytes(rng.randrange(256) for _ in range(width * 3))
+                   for _ in range(height))
+    return (b"\x89PNG\r\n\x1a\n" +
+            chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 2, 0, 0, 0)) +
+            chunk(b"IDAT", zlib.compress(raw)) + chunk(b"IEND", b""))
+
+
+RLE8 = bytes([3, 1, 0, 3, 2, 3, 4, 0, 0, 0, 2, 5, 0, 2, 2, 1, 2, 6, 0, 0, 10, 7, 0, 1])
+RLE4 = bytes([5, 0x12, 0, 0, 0, 3, 0x34, 0x50, 2, 0x67, 0, 2, 1, 0, 3, 0x89, 0, 1])
+PNG = png(3, 2)
+JPEG = b"\xff\xd8\xff\xe0\x00\x10JFIF\x00\x01\x01\x00\x00\x01\x00\x01\x00\x00\xff\xd9"
+
+SEEDS = {
+    "pal1.dib": header(40, 19, 4, 1, colors=2) + palette(2) + rows(19, 4, 1),
+    "pal4.dib": header(40, 9, 5, 4) + palette(16) + rows(9, 5, 4),
+    "pal8_core.dib": header(12, 7, 3, 8) + palette(256, core=True) + rows(7, 3, 8),
+    "pal8_short_table.dib": header(40, 5, -3, 8, colors=12) + palette(12) + rows(5, 3, 8),
+    "rle8.dib": header(40, 6, 4, 8, BI_RLE8, len(RLE8), 16) + palette(16) + RLE8,
+    "rle4.dib": header(40, 5, 3, 4, BI_RLE4, len(RLE4), 16) + palette(16) + RLE4,
+    "rgb16_555.dib": header(40, 6, 3, 16) + rows(6, 3, 16),
+    "bitfields16_565.dib": header(40, 5, 4, 16, BI_BITFIELDS) +
+        struct.pack("<III", 0xF800, 0x07E0, 0x001F) + rows(5, 4, 16),
+    "alphabitfields16_4444.dib": header(40, 4, 4, 16, BI_ALPHABITFIELDS) +
+        struct.pack("<IIII", 0x0F00, 0x00F0, 0x000F, 0xF000) + rows(4, 4, 16),
+    "rgb24_top_down.dib": header(40, 5, -4, 24) + rows(5, 4, 24),
+    "rgb32_zero_alpha.dib": header(40, 4, 3, 32) + bytes(x if i % 4 != 3 else 0
+                                                        for i, x in enumerate(rows(4, 3, 32))),
+    "v5_bgra.dib": header(124, 4, 4, 32, BI_BITFIELDS,
+                          masks=(0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000)) +
+        rows(4, 4, 32),
+    "v5_masks_repeated.dib": header(124, 3, 2, 32, BI_BITFIELDS,
+                                    masks=(0x00FF0000, 0x0000FF00, 0x000000FF, 0)) +
+        struct.pack("<III", 0x00FF0000, 0x0000FF00, 0x000000FF) + rows(3, 2, 32),
+    "v4_rgba.dib": header(108, 3, -3, 32, BI_BITFIELDS,
+                          masks=(0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000)) +
+        rows(3, 3, 32),
+    "v5_a2r10g10b10.dib": header(124, 3, 3, 32, BI_BITFIELDS,
+                                 masks=(0x3FF00000, 0x000FFC00, 0x000003FF, 0xC0000000)) +
+        rows(3, 3, 32),
+    "png.dib": header(124, 3, 2, 0, BI_PNG, len(PNG)) + PNG,
+    "jpeg.dib": header(124, 1, 1, 0, BI_JPEG, len(JPEG)) + JPEG,
+}
+
+os.makedirs(OUT, exist_ok=True)
+for name, data in SEEDS.items():
+    with open(os.path.join(OUT, name), "wb") as f:
+        f.write(data)
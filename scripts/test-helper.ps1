@@ -54,6 +54,44 @@ function Set-ClipboardText([string]$text) {
   Set-Clipboard -Value $text
 }
 
+function Set-ClipboardNarrowText([byte[]]$bytes, [int]$lcid, [string]$unicode = "") {
+  # CF_TEXT (and CF_LOCALE), as older apps set it; Windows synthesizes the rest. With
+  # $unicode, CF_UNICODETEXT is set after CF_TEXT, as apps that write '?' for what the
+  # code page lacks do.
+  if (-not ("PtfNarrowClip" -as [type])) {
+    Add-Type -TypeDefinition @"
+using System;
+using System.Runtime.InteropServices;
+public static class PtfNarrowClip {
+  [DllImport("user32.dll", SetLastError = true)] static extern bool OpenClipboard(IntPtr owner);
+  [DllImport("user32.dll")] static extern bool EmptyClipboard();
+  [DllImport("user32.dll")] static extern bool CloseClipboard();
+  [DllImport("user32.dll")] static extern IntPtr SetClipboardData(uint format, IntPtr mem);
+  [DllImport("kernel32.dll")] static extern IntPtr GlobalAlloc(uint flags, UIntPtr size);
+  [DllImport("kernel32.dll")] static extern IntPtr GlobalLock(IntPtr mem);
+  [DllImport("kernel32.dll")] static extern bool GlobalUnlock(IntPtr mem);
+  static IntPtr Block(byte[] bytes) {
+    IntPtr h = GlobalAlloc(0x0042, (UIntPtr)(bytes.Length + 1));  // GHND: zeroed
+    Marshal.Copy(bytes, 0, GlobalLock(h), bytes.Length);
+    GlobalUnlock(h);
+    return h;
+  }
+  public static void Set(byte[] text, int lcid, string unicode) {
+    if (!OpenClipboard(IntPtr.Zero)) throw new InvalidOperationException("OpenClipboard");
+    EmptyClipboard();
+    SetClipboardData(1, Block(text));  // CF_TEXT
+    if (lcid != 0) SetClipboardData(16, Block(BitConverter.GetBytes(lcid)));  // CF_LOCALE
+    if (!String.IsNullOrEmpty(unicode)) {
+      SetClipboardData(13, Block(System.Text.Encoding.Unicode.GetBytes(unicode + "\0")));
+    }
+    CloseClipboard();
+  }
+}
+"@
+  }
+  [PtfNarrowClip]::Set($bytes, $lcid, $unicode)
+}
+
 function Build-HtmlClipboardFormat([string]$htmlFragment) {
   # Minimal CF_HTML payload with correct byte offsets.
   # See https://learn.microsoft.com/en-us/windows/win32/dataxchg/html-clipboard-format
@@ -150,6 +188,19 @@ function Verify-Png([string]$dir) {
   Info "OK: $($f.Name) PNG decoded and matches expected pixel"
 }
 
+function Verify-Qoi([string]$dir) {
+  $f = LatestPtfFileByExt $dir ".qoi"
+  Assert-True ($null -ne $f) "Expected a .qoi file to be created"
+  $b = [System.IO.File]::ReadAllBytes($f.FullName)
+  Assert-True ($b.Length -gt 22) "QOI file too short: $($b.Length) bytes"
+  $magic = [System.Text.Encoding]::ASCII.GetString($b, 0, 4)
+  Assert-True ($magic -eq "qoif") "Unexpected QOI magic '$magic'"
+  $w = ($b[4] -shl 24) -bor ($b[5] -shl 16) -bor ($b[6] -shl 8) -bor $b[7]
+  $h = ($b[8] -shl 24) -bor ($b[9] -shl 16) -bor ($b[10] -shl 8) -bor $b[11]
+  Assert-True ($w -eq 32 -and $h -eq 32) "Unexpected QOI size: ${w}x${h}"
+  Info "OK: $($f.Name) QOI header matches"
+}
+
 Ensure-STA
 
 $root = Get-RepoRoot
@@ -179,6 +230,59 @@ $fTxt = LatestPtfFileByExt $testDir ".txt"
 Assert-True ($fTxt.Name -match "-01\.txt$") "Expected collision-suffixed file, got $($fTxt.Name)"
 Verify-TextFile $testDir ".txt" $t2
 
+Info "== Test 2b: Legacy CF_TEXT (UTF-8, code page 1252, '?' with CF_UNICODETEXT) =="
+$cafe = "caf" + [char]0xE9
+Set-ClipboardNarrowText ([System.Text.Encoding]::UTF8.GetBytes($cafe)) 0
+Run-Helper $helper $testDir "text-txt"
+Verify-TextFile $testDir ".txt" $cafe
+Set-ClipboardNarrowText ([byte[]](0x63, 0x61, 0x66, 0xE9)) 0x0409
+Run-Helper $helper $testDir "text-txt"
+Verify-TextFile $testDir ".txt" $cafe
+Set-ClipboardNarrowText ([System.Text.Encoding]::ASCII.GetBytes("caf?")) 0x0409 $cafe
+Run-Helper $helper $testDir "text-txt"
+Verify-TextFile $testDir ".txt" $cafe
+
+Info "== Test 2c: Compressed output (.txt.gz) =="
+$t2c = "Compressed PasteToFile test " * 1000
+Set-ClipboardText $t2c
+& $helper --target "$testDir" --action text-txt --gzip-above-mb 0 | Out-Null
+Assert-True ($LASTEXITCODE -eq 0) "Helper exited with $LASTEXITCODE for --gzip-above-mb"
+$fGz = LatestPtfFiles $testDir | Where-Object { $_.Name -like "*.txt.gz" } | Select-Object -Last 1
+Assert-True ($null -ne $fGz) "Expected a .txt.gz file to be created"
+$gzStream = New-Object System.IO.Compression.GZipStream(
+  [System.IO.File]::OpenRead($fGz.FullName), [System.IO.Compression.CompressionMode]::Decompress)
+$gzReader = New-Object System.IO.StreamReader($gzStream, [System.Text.Encoding]::UTF8)
+$gzText = $gzReader.ReadToEnd()
+$gzReader.Dispose()
+Assert-True ($gzText -eq $t2c) "Content mismatch for $($fGz.Name)"
+Info "OK: $($fGz.Name) decompresses to the copied text"
+
+Info "== Test 2d: Name template (clip-001.txt, clip-002.txt) =="
+$namedDir = Join-Path $testDir "named"
+New-Item -ItemType Directory -Path $namedDir | Out-Null
+Set-ClipboardText "Named PasteToFile test"
+foreach ($i in 1..2) {
+  & $helper --target "$namedDir" --action text-txt --name-template "clip-{seq:03}{ext}" | Out-Null
+  Assert-True ($LASTEXITCODE -eq 0) "Helper exited with $LASTEXITCODE for --name-template"
+}
+$named = (Get-ChildItem -Path $namedDir -File | Sort-Object Name | ForEach-Object { $_.Name }) -join ","
+Assert-True ($named -eq "clip-001.txt,clip-002.txt") "Unexpected names from --name-template: $named"
+Info "OK: $named"
+
+Info "== Test 2e: Dedup (skip, then hard link) =="
+$dedupDir = Join-Path $testDir "dedup"
+New-Item -ItemType Directory -Path $dedupDir | Out-Null
+Set-ClipboardText "Dedup PasteToFile test"
+foreach ($mode in "skip", "skip", "link") {
+  & $helper --target "$dedupDir" --action text-txt --dedup $mode | Out-Null
+  Assert-True ($LASTEXITCODE -eq 0) "Helper exited with $LASTEXITCODE for --dedup $mode"
+}
+$dedupFiles = @(Get-ChildItem -Path $dedupDir -File -Filter "PTF-*")
+Assert-True ($dedupFiles.Count -eq 2) "Expected one file and one link, got $($dedupFiles.Count)"
+$links = (& fsutil hardlink list $dedupFiles[0].FullName | Measure-Object).Count
+Assert-True ($links -eq 2) "Expected $($dedupFiles[0].Name) to have two names, got $links"
+Info "OK: repeated save skipped, then linked"
+
 Info "== Test 3: Markdown (.md) =="
 $md = "# Title`n`n- item1`n"
 Set-ClipboardText $md
@@ -190,6 +294,11 @@ Set-ClipboardTestImage
 Run-Helper $helper $testDir "png"
 Verify-Png $testDir
 
+Info "== Test 4b: Image (QOI) =="
+Set-ClipboardTestImage
+Run-Helper $helper $testDir "qoi"
+Verify-Qoi $testDir
+
 Info "== Test 5: HTML (.html) =="
 $htmlClip = Build-HtmlClipboardFormat "<b>Bold</b> and <i>italic</i>"
 Set-ClipboardRich "Plain fallback" $null $htmlClip
@@ -202,6 +311,17 @@ Set-ClipboardRich "Plain fallback" $rtf $null
 Run-Helper $helper $testDir "rtf"
 Verify-StartsWith $testDir ".rtf" "{\rtf1"
 
+Info "== Test 6b: RTF as Text / RTF as HTML =="
+Run-Helper $helper $testDir "rtf-txt"
+# The space after the font table group is document text.
+Verify-TextFile $testDir ".txt" " Hello RTF"
+Run-Helper $helper $testDir "rtf-html"
+Verify-StartsWith $testDir ".html" "<!DOCTYPE html>"
+$fHtml = LatestPtfFileByExt $testDir ".html"
+$rtfHtml = [System.IO.File]::ReadAllText($fHtml.FullName)
+Assert-True ($rtfHtml.Contains("Hello <b>RTF</b>")) "RTF as HTML lost the bold run"
+Info "OK: $($fHtml.Name) converted from RTF"
+
 Info "== Test 7: Save All Available Formats (txt/html/rtf) =="
 $htmlClip2 = Build-HtmlClipboardFormat "Fragment2"
 Set-ClipboardRich "SaveAll text" $rtf $htmlClip2
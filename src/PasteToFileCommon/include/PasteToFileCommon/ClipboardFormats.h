@@ -8,11 +8,16 @@ struct ClipboardFormatsAvailable {
   bool hasText = false;
   bool hasHtml = false;
   bool hasRtf = false;
-  bool hasImage = false;
+  bool hasImage = false;    // any of the formats below, or CF_DIBV5/CF_DIB/CF_BITMAP
+  bool hasPng = false;      // "PNG" or "image/png"
+  bool hasJpeg = false;     // "JFIF"
 };
 
 UINT GetHtmlClipboardFormat(); // "HTML Format"
 UINT GetRtfClipboardFormat();  // "Rich Text Format"
+UINT GetPngClipboardFormat();      // "PNG" (browsers, Office, most screenshot tools)
+UINT GetMimePngClipboardFormat();  // "image/png"
+UINT GetJfifClipboardFormat();     // "JFIF"
 
 // Uses IsClipboardFormatAvailable (does not require OpenClipboard).
 ClipboardFormatsAvailable QueryClipboardFormatsAvailable();
@@ -2,12 +2,21 @@
 
 #include <string>
 
+#include "PasteToFileCommon/NameIndex.h"
+#include "PasteToFileCommon/NameTemplate.h"
+
 namespace ptf {
 
-// Builds a base name like: PTF-2026-feb-23
-std::wstring BuildDatedBaseName();
+// The local time now, and the clipboard history item (0 = none), for
+// rendering a NameTemplate.
+NameFields CurrentNameFields(int historyItem = 0);
+
+// Adds the names in `dir` that start with `prefix` to `index`, with one
+// listing (the prefix filter runs on the server for network shares). False
+// when the directory cannot be listed; the index is then left as it was.
+bool IndexDirectory(const std::wstring& dir, const std::wstring& prefix, NameIndex* index);
 
-// Returns a full path with a collision-safe suffix:
+// Returns a full path with a collision-safe suffix (NameTemplate::kDefault):
 //   <dir>\\PTF-YYYY-mon-DD.ext
 //   <dir>\\PTF-YYYY-mon-DD-01.ext
 //   ...
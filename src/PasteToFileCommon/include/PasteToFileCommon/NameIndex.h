@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "PasteToFileCommon/NameTemplate.h"
+
+// The file names already in one directory, read with a single listing, so a
+// free name can be picked without probing the file system candidate by
+// candidate (each probe is a round trip on a network share).
+// Portable (no Windows headers); names compare case-insensitively. The index
+// only narrows the choice: callers still create with CREATE_NEW semantics and
+// move on when another process took the name first.
+
+namespace ptf {
+
+class NameIndex {
+ public:
+  // How many sequence numbers are tried for one name.
+  static constexpr int kMaxSuffix = 1000;
+
+  // A name found in the directory (no path).
+  void Add(std::wstring_view fileName);
+
+  // The lowest sequence number whose name is not known to exist, or -1 when
+  // the first kMaxSuffix are all taken. Each name (as rendered for the first
+  // sequence number) keeps a cursor past the numbers seen taken, so
+  // allocating names in turn is amortized O(1); candidates are rendered into
+  // a reused buffer.
+  int NextFree(const NameTemplate& name, const NameFields& fields, std::wstring_view ext);
+
+  // Records a name as taken: created by this process, or found to exist.
+  void MarkUsed(std::wstring_view fileName);
+
+  size_t Size() const { return names_.size(); }
+
+ private:
+  // Lower case, like everything in names_ and cursors_.
+  const std::wstring& Render(const NameTemplate& name, const NameFields& fields, int seq,
+                             std::wstring_view ext);
+
+  std::unordered_set<std::wstring> names_;
+  std::map<std::wstring, int, std::less<>> cursors_;
+  std::wstring scratch_;
+};
+
+} // namespace ptf
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Output file names from a pattern such as "{date:%Y%m%d}-{time}-{seq:03}-{fmt}{ext}".
+// The pattern is parsed once into a list of tokens; rendering a name appends to
+// a caller's buffer, so picking among many candidates allocates nothing.
+// Portable (no Windows headers).
+//
+// Fields:
+//   {date[:spec]}  local date, spec defaults to "%Y-%m-%d"
+//   {time[:spec]}  local time, spec defaults to "%H%M%S"
+//                  spec: %Y %y %m %b (jan..dec) %d %H %M %S %%, other text as is
+//   {seq}          "" for the first name, then "-01", "-02", ... (as unique names always were)
+//   {seq:N}        always present, from 1, zero-padded to N digits (1-9)
+//   {hist}         "-HIST-0001" for clipboard history item 1, "" otherwise
+//   {item[:N]}     the history item number padded to N digits (default 4), "" otherwise
+//   {ext}          the extension with its dot (".txt", ".html.gz")
+//   {fmt}          the extension without dots or compression suffix ("txt", "html")
+//   {{ }}          literal braces
+// Without {seq}, one is added before {ext}; without {ext}, it is added at the end.
+
+namespace ptf {
+
+// What a save's name is built from.
+struct NameFields {
+  uint16_t year = 0;
+  uint16_t month = 0;  // 1-12
+  uint16_t day = 0;
+  uint16_t hour = 0;
+  uint16_t minute = 0;
+  uint16_t second = 0;
+  int item = 0;  // clipboard history item (1-based); 0 = not from history
+};
+
+class NameTemplate {
+ public:
+  // The names the helper has always written: "PTF-2026-feb-23[-NN].txt",
+  // "PTF-2026-feb-23-HIST-0001[-NN].png".
+  static constexpr const wchar_t* kDefault = L"PTF-{date:%Y-%b-%d}{hist}{seq}{ext}";
+
+  NameTemplate();  // kDefault
+
+  // Replaces the template. False, with `error` set and the template left as it
+  // was, when the pattern is malformed or has characters file names cannot.
+  bool Compile(std::wstring_view pattern, std::wstring* error);
+
+  // The sequence number of the first candidate name (0 or 1).
+  int FirstSeq() const { return firstSeq_; }
+
+  // Appends the name for sequence number `seq` to `out`.
+  void Append(const NameFields& fields, int seq, std::wstring_view ext, std::wstring* out) const;
+
+  // Appends the start of the name up to the first field that is not part of
+  // the date: every name written on one day starts with it, so it is the
+  // filter for the single directory listing (see NameIndex).
+  void AppendListingPrefix(const NameFields& fields, std::wstring* out) const;
+
+ private:
+  enum class Op : uint8_t {
+    Literal,
+    Year,
+    Year2,
+    Month,
+    MonthName,
+    Day,
+    Hour,
+    Minute,
+    Second,
+    Hist,
+    Item,
+    SeqOptional,
+    Seq,
+    Ext,
+    Fmt,
+  };
+
+  struct Token {
+    Op op;
+    uint8_t width;    // Item, Seq
+    uint16_t offset;  // Literal: range in literals_
+    uint16_t length;
+  };
+
+  static bool IsDateOp(Op op);
+  void AppendToken(const Token& token, const NameFields& fields, int seq, std::wstring_view ext,
+                   std::wstring* out) const;
+
+  std::vector<Token> tokens_;
+  std::wstring literals_;
+  int firstSeq_ = 0;
+};
+
+} // namespace ptf
@@ -1,11 +1,41 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <string_view>
 
+// UTF-16 (UTF-32 where wchar_t is 4 bytes) <-> UTF-8 without the Win32 code
+// page APIs: one pass over the input, with a vectorized ASCII fast path.
+// Ill-formed input never fails; it is replaced with U+FFFD, as
+// WideCharToMultiByte/MultiByteToWideChar do without the *_ERR_INVALID_CHARS
+// flags:
+//   - a lone surrogate (or a wchar_t above U+10FFFF) becomes one U+FFFD
+//   - each maximal ill-formed UTF-8 subpart becomes one U+FFFD (Unicode 15,
+//     section 3.9 "U+FFFD substitution of maximal subparts")
+
 namespace ptf {
 
 std::string WideToUtf8(std::wstring_view wide);
 std::wstring Utf8ToWide(std::string_view utf8);
 
+// True when every sequence is well-formed UTF-8 (pure ASCII included), so the
+// bytes can be used as UTF-8 without conversion. ASCII is checked 16 bytes at
+// a time.
+bool IsWellFormedUtf8(std::string_view bytes);
+
+struct UtfChunkResult {
+  size_t consumed = 0;  // input units read
+  size_t written = 0;   // output units produced
+};
+
+// Streaming forms for input that arrives in pieces. Converts as much of the
+// input as fits in `capacity` output units. Unless `final` is set, a sequence
+// cut off at the end of the input (a high surrogate, a partial UTF-8 sequence)
+// is left unconsumed so it can be passed again with the next piece. Make
+// progress with capacity >= 4 (bytes) or >= 2 (wchar_t).
+UtfChunkResult WideToUtf8Chunk(const wchar_t* wide, size_t size, char* out, size_t capacity,
+                               bool final);
+UtfChunkResult Utf8ToWideChunk(const char* utf8, size_t size, wchar_t* out, size_t capacity,
+                               bool final);
+
 } // namespace ptf
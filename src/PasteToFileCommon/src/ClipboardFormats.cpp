@@ -12,6 +12,21 @@ UINT GetRtfClipboardFormat() {
   return fmt;
 }
 
+UINT GetPngClipboardFormat() {
+  static UINT fmt = RegisterClipboardFormatW(L"PNG");
+  return fmt;
+}
+
+UINT GetMimePngClipboardFormat() {
+  static UINT fmt = RegisterClipboardFormatW(L"image/png");
+  return fmt;
+}
+
+UINT GetJfifClipboardFormat() {
+  static UINT fmt = RegisterClipboardFormatW(L"JFIF");
+  return fmt;
+}
+
 ClipboardFormatsAvailable QueryClipboardFormatsAvailable() {
   ClipboardFormatsAvailable out{};
 
@@ -24,7 +39,16 @@ ClipboardFormatsAvailable QueryClipboardFormatsAvailable() {
   UINT rtf = GetRtfClipboardFormat();
   if (rtf != 0) out.hasRtf = IsClipboardFormatAvailable(rtf) != FALSE;
 
-  out.hasImage = IsClipboardFormatAvailable(CF_DIBV5) != FALSE ||
+  UINT png = GetPngClipboardFormat();
+  UINT mimePng = GetMimePngClipboardFormat();
+  out.hasPng = (png != 0 && IsClipboardFormatAvailable(png) != FALSE) ||
+               (mimePng != 0 && IsClipboardFormatAvailable(mimePng) != FALSE);
+
+  UINT jfif = GetJfifClipboardFormat();
+  if (jfif != 0) out.hasJpeg = IsClipboardFormatAvailable(jfif) != FALSE;
+
+  out.hasImage = out.hasPng || out.hasJpeg ||
+                 IsClipboardFormatAvailable(CF_DIBV5) != FALSE ||
                  IsClipboardFormatAvailable(CF_DIB) != FALSE ||
                  IsClipboardFormatAvailable(CF_BITMAP) != FALSE;
 
@@ -6,45 +6,53 @@
 
 namespace ptf {
 
-static const wchar_t* Month3Lower(int month1To12) {
-  static const wchar_t* kMonths[] = {L"jan", L"feb", L"mar", L"apr", L"may", L"jun",
-                                     L"jul", L"aug", L"sep", L"oct", L"nov", L"dec"};
-  if (month1To12 < 1 || month1To12 > 12) return L"unk";
-  return kMonths[month1To12 - 1];
-}
-
-std::wstring BuildDatedBaseName() {
+NameFields CurrentNameFields(int historyItem) {
   SYSTEMTIME st{};
   GetLocalTime(&st);
-  wchar_t buf[64]{};
-  swprintf_s(buf, L"PTF-%04u-%s-%02u", st.wYear, Month3Lower(st.wMonth),
-             st.wDay);
-  return buf;
+  NameFields fields;
+  fields.year = st.wYear;
+  fields.month = st.wMonth;
+  fields.day = st.wDay;
+  fields.hour = st.wHour;
+  fields.minute = st.wMinute;
+  fields.second = st.wSecond;
+  fields.item = historyItem;
+  return fields;
 }
 
-static bool FileExists(const std::wstring& path) {
-  DWORD attrs = GetFileAttributesW(path.c_str());
-  return attrs != INVALID_FILE_ATTRIBUTES && !(attrs & FILE_ATTRIBUTE_DIRECTORY);
+bool IndexDirectory(const std::wstring& dir, const std::wstring& prefix, NameIndex* index) {
+  WIN32_FIND_DATAW data{};
+  HANDLE find = FindFirstFileExW(JoinPath(dir, prefix + L"*").c_str(), FindExInfoBasic, &data,
+                                 FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+  if (find == INVALID_HANDLE_VALUE) return GetLastError() == ERROR_FILE_NOT_FOUND;
+  do {
+    index->Add(data.cFileName);
+  } while (FindNextFileW(find, &data));
+  FindClose(find);
+  return true;
 }
 
 std::wstring PickUniquePath(const std::wstring& dir,
                             const std::wstring& extensionWithDot) {
-  std::wstring base = BuildDatedBaseName();
-  std::wstring p0 = JoinPath(dir, base + extensionWithDot);
-  if (!FileExists(p0)) return p0;
-
-  for (int i = 1; i < 1000; i++) {
-    wchar_t suffix[16]{};
-    swprintf_s(suffix, L"-%02d", i);
-    std::wstring p = JoinPath(dir, base + suffix + extensionWithDot);
-    if (!FileExists(p)) return p;
+  const NameTemplate name;
+  const NameFields fields = CurrentNameFields();
+  std::wstring prefix;
+  name.AppendListingPrefix(fields, &prefix);
+  NameIndex index;
+  IndexDirectory(dir, prefix, &index);
+  std::wstring fileName;
+  int seq = index.NextFree(name, fields, extensionWithDot);
+  if (seq >= 0) {
+    name.Append(fields, seq, extensionWithDot, &fileName);
+    return JoinPath(dir, fileName);
   }
 
   // Fallback: include ticks if pathological.
+  name.Append(fields, 0, L"", &fileName);
   ULONGLONG t = GetTickCount64();
   wchar_t buf[32]{};
   swprintf_s(buf, L"-%llu", t);
-  return JoinPath(dir, base + buf + extensionWithDot);
+  return JoinPath(dir, fileName + buf + extensionWithDot);
 }
 
 } // namespace ptf
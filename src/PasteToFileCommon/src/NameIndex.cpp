@@ -0,0 +1,44 @@
+#include "PasteToFileCommon/NameIndex.h"
+
+#include <cwctype>
+
+namespace ptf {
+
+namespace {
+
+void LowerInPlace(std::wstring* s) {
+  for (wchar_t& c : *s) c = static_cast<wchar_t>(towlower(c));
+}
+
+} // namespace
+
+void NameIndex::Add(std::wstring_view fileName) {
+  std::wstring name(fileName);
+  LowerInPlace(&name);
+  names_.insert(std::move(name));
+}
+
+const std::wstring& NameIndex::Render(const NameTemplate& name, const NameFields& fields, int seq,
+                                      std::wstring_view ext) {
+  scratch_.clear();
+  name.Append(fields, seq, ext, &scratch_);
+  LowerInPlace(&scratch_);
+  return scratch_;
+}
+
+int NameIndex::NextFree(const NameTemplate& name, const NameFields& fields,
+                        std::wstring_view ext) {
+  const int first = name.FirstSeq();
+  const std::wstring& key = Render(name, fields, first, ext);
+  auto found = cursors_.find(key);
+  if (found == cursors_.end()) found = cursors_.emplace(key, first).first;
+  int& cursor = found->second;
+  while (cursor < first + kMaxSuffix && names_.count(Render(name, fields, cursor, ext)) != 0) {
+    cursor++;
+  }
+  return cursor < first + kMaxSuffix ? cursor : -1;
+}
+
+void NameIndex::MarkUsed(std::wstring_view fileName) { Add(fileName); }
+
+} // namespace ptf
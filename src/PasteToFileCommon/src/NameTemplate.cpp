@@ -0,0 +1,253 @@
+#include "PasteToFileCommon/NameTemplate.h"
+
+namespace ptf {
+
+namespace {
+
+constexpr size_t kMaxPattern = 1024;
+
+const wchar_t* Month3Lower(int month1To12) {
+  static const wchar_t* kMonths[] = {L"jan", L"feb", L"mar", L"apr", L"may", L"jun",
+                                     L"jul", L"aug", L"sep", L"oct", L"nov", L"dec"};
+  if (month1To12 < 1 || month1To12 > 12) return L"unk";
+  return kMonths[month1To12 - 1];
+}
+
+// Characters Windows does not allow in file names (the pattern names a file,
+// not a path).
+bool IsNameChar(wchar_t c) {
+  if (c < 0x20) return false;
+  switch (c) {
+    case L'\\':
+    case L'/':
+    case L':':
+    case L'*':
+    case L'?':
+    case L'"':
+    case L'<':
+    case L'>':
+    case L'|':
+      return false;
+    default:
+      return true;
+  }
+}
+
+void AppendNumber(unsigned value, unsigned width, std::wstring* out) {
+  wchar_t digits[12];
+  unsigned n = 0;
+  do {
+    digits[n++] = static_cast<wchar_t>(L'0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  for (unsigned i = n; i < width; i++) out->push_back(L'0');
+  while (n > 0) out->push_back(digits[--n]);
+}
+
+// A width spec: one digit 1-9, optionally after a 0 ("3" or "03").
+bool ParseWidth(std::wstring_view spec, uint8_t* width) {
+  if (spec.size() == 2 && spec[0] == L'0') spec.remove_prefix(1);
+  if (spec.size() != 1 || spec[0] < L'1' || spec[0] > L'9') return false;
+  *width = static_cast<uint8_t>(spec[0] - L'0');
+  return true;
+}
+
+} // namespace
+
+NameTemplate::NameTemplate() {
+  std::wstring error;
+  Compile(kDefault, &error);
+}
+
+bool NameTemplate::IsDateOp(Op op) {
+  return op == Op::Literal || op == Op::Year || op == Op::Year2 || op == Op::Month ||
+         op == Op::MonthName || op == Op::Day;
+}
+
+bool NameTemplate::Compile(std::wstring_view pattern, std::wstring* error) {
+  if (pattern.size() > kMaxPattern) {
+    *error = L"name template is longer than " + std::to_wstring(kMaxPattern) + L" characters";
+    return false;
+  }
+
+  std::vector<Token> tokens;
+  std::wstring literals;
+  auto addOp = [&](Op op, uint8_t width = 0) { tokens.push_back({op, width, 0, 0}); };
+  auto addLiteral = [&](wchar_t c) {
+    if (tokens.empty() || tokens.back().op != Op::Literal) {
+      tokens.push_back({Op::Literal, 0, static_cast<uint16_t>(literals.size()), 0});
+    }
+    literals.push_back(c);
+    tokens.back().length++;
+  };
+  auto fail = [&](const std::wstring& message) {
+    *error = message + L" in name template \"" + std::wstring(pattern) + L"\"";
+    return false;
+  };
+
+  // strftime-style date/time spec, expanded into the tokens it stands for.
+  auto addDateSpec = [&](std::wstring_view spec) {
+    for (size_t i = 0; i < spec.size(); i++) {
+      if (spec[i] != L'%') {
+        if (!IsNameChar(spec[i])) return false;
+        addLiteral(spec[i]);
+        continue;
+      }
+      if (++i == spec.size()) return false;
+      switch (spec[i]) {
+        case L'Y': addOp(Op::Year); break;
+        case L'y': addOp(Op::Year2); break;
+        case L'm': addOp(Op::Month); break;
+        case L'b': addOp(Op::MonthName); break;
+        case L'd': addOp(Op::Day); break;
+        case L'H': addOp(Op::Hour); break;
+        case L'M': addOp(Op::Minute); break;
+        case L'S': addOp(Op::Second); break;
+        case L'%': addLiteral(L'%'); break;
+        default: return false;
+      }
+    }
+    return true;
+  };
+
+  bool haveSeq = false;
+  bool haveExt = false;
+  int firstSeq = 0;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    const wchar_t c = pattern[i];
+    if (c == L'}') {
+      if (i + 1 == pattern.size() || pattern[i + 1] != L'}') return fail(L"unmatched '}'");
+      addLiteral(L'}');
+      i++;
+      continue;
+    }
+    if (c != L'{') {
+      if (!IsNameChar(c)) return fail(L"'" + std::wstring(1, c) + L"' is not allowed");
+      addLiteral(c);
+      continue;
+    }
+    if (i + 1 < pattern.size() && pattern[i + 1] == L'{') {
+      addLiteral(L'{');
+      i++;
+      continue;
+    }
+
+    const size_t open = i;
+    const size_t close = pattern.find(L'}', open + 1);
+    if (close == std::wstring_view::npos) return fail(L"unterminated '{'");
+    std::wstring_view field = pattern.substr(open + 1, close - open - 1);
+    std::wstring_view spec;
+    bool hasSpec = false;
+    const size_t colon = field.find(L':');
+    if (colon != std::wstring_view::npos) {
+      spec = field.substr(colon + 1);
+      field = field.substr(0, colon);
+      hasSpec = true;
+    }
+    i = close;
+
+    uint8_t width = 0;
+    if (field == L"date" || field == L"time") {
+      if (!hasSpec) spec = field == L"date" ? L"%Y-%m-%d" : L"%H%M%S";
+      if (!addDateSpec(spec)) return fail(L"bad {" + std::wstring(field) + L"} format");
+    } else if (field == L"seq") {
+      if (haveSeq) return fail(L"more than one {seq}");
+      haveSeq = true;
+      if (!hasSpec) {
+        addOp(Op::SeqOptional);
+      } else if (ParseWidth(spec, &width)) {
+        addOp(Op::Seq, width);
+        firstSeq = 1;
+      } else {
+        return fail(L"bad {seq} width");
+      }
+    } else if (field == L"item") {
+      width = 4;
+      if (hasSpec && !ParseWidth(spec, &width)) return fail(L"bad {item} width");
+      addOp(Op::Item, width);
+    } else if ((field == L"hist" || field == L"ext" || field == L"fmt") && !hasSpec) {
+      if (field == L"ext") {
+        if (haveExt) return fail(L"more than one {ext}");
+        haveExt = true;
+      }
+      addOp(field == L"hist" ? Op::Hist : field == L"ext" ? Op::Ext : Op::Fmt);
+    } else {
+      return fail(L"unknown field " + std::wstring(pattern.substr(open, close - open + 1)));
+    }
+  }
+
+  if (!haveExt) addOp(Op::Ext);
+  if (!haveSeq) {
+    // Unique names keep their "-NN" next to the extension.
+    for (size_t t = 0; t < tokens.size(); t++) {
+      if (tokens[t].op == Op::Ext) {
+        tokens.insert(tokens.begin() + static_cast<std::ptrdiff_t>(t),
+                      Token{Op::SeqOptional, 0, 0, 0});
+        break;
+      }
+    }
+  }
+
+  tokens_ = std::move(tokens);
+  literals_ = std::move(literals);
+  firstSeq_ = firstSeq;
+  return true;
+}
+
+void NameTemplate::AppendToken(const Token& token, const NameFields& fields, int seq,
+                               std::wstring_view ext, std::wstring* out) const {
+  switch (token.op) {
+    case Op::Literal:
+      out->append(literals_, token.offset, token.length);
+      break;
+    case Op::Year: AppendNumber(fields.year, 4, out); break;
+    case Op::Year2: AppendNumber(fields.year % 100u, 2, out); break;
+    case Op::Month: AppendNumber(fields.month, 2, out); break;
+    case Op::MonthName: out->append(Month3Lower(fields.month)); break;
+    case Op::Day: AppendNumber(fields.day, 2, out); break;
+    case Op::Hour: AppendNumber(fields.hour, 2, out); break;
+    case Op::Minute: AppendNumber(fields.minute, 2, out); break;
+    case Op::Second: AppendNumber(fields.second, 2, out); break;
+    case Op::Hist:
+      if (fields.item > 0) {
+        out->append(L"-HIST-");
+        AppendNumber(static_cast<unsigned>(fields.item), 4, out);
+      }
+      break;
+    case Op::Item:
+      if (fields.item > 0) AppendNumber(static_cast<unsigned>(fields.item), token.width, out);
+      break;
+    case Op::SeqOptional:
+      if (seq > 0) {
+        out->push_back(L'-');
+        AppendNumber(static_cast<unsigned>(seq), 2, out);
+      }
+      break;
+    case Op::Seq:
+      AppendNumber(static_cast<unsigned>(seq), token.width, out);
+      break;
+    case Op::Ext:
+      out->append(ext);
+      break;
+    case Op::Fmt: {
+      std::wstring_view fmt = ext;
+      if (!fmt.empty() && fmt[0] == L'.') fmt.remove_prefix(1);
+      out->append(fmt.substr(0, fmt.find(L'.')));
+      break;
+    }
+  }
+}
+
+void NameTemplate::Append(const NameFields& fields, int seq, std::wstring_view ext,
+                          std::wstring* out) const {
+  for (const Token& token : tokens_) AppendToken(token, fields, seq, ext, out);
+}
+
+void NameTemplate::AppendListingPrefix(const NameFields& fields, std::wstring* out) const {
+  for (const Token& token : tokens_) {
+    if (!IsDateOp(token.op)) break;
+    AppendToken(token, fields, 0, {}, out);
+  }
+}
+
+} // namespace ptf
@@ -1,40 +1,291 @@
 #include "PasteToFileCommon/Utf.h"
 
-#include <windows.h>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define PTF_UTF_SSE2 1
+#include <emmintrin.h>
+#else
+#define PTF_UTF_SSE2 0
+#endif
 
 namespace ptf {
 
-std::string WideToUtf8(std::wstring_view wide) {
-  if (wide.empty()) return {};
+namespace {
+
+constexpr uint32_t kReplacement = 0xFFFD;
+
+// Unit is a 2-byte (UTF-16) or 4-byte (UTF-32) code unit type. Everything is
+// written against it so both wchar_t widths share one implementation.
+template <typename Unit>
+constexpr bool kUtf16 = sizeof(Unit) == 2;
+
+// ---------------------------------------------------------------------------
+// ASCII runs. Return how many leading units of `in` (at most n) are ASCII,
+// having copied them to `out`.
+
+template <typename Unit>
+size_t NarrowAscii(const Unit* in, size_t n, char* out) {
+  size_t i = 0;
+#if PTF_UTF_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  if constexpr (kUtf16<Unit>) {
+    const __m128i high = _mm_set1_epi16(static_cast<short>(0xFF80));
+    for (; i + 16 <= n; i += 16) {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+      const __m128i hi = _mm_and_si128(_mm_or_si128(a, b), high);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(hi, zero)) != 0xFFFF) break;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(a, b));
+    }
+  } else {
+    const __m128i high = _mm_set1_epi32(static_cast<int>(0xFFFFFF80u));
+    for (; i + 16 <= n; i += 16) {
+      const __m128i* p = reinterpret_cast<const __m128i*>(in + i);
+      const __m128i a = _mm_loadu_si128(p);
+      const __m128i b = _mm_loadu_si128(p + 1);
+      const __m128i c = _mm_loadu_si128(p + 2);
+      const __m128i d = _mm_loadu_si128(p + 3);
+      const __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, high), zero)) != 0xFFFF) break;
+      const __m128i ab = _mm_packs_epi32(a, b);
+      const __m128i cd = _mm_packs_epi32(c, d);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(ab, cd));
+    }
+  }
+#endif
+  for (; i < n && static_cast<uint32_t>(in[i]) < 0x80; i++) out[i] = static_cast<char>(in[i]);
+  return i;
+}
+
+template <typename Unit>
+size_t WidenAscii(const uint8_t* in, size_t n, Unit* out) {
+  size_t i = 0;
+#if PTF_UTF_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    if (_mm_movemask_epi8(v) != 0) break;
+    const __m128i lo = _mm_unpacklo_epi8(v, zero);
+    const __m128i hi = _mm_unpackhi_epi8(v, zero);
+    __m128i* dst = reinterpret_cast<__m128i*>(out + i);
+    if constexpr (kUtf16<Unit>) {
+      _mm_storeu_si128(dst, lo);
+      _mm_storeu_si128(dst + 1, hi);
+    } else {
+      _mm_storeu_si128(dst, _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+    }
+  }
+#endif
+  for (; i < n && in[i] < 0x80; i++) out[i] = static_cast<Unit>(in[i]);
+  return i;
+}
+
+// ---------------------------------------------------------------------------
+
+template <typename Unit>
+UtfChunkResult EncodeUtf8(const Unit* in, size_t n, char* out, size_t capacity, bool final) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < n) {
+    const size_t ascii = n - i < capacity - o ? n - i : capacity - o;
+    const size_t run = NarrowAscii(in + i, ascii, out + o);
+    i += run;
+    o += run;
+    if (i == n || o == capacity) break;
+    const size_t room = capacity - o;
+
+    uint32_t c = static_cast<uint32_t>(in[i]);
+    size_t used = 1;
+    if (c >= 0xD800 && c <= 0xDFFF) {
+      const uint32_t high = c;
+      c = kReplacement;
+      if constexpr (kUtf16<Unit>) {
+        if (high <= 0xDBFF) {
+          if (i + 1 == n) {
+            if (!final) break;  // the low half may come with the next chunk
+          } else {
+            const uint32_t low = static_cast<uint32_t>(in[i + 1]);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+              c = 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00);
+              used = 2;
+            }
+          }
+        }
+      }
+    } else if (c > 0x10FFFF) {
+      c = kReplacement;
+    }
+
+    uint8_t* dst = reinterpret_cast<uint8_t*>(out + o);
+    if (c < 0x800) {
+      if (room < 2) break;
+      dst[0] = static_cast<uint8_t>(0xC0 | (c >> 6));
+      dst[1] = static_cast<uint8_t>(0x80 | (c & 0x3F));
+      o += 2;
+    } else if (c < 0x10000) {
+      if (room < 3) break;
+      dst[0] = static_cast<uint8_t>(0xE0 | (c >> 12));
+      dst[1] = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3F));
+      dst[2] = static_cast<uint8_t>(0x80 | (c & 0x3F));
+      o += 3;
+    } else {
+      if (room < 4) break;
+      dst[0] = static_cast<uint8_t>(0xF0 | (c >> 18));
+      dst[1] = static_cast<uint8_t>(0x80 | ((c >> 12) & 0x3F));
+      dst[2] = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3F));
+      dst[3] = static_cast<uint8_t>(0x80 | (c & 0x3F));
+      o += 4;
+    }
+    i += used;
+  }
+  return {i, o};
+}
 
-  int needed = WideCharToMultiByte(CP_UTF8, 0, wide.data(),
-                                   static_cast<int>(wide.size()), nullptr, 0,
-                                   nullptr, nullptr);
-  if (needed <= 0) return {};
+template <typename Unit>
+UtfChunkResult DecodeUtf8(const uint8_t* in, size_t n, Unit* out, size_t capacity, bool final) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < n) {
+    const size_t ascii = n - i < capacity - o ? n - i : capacity - o;
+    const size_t run = WidenAscii(in + i, ascii, out + o);
+    i += run;
+    o += run;
+    if (i == n || o == capacity) break;
+    const size_t room = capacity - o;
 
+    // Well-formed sequences per Unicode table 3-7: the second byte's range
+    // depends on the lead byte (no overlongs, surrogates or > U+10FFFF).
+    const uint8_t lead = in[i];
+    size_t need = 0;
+    uint8_t lo = 0x80;
+    uint8_t hi = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      need = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+      need = 3;
+      if (lead == 0xE0) lo = 0xA0;
+      if (lead == 0xED) hi = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      need = 4;
+      if (lead == 0xF0) lo = 0x90;
+      if (lead == 0xF4) hi = 0x8F;
+    }
+
+    uint32_t c = kReplacement;
+    size_t got = 1;  // bytes of the (maximal) valid prefix
+    if (need != 0) {
+      uint32_t value = lead & (0x7Fu >> need);
+      for (; got < need && i + got < n; got++) {
+        const uint8_t b = in[i + got];
+        if (got == 1 ? (b < lo || b > hi) : (b & 0xC0) != 0x80) break;
+        value = (value << 6) | (b & 0x3Fu);
+      }
+      if (got == need) {
+        c = value;
+      } else if (i + got == n && !final) {
+        break;  // the rest of the sequence may come with the next chunk
+      }
+    }
+
+    bool surrogatePair = false;
+    if constexpr (kUtf16<Unit>) surrogatePair = c >= 0x10000;
+    if (surrogatePair) {
+      if (room < 2) break;
+      out[o] = static_cast<Unit>(0xD800 + ((c - 0x10000) >> 10));
+      out[o + 1] = static_cast<Unit>(0xDC00 + ((c - 0x10000) & 0x3FF));
+      o += 2;
+    } else {
+      out[o++] = static_cast<Unit>(c);
+    }
+    i += got;
+  }
+  return {i, o};
+}
+
+} // namespace
+
+UtfChunkResult WideToUtf8Chunk(const wchar_t* wide, size_t size, char* out, size_t capacity,
+                               bool final) {
+  return EncodeUtf8(wide, size, out, capacity, final);
+}
+
+UtfChunkResult Utf8ToWideChunk(const char* utf8, size_t size, wchar_t* out, size_t capacity,
+                               bool final) {
+  return DecodeUtf8(reinterpret_cast<const uint8_t*>(utf8), size, out, capacity, final);
+}
+
+std::string WideToUtf8(std::wstring_view wide) {
+  // Sized for ASCII; grown from the ratio seen so far when the text is not.
   std::string out;
-  out.resize(static_cast<size_t>(needed));
-  int written = WideCharToMultiByte(CP_UTF8, 0, wide.data(),
-                                    static_cast<int>(wide.size()), out.data(),
-                                    static_cast<int>(out.size()), nullptr,
-                                    nullptr);
-  if (written != needed) return {};
+  out.resize(wide.size());
+  size_t consumed = 0;
+  size_t written = 0;
+  for (;;) {
+    UtfChunkResult r = WideToUtf8Chunk(wide.data() + consumed, wide.size() - consumed,
+                                       out.data() + written, out.size() - written, true);
+    consumed += r.consumed;
+    written += r.written;
+    if (consumed == wide.size()) break;
+    const double perUnit = consumed ? static_cast<double>(written) / consumed : 3.0;
+    const size_t left = wide.size() - consumed;
+    out.resize(written + static_cast<size_t>(perUnit * left) + left / 8 + 4);
+  }
+  out.resize(written);
   return out;
 }
 
-std::wstring Utf8ToWide(std::string_view utf8) {
-  if (utf8.empty()) return {};
+bool IsWellFormedUtf8(std::string_view bytes) {
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(bytes.data());
+  const size_t n = bytes.size();
+  size_t i = 0;
+  while (i < n) {
+#if PTF_UTF_SSE2
+    while (i + 16 <= n &&
+           _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))) == 0) {
+      i += 16;
+    }
+#endif
+    while (i < n && in[i] < 0x80) i++;
+    if (i == n) break;
 
-  int needed = MultiByteToWideChar(CP_UTF8, 0, utf8.data(),
-                                   static_cast<int>(utf8.size()), nullptr, 0);
-  if (needed <= 0) return {};
+    // The same table 3-7 ranges DecodeUtf8 accepts.
+    const uint8_t lead = in[i];
+    size_t need;
+    uint8_t lo = 0x80;
+    uint8_t hi = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      need = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+      need = 3;
+      if (lead == 0xE0) lo = 0xA0;
+      if (lead == 0xED) hi = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      need = 4;
+      if (lead == 0xF0) lo = 0x90;
+      if (lead == 0xF4) hi = 0x8F;
+    } else {
+      return false;
+    }
+    if (n - i < need) return false;
+    if (in[i + 1] < lo || in[i + 1] > hi) return false;
+    for (size_t k = 2; k < need; k++) {
+      if ((in[i + k] & 0xC0) != 0x80) return false;
+    }
+    i += need;
+  }
+  return true;
+}
 
+std::wstring Utf8ToWide(std::string_view utf8) {
+  // Every input byte yields at most one output unit.
   std::wstring out;
-  out.resize(static_cast<size_t>(needed));
-  int written =
-      MultiByteToWideChar(CP_UTF8, 0, utf8.data(),
-                          static_cast<int>(utf8.size()), out.data(), needed);
-  if (written != needed) return {};
+  out.resize(utf8.size());
+  UtfChunkResult r = Utf8ToWideChunk(utf8.data(), utf8.size(), out.data(), out.size(), true);
+  out.resize(r.written);
   return out;
 }
 
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Output interface for the streaming encoders. Portable (no Windows headers).
+
+namespace ptf_helper {
+
+class ByteSink {
+ public:
+  virtual ~ByteSink() = default;
+  virtual bool Write(const uint8_t* data, size_t size) = 0;
+};
+
+class MemorySink : public ByteSink {
+ public:
+  bool Write(const uint8_t* data, size_t size) override {
+    bytes.insert(bytes.end(), data, data + size);
+    return true;
+  }
+  std::vector<uint8_t> bytes;
+};
+
+class StdioSink : public ByteSink {
+ public:
+  explicit StdioSink(FILE* f) : f_(f) {}
+  bool Write(const uint8_t* data, size_t size) override {
+    return fwrite(data, 1, size, f_) == size;
+  }
+
+ private:
+  FILE* f_;
+};
+
+} // namespace ptf_helper
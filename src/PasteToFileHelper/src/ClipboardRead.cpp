@@ -2,13 +2,19 @@
 
 #include <algorithm>
 #include <cstring>
+#include <cwchar>
+
+#include "CodePage.h"
+#include "DibParse.h"
+#include "PixelKernels.h"
 
 #include "PasteToFileCommon/ClipboardFormats.h"
 #include "PasteToFileCommon/Logging.h"
 
 namespace ptf_helper {
 
-static std::optional<std::vector<uint8_t>> ReadClipboardHglobalBytes(UINT format) {
+static std::optional<std::vector<uint8_t>> ReadClipboardHglobalBytes(UINT format,
+                                                                     bool trimNuls = true) {
   if (!IsClipboardFormatAvailable(format)) return std::nullopt;
   if (!OpenClipboard(nullptr)) return std::nullopt;
 
@@ -34,58 +40,87 @@ static std::optional<std::vector<uint8_t>> ReadClipboardHglobalBytes(UINT format
   CloseClipboard();
 
   // Trim trailing NULs to make file output cleaner.
-  while (!bytes.empty() && bytes.back() == 0) bytes.pop_back();
+  while (trimNuls && !bytes.empty() && bytes.back() == 0) bytes.pop_back();
   return bytes;
 }
 
-std::optional<ClipboardText> ReadClipboardText() {
-  if (!IsClipboardFormatAvailable(CF_UNICODETEXT) &&
-      !IsClipboardFormatAvailable(CF_TEXT)) {
-    return std::nullopt;
+ClipboardTextLock::~ClipboardTextLock() {
+  if (narrowLocked_) GlobalUnlock(narrowLocked_);
+  if (wideLocked_) GlobalUnlock(wideLocked_);
+  if (open_) CloseClipboard();
+}
+
+// The code page CF_TEXT (ANSI) or CF_OEMTEXT (OEM) text was written in: the
+// one of the CF_LOCALE the source set, or the system's. Call with the
+// clipboard open.
+static UINT ClipboardTextCodePage(UINT format) {
+  const bool oem = format == CF_OEMTEXT;
+  if (HANDLE h = GetClipboardData(CF_LOCALE)) {
+    if (GlobalSize(h) >= sizeof(LCID)) {
+      if (const LCID* lcid = static_cast<const LCID*>(GlobalLock(h))) {
+        const LCID locale = *lcid;
+        GlobalUnlock(h);
+        DWORD codePage = 0;
+        const LCTYPE type = (oem ? LOCALE_IDEFAULTCODEPAGE : LOCALE_IDEFAULTANSICODEPAGE) |
+                            LOCALE_RETURN_NUMBER;
+        if (GetLocaleInfoW(locale, type, reinterpret_cast<LPWSTR>(&codePage),
+                           sizeof(codePage) / sizeof(wchar_t)) &&
+            codePage != 0) {
+          return codePage;
+        }
+      }
+    }
   }
+  return oem ? GetOEMCP() : GetACP();
+}
 
-  if (!OpenClipboard(nullptr)) return std::nullopt;
+// Locks the block of `format` and returns it, with its size in bytes.
+static HGLOBAL LockClipboardBlock(UINT format, void** p, size_t* size) {
+  HGLOBAL h = static_cast<HGLOBAL>(GetClipboardData(format));
+  if (!h) return nullptr;
+  *size = static_cast<size_t>(GlobalSize(h));
+  *p = GlobalLock(h);
+  return *p ? h : nullptr;
+}
 
-  ClipboardText out{};
-  if (IsClipboardFormatAvailable(CF_UNICODETEXT)) {
-    HANDLE h = GetClipboardData(CF_UNICODETEXT);
-    if (!h) {
-      CloseClipboard();
-      return std::nullopt;
-    }
-    const wchar_t* p = static_cast<const wchar_t*>(GlobalLock(h));
-    if (!p) {
-      CloseClipboard();
-      return std::nullopt;
-    }
-    out.text = p;
-    GlobalUnlock(h);
-    CloseClipboard();
-    return out;
+bool ClipboardTextLock::Acquire() {
+  if (open_) return false;
+  // The system synthesizes CF_UNICODETEXT when only CF_TEXT/CF_OEMTEXT is set.
+  if (!IsClipboardFormatAvailable(CF_UNICODETEXT)) return false;
+  if (!OpenClipboard(nullptr)) return false;
+  open_ = true;
+
+  // The block may be larger than the text; stop at the terminator.
+  void* p = nullptr;
+  size_t size = 0;
+  wideLocked_ = LockClipboardBlock(CF_UNICODETEXT, &p, &size);
+  if (wideLocked_) {
+    const wchar_t* w = static_cast<const wchar_t*>(p);
+    text_ = std::wstring_view(w, wcsnlen(w, size / sizeof(wchar_t)));
   }
 
-  // CF_TEXT fallback (ACP).
-  HANDLE h = GetClipboardData(CF_TEXT);
-  if (!h) {
-    CloseClipboard();
-    return std::nullopt;
+  // Formats are enumerated in the order they were set, and synthesized ones
+  // after all of those, so the first text format is the one the source wrote.
+  // When that is CF_TEXT/CF_OEMTEXT, the 8-bit block is kept only if it holds
+  // what CF_UNICODETEXT does (ChooseNarrowTextEncoding): enumeration does not
+  // tell a synthesized CF_UNICODETEXT from one the source set after CF_TEXT.
+  UINT original = CF_UNICODETEXT;
+  for (UINT f = EnumClipboardFormats(0); f != 0; f = EnumClipboardFormats(f)) {
+    if (f == CF_UNICODETEXT || f == CF_TEXT || f == CF_OEMTEXT) {
+      original = f;
+      break;
+    }
   }
-  const char* p = static_cast<const char*>(GlobalLock(h));
-  if (!p) {
-    CloseClipboard();
-    return std::nullopt;
+  if (original != CF_UNICODETEXT) narrowLocked_ = LockClipboardBlock(original, &p, &size);
+  if (narrowLocked_) {
+    const char* c = static_cast<const char*>(p);
+    narrowText_ = std::string_view(c, strnlen(c, size));
+    codePage_ = ClipboardTextCodePage(original);
+    encoding_ = ChooseNarrowTextEncoding(narrowText_, codePage_,
+                                         wideLocked_ ? &text_ : nullptr);
+    narrow_ = encoding_ != NarrowTextEncoding::System;
   }
-  std::string s(p);
-  GlobalUnlock(h);
-  CloseClipboard();
-
-  int needed = MultiByteToWideChar(CP_ACP, 0, s.data(), static_cast<int>(s.size()),
-                                   nullptr, 0);
-  if (needed <= 0) return std::nullopt;
-  out.text.resize(static_cast<size_t>(needed));
-  MultiByteToWideChar(CP_ACP, 0, s.data(), static_cast<int>(s.size()),
-                      out.text.data(), needed);
-  return out;
+  return narrow_ || wideLocked_ != nullptr;
 }
 
 std::optional<ClipboardBytes> ReadClipboardHtmlFormat() {
@@ -104,91 +139,138 @@ std::optional<ClipboardBytes> ReadClipboardRtfFormat() {
   return ClipboardBytes{std::move(*bytes)};
 }
 
-static std::optional<HBITMAP> CreateHbitmapFromDibGlobal(HGLOBAL hg) {
-  SIZE_T size = GlobalSize(hg);
-  void* dib = GlobalLock(hg);
-  if (!dib || size < sizeof(BITMAPINFOHEADER)) {
-    if (dib) GlobalUnlock(hg);
+static std::optional<ClipboardEncodedImage> ReadEncodedImageFormat(UINT format,
+                                                                   ImageContainer expected) {
+  if (!format) return std::nullopt;
+  // Binary streams may legitimately end in zero bytes, so trim by structure.
+  auto bytes = ReadClipboardHglobalBytes(format, false);
+  if (!bytes) return std::nullopt;
+  if (SniffImageContainer(bytes->data(), bytes->size()) != expected) {
+    ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
+                      L"[Helper] encoded image format " + std::to_wstring(format) +
+                          L" has an unexpected signature");
     return std::nullopt;
   }
+  size_t length = EncodedImageLength(bytes->data(), bytes->size());
+  if (length == 0) return std::nullopt;
+  bytes->resize(length);
+  return ClipboardEncodedImage{std::move(*bytes), expected};
+}
 
-  const BITMAPINFOHEADER* bih = static_cast<const BITMAPINFOHEADER*>(dib);
-  if (bih->biSize < sizeof(BITMAPINFOHEADER)) {
-    GlobalUnlock(hg);
-    return std::nullopt;
+std::optional<ClipboardEncodedImage> ReadClipboardEncodedImage(bool allowJpeg) {
+  if (auto png = ReadEncodedImageFormat(ptf::GetPngClipboardFormat(), ImageContainer::Png)) {
+    return png;
+  }
+  if (auto png = ReadEncodedImageFormat(ptf::GetMimePngClipboardFormat(), ImageContainer::Png)) {
+    return png;
   }
+  if (allowJpeg) return ReadEncodedImageFormat(ptf::GetJfifClipboardFormat(), ImageContainer::Jpeg);
+  return std::nullopt;
+}
 
-  const BITMAPINFO* bmi = static_cast<const BITMAPINFO*>(dib);
+ClipboardDibLock::~ClipboardDibLock() {
+  if (locked_) GlobalUnlock(locked_);
+  if (open_) CloseClipboard();
+}
 
-  // Compute palette size (for <= 8bpp).
-  DWORD paletteBytes = 0;
-  if (bih->biBitCount <= 8) {
-    DWORD colors = bih->biClrUsed ? bih->biClrUsed : (1u << bih->biBitCount);
-    paletteBytes = colors * sizeof(RGBQUAD);
-  } else if (bih->biCompression == BI_BITFIELDS) {
-    paletteBytes = 3 * sizeof(DWORD);
+bool ClipboardDibLock::Acquire() {
+  if (open_) return false;
+  if (!IsClipboardFormatAvailable(CF_DIBV5) && !IsClipboardFormatAvailable(CF_DIB)) {
+    return false;
   }
+  if (!OpenClipboard(nullptr)) return false;
+  open_ = true;
 
-  const uint8_t* bits =
-      static_cast<const uint8_t*>(dib) + bih->biSize + paletteBytes;
-  SIZE_T bitsBytes = size - (bih->biSize + paletteBytes);
+  // CF_DIBV5 keeps the alpha channel when the source provided one.
+  UINT fmt = IsClipboardFormatAvailable(CF_DIBV5) ? CF_DIBV5 : CF_DIB;
+  HGLOBAL hg = static_cast<HGLOBAL>(GetClipboardData(fmt));
+  if (!hg) return false;
 
-  HDC hdc = GetDC(nullptr);
-  void* outBits = nullptr;
-  HBITMAP hbm = CreateDIBSection(hdc, bmi, DIB_RGB_COLORS, &outBits, nullptr, 0);
-  ReleaseDC(nullptr, hdc);
+  SIZE_T size = GlobalSize(hg);
+  const uint8_t* dib = static_cast<const uint8_t*>(GlobalLock(hg));
+  if (!dib) return false;
+  locked_ = hg;
 
-  if (!hbm || !outBits) {
-    GlobalUnlock(hg);
-    if (hbm) DeleteObject(hbm);
-    return std::nullopt;
+  if (ParsePackedDib(dib, static_cast<size_t>(size), &source_)) {
+    inPlace_ = true;
+    return true;
   }
-
-  // Avoid overrunning the DIBSection if GlobalSize is larger than the actual pixel data.
-  int width = bih->biWidth;
-  int height = bih->biHeight < 0 ? -bih->biHeight : bih->biHeight;
-  int bpp = bih->biBitCount;
-  size_t stride = static_cast<size_t>(((width * bpp + 31) / 32) * 4);
-  size_t expected = stride * static_cast<size_t>(height);
-  size_t toCopy = (expected < bitsBytes) ? expected : static_cast<size_t>(bitsBytes);
-  memcpy(outBits, bits, toCopy);
-  GlobalUnlock(hg);
-  return hbm;
+  if (!decoder_.Open(dib, static_cast<size_t>(size))) {
+    ptf::LogLine(L"Clipboard DIB layout not supported");
+    return false;
+  }
+  ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
+                    L"[Helper] DIB layout not encodable in place; decoding bpp/compression");
+  return true;
 }
 
-std::optional<HBITMAP> ReadClipboardImageAsHbitmap() {
-  if (!IsClipboardFormatAvailable(CF_BITMAP) &&
-      !IsClipboardFormatAvailable(CF_DIBV5) &&
-      !IsClipboardFormatAvailable(CF_DIB)) {
-    return std::nullopt;
-  }
+ClipboardBitmapLock::~ClipboardBitmapLock() {
+  if (open_) CloseClipboard();
+}
 
-  if (!OpenClipboard(nullptr)) return std::nullopt;
+// No CopyImage: GetDIBits reads the clipboard's bitmap a band at a time. Its
+// bits are not read through GetObject's DIBSECTION either, since a bitmap put
+// on the clipboard by another process need not be mapped in this one.
+bool ClipboardBitmapLock::Acquire() {
+  if (open_) return false;
+  if (!IsClipboardFormatAvailable(CF_BITMAP)) return false;
+  if (!OpenClipboard(nullptr)) return false;
+  open_ = true;
+  bitmap_ = static_cast<HBITMAP>(GetClipboardData(CF_BITMAP));
+  return bitmap_ != nullptr;
+}
 
-  // Prefer CF_BITMAP if available because it is simplest.
-  if (IsClipboardFormatAvailable(CF_BITMAP)) {
-    HBITMAP src = static_cast<HBITMAP>(GetClipboardData(CF_BITMAP));
-    if (!src) {
-      CloseClipboard();
-      return std::nullopt;
-    }
-    // Make our own copy; clipboard owns the original.
-    HBITMAP copy = static_cast<HBITMAP>(CopyImage(src, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION));
-    CloseClipboard();
-    if (!copy) return std::nullopt;
-    return copy;
+bool HbitmapBandReader::Open(size_t bandBudgetBytes) {
+  BITMAP bm{};
+  if (GetObjectW(hbm_, sizeof(bm), &bm) == 0 || bm.bmWidth <= 0 || bm.bmHeight == 0) {
+    return false;
   }
+  width_ = static_cast<uint32_t>(bm.bmWidth);
+  height_ = static_cast<uint32_t>(bm.bmHeight < 0 ? -bm.bmHeight : bm.bmHeight);
+  bandRows_ = BandRowsForBudget(bandBudgetBytes, static_cast<size_t>(width_) * 4, height_);
 
-  UINT fmt = IsClipboardFormatAvailable(CF_DIBV5) ? CF_DIBV5 : CF_DIB;
-  HGLOBAL hg = static_cast<HGLOBAL>(GetClipboardData(fmt));
-  if (!hg) {
-    CloseClipboard();
-    return std::nullopt;
+  // GDI leaves the alpha byte at zero for most 24/32-bit bitmaps; treat an
+  // all-zero alpha channel as "no alpha" rather than writing a transparent image.
+  format_ = PixelFormat::Bgra8;
+  bool anyAlpha = false;
+  for (uint32_t y = 0; y < height_ && !anyAlpha; y += bandRows_) {
+    PixelSource band;
+    const uint32_t rows = height_ - y < bandRows_ ? height_ - y : bandRows_;
+    if (!ReadBand(y, rows, &band)) return false;
+    anyAlpha = AnyAlpha32(band.pixels, static_cast<size_t>(width_) * band.height);
   }
+  if (!anyAlpha) format_ = PixelFormat::Bgrx8;
+  return true;
+}
 
-  auto hbm = CreateHbitmapFromDibGlobal(hg);
-  CloseClipboard();
-  return hbm;
+bool HbitmapBandReader::ReadBand(uint32_t y, uint32_t rows, PixelSource* band) {
+  if (rows == 0 || y >= height_ || rows > height_ - y) return false;
+
+  // Ask for bottom-up rows: GetDIBits numbers scan lines from the bottom, so
+  // the band starting at top row `y` starts at scan line height - y - rows.
+  BITMAPINFO bmi{};
+  bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  bmi.bmiHeader.biWidth = static_cast<LONG>(width_);
+  bmi.bmiHeader.biHeight = static_cast<LONG>(height_);
+  bmi.bmiHeader.biPlanes = 1;
+  bmi.bmiHeader.biBitCount = 32;
+  bmi.bmiHeader.biCompression = BI_RGB;
+
+  const size_t stride = static_cast<size_t>(width_) * 4;
+  band_.resize(stride * rows);
+  HDC hdc = GetDC(nullptr);
+  int lines = GetDIBits(hdc, hbm_, height_ - y - rows, rows, band_.data(), &bmi,
+                        DIB_RGB_COLORS);
+  ReleaseDC(nullptr, hdc);
+  if (lines != static_cast<int>(rows)) return false;
+
+  band->pixels = band_.data();
+  band->stride = stride;
+  band->width = width_;
+  band->height = rows;
+  band->format = format_;
+  band->bottomUp = true;
+  return true;
 }
 
 } // namespace ptf_helper
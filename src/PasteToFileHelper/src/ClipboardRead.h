@@ -2,28 +2,139 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <windows.h>
 
+#include "CodePage.h"
+#include "DibDecode.h"
+#include "ImageSniff.h"
+#include "PixelSource.h"
+
 namespace ptf_helper {
 
-struct ClipboardText {
-  std::wstring text;
+struct ClipboardBytes {
+  std::vector<uint8_t> bytes;
 };
 
-struct ClipboardBytes {
+struct ClipboardEncodedImage {
   std::vector<uint8_t> bytes;
+  ImageContainer container = ImageContainer::Unknown;
 };
 
-// Reads CF_UNICODETEXT (preferred) or CF_TEXT.
-std::optional<ClipboardText> ReadClipboardText();
+// Keeps the clipboard open with its text block locked so the text can be
+// written without copying it. When the source application set CF_TEXT or
+// CF_OEMTEXT rather than CF_UNICODETEXT, that original block is locked as well
+// and, when ChooseNarrowTextEncoding finds it lossless, used instead
+// (IsNarrow()); the code page comes from CF_LOCALE when present. Other
+// applications cannot open the clipboard while this is held, so keep its scope
+// to the write.
+class ClipboardTextLock {
+ public:
+  ClipboardTextLock() = default;
+  ~ClipboardTextLock();
+  ClipboardTextLock(const ClipboardTextLock&) = delete;
+  ClipboardTextLock& operator=(const ClipboardTextLock&) = delete;
+
+  bool Acquire();
+
+  bool IsNarrow() const { return narrow_; }
+  // Up to the first NUL; valid while this object lives.
+  std::wstring_view Text() const { return text_; }
+  std::string_view Narrow() const { return narrowText_; }
+  UINT CodePage() const { return codePage_; }
+  NarrowTextEncoding Encoding() const { return encoding_; }
+
+ private:
+  bool open_ = false;
+  HGLOBAL wideLocked_ = nullptr;
+  HGLOBAL narrowLocked_ = nullptr;
+  bool narrow_ = false;
+  UINT codePage_ = 0;
+  NarrowTextEncoding encoding_ = NarrowTextEncoding::System;
+  std::wstring_view text_;
+  std::string_view narrowText_;
+};
 
 // Reads the registered formats: "HTML Format" and "Rich Text Format".
 std::optional<ClipboardBytes> ReadClipboardHtmlFormat();
 std::optional<ClipboardBytes> ReadClipboardRtfFormat();
 
-// Attempts to read an image as an HBITMAP (caller owns and must DeleteObject).
-// Prefers CF_BITMAP, then CF_DIBV5/CF_DIB.
-std::optional<HBITMAP> ReadClipboardImageAsHbitmap();
+// Reads an image the source application already encoded: the registered "PNG"
+// or "image/png" formats, and "JFIF" as well when `allowJpeg` is set. The bytes
+// are trimmed to the end of the stream and checked against the container's
+// signature, so they can be written to disk as-is.
+std::optional<ClipboardEncodedImage> ReadClipboardEncodedImage(bool allowJpeg);
+
+// Keeps the clipboard open with its CF_DIBV5/CF_DIB block locked while it is
+// encoded. Layouts ParsePackedDib accepts are encoded in place (InPlace() and
+// Pixels()); every other bit depth and compression goes through Decoder(),
+// which converts a band at a time. Acquire() fails when there is no DIB or it
+// cannot be decoded; ClipboardBitmapLock is the last resort then.
+// Other applications cannot open the clipboard while this is held, so keep its
+// scope to the encode.
+class ClipboardDibLock {
+ public:
+  ClipboardDibLock() = default;
+  ~ClipboardDibLock();
+  ClipboardDibLock(const ClipboardDibLock&) = delete;
+  ClipboardDibLock& operator=(const ClipboardDibLock&) = delete;
+
+  bool Acquire();
+  bool InPlace() const { return inPlace_; }
+  const PixelSource& Pixels() const { return source_; }
+  DibDecoder& Decoder() { return decoder_; }
+
+ private:
+  bool open_ = false;
+  bool inPlace_ = false;
+  HGLOBAL locked_ = nullptr;
+  PixelSource source_;
+  DibDecoder decoder_;
+};
+
+// Keeps the clipboard open while its CF_BITMAP is encoded, so HbitmapBandReader
+// reads bands straight from the clipboard's own bitmap instead of a copy of
+// the whole image. The clipboard owns Bitmap(); do not delete it. Used only
+// when no DIB could be read; the same scope rule as ClipboardDibLock applies.
+class ClipboardBitmapLock {
+ public:
+  ClipboardBitmapLock() = default;
+  ~ClipboardBitmapLock();
+  ClipboardBitmapLock(const ClipboardBitmapLock&) = delete;
+  ClipboardBitmapLock& operator=(const ClipboardBitmapLock&) = delete;
+
+  bool Acquire();
+  HBITMAP Bitmap() const { return bitmap_; }
+
+ private:
+  bool open_ = false;
+  HBITMAP bitmap_ = nullptr;
+};
+
+// Reads an HBITMAP as 32-bit BGRA bands through GetDIBits, so only one band of
+// pixels is copied at a time. An all-zero alpha channel is reported as Bgrx8.
+class HbitmapBandReader : public PixelBandReader {
+ public:
+  explicit HbitmapBandReader(HBITMAP hbm) : hbm_(hbm) {}
+
+  // Reads the bitmap size, picks a band height that keeps one band within
+  // `bandBudgetBytes` (0 = whole image) and scans the alpha channel.
+  bool Open(size_t bandBudgetBytes);
+
+  uint32_t BandRows() const { return bandRows_; }
+  uint32_t Width() const override { return width_; }
+  uint32_t Height() const override { return height_; }
+  PixelFormat Format() const override { return format_; }
+  bool ReadBand(uint32_t y, uint32_t rows, PixelSource* band) override;
+
+ private:
+  HBITMAP hbm_;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint32_t bandRows_ = 0;
+  PixelFormat format_ = PixelFormat::Bgra8;
+  std::vector<uint8_t> band_;
+};
 
 } // namespace ptf_helper
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Legacy 8-bit text (CF_TEXT/CF_OEMTEXT, RTF escapes) without the Win32 code
+// page APIs. Portable (no Windows headers).
+
+namespace ptf_helper {
+
+// Code points of bytes 0x80-0xFF in the single-byte Windows (874, 1250-1258)
+// and DOS (437, 850, 852, 866) code pages; bytes 0x00-0x7F are ASCII. Bytes a
+// code page leaves undefined map to U+0080-U+009F as the Win32 converter does,
+// or to U+FFFD above that. nullptr for anything else: double-byte code pages
+// (932, 936, 949, 950), UTF-8 and unknown numbers.
+const uint16_t* SingleByteCodePage(uint32_t codePage);
+
+enum class NarrowTextEncoding {
+  Utf8,        // ASCII or well-formed UTF-8: the bytes are written as they are
+  SingleByte,  // converted with SingleByteCodePage()
+  System,      // save the clipboard's CF_UNICODETEXT instead
+};
+
+// How to save 8-bit clipboard text that was written in `codePage`. `wide` is the
+// clipboard's CF_UNICODETEXT, or nullptr when there is none. Text that is
+// well-formed UTF-8 is taken as UTF-8 whatever the code page says: apps that
+// put UTF-8 in CF_TEXT are common, and legacy text with non-ASCII characters is
+// very rarely well-formed UTF-8 by accident. The 8-bit text is only used when
+// nothing is lost: `wide` must hold the same characters, read either as UTF-8
+// or in the code page (the copy the system synthesizes). Apps that write '?'
+// to CF_TEXT for characters the code page lacks, with the real text in
+// CF_UNICODETEXT, get System.
+NarrowTextEncoding ChooseNarrowTextEncoding(std::string_view text, uint32_t codePage,
+                                           const std::wstring_view* wide);
+
+// True when `text`, decoded with `table` (from SingleByteCodePage) or as UTF-8
+// when it is null, is exactly `wide`.
+bool NarrowTextMatches(std::string_view text, const uint16_t* table, std::wstring_view wide);
+
+} // namespace ptf_helper
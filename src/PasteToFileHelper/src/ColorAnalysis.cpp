@@ -0,0 +1,116 @@
+#include "ColorAnalysis.h"
+
+#include <algorithm>
+
+#include "PixelKernels.h"
+
+namespace ptf_helper {
+
+void ColorSet::Clear() {
+  std::fill(index_, index_ + kSlots, static_cast<int16_t>(-1));
+  count_ = 0;
+}
+
+bool ColorSet::Insert(uint32_t color) {
+  size_t slot = Slot(color);
+  while (index_[slot] >= 0) {
+    if (keys_[slot] == color) return true;
+    slot = (slot + 1) & (kSlots - 1);
+  }
+  if (count_ == kMaxColors) return false;
+  keys_[slot] = color;
+  index_[slot] = static_cast<int16_t>(count_);
+  colors_[count_++] = color;
+  return true;
+}
+
+int ColorSet::Find(uint32_t color) const {
+  size_t slot = Slot(color);
+  while (index_[slot] >= 0) {
+    if (keys_[slot] == color) return index_[slot];
+    slot = (slot + 1) & (kSlots - 1);
+  }
+  return -1;
+}
+
+ColorAnalyzer::ColorAnalyzer(uint32_t width, PixelFormat format)
+    : width_(width),
+      format_(format),
+      // Formats without an alpha channel are opaque by definition; their fourth
+      // byte (Bgrx8) is ignored.
+      alphaChannel_(HasAlphaChannel(format)) {}
+
+void ColorAnalyzer::AddRow(const uint8_t* row) {
+  if (Done()) return;
+  const size_t bpp = BytesPerPixel(format_);
+  const size_t width = width_;
+  if (bpp == 4) {
+    if (gray_ || (alphaChannel_ && opaque_)) {
+      ScanOpaqueGray32(row, width, alphaChannel_ ? &opaque_ : &ignoredOpaque_, &gray_);
+    }
+  } else {
+    for (size_t x = 0; x < width && gray_; x++) {
+      const uint8_t* p = row + x * 3;
+      gray_ = p[0] == p[1] && p[1] == p[2];
+    }
+  }
+
+  if (fewColors_) {
+    // Screenshots are dominated by runs; skip repeats before hashing.
+    uint32_t last = ~PackArgb(row, format_);
+    for (size_t x = 0; x < width; x++) {
+      uint32_t c = PackArgb(row + x * bpp, format_);
+      if (c == last) continue;
+      last = c;
+      if (!colors_.Insert(c)) {
+        fewColors_ = false;
+        break;
+      }
+    }
+  }
+}
+
+void ColorAnalyzer::AddRows(const PixelSource& band) {
+  for (uint32_t y = 0; y < band.height && !Done(); y++) AddRow(band.Row(y));
+}
+
+bool ColorAnalyzer::Done() const {
+  return !fewColors_ && !gray_ && (!opaque_ || !alphaChannel_);
+}
+
+void ColorAnalyzer::Plan(PngColorPlan* plan) const {
+  const bool alpha = !opaque_;
+  plan->palette.clear();
+  plan->translucentEntries = 0;
+  plan->bitDepth = 8;
+  // An opaque gray image with more than 16 levels is as small as gray 8-bit
+  // without needing PLTE; otherwise a palette at <= 8 bits per pixel wins.
+  if (fewColors_ && !(gray_ && !alpha && colors_.Size() > 16)) {
+    plan->mode = PngColorMode::Palette;
+    plan->palette.reserve(ColorSet::kMaxColors);
+    // Translucent entries first, each group in first-seen order.
+    for (size_t i = 0; i < colors_.Size(); i++) {
+      if ((colors_.At(i) >> 24) != 0xFF) plan->palette.push_back(colors_.At(i));
+    }
+    plan->translucentEntries = plan->palette.size();
+    for (size_t i = 0; i < colors_.Size(); i++) {
+      if ((colors_.At(i) >> 24) == 0xFF) plan->palette.push_back(colors_.At(i));
+    }
+    const size_t n = plan->palette.size();
+    plan->bitDepth = n <= 2 ? 1 : n <= 4 ? 2 : n <= 16 ? 4 : 8;
+  } else if (gray_) {
+    plan->mode = alpha ? PngColorMode::GrayAlpha : PngColorMode::Gray;
+  } else {
+    plan->mode = alpha ? PngColorMode::Rgba : PngColorMode::Rgb;
+  }
+}
+
+PngColorPlan AnalyzePixels(const PixelSource& source) {
+  ColorAnalyzer analyzer(source.width, source.format);
+  analyzer.AddRows(source);
+  PngColorPlan plan;
+  analyzer.Plan(&plan);
+  return plan;
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PixelSource.h"
+
+// Pre-encode analysis that picks the smallest lossless PNG color type.
+// Portable (no Windows headers).
+
+namespace ptf_helper {
+
+enum class PngColorMode {
+  Gray,       // color type 0
+  Rgb,        // color type 2
+  Palette,    // color type 3 (+ tRNS when some entries are translucent)
+  GrayAlpha,  // color type 4
+  Rgba,       // color type 6
+};
+
+// Open-addressed set of at most kMaxColors colors (0xAARRGGBB), each mapped to
+// its palette index. Fixed size so analysis never allocates per pixel.
+class ColorSet {
+ public:
+  static constexpr size_t kMaxColors = 256;
+
+  ColorSet() { Clear(); }
+
+  void Clear();
+
+  // Adds `color` if new. Returns false (and leaves the set unchanged) once
+  // kMaxColors distinct colors are already present.
+  bool Insert(uint32_t color);
+
+  // Palette index of `color`, or -1.
+  int Find(uint32_t color) const;
+
+  size_t Size() const { return count_; }
+  uint32_t At(size_t index) const { return colors_[index]; }
+
+ private:
+  static constexpr size_t kSlots = 1024;  // load factor stays at or below 1/4
+
+  static size_t Slot(uint32_t color) { return (color * 0x9E3779B1u) >> 22; }
+
+  uint32_t keys_[kSlots];
+  int16_t index_[kSlots];  // -1 = empty
+  uint32_t colors_[kMaxColors];
+  size_t count_ = 0;
+};
+
+struct PngColorPlan {
+  PngColorMode mode = PngColorMode::Rgba;
+  // Palette mode only: entries with alpha < 0xFF first, so tRNS stays short.
+  std::vector<uint32_t> palette;
+  size_t translucentEntries = 0;
+  int bitDepth = 8;  // 1, 2, 4 or 8 for Palette; 8 otherwise
+};
+
+// Incremental form of AnalyzePixels for images supplied in bands.
+class ColorAnalyzer {
+ public:
+  ColorAnalyzer(uint32_t width, PixelFormat format);
+
+  // Rows must all be `width` pixels of the constructor's format.
+  void AddRow(const uint8_t* row);
+  void AddRows(const PixelSource& band);
+
+  // True once every cheaper layout is ruled out; further rows change nothing.
+  bool Done() const;
+
+  // Fills `plan`, reusing its palette's memory.
+  void Plan(PngColorPlan* plan) const;
+
+ private:
+  uint32_t width_;
+  PixelFormat format_;
+  bool alphaChannel_;
+  bool opaque_ = true;
+  bool gray_ = true;
+  bool fewColors_ = true;
+  bool ignoredOpaque_ = true;
+  ColorSet colors_;
+};
+
+// Scans the image once: SIMD checks for fully opaque alpha and R == G == B,
+// plus a bounded color count that stops at 257 colors. Returns the most
+// compact layout that reproduces every pixel exactly.
+PngColorPlan AnalyzePixels(const PixelSource& source);
+
+} // namespace ptf_helper
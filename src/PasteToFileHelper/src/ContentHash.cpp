@@ -0,0 +1,115 @@
+#include "ContentHash.h"
+
+#include <cstring>
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+
+uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// Little-endian loads; the helper only targets little-endian machines.
+uint64_t Load64(const uint8_t* p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t Load32(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint64_t Round(uint64_t acc, uint64_t input) {
+  acc += input * kPrime2;
+  acc = Rotl(acc, 31);
+  return acc * kPrime1;
+}
+
+uint64_t MergeRound(uint64_t acc, uint64_t v) {
+  acc ^= Round(0, v);
+  return acc * kPrime1 + kPrime4;
+}
+
+} // namespace
+
+Xxh64::Xxh64(uint64_t seed) : seed_(seed) {
+  v_[0] = seed + kPrime1 + kPrime2;
+  v_[1] = seed + kPrime2;
+  v_[2] = seed;
+  v_[3] = seed - kPrime1;
+}
+
+void Xxh64::Update(const uint8_t* data, size_t size) {
+  total_ += size;
+  if (buffered_ > 0) {
+    const size_t take = size < 32 - buffered_ ? size : 32 - buffered_;
+    std::memcpy(buffer_ + buffered_, data, take);
+    buffered_ += take;
+    data += take;
+    size -= take;
+    if (buffered_ < 32) return;
+    for (int i = 0; i < 4; i++) v_[i] = Round(v_[i], Load64(buffer_ + 8 * i));
+    buffered_ = 0;
+  }
+  // Four independent lanes per 32-byte stripe.
+  uint64_t v0 = v_[0], v1 = v_[1], v2 = v_[2], v3 = v_[3];
+  for (; size >= 32; data += 32, size -= 32) {
+    v0 = Round(v0, Load64(data));
+    v1 = Round(v1, Load64(data + 8));
+    v2 = Round(v2, Load64(data + 16));
+    v3 = Round(v3, Load64(data + 24));
+  }
+  v_[0] = v0;
+  v_[1] = v1;
+  v_[2] = v2;
+  v_[3] = v3;
+  if (size > 0) {
+    std::memcpy(buffer_, data, size);
+    buffered_ = size;
+  }
+}
+
+uint64_t Xxh64::Digest() const {
+  uint64_t h;
+  if (total_ >= 32) {
+    h = Rotl(v_[0], 1) + Rotl(v_[1], 7) + Rotl(v_[2], 12) + Rotl(v_[3], 18);
+    for (int i = 0; i < 4; i++) h = MergeRound(h, v_[i]);
+  } else {
+    h = seed_ + kPrime5;
+  }
+  h += total_;
+
+  const uint8_t* p = buffer_;
+  size_t n = buffered_;
+  for (; n >= 8; p += 8, n -= 8) {
+    h ^= Round(0, Load64(p));
+    h = Rotl(h, 27) * kPrime1 + kPrime4;
+  }
+  if (n >= 4) {
+    h ^= static_cast<uint64_t>(Load32(p)) * kPrime1;
+    h = Rotl(h, 23) * kPrime2 + kPrime3;
+    p += 4;
+    n -= 4;
+  }
+  for (; n > 0; p++, n--) {
+    h ^= *p * kPrime5;
+    h = Rotl(h, 11) * kPrime1;
+  }
+
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ByteSink.h"
+
+// Fast non-cryptographic content hash for spotting repeated saves: XXH64
+// (same results as the reference xxHash implementation), fed incrementally.
+// Portable (no Windows headers).
+
+namespace ptf_helper {
+
+class Xxh64 {
+ public:
+  explicit Xxh64(uint64_t seed = 0);
+
+  void Update(const uint8_t* data, size_t size);
+  uint64_t Digest() const;
+  uint64_t Bytes() const { return total_; }
+
+ private:
+  uint64_t v_[4];
+  uint64_t seed_;
+  uint64_t total_ = 0;
+  uint8_t buffer_[32];
+  size_t buffered_ = 0;
+};
+
+// Passes everything through to `out`, hashing it on the way.
+class HashingSink : public ByteSink {
+ public:
+  explicit HashingSink(ByteSink* out) : out_(out) {}
+  bool Write(const uint8_t* data, size_t size) override {
+    hash_.Update(data, size);
+    return out_->Write(data, size);
+  }
+  const Xxh64& Hash() const { return hash_; }
+
+ private:
+  ByteSink* out_;
+  Xxh64 hash_;
+};
+
+} // namespace ptf_helper
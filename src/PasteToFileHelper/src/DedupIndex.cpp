@@ -0,0 +1,178 @@
+#include "DedupIndex.h"
+
+#include <cstring>
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr uint64_t kMagic = 0x3150554444465450ULL;  // "PTFDDUP1"
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kMaxSlots = 1u << 24;
+constexpr uint32_t kMaxHeapBytes = 1u << 30;
+constexpr size_t kMaxNameBytes = 0xFFFF;
+
+// Key 0 marks an empty slot.
+uint64_t StoredKey(uint64_t key) { return key != 0 ? key : 1; }
+
+bool HasRoomFor(uint32_t entries, uint32_t slots) {
+  return static_cast<uint64_t>(entries) * 10 <= static_cast<uint64_t>(slots) * 7;
+}
+
+} // namespace
+
+struct DedupIndex::Header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t slotCount;
+  uint32_t used;
+  uint32_t heapBytes;
+  uint32_t heapUsed;
+  uint32_t reserved;
+};
+
+struct DedupIndex::Slot {
+  uint64_t key;
+  uint64_t size;
+  uint64_t writeTime;
+  uint32_t nameOffset;
+  uint16_t nameBytes;
+  uint16_t reserved;
+};
+
+static_assert(sizeof(DedupIndex::Header) == 32, "index header layout");
+static_assert(sizeof(DedupIndex::Slot) == 32, "index slot layout");
+
+size_t DedupIndex::ImageBytes(uint32_t slots, uint32_t heapBytes) {
+  return sizeof(Header) + static_cast<size_t>(slots) * sizeof(Slot) + heapBytes;
+}
+
+void DedupIndex::Format(uint8_t* data, uint32_t slots, uint32_t heapBytes) {
+  std::memset(data, 0, ImageBytes(slots, heapBytes));
+  Header header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.slotCount = slots;
+  header.heapBytes = heapBytes;
+  std::memcpy(data, &header, sizeof(header));
+}
+
+DedupIndex::Slot* DedupIndex::slots() const {
+  return reinterpret_cast<Slot*>(data_ + sizeof(Header));
+}
+
+uint8_t* DedupIndex::heap() const {
+  return data_ + sizeof(Header) + static_cast<size_t>(header()->slotCount) * sizeof(Slot);
+}
+
+bool DedupIndex::Attach(uint8_t* data, size_t size) {
+  data_ = nullptr;
+  if (!data || size < sizeof(Header)) return false;
+  const Header* h = reinterpret_cast<const Header*>(data);
+  if (h->magic != kMagic || h->version != kVersion) return false;
+  if (h->slotCount == 0 || h->slotCount > kMaxSlots ||
+      (h->slotCount & (h->slotCount - 1)) != 0) {
+    return false;
+  }
+  if (h->heapBytes > kMaxHeapBytes || h->heapUsed > h->heapBytes) return false;
+  if (h->used >= h->slotCount) return false;
+  if (ImageBytes(h->slotCount, h->heapBytes) > size) return false;
+  data_ = data;
+  return true;
+}
+
+size_t DedupIndex::Bytes() const {
+  return data_ ? ImageBytes(header()->slotCount, header()->heapBytes) : 0;
+}
+
+uint32_t DedupIndex::Count() const { return data_ ? header()->used : 0; }
+
+// Names are checked against the heap on every read: another process may have
+// left the file half-written.
+bool DedupIndex::Read(const Slot& slot, DedupEntry* entry) const {
+  if (static_cast<uint64_t>(slot.nameOffset) + slot.nameBytes > header()->heapUsed) return false;
+  entry->key = slot.key;
+  entry->size = slot.size;
+  entry->writeTime = slot.writeTime;
+  entry->name = std::string_view(reinterpret_cast<const char*>(heap() + slot.nameOffset),
+                                 slot.nameBytes);
+  return true;
+}
+
+bool DedupIndex::Find(uint64_t key, uint64_t size, DedupEntry* entry) const {
+  if (!data_) return false;
+  key = StoredKey(key);
+  const uint32_t mask = header()->slotCount - 1;
+  const Slot* table = slots();
+  // The table is never full, so an empty slot ends every probe; the bound
+  // only matters for a damaged file.
+  uint32_t i = static_cast<uint32_t>(key) & mask;
+  for (uint32_t probes = 0; probes <= mask; probes++, i = (i + 1) & mask) {
+    const Slot& slot = table[i];
+    if (slot.key == 0) return false;
+    if (slot.key == key && slot.size == size) return Read(slot, entry);
+  }
+  return false;
+}
+
+bool DedupIndex::Insert(const DedupEntry& entry) {
+  if (!data_ || entry.name.empty() || entry.name.size() > kMaxNameBytes) return false;
+  Header* h = header();
+  if (h->heapBytes - h->heapUsed < entry.name.size()) return false;
+
+  const uint64_t key = StoredKey(entry.key);
+  const uint32_t mask = h->slotCount - 1;
+  Slot* table = slots();
+  uint32_t i = static_cast<uint32_t>(key) & mask;
+  uint32_t probes = 0;
+  while (table[i].key != 0 && !(table[i].key == key && table[i].size == entry.size)) {
+    if (++probes > mask) return false;
+    i = (i + 1) & mask;
+  }
+  const bool added = table[i].key == 0;
+  // Keep the load at or below 70% so probes stay short.
+  if (added && !HasRoomFor(h->used + 1, h->slotCount)) return false;
+
+  std::memcpy(heap() + h->heapUsed, entry.name.data(), entry.name.size());
+  Slot slot{};
+  slot.key = key;
+  slot.size = entry.size;
+  slot.writeTime = entry.writeTime;
+  slot.nameOffset = h->heapUsed;
+  slot.nameBytes = static_cast<uint16_t>(entry.name.size());
+  h->heapUsed += static_cast<uint32_t>(entry.name.size());
+  // The key goes in last, so a reader never sees a live slot without its name.
+  Slot& target = table[i];
+  target.size = slot.size;
+  target.writeTime = slot.writeTime;
+  target.nameOffset = slot.nameOffset;
+  target.nameBytes = slot.nameBytes;
+  target.key = slot.key;
+  if (added) h->used++;
+  return true;
+}
+
+void DedupIndex::GrowSize(size_t nameBytes, uint32_t* slots, uint32_t* heapBytes) const {
+  uint32_t s = kInitialSlots;
+  uint32_t heap = kInitialHeapBytes;
+  if (data_) {
+    s = header()->slotCount;
+    heap = header()->heapBytes;
+    if (!HasRoomFor(header()->used + 1, s)) s *= 2;
+    // Compaction may free some of the heap, but not reliably enough to count on.
+    while (heap < kMaxHeapBytes && heap - header()->heapUsed < nameBytes + heap / 4) heap *= 2;
+  }
+  *slots = s < kMaxSlots ? s : kMaxSlots;
+  *heapBytes = heap < kMaxHeapBytes ? heap : kMaxHeapBytes;
+}
+
+void DedupIndex::CopyTo(DedupIndex* to) const {
+  if (!data_) return;
+  const Slot* table = slots();
+  for (uint32_t i = 0; i < header()->slotCount; i++) {
+    DedupEntry entry;
+    if (table[i].key != 0 && Read(table[i], &entry)) to->Insert(entry);
+  }
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// A hash -> file name table laid out in one flat block of bytes, so it can
+// live in a memory-mapped file and be updated in place (see DedupStore).
+// Portable (no Windows headers).
+//
+// Layout (little-endian): a 32-byte header, a power-of-two array of 32-byte
+// slots (open addressing, linear probing) and a heap of UTF-8 file names.
+// Lookups and inserts touch one or two slots on average; the table is
+// rebuilt larger when it is 70% full or the heap runs out.
+
+namespace ptf_helper {
+
+struct DedupEntry {
+  uint64_t key = 0;        // content hash, mixed with the extension
+  uint64_t size = 0;       // file size in bytes
+  uint64_t writeTime = 0;  // last write time when recorded
+  std::string_view name;   // UTF-8, no directory
+};
+
+class DedupIndex {
+ public:
+  static constexpr uint32_t kInitialSlots = 1024;
+  static constexpr uint32_t kInitialHeapBytes = 64 * 1024;
+
+  struct Header;
+  struct Slot;
+
+  static size_t ImageBytes(uint32_t slots, uint32_t heapBytes);
+
+  // Writes an empty index into `data`, which holds ImageBytes(slots, heapBytes).
+  static void Format(uint8_t* data, uint32_t slots, uint32_t heapBytes);
+
+  // Uses the index in `data`. False (and detached) when the bytes are not a
+  // well-formed index or it does not fit in `size`.
+  bool Attach(uint8_t* data, size_t size);
+
+  // Bytes the attached index occupies (may be less than the mapping).
+  size_t Bytes() const;
+
+  bool Find(uint64_t key, uint64_t size, DedupEntry* entry) const;
+
+  // Adds the entry, replacing one with the same key and size. False when it
+  // does not fit; then copy to a larger index (GrowSize, CopyTo) and retry.
+  bool Insert(const DedupEntry& entry);
+
+  // Sizes for a rebuilt index that can take an entry with a `nameBytes` name.
+  void GrowSize(size_t nameBytes, uint32_t* slots, uint32_t* heapBytes) const;
+
+  // Inserts every entry into `to` (which must be large enough), leaving out
+  // the names of replaced entries.
+  void CopyTo(DedupIndex* to) const;
+
+  uint32_t Count() const;
+
+ private:
+  Header* header() const { return reinterpret_cast<Header*>(data_); }
+  Slot* slots() const;
+  uint8_t* heap() const;
+  bool Read(const Slot& slot, DedupEntry* entry) const;
+
+  uint8_t* data_ = nullptr;
+};
+
+} // namespace ptf_helper
@@ -0,0 +1,166 @@
+#include "DedupStore.h"
+
+#include <cstring>
+#include <vector>
+
+#include "PasteToFileCommon/Logging.h"
+#include "PasteToFileCommon/Utf.h"
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr wchar_t kIndexName[] = L"~ptf-dedup.idx";
+
+// The lock is taken on a byte far past the end of the file: it serializes
+// helper processes without getting in the way of the mapped view.
+constexpr DWORD kLockOffsetHigh = 0x7FFFFFFF;
+
+bool FileStamp(const std::wstring& path, uint64_t* size, uint64_t* writeTime) {
+  WIN32_FILE_ATTRIBUTE_DATA data{};
+  if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) return false;
+  if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) return false;
+  *size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+  *writeTime = (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+               data.ftLastWriteTime.dwLowDateTime;
+  return true;
+}
+
+// Recorded names never leave the folder, whatever is in the file.
+bool IsPlainName(const std::wstring& name) {
+  return !name.empty() && name != L"." && name != L".." &&
+         name.find_first_of(L"\\/:") == std::wstring::npos;
+}
+
+} // namespace
+
+class DedupStore::Lock {
+ public:
+  explicit Lock(HANDLE file) : file_(file) {
+    OVERLAPPED ov{};
+    ov.OffsetHigh = kLockOffsetHigh;
+    locked_ = LockFileEx(file_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov) != FALSE;
+  }
+  ~Lock() {
+    if (!locked_) return;
+    OVERLAPPED ov{};
+    ov.OffsetHigh = kLockOffsetHigh;
+    UnlockFileEx(file_, 0, 1, 0, &ov);
+  }
+  Lock(const Lock&) = delete;
+  Lock& operator=(const Lock&) = delete;
+  bool Locked() const { return locked_; }
+
+ private:
+  HANDLE file_;
+  bool locked_ = false;
+};
+
+DedupStore::~DedupStore() {
+  Unmap();
+  if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+}
+
+bool DedupStore::Open(const std::wstring& dir) {
+  dir_ = dir;
+  const std::wstring path = dir + L"\\" + kIndexName;
+  file_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS,
+                      FILE_ATTRIBUTE_HIDDEN, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
+                      L"[Helper] dedup: cannot open " + path + L" err=" +
+                          std::to_wstring(GetLastError()));
+    return false;
+  }
+  Lock lock(file_);
+  return lock.Locked() && Refresh();
+}
+
+bool DedupStore::Map(size_t bytes) {
+  const uint64_t size = bytes;
+  mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+                                static_cast<DWORD>(size), nullptr);
+  if (!mapping_) return false;
+  view_ = static_cast<uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0,
+                                              bytes));
+  if (!view_) {
+    Unmap();
+    return false;
+  }
+  viewBytes_ = bytes;
+  return true;
+}
+
+void DedupStore::Unmap() {
+  index_.Attach(nullptr, 0);
+  if (view_) UnmapViewOfFile(view_);
+  if (mapping_) CloseHandle(mapping_);
+  view_ = nullptr;
+  mapping_ = nullptr;
+  viewBytes_ = 0;
+}
+
+// Called with the lock held: another process may have grown or rebuilt the
+// file since the last operation.
+bool DedupStore::Refresh() {
+  LARGE_INTEGER size{};
+  if (!GetFileSizeEx(file_, &size)) return false;
+  if (static_cast<uint64_t>(size.QuadPart) != viewBytes_) {
+    Unmap();
+    if (size.QuadPart > 0 && !Map(static_cast<size_t>(size.QuadPart))) return false;
+  }
+  if (index_.Attach(view_, viewBytes_)) return true;
+  // New, or not an index we can read: start over.
+  return Rebuild(nullptr, 0);
+}
+
+// Rewrites the file as a fresh index holding `from`'s entries, sized to take
+// one more entry with a `nameBytes` name.
+bool DedupStore::Rebuild(const DedupIndex* from, size_t nameBytes) {
+  uint32_t slots = DedupIndex::kInitialSlots;
+  uint32_t heapBytes = DedupIndex::kInitialHeapBytes;
+  if (from) from->GrowSize(nameBytes, &slots, &heapBytes);
+  std::vector<uint8_t> image(DedupIndex::ImageBytes(slots, heapBytes));
+  DedupIndex::Format(image.data(), slots, heapBytes);
+  DedupIndex fresh;
+  fresh.Attach(image.data(), image.size());
+  if (from) from->CopyTo(&fresh);
+
+  Unmap();
+  LARGE_INTEGER end{};
+  end.QuadPart = static_cast<LONGLONG>(image.size());
+  if (!SetFilePointerEx(file_, end, nullptr, FILE_BEGIN) || !SetEndOfFile(file_) ||
+      !Map(image.size())) {
+    return false;
+  }
+  std::memcpy(view_, image.data(), image.size());
+  return index_.Attach(view_, viewBytes_);
+}
+
+bool DedupStore::Find(uint64_t key, uint64_t size, std::wstring* fileName) {
+  DedupEntry entry;
+  {
+    Lock lock(file_);
+    if (!lock.Locked() || !Refresh() || !index_.Find(key, size, &entry)) return false;
+    *fileName = ptf::Utf8ToWide(entry.name);
+  }
+  uint64_t fileSize = 0;
+  uint64_t writeTime = 0;
+  return IsPlainName(*fileName) && FileStamp(dir_ + L"\\" + *fileName, &fileSize, &writeTime) &&
+         fileSize == size && writeTime == entry.writeTime;
+}
+
+void DedupStore::Add(uint64_t key, const std::wstring& fileName) {
+  DedupEntry entry;
+  entry.key = key;
+  if (!FileStamp(dir_ + L"\\" + fileName, &entry.size, &entry.writeTime)) return;
+  const std::string name = ptf::WideToUtf8(fileName);
+  entry.name = name;
+
+  Lock lock(file_);
+  if (!lock.Locked() || !Refresh()) return;
+  if (!index_.Insert(entry) && Rebuild(&index_, name.size())) index_.Insert(entry);
+}
+
+} // namespace ptf_helper
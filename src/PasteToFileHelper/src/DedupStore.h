@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <windows.h>
+
+#include "DedupIndex.h"
+
+namespace ptf_helper {
+
+// The dedup index of one folder: a hidden "~ptf-dedup.idx" file, mapped into
+// memory once per run and updated in place. Other helper processes may use
+// the same file; every operation holds a lock on it, and the index is only a
+// cache: entries are checked against the files they name before use, and a
+// damaged index is started over.
+class DedupStore {
+ public:
+  DedupStore() = default;
+  ~DedupStore();
+  DedupStore(const DedupStore&) = delete;
+  DedupStore& operator=(const DedupStore&) = delete;
+
+  // False when the index file cannot be created or mapped.
+  bool Open(const std::wstring& dir);
+
+  // The name of a file in the folder with this content: one recorded with
+  // the same key and size, and unchanged since.
+  bool Find(uint64_t key, uint64_t size, std::wstring* fileName);
+
+  // Records a file just saved in the folder.
+  void Add(uint64_t key, const std::wstring& fileName);
+
+ private:
+  class Lock;
+
+  bool Map(size_t bytes);
+  void Unmap();
+  bool Refresh();
+  bool Rebuild(const DedupIndex* from, size_t nameBytes);
+
+  std::wstring dir_;
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+  uint8_t* view_ = nullptr;
+  size_t viewBytes_ = 0;
+  DedupIndex index_;
+};
+
+} // namespace ptf_helper
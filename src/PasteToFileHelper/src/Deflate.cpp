@@ -0,0 +1,681 @@
+#include "Deflate.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr size_t kWindowSize = 32768;
+constexpr size_t kMaxPending = 128 * 1024;
+constexpr size_t kMaxTokensPerBlock = 32 * 1024;
+constexpr int kMinMatch = 3;
+constexpr int kMaxMatch = 258;
+constexpr int kHashBits = 15;
+constexpr uint32_t kHashMask = (1u << kHashBits) - 1;
+
+constexpr int kNumLitLen = 286;
+constexpr int kNumDist = 30;
+constexpr int kNumCodeLen = 19;
+
+constexpr uint16_t kLenBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,
+                                   15, 17, 19, 23, 27, 31, 35, 43, 51,  59,
+                                   67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLenExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                   2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,
+                                    17,   25,   33,   49,   65,   97,    129,   193,
+                                    257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                                    4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,  4,  4,  5,  5,  6,
+                                    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr uint8_t kCodeLenOrder[kNumCodeLen] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                                11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+struct Tables {
+  uint32_t crc[256];
+  uint8_t lenCode[kMaxMatch + 1];  // match length -> index into kLenBase
+  uint8_t distCode[512];           // see DistCode()
+  uint8_t fixedLitLen[288];
+
+  Tables() {
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+      crc[n] = c;
+    }
+    for (int code = 0; code < 29; code++) {
+      int last = (code == 28) ? kMaxMatch : kLenBase[code] + (1 << kLenExtra[code]) - 1;
+      for (int len = kLenBase[code]; len <= last && len <= kMaxMatch; len++) {
+        lenCode[len] = static_cast<uint8_t>(code);
+      }
+    }
+    lenCode[kMaxMatch] = 28;
+    for (int code = 0; code < kNumDist; code++) {
+      int first = kDistBase[code];
+      int last = first + (1 << kDistExtra[code]) - 1;
+      for (int d = first; d <= last; d++) {
+        if (d <= 256) {
+          distCode[d - 1] = static_cast<uint8_t>(code);
+        } else {
+          distCode[256 + ((d - 1) >> 7)] = static_cast<uint8_t>(code);
+        }
+      }
+    }
+    for (int i = 0; i < 288; i++) {
+      fixedLitLen[i] = static_cast<uint8_t>(i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8);
+    }
+  }
+};
+
+const Tables& GetTables() {
+  static const Tables tables;
+  return tables;
+}
+
+inline int DistCode(const Tables& t, uint32_t dist) {
+  return dist <= 256 ? t.distCode[dist - 1] : t.distCode[256 + ((dist - 1) >> 7)];
+}
+
+inline uint32_t Hash3(const uint8_t* p) {
+  return ((static_cast<uint32_t>(p[0]) << 10) ^ (static_cast<uint32_t>(p[1]) << 5) ^ p[2]) &
+         kHashMask;
+}
+
+inline uint16_t ReverseBits(uint16_t code, int len) {
+  uint16_t r = 0;
+  for (int i = 0; i < len; i++) {
+    r = static_cast<uint16_t>((r << 1) | (code & 1));
+    code >>= 1;
+  }
+  return r;
+}
+
+// Builds canonical code words (bit-reversed for LSB-first output).
+void BuildCodes(const uint8_t* lengths, int n, uint16_t* codes) {
+  uint16_t count[16]{};
+  for (int i = 0; i < n; i++) count[lengths[i]]++;
+  count[0] = 0;
+  uint16_t next[16]{};
+  uint16_t code = 0;
+  for (int bits = 1; bits < 16; bits++) {
+    code = static_cast<uint16_t>((code + count[bits - 1]) << 1);
+    next[bits] = code;
+  }
+  for (int i = 0; i < n; i++) {
+    int len = lengths[i];
+    codes[i] = len ? ReverseBits(next[len]++, len) : 0;
+  }
+}
+
+// Length-limited Huffman code lengths (zlib-style overflow redistribution).
+// Works in fixed-size arrays: it runs three times per block, so it must not
+// allocate. n <= kNumLitLen.
+void BuildLengths(const uint32_t* freq, int n, int maxBits, uint8_t* lengths) {
+  struct Node {
+    uint32_t freq;
+    int parent;
+  };
+  Node nodes[2 * kNumLitLen];
+  int leaves[kNumLitLen];
+  int depth[2 * kNumLitLen];
+  size_t nodeCount = 0;
+  size_t leafCount = 0;
+  std::fill(lengths, lengths + n, uint8_t{0});
+
+  for (int i = 0; i < n; i++) {
+    if (freq[i]) leaves[leafCount++] = i;
+  }
+  // Deflate decoders want a complete code; pad with dummy symbols.
+  for (int i = 0; leafCount < 2 && i < n; i++) {
+    if (!freq[i]) leaves[leafCount++] = i;
+  }
+  std::sort(leaves, leaves + leafCount, [&](int a, int b) {
+    return freq[a] != freq[b] ? freq[a] < freq[b] : a < b;
+  });
+
+  for (size_t i = 0; i < leafCount; i++) {
+    const int sym = leaves[i];
+    nodes[nodeCount++] = Node{freq[sym] ? freq[sym] : 1, -1};
+  }
+
+  // Two-queue Huffman construction: leaves are sorted, internal nodes are
+  // produced in non-decreasing order.
+  size_t leafNext = 0;
+  size_t innerNext = leafCount;
+  auto takeMin = [&]() -> int {
+    bool leafOk = leafNext < leafCount;
+    bool innerOk = innerNext < nodeCount;
+    if (leafOk && (!innerOk || nodes[leafNext].freq <= nodes[innerNext].freq)) {
+      return static_cast<int>(leafNext++);
+    }
+    return static_cast<int>(innerNext++);
+  };
+  for (size_t merges = 0; merges + 1 < leafCount; merges++) {
+    int a = takeMin();
+    int b = takeMin();
+    nodes[nodeCount] = Node{nodes[a].freq + nodes[b].freq, -1};
+    nodes[a].parent = static_cast<int>(nodeCount);
+    nodes[b].parent = static_cast<int>(nodeCount);
+    nodeCount++;
+  }
+
+  // Depths top-down (parents always have larger indices), clamped to maxBits.
+  depth[nodeCount - 1] = 0;
+  uint32_t blCount[16]{};
+  for (int i = static_cast<int>(nodeCount) - 2; i >= 0; i--) {
+    const int d = std::min(depth[nodes[i].parent] + 1, maxBits);
+    depth[i] = d;
+    if (i < static_cast<int>(leafCount)) blCount[d]++;
+  }
+
+  // Clamping oversubscribes the code. The Kraft sum, in units of 2^-maxBits,
+  // must come back to exactly 2^maxBits: each step moves one maxBits leaf
+  // under a shorter leaf, which lengthens it by one bit and lowers the sum by
+  // one. Counting clamped leaves alone (as opposed to the sum) can stop short
+  // and leave a code decoders reject.
+  uint32_t kraft = 0;
+  for (int bits = 1; bits <= maxBits; bits++) kraft += blCount[bits] << (maxBits - bits);
+  while (kraft > (1u << maxBits)) {
+    blCount[maxBits]--;
+    for (int bits = maxBits - 1; bits > 0; bits--) {
+      if (blCount[bits] != 0) {
+        blCount[bits]--;
+        blCount[bits + 1] += 2;
+        break;
+      }
+    }
+    kraft--;
+  }
+
+  // Least frequent symbols get the longest codes.
+  size_t k = 0;
+  for (int bits = maxBits; bits >= 1; bits--) {
+    for (uint32_t c = 0; c < blCount[bits]; c++) {
+      lengths[leaves[k++]] = static_cast<uint8_t>(bits);
+    }
+  }
+}
+
+} // namespace
+
+uint32_t Crc32Update(uint32_t crc, const uint8_t* data, size_t size) {
+  const Tables& t = GetTables();
+  uint32_t c = crc ^ 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; i++) c = t.crc[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+  return c ^ 0xFFFFFFFFu;
+}
+
+uint32_t Adler32Update(uint32_t adler, const uint8_t* data, size_t size) {
+  constexpr uint32_t kMod = 65521;
+  constexpr size_t kMaxRun = 5552;  // largest n with no uint32 overflow
+  uint32_t a = adler & 0xFFFF;
+  uint32_t b = adler >> 16;
+  while (size > 0) {
+    size_t n = std::min(size, kMaxRun);
+    size -= n;
+    for (size_t i = 0; i < n; i++) {
+      a += data[i];
+      b += a;
+    }
+    data += n;
+    a %= kMod;
+    b %= kMod;
+  }
+  return (b << 16) | a;
+}
+
+namespace {
+
+// a * b modulo the CRC-32 polynomial, in the reflected bit order of the CRC.
+uint32_t MultModP(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31;
+  uint32_t p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) break;
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ 0xEDB88320u : b >> 1;
+  }
+  return p;
+}
+
+} // namespace
+
+uint32_t Crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t size2) {
+  // x^(2^k) mod P for k = 0..31; appending size2 zero bytes multiplies by
+  // x^(8 * size2), built from these powers as in zlib's crc32_combine.
+  static const struct Powers {
+    uint32_t x2n[32];
+    Powers() {
+      x2n[0] = 1u << 30;  // x^1
+      for (int k = 1; k < 32; k++) x2n[k] = MultModP(x2n[k - 1], x2n[k - 1]);
+    }
+  } powers;
+  uint32_t factor = 1u << 31;  // x^0
+  unsigned k = 3;
+  for (uint64_t n = size2; n != 0; n >>= 1, k++) {
+    if (n & 1) factor = MultModP(powers.x2n[k & 31], factor);
+  }
+  return MultModP(factor, crc1) ^ crc2;
+}
+
+DeflateEncoder::DeflateEncoder(int level) { Reset(level); }
+
+void DeflateEncoder::Reset(int level) {
+  struct Params {
+    int chain;
+    int nice;
+    bool lazy;
+  };
+  static const Params kParams[10] = {{0, 0, false},     {4, 16, false},
+                                     {8, 32, false},    {32, 32, false},
+                                     {16, 32, true},    {32, 64, true},
+                                     {128, 128, true},  {256, 128, true},
+                                     {1024, 258, true}, {4096, 258, true}};
+  level_ = std::clamp(level, 0, 9);
+  maxChain_ = kParams[level_].chain;
+  niceLength_ = kParams[level_].nice;
+  lazy_ = kParams[level_].lazy;
+
+  window_.clear();
+  window_.reserve(kWindowSize + kMaxPending);
+  pendingBegin_ = 0;
+  head_.assign(size_t{1} << kHashBits, -1);
+  prev_.assign(kWindowSize + kMaxPending, -1);
+  tokens_.clear();
+  out_.clear();
+  bitBuf_ = 0;
+  bitCount_ = 0;
+}
+
+void DeflateEncoder::SetDictionary(const uint8_t* data, size_t size) {
+  // Only the last 32 KiB can be referenced by a match.
+  if (size > kWindowSize) {
+    data += size - kWindowSize;
+    size = kWindowSize;
+  }
+  window_.assign(data, data + size);
+  pendingBegin_ = size;
+  for (size_t p = 0; p + kMinMatch <= size; p++) {
+    uint32_t h = Hash3(window_.data() + p);
+    prev_[p] = head_[h];
+    head_[h] = static_cast<int32_t>(p);
+  }
+}
+
+void DeflateEncoder::PutBits(uint32_t bits, int count) {
+  bitBuf_ |= static_cast<uint64_t>(bits) << bitCount_;
+  bitCount_ += count;
+  while (bitCount_ >= 8) {
+    out_.push_back(static_cast<uint8_t>(bitBuf_));
+    bitBuf_ >>= 8;
+    bitCount_ -= 8;
+  }
+}
+
+void DeflateEncoder::AlignToByte() {
+  if (bitCount_ > 0) PutBits(0, 8 - bitCount_);
+}
+
+void DeflateEncoder::Write(const uint8_t* data, size_t size) {
+  while (size > 0) {
+    size_t pending = window_.size() - pendingBegin_;
+    size_t n = std::min(size, kMaxPending - pending);
+    window_.insert(window_.end(), data, data + n);
+    data += n;
+    size -= n;
+    if (window_.size() - pendingBegin_ >= kMaxPending) CompressPending(false);
+  }
+}
+
+void DeflateEncoder::Flush(bool final) {
+  CompressPending(final);
+  if (final) {
+    AlignToByte();
+    return;
+  }
+  // Sync flush: empty stored block leaves the stream byte-aligned.
+  PutBits(0, 3);
+  AlignToByte();
+  PutBits(0x0000, 16);
+  PutBits(0xFFFF, 16);
+}
+
+void DeflateEncoder::CompressPending(bool final) {
+  const size_t end = window_.size();
+  size_t pos = pendingBegin_;
+  if (pos == end) {
+    if (final) {
+      // Empty final block with fixed codes: header + end-of-block.
+      PutBits(1, 1);
+      PutBits(1, 2);
+      PutBits(0, 7);
+    }
+    return;
+  }
+
+  tokens_.clear();
+  size_t blockBegin = pos;
+  size_t covered = pos;  // raw bytes represented by tokens_
+  const uint8_t* w = window_.data();
+
+  auto hashAt = [&](size_t p) -> uint32_t { return Hash3(w + p); };
+  auto insert = [&](size_t p) {
+    if (p + kMinMatch > end) return;
+    uint32_t h = hashAt(p);
+    prev_[p] = head_[h];
+    head_[h] = static_cast<int32_t>(p);
+  };
+  auto findMatch = [&](size_t p, int minBetter, uint32_t* distOut) -> int {
+    size_t avail = end - p;
+    if (avail < static_cast<size_t>(kMinMatch)) return 0;
+    int limit = static_cast<int>(std::min<size_t>(avail, kMaxMatch));
+    int best = std::max(minBetter, kMinMatch - 1);
+    if (best >= limit) return 0;
+    int found = 0;
+    int32_t cand = head_[hashAt(p)];
+    for (int chain = maxChain_; cand >= 0 && chain > 0; chain--) {
+      size_t dist = p - static_cast<size_t>(cand);
+      if (dist > kWindowSize) break;
+      const uint8_t* a = w + cand;
+      const uint8_t* b = w + p;
+      if (a[best] == b[best] && a[0] == b[0] && a[1] == b[1]) {
+        int len = 2;
+        while (len < limit && a[len] == b[len]) len++;
+        if (len > best) {
+          best = len;
+          found = len;
+          *distOut = static_cast<uint32_t>(dist);
+          if (len >= niceLength_ || len == limit) break;
+        }
+      }
+      cand = prev_[cand];
+    }
+    return found;
+  };
+  auto addLiteral = [&](uint8_t lit) {
+    tokens_.push_back(lit);
+    covered++;
+  };
+  auto addMatch = [&](int len, uint32_t dist) {
+    tokens_.push_back(0x80000000u | (static_cast<uint32_t>(len) << 16) | (dist - 1));
+    covered += static_cast<size_t>(len);
+  };
+  auto maybeSplit = [&]() {
+    if (tokens_.size() >= kMaxTokensPerBlock) {
+      EmitBlock(blockBegin, covered, false);
+      tokens_.clear();
+      blockBegin = covered;
+    }
+  };
+
+  if (level_ == 0) {
+    EmitBlock(pos, end, final);
+    pendingBegin_ = end;
+    SlideWindow();
+    return;
+  }
+
+  if (!lazy_) {
+    while (pos < end) {
+      uint32_t dist = 0;
+      int len = findMatch(pos, 0, &dist);
+      insert(pos);
+      if (len >= kMinMatch) {
+        addMatch(len, dist);
+        if (len <= niceLength_) {
+          for (size_t p = pos + 1; p < pos + len; p++) insert(p);
+        }
+        pos += static_cast<size_t>(len);
+      } else {
+        addLiteral(w[pos]);
+        pos++;
+      }
+      maybeSplit();
+    }
+  } else {
+    bool haveLiteral = false;
+    int prevLen = 0;
+    uint32_t prevDist = 0;
+    while (pos < end) {
+      uint32_t dist = 0;
+      int len = 0;
+      if (prevLen < niceLength_) len = findMatch(pos, prevLen, &dist);
+      insert(pos);
+      if (prevLen >= kMinMatch && len <= prevLen) {
+        addMatch(prevLen, prevDist);
+        size_t stop = pos - 1 + static_cast<size_t>(prevLen);
+        for (size_t p = pos + 1; p < stop; p++) insert(p);
+        pos = stop;
+        prevLen = 0;
+        haveLiteral = false;
+        maybeSplit();
+        continue;
+      }
+      if (haveLiteral) {
+        addLiteral(w[pos - 1]);
+        maybeSplit();
+      }
+      prevLen = len;
+      prevDist = dist;
+      haveLiteral = true;
+      pos++;
+    }
+    if (haveLiteral) addLiteral(w[pos - 1]);
+  }
+
+  EmitBlock(blockBegin, covered, final);
+  tokens_.clear();
+  pendingBegin_ = end;
+  SlideWindow();
+}
+
+void DeflateEncoder::EmitBlock(size_t rawBegin, size_t rawEnd, bool final) {
+  const Tables& t = GetTables();
+  const size_t rawSize = rawEnd - rawBegin;
+
+  auto writeStored = [&]() {
+    size_t p = rawBegin;
+    do {
+      size_t n = std::min<size_t>(rawEnd - p, 65535);
+      bool last = (p + n == rawEnd);
+      PutBits((final && last) ? 1 : 0, 1);
+      PutBits(0, 2);
+      AlignToByte();
+      PutBits(static_cast<uint32_t>(n), 16);
+      PutBits(static_cast<uint32_t>(~n) & 0xFFFF, 16);
+      out_.insert(out_.end(), window_.begin() + p, window_.begin() + p + n);
+      p += n;
+    } while (p < rawEnd);
+  };
+
+  if (level_ == 0) {
+    writeStored();
+    return;
+  }
+
+  uint32_t litFreq[kNumLitLen]{};
+  uint32_t distFreq[kNumDist]{};
+  for (uint32_t tok : tokens_) {
+    if (tok & 0x80000000u) {
+      int len = static_cast<int>((tok >> 16) & 0x1FF);
+      uint32_t dist = (tok & 0xFFFF) + 1;
+      litFreq[257 + t.lenCode[len]]++;
+      distFreq[DistCode(t, dist)]++;
+    } else {
+      litFreq[tok]++;
+    }
+  }
+  litFreq[256] = 1;
+
+  uint8_t litLen[kNumLitLen];
+  uint8_t distLen[kNumDist];
+  BuildLengths(litFreq, kNumLitLen, 15, litLen);
+  BuildLengths(distFreq, kNumDist, 15, distLen);
+
+  int hlit = kNumLitLen;
+  while (hlit > 257 && litLen[hlit - 1] == 0) hlit--;
+  int hdist = kNumDist;
+  while (hdist > 1 && distLen[hdist - 1] == 0) hdist--;
+
+  // Run-length encode the combined code-length sequence (symbols 16/17/18).
+  uint8_t all[kNumLitLen + kNumDist];
+  std::memcpy(all, litLen, hlit);
+  std::memcpy(all + hlit, distLen, hdist);
+  const int total = hlit + hdist;
+  // symbol | (extra << 8); at most one per code length
+  uint16_t clSyms[kNumLitLen + kNumDist];
+  size_t clCount = 0;
+  auto pushSym = [&](uint16_t sym) { clSyms[clCount++] = sym; };
+  for (int i = 0; i < total;) {
+    uint8_t v = all[i];
+    int run = 1;
+    while (i + run < total && all[i + run] == v) run++;
+    int left = run;
+    if (v == 0) {
+      while (left >= 11) {
+        int n = std::min(left, 138);
+        pushSym(static_cast<uint16_t>(18 | ((n - 11) << 8)));
+        left -= n;
+      }
+      if (left >= 3) {
+        pushSym(static_cast<uint16_t>(17 | ((left - 3) << 8)));
+        left = 0;
+      }
+    } else {
+      pushSym(v);
+      left--;
+      while (left >= 3) {
+        int n = std::min(left, 6);
+        pushSym(static_cast<uint16_t>(16 | ((n - 3) << 8)));
+        left -= n;
+      }
+    }
+    while (left-- > 0) pushSym(v);
+    i += run;
+  }
+
+  uint32_t clFreq[kNumCodeLen]{};
+  for (size_t i = 0; i < clCount; i++) clFreq[clSyms[i] & 0xFF]++;
+  uint8_t clLen[kNumCodeLen];
+  BuildLengths(clFreq, kNumCodeLen, 7, clLen);
+  int hclen = kNumCodeLen;
+  while (hclen > 4 && clLen[kCodeLenOrder[hclen - 1]] == 0) hclen--;
+
+  // Compare block sizes (in bits) for dynamic, fixed and stored encodings.
+  uint64_t extraBits = 0;
+  uint64_t dynBits = 5 + 5 + 4 + 3 * static_cast<uint64_t>(hclen);
+  uint64_t fixedBits = 0;
+  for (size_t i = 0; i < clCount; i++) {
+    int sym = clSyms[i] & 0xFF;
+    dynBits += clLen[sym] + (sym == 16 ? 2 : sym == 17 ? 3 : sym == 18 ? 7 : 0);
+  }
+  for (int i = 0; i < kNumLitLen; i++) {
+    dynBits += static_cast<uint64_t>(litFreq[i]) * litLen[i];
+    fixedBits += static_cast<uint64_t>(litFreq[i]) * t.fixedLitLen[i];
+    if (i >= 257) extraBits += static_cast<uint64_t>(litFreq[i]) * kLenExtra[i - 257];
+  }
+  for (int i = 0; i < kNumDist; i++) {
+    dynBits += static_cast<uint64_t>(distFreq[i]) * distLen[i];
+    fixedBits += static_cast<uint64_t>(distFreq[i]) * 5;
+    extraBits += static_cast<uint64_t>(distFreq[i]) * kDistExtra[i];
+  }
+  dynBits += extraBits + 3;
+  fixedBits += extraBits + 3;
+  uint64_t storedBits = (rawSize / 65535 + 1) * (3 + 7 + 32) + 8 * static_cast<uint64_t>(rawSize);
+
+  if (storedBits <= dynBits && storedBits <= fixedBits) {
+    writeStored();
+    return;
+  }
+
+  // The fixed code is defined over all 288 literal/length symbols.
+  uint16_t litCode[288];
+  uint16_t distCode[kNumDist];
+  const uint8_t* useLitLen = litLen;
+  int numLitLen = kNumLitLen;
+  const uint8_t* useDistLen = distLen;
+  uint8_t fixedDistLen[kNumDist];
+
+  if (fixedBits <= dynBits) {
+    std::fill(fixedDistLen, fixedDistLen + kNumDist, uint8_t{5});
+    useLitLen = t.fixedLitLen;
+    numLitLen = 288;
+    useDistLen = fixedDistLen;
+    PutBits(final ? 1 : 0, 1);
+    PutBits(1, 2);
+  } else {
+    PutBits(final ? 1 : 0, 1);
+    PutBits(2, 2);
+    PutBits(static_cast<uint32_t>(hlit - 257), 5);
+    PutBits(static_cast<uint32_t>(hdist - 1), 5);
+    PutBits(static_cast<uint32_t>(hclen - 4), 4);
+    for (int i = 0; i < hclen; i++) PutBits(clLen[kCodeLenOrder[i]], 3);
+    uint16_t clCode[kNumCodeLen];
+    BuildCodes(clLen, kNumCodeLen, clCode);
+    for (size_t i = 0; i < clCount; i++) {
+      const uint16_t s = clSyms[i];
+      int sym = s & 0xFF;
+      PutBits(clCode[sym], clLen[sym]);
+      if (sym == 16) PutBits(s >> 8, 2);
+      if (sym == 17) PutBits(s >> 8, 3);
+      if (sym == 18) PutBits(s >> 8, 7);
+    }
+  }
+  BuildCodes(useLitLen, numLitLen, litCode);
+  BuildCodes(useDistLen, kNumDist, distCode);
+
+  for (uint32_t tok : tokens_) {
+    if (tok & 0x80000000u) {
+      int len = static_cast<int>((tok >> 16) & 0x1FF);
+      uint32_t dist = (tok & 0xFFFF) + 1;
+      int lc = t.lenCode[len];
+      PutBits(litCode[257 + lc], useLitLen[257 + lc]);
+      if (kLenExtra[lc]) PutBits(static_cast<uint32_t>(len - kLenBase[lc]), kLenExtra[lc]);
+      int dc = DistCode(t, dist);
+      PutBits(distCode[dc], useDistLen[dc]);
+      if (kDistExtra[dc]) PutBits(dist - kDistBase[dc], kDistExtra[dc]);
+    } else {
+      PutBits(litCode[tok], useLitLen[tok]);
+    }
+  }
+  PutBits(litCode[256], useLitLen[256]);
+}
+
+void DeflateEncoder::SlideWindow() {
+  if (window_.size() <= kWindowSize) return;
+  const size_t shift = window_.size() - kWindowSize;
+  window_.erase(window_.begin(), window_.begin() + shift);
+  pendingBegin_ -= shift;
+
+  const int32_t s = static_cast<int32_t>(shift);
+  for (int32_t& h : head_) h = (h >= s) ? h - s : -1;
+  for (size_t i = 0; i < kWindowSize; i++) {
+    int32_t p = prev_[i + shift];
+    prev_[i] = (p >= s) ? p - s : -1;
+  }
+  std::fill(prev_.begin() + kWindowSize, prev_.end(), -1);
+}
+
+std::vector<uint8_t> ZlibCompress(const uint8_t* data, size_t size, int level) {
+  DeflateEncoder enc(level);
+  enc.Write(data, size);
+  enc.Flush(true);
+
+  std::vector<uint8_t> out;
+  out.reserve(enc.Output().size() + 6);
+  out.push_back(0x78);
+  out.push_back(level <= 1 ? 0x01 : level <= 5 ? 0x5E : level == 6 ? 0x9C : 0xDA);
+  out.insert(out.end(), enc.Output().begin(), enc.Output().end());
+  uint32_t adler = Adler32Update(1, data, size);
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(adler >> shift));
+  }
+  return out;
+}
+
+} // namespace ptf_helper
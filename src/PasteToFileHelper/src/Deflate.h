@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Self-contained DEFLATE (RFC 1951) compressor plus the checksums used by the
+// zlib and PNG containers. Portable: no Windows headers, so it can be built and
+// measured off Windows.
+
+namespace ptf_helper {
+
+uint32_t Crc32Update(uint32_t crc, const uint8_t* data, size_t size);
+uint32_t Adler32Update(uint32_t adler, const uint8_t* data, size_t size);
+
+// CRC-32 of A followed by B, from crc(A), crc(B) and the length of B, so
+// pieces of a stream can be checksummed in parallel.
+uint32_t Crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t size2);
+
+// Streaming raw-deflate encoder. Input is buffered internally; compressed
+// bytes are appended to Output() and may be drained by the caller at any time.
+class DeflateEncoder {
+ public:
+  // level: 0 (stored) .. 9 (slowest/smallest).
+  explicit DeflateEncoder(int level = 6);
+
+  void Reset(int level);
+
+  // Primes the match window with data that precedes this stream (as in
+  // pigz), without emitting it. Call right after construction or Reset().
+  void SetDictionary(const uint8_t* data, size_t size);
+
+  void Write(const uint8_t* data, size_t size);
+
+  // Compresses everything buffered so far. When final is false, the stream is
+  // byte-aligned with an empty stored block (a "sync flush") so the output can
+  // be concatenated with another deflate stream.
+  void Flush(bool final);
+
+  std::vector<uint8_t>& Output() { return out_; }
+
+ private:
+  void CompressPending(bool final);
+  void EmitBlock(size_t rawBegin, size_t rawEnd, bool final);
+  void SlideWindow();
+
+  void PutBits(uint32_t bits, int count);
+  void AlignToByte();
+
+  int level_ = 6;
+  int maxChain_ = 0;
+  int niceLength_ = 0;
+  bool lazy_ = false;
+
+  std::vector<uint8_t> window_;   // history (<= 32 KiB) + pending input
+  size_t pendingBegin_ = 0;       // first byte of window_ not yet compressed
+  std::vector<int32_t> head_;
+  std::vector<int32_t> prev_;
+  std::vector<uint32_t> tokens_;  // literal or (length, distance) per entry
+
+  std::vector<uint8_t> out_;
+  uint64_t bitBuf_ = 0;
+  int bitCount_ = 0;
+};
+
+// Convenience: compresses a whole buffer into a zlib (RFC 1950) stream.
+std::vector<uint8_t> ZlibCompress(const uint8_t* data, size_t size, int level);
+
+} // namespace ptf_helper
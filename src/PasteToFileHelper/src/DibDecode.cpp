@@ -0,0 +1,431 @@
+#include "DibDecode.h"
+
+#include <cstring>
+
+namespace ptf_helper {
+
+namespace {
+
+// wingdi.h values, repeated here to keep this file portable.
+constexpr uint32_t kBiRgb = 0;
+constexpr uint32_t kBiRle8 = 1;
+constexpr uint32_t kBiRle4 = 2;
+constexpr uint32_t kBiBitfields = 3;
+constexpr uint32_t kBiJpeg = 4;
+constexpr uint32_t kBiPng = 5;
+constexpr uint32_t kBiAlphaBitfields = 6;
+
+constexpr size_t kCoreHeaderSize = 12;  // BITMAPCOREHEADER
+constexpr size_t kInfoHeaderSize = 40;  // BITMAPINFOHEADER
+constexpr size_t kV2HeaderSize = 52;    // RGB masks inside the header
+constexpr size_t kV3HeaderSize = 56;    // plus the alpha mask
+
+// RLE bitmaps are expanded to one byte per pixel; their size is not bounded
+// by the input (delta records skip pixels), so cap it.
+constexpr uint64_t kMaxRlePixels = 1ull << 28;
+
+uint32_t ReadLe32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t ReadLe16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+constexpr int LowestSetBit(uint32_t mask) {
+  int shift = 0;
+  while (shift < 32 && !(mask & (1u << shift))) shift++;
+  return shift;
+}
+
+// True for an empty mask or one run of set bits.
+constexpr bool IsContiguous(uint32_t mask) {
+  if (mask == 0) return true;
+  const uint64_t run = (static_cast<uint64_t>(mask) >> LowestSetBit(mask)) + 1;
+  return (run & (run - 1)) == 0;
+}
+
+// Scales the channel selected by `mask` to 0..255 (0 for an empty mask).
+inline uint8_t ScaleChannel(uint32_t px, uint32_t mask, int shift, uint64_t max) {
+  if (max == 0) return 0;
+  const uint64_t v = (px & mask) >> shift;
+  return static_cast<uint8_t>(max == 255 ? v : (v * 255 + max / 2) / max);
+}
+
+template <uint32_t Mask>
+inline uint8_t FixedChannel(uint32_t px) {
+  constexpr int kShift = LowestSetBit(Mask);
+  constexpr uint32_t kMax = Mask ? Mask >> kShift : 0;
+  if constexpr (kMax == 0) {
+    return 0;
+  } else if constexpr (kMax == 255) {
+    return static_cast<uint8_t>((px & Mask) >> kShift);
+  } else if constexpr (kMax < (1u << 16)) {
+    // Small enough for 32-bit math, so the division becomes a multiply.
+    return static_cast<uint8_t>((((px & Mask) >> kShift) * 255 + kMax / 2) / kMax);
+  } else {
+    return ScaleChannel(px, Mask, kShift, kMax);
+  }
+}
+
+template <int Bytes>
+inline uint32_t ReadPixel(const uint8_t* p) {
+  if constexpr (Bytes == 2) {
+    return ReadLe16(p);
+  } else {
+    return ReadLe32(p);
+  }
+}
+
+} // namespace
+
+// Row unpackers. Templates give the common layouts constant masks and shifts,
+// so the scaling divisions compile to multiplies.
+struct DibUnpackers {
+  template <int Bits>
+  static void Palette(const DibDecoder& dib, const uint8_t* src, uint8_t* out) {
+    for (uint32_t x = 0; x < dib.width_; x++, out += 4) {
+      uint32_t index;
+      if constexpr (Bits == 8) {
+        index = src[x];
+      } else if constexpr (Bits == 4) {
+        index = (src[x >> 1] >> ((x & 1) ? 0 : 4)) & 0x0F;
+      } else {
+        index = (src[x >> 3] >> (7 - (x & 7))) & 0x01;
+      }
+      std::memcpy(out, dib.palette_ + index * 4, 4);
+    }
+  }
+
+  static void Bgr24(const DibDecoder& dib, const uint8_t* src, uint8_t* out) {
+    for (uint32_t x = 0; x < dib.width_; x++, src += 3, out += 4) {
+      out[0] = src[2];
+      out[1] = src[1];
+      out[2] = src[0];
+      out[3] = 0xFF;
+    }
+  }
+
+  template <int Bytes, uint32_t R, uint32_t G, uint32_t B, uint32_t A>
+  static void Fixed(const DibDecoder& dib, const uint8_t* src, uint8_t* out) {
+    const bool alpha = A != 0 && dib.useAlpha_;
+    for (uint32_t x = 0; x < dib.width_; x++, src += Bytes, out += 4) {
+      const uint32_t px = ReadPixel<Bytes>(src);
+      out[0] = FixedChannel<R>(px);
+      out[1] = FixedChannel<G>(px);
+      out[2] = FixedChannel<B>(px);
+      out[3] = alpha ? FixedChannel<A>(px) : 0xFF;
+    }
+  }
+
+  template <int Bytes>
+  static void Generic(const DibDecoder& dib, const uint8_t* src, uint8_t* out) {
+    int shift[4];
+    uint64_t max[4];
+    for (int c = 0; c < 4; c++) {
+      shift[c] = LowestSetBit(dib.masks_[c]);
+      max[c] = dib.masks_[c] ? static_cast<uint64_t>(dib.masks_[c]) >> shift[c] : 0;
+    }
+    for (uint32_t x = 0; x < dib.width_; x++, src += Bytes, out += 4) {
+      const uint32_t px = ReadPixel<Bytes>(src);
+      out[0] = ScaleChannel(px, dib.masks_[0], shift[0], max[0]);
+      out[1] = ScaleChannel(px, dib.masks_[1], shift[1], max[1]);
+      out[2] = ScaleChannel(px, dib.masks_[2], shift[2], max[2]);
+      out[3] = dib.useAlpha_ ? ScaleChannel(px, dib.masks_[3], shift[3], max[3]) : 0xFF;
+    }
+  }
+};
+
+bool DibDecoder::Open(const uint8_t* data, size_t size) {
+  if (!data || size < kCoreHeaderSize || unpack_ || embedded_ != ImageContainer::Unknown) {
+    return false;
+  }
+
+  const uint32_t headerSize = ReadLe32(data);
+  int64_t width = 0;
+  int64_t height = 0;
+  uint16_t planes = 0;
+  uint32_t compression = kBiRgb;
+  uint32_t imageSize = 0;
+  uint32_t colorsUsed = 0;
+  if (headerSize == kCoreHeaderSize) {
+    width = ReadLe16(data + 4);
+    height = ReadLe16(data + 6);
+    planes = ReadLe16(data + 8);
+    bitCount_ = ReadLe16(data + 10);
+  } else {
+    if (headerSize < kInfoHeaderSize || size < kInfoHeaderSize) return false;
+    width = static_cast<int32_t>(ReadLe32(data + 4));
+    height = static_cast<int32_t>(ReadLe32(data + 8));
+    planes = ReadLe16(data + 12);
+    bitCount_ = ReadLe16(data + 14);
+    compression = ReadLe32(data + 16);
+    imageSize = ReadLe32(data + 20);
+    colorsUsed = ReadLe32(data + 32);
+  }
+  if (headerSize > size || width <= 0 || height == 0 || planes != 1) return false;
+
+  const bool rle = compression == kBiRle8 || compression == kBiRle4;
+  const bool bitfields = compression == kBiBitfields || compression == kBiAlphaBitfields;
+  const bool encoded = compression == kBiJpeg || compression == kBiPng;
+  switch (bitCount_) {
+    case 1:
+    case 24:
+      if (compression != kBiRgb) return false;
+      break;
+    case 4:
+    case 8:
+      if (compression != kBiRgb && compression != (bitCount_ == 8 ? kBiRle8 : kBiRle4)) {
+        return false;
+      }
+      break;
+    case 16:
+    case 32:
+      if (compression != kBiRgb && !bitfields) return false;
+      break;
+    case 0:
+      if (!encoded) return false;  // the payload defines the depth
+      break;
+    default:
+      return false;
+  }
+  if (rle && height < 0) return false;  // RLE bitmaps are always bottom-up
+  if (rle && static_cast<uint64_t>(width) * static_cast<uint64_t>(height) > kMaxRlePixels) {
+    return false;
+  }
+
+  width_ = static_cast<uint32_t>(width);
+  height_ = static_cast<uint32_t>(height < 0 ? -height : height);
+  bottomUp_ = height > 0;
+
+  uint64_t offset = headerSize;
+  if (!ReadMasks(data, size, headerSize, compression, &offset)) return false;
+  if (!ReadPalette(data, size, headerSize, colorsUsed, &offset)) return false;
+  if (offset > size) return false;
+  const size_t available = size - static_cast<size_t>(offset);
+  bits_ = data + offset;
+
+  if (encoded || rle) {
+    bitsSize_ = imageSize != 0 && imageSize <= available ? imageSize : available;
+    if (rle) {
+      ExpandRle(compression == kBiRle4);
+      SelectUnpacker();
+      return true;
+    }
+    const ImageContainer expected =
+        compression == kBiPng ? ImageContainer::Png : ImageContainer::Jpeg;
+    if (SniffImageContainer(bits_, bitsSize_) != expected) return false;
+    bitsSize_ = EncodedImageLength(bits_, bitsSize_);
+    if (bitsSize_ == 0) return false;
+    embedded_ = expected;
+    return true;
+  }
+
+  const uint64_t stride = ((static_cast<uint64_t>(width_) * bitCount_ + 31) / 32) * 4;
+  const uint64_t imageBytes = stride * height_;
+  if (imageBytes > available || stride > SIZE_MAX / 4) return false;
+  // Some producers write a V4/V5 header and then repeat the three masks after
+  // it. Skip them when the block has exactly that much extra room.
+  if (bitfields && headerSize > kInfoHeaderSize && available == imageBytes + 12) {
+    bits_ += 12;
+  }
+  stride_ = static_cast<size_t>(stride);
+  bitsSize_ = static_cast<size_t>(imageBytes);
+
+  // BI_RGB leaves the fourth byte undefined and GDI usually zeroes it, so an
+  // all-zero alpha channel is treated as opaque.
+  useAlpha_ = masks_[3] != 0 && ScanForAlpha();
+  SelectUnpacker();
+  return true;
+}
+
+bool DibDecoder::ReadMasks(const uint8_t* data, size_t size, uint32_t headerSize,
+                           uint32_t compression, uint64_t* offset) {
+  if (bitCount_ == 16) {
+    // BI_RGB 16-bit is X1R5G5B5.
+    masks_[0] = 0x7C00;
+    masks_[1] = 0x03E0;
+    masks_[2] = 0x001F;
+    masks_[3] = 0;
+  } else if (bitCount_ == 32) {
+    masks_[0] = 0x00FF0000;
+    masks_[1] = 0x0000FF00;
+    masks_[2] = 0x000000FF;
+    masks_[3] = 0xFF000000;
+  }
+  if (compression != kBiBitfields && compression != kBiAlphaBitfields) return true;
+
+  // A plain BITMAPINFOHEADER is followed by the masks; V2+ headers hold them.
+  const size_t maskCount = compression == kBiAlphaBitfields ? 4 : 3;
+  if (headerSize == kInfoHeaderSize) {
+    if (size < kInfoHeaderSize + maskCount * 4) return false;
+    *offset += maskCount * 4;
+  } else if (headerSize < kV2HeaderSize ||
+             (maskCount == 4 && headerSize < kV3HeaderSize)) {
+    return false;
+  }
+  for (size_t i = 0; i < maskCount; i++) masks_[i] = ReadLe32(data + kInfoHeaderSize + i * 4);
+  if (maskCount == 3) masks_[3] = headerSize >= kV3HeaderSize ? ReadLe32(data + 52) : 0;
+
+  const uint32_t pixelBits = bitCount_ == 16 ? 0xFFFFu : 0xFFFFFFFFu;
+  for (uint32_t mask : masks_) {
+    if ((mask & ~pixelBits) != 0 || !IsContiguous(mask)) return false;
+  }
+  return true;
+}
+
+bool DibDecoder::ReadPalette(const uint8_t* data, size_t size, uint32_t headerSize,
+                             uint32_t colorsUsed, uint64_t* offset) {
+  // Indices past the end of a short table decode as opaque black, like GDI.
+  for (size_t i = 0; i < 256; i++) palette_[i * 4 + 3] = 0xFF;
+
+  const bool core = headerSize == kCoreHeaderSize;
+  const size_t entryBytes = core ? 3 : 4;
+  uint64_t entries = colorsUsed;
+  if (bitCount_ >= 1 && bitCount_ <= 8 && (entries == 0 || core)) entries = 1ull << bitCount_;
+  // Tables are allowed (and skipped) above 8 bpp too.
+  const uint64_t tableBytes = entries * entryBytes;
+  if (*offset > size || tableBytes > size - *offset) return false;
+
+  const uint8_t* table = data + *offset;
+  const size_t used = entries < 256 ? static_cast<size_t>(entries) : 256;
+  for (size_t i = 0; bitCount_ <= 8 && i < used; i++) {
+    const uint8_t* e = table + i * entryBytes;  // blue, green, red[, reserved]
+    palette_[i * 4 + 0] = e[2];
+    palette_[i * 4 + 1] = e[1];
+    palette_[i * 4 + 2] = e[0];
+  }
+  *offset += tableBytes;
+  return true;
+}
+
+bool DibDecoder::ScanForAlpha() const {
+  const size_t bytes = bitCount_ / 8;
+  for (uint32_t y = 0; y < height_; y++) {
+    const uint8_t* row = bits_ + static_cast<size_t>(y) * stride_;
+    for (uint32_t x = 0; x < width_; x++, row += bytes) {
+      const uint32_t px = bytes == 2 ? ReadLe16(row) : ReadLe32(row);
+      if (px & masks_[3]) return true;
+    }
+  }
+  return false;
+}
+
+void DibDecoder::ExpandRle(bool rle4) {
+  indices_.assign(static_cast<size_t>(width_) * height_, 0);
+  const uint8_t* p = bits_;
+  const size_t size = bitsSize_;
+  size_t pos = 0;
+  uint64_t x = 0;
+  uint64_t y = 0;  // counted from the bottom row
+  auto put = [&](uint8_t index) {
+    if (x < width_ && y < height_) {
+      indices_[static_cast<size_t>(height_ - 1 - y) * width_ + static_cast<size_t>(x)] = index;
+    }
+    x++;
+  };
+
+  while (pos + 2 <= size && y < height_) {
+    const uint8_t count = p[pos];
+    const uint8_t value = p[pos + 1];
+    pos += 2;
+    if (count > 0) {
+      // Encoded run: `count` pixels of `value` (RLE4: its two nibbles in turn).
+      for (int i = 0; i < count && x < width_; i++) {
+        put(rle4 ? static_cast<uint8_t>((i & 1) ? value & 0x0F : value >> 4) : value);
+      }
+      continue;
+    }
+    switch (value) {
+      case 0:  // end of line
+        x = 0;
+        y++;
+        break;
+      case 1:  // end of bitmap
+        return;
+      case 2:  // delta
+        if (pos + 2 > size) return;
+        x += p[pos];
+        y += p[pos + 1];
+        pos += 2;
+        break;
+      default: {  // absolute run of `value` pixels, padded to a 16-bit boundary
+        const size_t bytes = rle4 ? (value + 1u) / 2 : value;
+        if (bytes > size - pos) return;
+        for (int i = 0; i < value; i++) {
+          put(rle4 ? static_cast<uint8_t>((p[pos + i / 2] >> ((i & 1) ? 0 : 4)) & 0x0F)
+                   : p[pos + i]);
+        }
+        pos += bytes + (bytes & 1);
+        break;
+      }
+    }
+  }
+}
+
+void DibDecoder::SelectUnpacker() {
+  if (!indices_.empty()) {
+    unpack_ = &DibUnpackers::Palette<8>;
+    return;
+  }
+  const uint32_t r = masks_[0];
+  const uint32_t g = masks_[1];
+  const uint32_t b = masks_[2];
+  const uint32_t a = masks_[3];
+  switch (bitCount_) {
+    case 1: unpack_ = &DibUnpackers::Palette<1>; return;
+    case 4: unpack_ = &DibUnpackers::Palette<4>; return;
+    case 8: unpack_ = &DibUnpackers::Palette<8>; return;
+    case 24: unpack_ = &DibUnpackers::Bgr24; return;
+    case 16:
+      if (r == 0xF800 && g == 0x07E0 && b == 0x001F && a == 0) {
+        unpack_ = &DibUnpackers::Fixed<2, 0xF800, 0x07E0, 0x001F, 0>;  // R5G6B5
+      } else if (r == 0x7C00 && g == 0x03E0 && b == 0x001F && a == 0) {
+        unpack_ = &DibUnpackers::Fixed<2, 0x7C00, 0x03E0, 0x001F, 0>;  // X1R5G5B5
+      } else if (r == 0x7C00 && g == 0x03E0 && b == 0x001F && a == 0x8000) {
+        unpack_ = &DibUnpackers::Fixed<2, 0x7C00, 0x03E0, 0x001F, 0x8000>;  // A1R5G5B5
+      } else if (r == 0x0F00 && g == 0x00F0 && b == 0x000F && a == 0xF000) {
+        unpack_ = &DibUnpackers::Fixed<2, 0x0F00, 0x00F0, 0x000F, 0xF000>;  // A4R4G4B4
+      } else {
+        unpack_ = &DibUnpackers::Generic<2>;
+      }
+      return;
+    case 32:
+      if (r == 0x00FF0000 && g == 0x0000FF00 && b == 0x000000FF) {
+        unpack_ = a == 0xFF000000
+                      ? &DibUnpackers::Fixed<4, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000>
+                      : &DibUnpackers::Generic<4>;
+      } else if (r == 0x000000FF && g == 0x0000FF00 && b == 0x00FF0000 && a == 0xFF000000) {
+        unpack_ = &DibUnpackers::Fixed<4, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000>;
+      } else if (r == 0x3FF00000 && g == 0x000FFC00 && b == 0x000003FF && a == 0xC0000000) {
+        unpack_ = &DibUnpackers::Fixed<4, 0x3FF00000, 0x000FFC00, 0x000003FF, 0xC0000000>;
+      } else {
+        unpack_ = &DibUnpackers::Generic<4>;
+      }
+      return;
+  }
+}
+
+bool DibDecoder::ReadBand(uint32_t y, uint32_t rows, PixelSource* band) {
+  if (!unpack_ || rows == 0 || y >= height_ || rows > height_ - y) return false;
+  const size_t outStride = static_cast<size_t>(width_) * 4;
+  band_.resize(outStride * rows);
+  for (uint32_t i = 0; i < rows; i++) {
+    const uint32_t top = y + i;
+    const uint8_t* src =
+        !indices_.empty()
+            ? indices_.data() + static_cast<size_t>(top) * width_
+            : bits_ + static_cast<size_t>(bottomUp_ ? height_ - 1 - top : top) * stride_;
+    unpack_(*this, src, band_.data() + i * outStride);
+  }
+  band->pixels = band_.data();
+  band->stride = outStride;
+  band->width = width_;
+  band->height = rows;
+  band->format = PixelFormat::Rgba8;
+  band->bottomUp = false;
+  return true;
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ImageSniff.h"
+#include "PixelSource.h"
+
+// Full packed DIB decoder for the layouts ParsePackedDib cannot encode in
+// place. Portable (no Windows headers), so it can be fuzzed and measured
+// against captured DIB files off Windows.
+
+namespace ptf_helper {
+
+// Decodes a packed DIB (BITMAPCOREHEADER, BITMAPINFOHEADER or V2-V5, then masks,
+// color table and bits) into RGBA rows:
+//   - 1/4/8-bit palettized, uncompressed or BI_RLE4/BI_RLE8
+//   - 16/32-bit BI_RGB and BI_BITFIELDS/BI_ALPHABITFIELDS with any contiguous
+//     masks (common layouts have dedicated unpackers)
+//   - 24-bit BI_RGB
+//   - top-down or bottom-up
+// BI_PNG/BI_JPEG blocks are not decoded; Embedded() reports the stream so it
+// can be written as-is.
+//
+// The block must stay valid and unchanged while the decoder is used. RLE images
+// are expanded to one byte per pixel in Open(); everything else is converted a
+// band at a time in ReadBand().
+class DibDecoder : public PixelBandReader {
+ public:
+  DibDecoder() = default;
+  DibDecoder(const DibDecoder&) = delete;
+  DibDecoder& operator=(const DibDecoder&) = delete;
+
+  // Validates the header against `size`; call once. Fails on unsupported or
+  // truncated layouts; RLE streams that stop early leave the remaining pixels
+  // at index 0.
+  bool Open(const uint8_t* data, size_t size);
+
+  // Container of a BI_PNG/BI_JPEG payload; Unknown for pixel data.
+  ImageContainer Embedded() const { return embedded_; }
+  const uint8_t* EmbeddedData() const { return bits_; }
+  size_t EmbeddedSize() const { return bitsSize_; }
+
+  // Rgba8. Opaque layouts (and 32-bit images whose alpha is all zero, as GDI
+  // writes them) get alpha 0xFF.
+  uint32_t Width() const override { return width_; }
+  uint32_t Height() const override { return height_; }
+  PixelFormat Format() const override { return PixelFormat::Rgba8; }
+  bool ReadBand(uint32_t y, uint32_t rows, PixelSource* band) override;
+
+ private:
+  // Converts one stored row into `width` RGBA pixels at `out`.
+  using RowUnpacker = void (*)(const DibDecoder& dib, const uint8_t* src, uint8_t* out);
+
+  bool ReadMasks(const uint8_t* data, size_t size, uint32_t headerSize, uint32_t compression,
+                 uint64_t* offset);
+  bool ReadPalette(const uint8_t* data, size_t size, uint32_t headerSize, uint32_t colorsUsed,
+                   uint64_t* offset);
+  bool ScanForAlpha() const;
+  void ExpandRle(bool rle4);
+  void SelectUnpacker();
+
+  const uint8_t* bits_ = nullptr;
+  size_t bitsSize_ = 0;
+  size_t stride_ = 0;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  bool bottomUp_ = true;
+  int bitCount_ = 0;
+  ImageContainer embedded_ = ImageContainer::Unknown;
+
+  uint32_t masks_[4] = {};  // red, green, blue, alpha
+  bool useAlpha_ = false;
+  uint8_t palette_[256 * 4] = {};  // RGBA
+  std::vector<uint8_t> indices_;   // RLE only: one palette index per pixel, top-down
+
+  RowUnpacker unpack_ = nullptr;
+  std::vector<uint8_t> band_;
+
+  friend struct DibUnpackers;
+};
+
+} // namespace ptf_helper
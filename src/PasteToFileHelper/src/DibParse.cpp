@@ -0,0 +1,109 @@
+#include "DibParse.h"
+
+#include "PixelKernels.h"
+
+namespace ptf_helper {
+
+namespace {
+
+// wingdi.h values, repeated here to keep this file portable.
+constexpr uint32_t kBiRgb = 0;
+constexpr uint32_t kBiBitfields = 3;
+constexpr uint32_t kBiAlphaBitfields = 6;
+
+constexpr size_t kInfoHeaderSize = 40;  // BITMAPINFOHEADER
+constexpr size_t kV3HeaderSize = 56;    // first header with an alpha mask
+
+constexpr uint32_t kRedMask = 0x00FF0000;
+constexpr uint32_t kGreenMask = 0x0000FF00;
+constexpr uint32_t kBlueMask = 0x000000FF;
+constexpr uint32_t kAlphaMask = 0xFF000000;
+
+uint32_t ReadLe32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t ReadLe16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+} // namespace
+
+bool ParsePackedDib(const uint8_t* data, size_t size, PixelSource* out) {
+  if (!data || !out || size < kInfoHeaderSize) return false;
+
+  const uint32_t headerSize = ReadLe32(data);
+  const int32_t width = static_cast<int32_t>(ReadLe32(data + 4));
+  const int32_t height = static_cast<int32_t>(ReadLe32(data + 8));
+  const uint16_t planes = ReadLe16(data + 12);
+  const uint16_t bitCount = ReadLe16(data + 14);
+  const uint32_t compression = ReadLe32(data + 16);
+  const uint32_t colorsUsed = ReadLe32(data + 32);
+
+  if (headerSize < kInfoHeaderSize || headerSize > size) return false;
+  if (width <= 0 || height == 0 || height == INT32_MIN || planes != 1) return false;
+
+  uint64_t offset = headerSize;
+  const bool bitfields = compression == kBiBitfields || compression == kBiAlphaBitfields;
+  if (bitCount == 24) {
+    if (compression != kBiRgb) return false;
+  } else if (bitCount == 32) {
+    if (compression != kBiRgb && !bitfields) return false;
+  } else {
+    return false;
+  }
+
+  uint32_t masks[4] = {kRedMask, kGreenMask, kBlueMask, kAlphaMask};
+  if (bitfields) {
+    // A plain BITMAPINFOHEADER is followed by the masks; V2+ headers hold them.
+    const size_t maskCount = compression == kBiAlphaBitfields ? 4 : 3;
+    const uint8_t* maskBytes = data + kInfoHeaderSize;
+    if (headerSize == kInfoHeaderSize) {
+      if (size < kInfoHeaderSize + maskCount * 4) return false;
+      offset += maskCount * 4;
+    } else if (headerSize < kInfoHeaderSize + maskCount * 4) {
+      return false;
+    }
+    for (size_t i = 0; i < maskCount; i++) masks[i] = ReadLe32(maskBytes + i * 4);
+    if (maskCount == 3) {
+      masks[3] = headerSize >= kV3HeaderSize ? ReadLe32(data + 52) : 0;
+    }
+    if (masks[0] != kRedMask || masks[1] != kGreenMask || masks[2] != kBlueMask) return false;
+    if (masks[3] != 0 && masks[3] != kAlphaMask) return false;
+  }
+
+  // Optional color table; unusual above 8 bpp but allowed.
+  offset += static_cast<uint64_t>(colorsUsed) * 4;
+
+  const uint64_t rows = static_cast<uint64_t>(height < 0 ? -static_cast<int64_t>(height) : height);
+  const uint64_t stride = ((static_cast<uint64_t>(width) * bitCount + 31) / 32) * 4;
+  const uint64_t imageBytes = stride * rows;
+  if (offset > size || imageBytes > size - offset) return false;
+
+  // Some producers write a V4/V5 header and then repeat the three masks after
+  // it. Skip them when the block has exactly that much extra room.
+  if (bitfields && headerSize > kInfoHeaderSize && size - offset == imageBytes + 12) {
+    offset += 12;
+  }
+
+  PixelSource src;
+  src.pixels = data + offset;
+  src.stride = static_cast<size_t>(stride);
+  src.width = static_cast<uint32_t>(width);
+  src.height = static_cast<uint32_t>(rows);
+  src.bottomUp = height > 0;
+  if (bitCount == 24) {
+    src.format = PixelFormat::Bgr8;
+  } else {
+    // BI_RGB leaves the fourth byte undefined and GDI usually zeroes it, so an
+    // all-zero alpha channel is treated as opaque.
+    bool alpha = masks[3] == kAlphaMask &&
+                 AnyAlpha32(src.pixels, static_cast<size_t>(src.width) * src.height);
+    src.format = alpha ? PixelFormat::Bgra8 : PixelFormat::Bgrx8;
+  }
+  *out = src;
+  return true;
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "PixelSource.h"
+
+// Packed DIB (CF_DIB / CF_DIBV5 layout) parsing. Portable (no Windows headers)
+// so DIB blobs saved to files can be checked off Windows.
+
+namespace ptf_helper {
+
+// Describes the pixels of a packed DIB (BITMAPINFOHEADER/V4/V5 header, optional
+// masks and color table, then the bits) as a PixelSource pointing into `data`.
+//
+// Only layouts the encoder can read directly are accepted: 24-bit BI_RGB and
+// 32-bit BI_RGB or BI_BITFIELDS in BGRA byte order. Anything else (palettes,
+// 16-bit, RLE, embedded PNG/JPEG) returns false so callers can fall back to DibDecoder.
+// A 32-bit image whose alpha bytes are all zero is reported as Bgrx8.
+bool ParsePackedDib(const uint8_t* data, size_t size, PixelSource* out);
+
+} // namespace ptf_helper
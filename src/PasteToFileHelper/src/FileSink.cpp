@@ -0,0 +1,303 @@
+#include "FileSink.h"
+
+#include <atomic>
+#include <cstring>
+#include <cwctype>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "DedupStore.h"
+
+#include "PasteToFileCommon/Filename.h"
+#include "PasteToFileCommon/Logging.h"
+
+namespace ptf_helper {
+
+bool HandleSink::Write(const uint8_t* data, size_t size) {
+  while (size > 0) {
+    DWORD chunk = static_cast<DWORD>(size > 0x40000000 ? 0x40000000 : size);
+    DWORD written = 0;
+    if (!WriteFile(h_, data, chunk, &written, nullptr) || written != chunk) return false;
+    data += chunk;
+    size -= chunk;
+  }
+  return true;
+}
+
+static OutputCompression g_compression;
+
+void SetOutputCompression(const OutputCompression& compression) { g_compression = compression; }
+
+static WriteDurability g_durability = WriteDurability::Fast;
+
+void SetWriteDurability(WriteDurability durability) { g_durability = durability; }
+
+static DedupMode g_dedup = DedupMode::Off;
+
+void SetDedupMode(DedupMode mode) { g_dedup = mode; }
+
+// Each folder's dedup index is opened on first use and kept mapped for the
+// run; null when the folder's index cannot be used. Only used from
+// FindSaved/RecordSaved, which RunSave calls under its dedup lock.
+static std::map<std::wstring, std::unique_ptr<DedupStore>> g_dedupStores;
+
+static DedupStore* FolderDedupStore(const std::wstring& dir) {
+  std::wstring key = dir;
+  for (wchar_t& c : key) c = static_cast<wchar_t>(towlower(c));
+  auto found = g_dedupStores.find(key);
+  if (found != g_dedupStores.end()) return found->second.get();
+  auto store = std::make_unique<DedupStore>();
+  if (!store->Open(dir)) store.reset();
+  return (g_dedupStores[key] = std::move(store)).get();
+}
+
+static ptf::NameTemplate g_nameTemplate;
+
+void SetNameTemplate(const ptf::NameTemplate& name) { g_nameTemplate = name; }
+
+// One listing per directory and name prefix for the whole run (see
+// ptf::NameIndex): names are then picked in memory, and the no-replace rename
+// only guards against other processes. The lock covers the cache, not the
+// file system.
+static std::mutex g_nameIndexMutex;
+static std::map<std::wstring, ptf::NameIndex> g_nameIndexes;
+
+static ptf::NameIndex& DirectoryIndex(const std::wstring& dir, const ptf::NameFields& name) {
+  // Names of every kind written on one day ("PTF-2026-feb-23",
+  // "...-HIST-0001") share the listing of their common prefix.
+  std::wstring prefix;
+  g_nameTemplate.AppendListingPrefix(name, &prefix);
+  std::wstring key = dir + L"|" + prefix;
+  for (wchar_t& c : key) c = static_cast<wchar_t>(towlower(c));
+  auto found = g_nameIndexes.find(key);
+  if (found != g_nameIndexes.end()) return found->second;
+  ptf::NameIndex& index = g_nameIndexes[key];
+  if (!ptf::IndexDirectory(dir, prefix, &index)) {
+    ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
+                      L"[Helper] could not list " + dir + L"; probing names instead");
+  }
+  return index;
+}
+
+// A hidden "~ptf-<pid>-<n>.tmp" in `dir`, opened for writing with the DELETE
+// access the rename needs. Invisible to the name index and, being hidden and
+// "~*.tmp", skipped by most sync tools should the process die mid-write.
+static HANDLE CreateTempFile(const std::wstring& dir, std::wstring* tempPath) {
+  static std::atomic<unsigned> counter{0};
+  for (int attempt = 0; attempt < 100; attempt++) {
+    wchar_t name[64]{};
+    swprintf_s(name, L"~ptf-%lu-%u.tmp", GetCurrentProcessId(), counter.fetch_add(1));
+    *tempPath = dir + L"\\" + name;
+    HANDLE h = CreateFileW(tempPath->c_str(), GENERIC_WRITE | DELETE, FILE_SHARE_READ, nullptr,
+                           CREATE_NEW, FILE_ATTRIBUTE_HIDDEN, nullptr);
+    if (h != INVALID_HANDLE_VALUE) return h;
+    DWORD err = GetLastError();
+    if (err != ERROR_FILE_EXISTS && err != ERROR_ALREADY_EXISTS) break;
+  }
+  return INVALID_HANDLE_VALUE;
+}
+
+// Reserves disk space up front so a large save does not grow the file extent
+// by extent (and fails early when the disk is full). Allocation past the end
+// of the data is released when the handle closes, so an estimate is fine.
+static void Preallocate(HANDLE h, uint64_t bytes) {
+  FILE_ALLOCATION_INFO info{};
+  info.AllocationSize.QuadPart = static_cast<LONGLONG>(bytes);
+  SetFileInformationByHandle(h, FileAllocationInfo, &info, sizeof(info));
+}
+
+// Renames the open file to `target` unless that name exists.
+static bool RenameNoReplace(HANDLE h, const std::wstring& target) {
+  const size_t nameBytes = target.size() * sizeof(wchar_t);
+  std::vector<uint8_t> buffer(sizeof(FILE_RENAME_INFO) + nameBytes);
+  auto* info = reinterpret_cast<FILE_RENAME_INFO*>(buffer.data());
+  info->ReplaceIfExists = FALSE;
+  info->RootDirectory = nullptr;
+  info->FileNameLength = static_cast<DWORD>(nameBytes);
+  std::memcpy(info->FileName, target.data(), nameBytes);
+  return SetFileInformationByHandle(h, FileRenameInfo, info, static_cast<DWORD>(buffer.size()));
+}
+
+static void DeleteOpenFile(HANDLE h) {
+  FILE_DISPOSITION_INFO info{};
+  info.DeleteFile = TRUE;
+  SetFileInformationByHandle(h, FileDispositionInfo, &info, sizeof(info));
+}
+
+// Paranoid mode: makes the rename itself durable. Directory handles can be
+// flushed on NTFS and ReFS; elsewhere this is a no-op.
+static void FlushDirectory(const std::wstring& dir) {
+  HANDLE h = CreateFileW(dir.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                         nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+  if (h == INVALID_HANDLE_VALUE) return;
+  FlushFileBuffers(h);
+  CloseHandle(h);
+}
+
+// Gives a file its final name: the first free one in the index. `create`
+// makes the name (renaming the temp file, or linking) without replacing, and
+// is the guard against names taken since the listing. A name is marked used
+// once it exists, so a failed `create` leaves no gap in the numbering; two
+// threads offered the same name are told apart by `create`.
+static bool CommitUniqueName(const std::wstring& targetDir, const ptf::NameFields& name,
+                             const std::wstring& extension,
+                             const std::function<bool(const std::wstring&)>& create,
+                             std::wstring* path) {
+  for (int attempt = 0; attempt < ptf::NameIndex::kMaxSuffix; attempt++) {
+    {
+      std::lock_guard<std::mutex> lock(g_nameIndexMutex);
+      const int seq = DirectoryIndex(targetDir, name).NextFree(g_nameTemplate, name, extension);
+      if (seq < 0) break;
+      *path = targetDir + L"\\";
+      g_nameTemplate.Append(name, seq, extension, path);
+    }
+    const bool created = create(*path);
+    const DWORD err = created ? ERROR_SUCCESS : GetLastError();
+    // Taken by this save, or by another process or thread since the listing.
+    const bool exists = err == ERROR_FILE_EXISTS || err == ERROR_ALREADY_EXISTS;
+    if (created || exists) {
+      std::lock_guard<std::mutex> lock(g_nameIndexMutex);
+      const std::wstring_view fileName = std::wstring_view(*path).substr(targetDir.size() + 1);
+      DirectoryIndex(targetDir, name).MarkUsed(fileName);
+    }
+    if (created) return true;
+    if (exists) continue;
+    ptf::LogLine(L"Could not create " + *path + L" err=" + std::to_wstring(err));
+    return false;
+  }
+  std::wstring first;
+  g_nameTemplate.Append(name, g_nameTemplate.FirstSeq(), extension, &first);
+  ptf::LogLine(L"No free name for " + first + L" in " + targetDir);
+  return false;
+}
+
+// RunSave's steps on a hidden temp file in `dir`, created (and preallocated)
+// up front.
+class FolderSave : public SaveTarget {
+ public:
+  FolderSave(const std::wstring& dir, const ptf::NameFields& name, const std::wstring& extension,
+             uint64_t preallocate)
+      : dir_(dir), name_(name), extension_(extension), h_(CreateTempFile(dir, &tempPath_)),
+        sink_(h_) {
+    if (h_ == INVALID_HANDLE_VALUE) {
+      ptf::LogLine(L"CreateFile failed: " + tempPath_ + L" err=" +
+                   std::to_wstring(GetLastError()));
+    } else if (preallocate > 0) {
+      Preallocate(h_, preallocate);
+    }
+  }
+  ~FolderSave() override {
+    if (h_ != INVALID_HANDLE_VALUE) CloseHandle(h_);
+  }
+  FolderSave(const FolderSave&) = delete;
+  FolderSave& operator=(const FolderSave&) = delete;
+
+  const std::wstring& TempPath() const { return tempPath_; }
+
+  ByteSink* Temp() override { return h_ != INVALID_HANDLE_VALUE ? &sink_ : nullptr; }
+
+  bool FlushTemp() override {
+    if (FlushFileBuffers(h_)) return true;
+    ptf::LogLine(L"Flush failed: " + tempPath_ + L" err=" + std::to_wstring(GetLastError()));
+    return false;
+  }
+
+  bool Commit(std::wstring* path) override {
+    const HANDLE h = h_;
+    if (!CommitUniqueName(dir_, name_, extension_,
+                          [h](const std::wstring& p) { return RenameNoReplace(h, p); }, path)) {
+      return false;
+    }
+    // The temp file's attributes go with it; the saved file is a normal one.
+    FILE_BASIC_INFO basic{};
+    basic.FileAttributes = FILE_ATTRIBUTE_NORMAL;
+    SetFileInformationByHandle(h_, FileBasicInfo, &basic, sizeof(basic));
+    CloseHandle(h_);
+    h_ = INVALID_HANDLE_VALUE;
+    return true;
+  }
+
+  bool Link(const std::wstring& existingPath, std::wstring* path) override {
+    return CommitUniqueName(dir_, name_, extension_,
+                            [&](const std::wstring& p) {
+                              return CreateHardLinkW(p.c_str(), existingPath.c_str(), nullptr) !=
+                                     FALSE;
+                            },
+                            path);
+  }
+
+  void Discard() override {
+    DeleteOpenFile(h_);
+    CloseHandle(h_);
+    h_ = INVALID_HANDLE_VALUE;
+  }
+
+  void FlushDirectory() override { ptf_helper::FlushDirectory(dir_); }
+
+  bool FindSaved(uint64_t key, uint64_t size, std::wstring* existingPath) override {
+    std::wstring existing;
+    DedupStore* store = FolderDedupStore(dir_);
+    if (!store || !store->Find(key, size, &existing)) return false;
+    *existingPath = dir_ + L"\\" + existing;
+    return true;
+  }
+
+  void RecordSaved(uint64_t key, const std::wstring& path) override {
+    if (DedupStore* store = FolderDedupStore(dir_)) store->Add(key, path.substr(dir_.size() + 1));
+  }
+
+ private:
+  std::wstring dir_;
+  ptf::NameFields name_;
+  std::wstring extension_;
+  std::wstring tempPath_;
+  HANDLE h_;
+  HandleSink sink_;
+};
+
+bool WriteStreamFileUniqueWithName(const std::wstring& targetDir,
+                                   const ptf::NameFields& name,
+                                   const std::wstring& extensionWithDot,
+                                   const std::function<bool(ByteSink*)>& write,
+                                   std::wstring* outPath,
+                                   uint64_t sizeHint) {
+  if (outPath) *outPath = L"";
+  SaveSettings settings;
+  settings.durability = g_durability;
+  settings.dedup = g_dedup;
+  settings.compress = sizeHint > 0 && sizeHint >= g_compression.minBytes;
+  settings.gzip = g_compression.gzip;
+  settings.extension = settings.compress ? extensionWithDot + L".gz" : extensionWithDot;
+
+  FolderSave target(targetDir, name, settings.extension, settings.compress ? 0 : sizeHint);
+  const SaveReport report = RunSave(&target, settings, write);
+  switch (report.result) {
+    case SaveResult::NoTempFile:
+    case SaveResult::NoName:  // logged by FolderSave / CommitUniqueName
+      return false;
+    case SaveResult::WriteFailed:
+      ptf::LogLine(L"Write failed: " + target.TempPath());
+      return false;
+    case SaveResult::Written:
+      ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
+                        L"[Helper] wrote " + report.path);
+      break;
+    case SaveResult::Linked:
+    case SaveResult::Skipped:
+      ptf::LogLine(L"Same content as " + report.existingPath +
+                   (report.result == SaveResult::Linked ? L"; linked as " + report.path
+                                                        : L"; not saved again"));
+      break;
+  }
+  if (settings.compress) {
+    ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
+                      L"[Helper] gzip " + std::to_wstring(report.gzipInputBytes) + L" -> " +
+                          std::to_wstring(report.gzipOutputBytes) + L" bytes");
+  }
+  if (outPath) *outPath = report.path;
+  return true;
+}
+
+} // namespace ptf_helper
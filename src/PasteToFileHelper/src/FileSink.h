@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <windows.h>
+
+#include "ByteSink.h"
+#include "GzipSink.h"
+#include "SaveFlow.h"
+
+#include "PasteToFileCommon/NameTemplate.h"
+
+namespace ptf_helper {
+
+// Adapts a Win32 file handle to the encoders' sink interface.
+class HandleSink : public ByteSink {
+ public:
+  explicit HandleSink(HANDLE h) : h_(h) {}
+  bool Write(const uint8_t* data, size_t size) override;
+
+ private:
+  HANDLE h_;
+};
+
+// Large saves can be written gzip-compressed, as "<name><ext>.gz".
+struct OutputCompression {
+  uint64_t minBytes = UINT64_MAX;  // UINT64_MAX = never
+  GzipOptions gzip;
+};
+
+// Compression used by WriteStreamFileUniqueWithName. Defaults to never.
+void SetOutputCompression(const OutputCompression& compression);
+
+// Durability used by WriteStreamFileUniqueWithName. Defaults to Fast.
+void SetWriteDurability(WriteDurability durability);
+
+// Dedup used by WriteStreamFileUniqueWithName. Defaults to Off.
+void SetDedupMode(DedupMode mode);
+
+// File names used by WriteStreamFileUniqueWithName. Defaults to
+// ptf::NameTemplate::kDefault.
+void SetNameTemplate(const ptf::NameTemplate& name);
+
+// Lets `write` stream into a hidden temp file in targetDir, then renames it
+// (never replacing) to the first free name the template gives for `name`, so
+// the final name only ever holds a complete file (see RunSave). A failed write
+// deletes the temp file.
+// `sizeHint` is the size of the data about to be saved (before conversion):
+// the file is preallocated to it, and when it reaches
+// OutputCompression::minBytes, ".gz" is appended to the extension and the
+// output is compressed. 0 (images, already compressed data) never compresses.
+// With dedup on, `outPath` may name an existing file with the same content
+// (see LastSaveSkipped).
+bool WriteStreamFileUniqueWithName(const std::wstring& targetDir,
+                                   const ptf::NameFields& name,
+                                   const std::wstring& extensionWithDot,
+                                   const std::function<bool(ByteSink*)>& write,
+                                   std::wstring* outPath,
+                                   uint64_t sizeHint = 0);
+
+} // namespace ptf_helper
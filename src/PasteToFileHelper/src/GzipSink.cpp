@@ -0,0 +1,176 @@
+#include "GzipSink.h"
+
+#include <algorithm>
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr size_t kDeflateWindow = 32 * 1024;
+constexpr size_t kDrainBytes = 256 * 1024;
+
+void PutLe32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  p[2] = static_cast<uint8_t>(v >> 16);
+  p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+} // namespace
+
+GzipSink::GzipSink(ByteSink* out, const GzipOptions& options) : out_(out), options_(options) {
+  if (options_.threads == 0) options_.threads = ThreadPool::DefaultThreadCount();
+  if (options_.segmentBytes < kDeflateWindow) options_.segmentBytes = kDeflateWindow;
+  if (options_.threads <= 1) deflate_ = std::make_unique<DeflateEncoder>(options_.level);
+
+  // No name or time stamp, so equal input gives equal files. XFL marks the
+  // fastest and slowest levels; OS 255 is "unknown".
+  const uint8_t xfl = options_.level >= 9 ? 2 : options_.level <= 1 ? 4 : 0;
+  const uint8_t header[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, xfl, 255};
+  Emit(header, sizeof(header));
+}
+
+// Workers still reference this sink until their segments are collected.
+GzipSink::~GzipSink() {
+  while (!inFlight_.empty()) {
+    inFlight_.front().wait();
+    inFlight_.pop_front();
+  }
+}
+
+bool GzipSink::Emit(const uint8_t* data, size_t size) {
+  if (ok_ && size > 0) ok_ = out_->Write(data, size);
+  outputBytes_ += size;
+  return ok_;
+}
+
+bool GzipSink::DrainSerial(bool all) {
+  std::vector<uint8_t>& out = deflate_->Output();
+  if (!all && out.size() < kDrainBytes) return ok_;
+  Emit(out.data(), out.size());
+  out.clear();
+  return ok_;
+}
+
+bool GzipSink::Write(const uint8_t* data, size_t size) {
+  if (!ok_ || finished_) return false;
+  inputBytes_ += size;
+  if (deflate_) {
+    crc_ = Crc32Update(crc_, data, size);
+    deflate_->Write(data, size);
+    return DrainSerial(false);
+  }
+  while (size > 0) {
+    const size_t take = std::min(size, options_.segmentBytes - segment_.size());
+    segment_.insert(segment_.end(), data, data + take);
+    data += take;
+    size -= take;
+    if (segment_.size() == options_.segmentBytes) {
+      SubmitSegment(false);
+      // Keep every worker busy while bounding buffered segments.
+      if (!CollectSegments(2 * static_cast<size_t>(pool_->Size()))) return false;
+    }
+  }
+  return true;
+}
+
+std::vector<uint8_t> GzipSink::TakeBuffer() {
+  if (spare_.empty()) return {};
+  std::vector<uint8_t> buffer = std::move(spare_.back());
+  spare_.pop_back();
+  buffer.clear();
+  return buffer;
+}
+
+// Runs on a worker (or, for a single segment, on the caller). Deflate
+// encoders are pooled so their hash chains and window are allocated once per
+// worker rather than once per segment.
+void GzipSink::CompressSegment(Segment* segment, bool final) {
+  std::unique_ptr<DeflateEncoder> enc;
+  {
+    std::lock_guard<std::mutex> lock(deflatersMutex_);
+    if (!idleDeflaters_.empty()) {
+      enc = std::move(idleDeflaters_.back());
+      idleDeflaters_.pop_back();
+    }
+  }
+  if (enc) {
+    enc->Reset(options_.level);
+  } else {
+    enc = std::make_unique<DeflateEncoder>(options_.level);
+  }
+  if (!segment->dictionary.empty()) {
+    enc->SetDictionary(segment->dictionary.data(), segment->dictionary.size());
+  }
+  segment->crc = Crc32Update(0, segment->input.data(), segment->input.size());
+  enc->Write(segment->input.data(), segment->input.size());
+  enc->Flush(final);
+  // Trade buffers so the encoder keeps an already grown one for next time.
+  segment->output.clear();
+  segment->output.swap(enc->Output());
+
+  std::lock_guard<std::mutex> lock(deflatersMutex_);
+  idleDeflaters_.push_back(std::move(enc));
+}
+
+void GzipSink::SubmitSegment(bool final) {
+  Segment segment;
+  segment.input.swap(segment_);
+  segment_ = TakeBuffer();
+  segment_.reserve(options_.segmentBytes);
+
+  segment.dictionary = TakeBuffer();
+  segment.dictionary.assign(dictionary_.begin(), dictionary_.end());
+  // The next segment may reference the last 32 KiB of everything before it.
+  // Segments other than the last are full, so that is always its own tail.
+  const std::vector<uint8_t>& input = segment.input;
+  const size_t keep = std::min(input.size(), kDeflateWindow);
+  dictionary_.assign(input.end() - static_cast<std::ptrdiff_t>(keep), input.end());
+  segment.output = TakeBuffer();
+
+  if (!pool_) pool_ = std::make_unique<ThreadPool>(options_.threads);
+  inFlight_.push_back(pool_->Submit([this, segment = std::move(segment), final]() mutable {
+    CompressSegment(&segment, final);
+    return std::move(segment);
+  }));
+}
+
+// Writes finished segments, in order, until at most maxInFlight remain.
+bool GzipSink::CollectSegments(size_t maxInFlight) {
+  while (inFlight_.size() > maxInFlight) {
+    Segment done = inFlight_.front().get();
+    inFlight_.pop_front();
+    crc_ = Crc32Combine(crc_, done.crc, done.input.size());
+    Emit(done.output.data(), done.output.size());
+    spare_.push_back(std::move(done.input));
+    spare_.push_back(std::move(done.dictionary));
+    spare_.push_back(std::move(done.output));
+    if (!ok_) return false;
+  }
+  return true;
+}
+
+bool GzipSink::Finish() {
+  if (!ok_ || finished_) return false;
+  finished_ = true;
+  if (deflate_) {
+    deflate_->Flush(true);
+    DrainSerial(true);
+  } else if (!pool_) {
+    // Everything fit in one segment: no threads are started for it.
+    Segment segment;
+    segment.input.swap(segment_);
+    CompressSegment(&segment, true);
+    crc_ = segment.crc;
+    Emit(segment.output.data(), segment.output.size());
+  } else {
+    SubmitSegment(true);
+    CollectSegments(0);
+  }
+  uint8_t trailer[8];
+  PutLe32(trailer, crc_);
+  PutLe32(trailer + 4, static_cast<uint32_t>(inputBytes_));  // ISIZE is the size mod 2^32
+  return Emit(trailer, sizeof(trailer));
+}
+
+} // namespace ptf_helper
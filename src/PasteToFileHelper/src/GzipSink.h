@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ByteSink.h"
+#include "Deflate.h"
+#include "ThreadPool.h"
+
+// A ByteSink that gzip-compresses (RFC 1952) everything written to it into
+// another sink. Portable (no Windows headers).
+
+namespace ptf_helper {
+
+struct GzipOptions {
+  // Large pastes go to slow (network) folders: level 1 already makes text
+  // about three times smaller at several times the speed of level 6.
+  int level = 1;
+
+  // Deflate worker threads: 0 = one per core, 1 = compress on the calling
+  // thread. With more than one thread the input is cut into segments that are
+  // deflated independently (each primed with the previous 32 KiB, like pigz)
+  // and checksummed on the worker; the output is still a single gzip member.
+  unsigned threads = 0;
+  size_t segmentBytes = 1024 * 1024;
+};
+
+class GzipSink : public ByteSink {
+ public:
+  GzipSink(ByteSink* out, const GzipOptions& options);
+  ~GzipSink() override;
+  GzipSink(const GzipSink&) = delete;
+  GzipSink& operator=(const GzipSink&) = delete;
+
+  bool Write(const uint8_t* data, size_t size) override;
+
+  // Ends the deflate stream and writes the CRC-32 and size trailer. Nothing
+  // may be written afterwards.
+  bool Finish();
+
+  uint64_t InputBytes() const { return inputBytes_; }
+  uint64_t OutputBytes() const { return outputBytes_; }
+
+ private:
+  struct Segment {
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> dictionary;
+    std::vector<uint8_t> output;
+    uint32_t crc = 0;
+  };
+
+  bool Emit(const uint8_t* data, size_t size);
+  bool DrainSerial(bool all);
+  void SubmitSegment(bool final);
+  bool CollectSegments(size_t maxInFlight);
+  std::vector<uint8_t> TakeBuffer();
+  void CompressSegment(Segment* segment, bool final);
+
+  ByteSink* out_;
+  GzipOptions options_;
+  bool ok_ = true;
+  bool finished_ = false;
+  uint32_t crc_ = 0;
+  uint64_t inputBytes_ = 0;
+  uint64_t outputBytes_ = 0;
+
+  // Serial mode.
+  std::unique_ptr<DeflateEncoder> deflate_;
+
+  // Parallel mode.
+  std::unique_ptr<ThreadPool> pool_;
+  std::vector<uint8_t> segment_;
+  std::vector<uint8_t> dictionary_;  // tail of the previous segment
+  std::deque<std::future<Segment>> inFlight_;
+  std::vector<std::vector<uint8_t>> spare_;  // caller thread only
+  std::mutex deflatersMutex_;
+  std::vector<std::unique_ptr<DeflateEncoder>> idleDeflaters_;
+};
+
+} // namespace ptf_helper
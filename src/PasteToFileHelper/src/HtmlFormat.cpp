@@ -0,0 +1,120 @@
+#include "HtmlFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr size_t kMaxHeaderBytes = 64 * 1024;
+constexpr uint64_t kNoOffset = UINT64_MAX;
+constexpr uint64_t kMaxOffset = uint64_t{1} << 48;
+
+bool KeyEquals(std::string_view key, const char* name) {
+  size_t i = 0;
+  for (; i < key.size() && name[i]; i++) {
+    char c = key[i];
+    if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    char n = name[i];
+    if (n >= 'A' && n <= 'Z') n = static_cast<char>(n - 'A' + 'a');
+    if (c != n) return false;
+  }
+  return i == key.size() && !name[i];
+}
+
+// A decimal offset (leading blanks and zeros allowed). Negative values (-1
+// marks an absent part) and implausibly large ones give kNoOffset.
+uint64_t ParseOffset(std::string_view value) {
+  size_t i = 0;
+  while (i < value.size() && value[i] == ' ') i++;
+  if (i == value.size() || value[i] < '0' || value[i] > '9') return kNoOffset;
+  uint64_t result = 0;
+  for (; i < value.size() && value[i] >= '0' && value[i] <= '9'; i++) {
+    result = result * 10 + static_cast<uint64_t>(value[i] - '0');
+    if (result > kMaxOffset) return kNoOffset;  // also stops before it could overflow
+  }
+  while (i < value.size() && value[i] == ' ') i++;
+  return i == value.size() ? result : kNoOffset;
+}
+
+// [start, end) of `data`, with end clamped to the size (some apps count a
+// terminator the clipboard read has already trimmed); false when the range is
+// missing or inverted.
+bool Range(std::string_view data, uint64_t start, uint64_t end, std::string_view* out) {
+  if (start == kNoOffset || end == kNoOffset || start > data.size()) return false;
+  if (end > data.size()) end = data.size();
+  if (end < start) return false;
+  *out = data.substr(static_cast<size_t>(start), static_cast<size_t>(end - start));
+  return true;
+}
+
+} // namespace
+
+bool ParseHtmlFormat(std::string_view data, HtmlFormat* out) {
+  *out = HtmlFormat{};
+  uint64_t startHtml = kNoOffset;
+  uint64_t endHtml = kNoOffset;
+  uint64_t startFragment = kNoOffset;
+  uint64_t endFragment = kNoOffset;
+
+  const size_t headerLimit = data.size() < kMaxHeaderBytes ? data.size() : kMaxHeaderBytes;
+  size_t pos = 0;
+  while (pos < headerLimit) {
+    // The header cannot run into the HTML it describes.
+    if (startHtml != kNoOffset && pos >= startHtml) break;
+    if (startFragment != kNoOffset && pos >= startFragment) break;
+
+    size_t colon = pos;
+    while (colon < headerLimit &&
+           ((data[colon] >= 'A' && data[colon] <= 'Z') ||
+            (data[colon] >= 'a' && data[colon] <= 'z'))) {
+      colon++;
+    }
+    if (colon == pos || colon == headerLimit || data[colon] != ':') break;
+    size_t lineEnd = colon + 1;
+    while (lineEnd < headerLimit && data[lineEnd] != '\r' && data[lineEnd] != '\n') lineEnd++;
+    if (lineEnd == headerLimit && headerLimit < data.size()) break;  // line longer than the cap
+
+    const std::string_view key = data.substr(pos, colon - pos);
+    const std::string_view value = data.substr(colon + 1, lineEnd - colon - 1);
+    if (KeyEquals(key, "Version")) {
+      out->version = value;
+    } else if (KeyEquals(key, "SourceURL")) {
+      out->sourceUrl = value;
+    } else if (KeyEquals(key, "StartHTML")) {
+      startHtml = ParseOffset(value);
+    } else if (KeyEquals(key, "EndHTML")) {
+      endHtml = ParseOffset(value);
+    } else if (KeyEquals(key, "StartFragment")) {
+      startFragment = ParseOffset(value);
+    } else if (KeyEquals(key, "EndFragment")) {
+      endFragment = ParseOffset(value);
+    }
+
+    pos = lineEnd;
+    if (pos < data.size() && data[pos] == '\r') pos++;
+    if (pos < data.size() && data[pos] == '\n') pos++;
+  }
+
+  const bool hasFragment = Range(data, startFragment, endFragment, &out->fragment);
+  bool hasDocument = Range(data, startHtml, endHtml, &out->document);
+  if (!hasDocument && startHtml == kNoOffset && hasFragment && pos <= startFragment) {
+    out->document = data.substr(pos);
+    hasDocument = true;
+  }
+  return hasDocument || hasFragment;
+}
+
+std::string_view SelectHtmlPart(std::string_view data, HtmlPart part, HtmlFormat* header) {
+  HtmlFormat parsed;
+  const bool ok = ParseHtmlFormat(data, &parsed);
+  if (header) *header = parsed;
+  if (!ok) return data;
+  if (part == HtmlPart::Fragment && !parsed.fragment.empty()) return parsed.fragment;
+  if (!parsed.document.empty()) return parsed.document;
+  if (!parsed.fragment.empty()) return parsed.fragment;
+  return data;
+}
+
+} // namespace ptf_helper
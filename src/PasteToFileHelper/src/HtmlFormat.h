@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string_view>
+
+// The registered "HTML Format" (CF_HTML) clipboard data: a header of ASCII
+// "Key:value" lines, then UTF-8 HTML, with StartHTML/EndHTML and
+// StartFragment/EndFragment given as byte offsets into the whole block.
+// Portable (no Windows headers). Only the header is read; the results are
+// views into the caller's buffer, so nothing is copied.
+
+namespace ptf_helper {
+
+enum class HtmlPart {
+  Document,  // StartHTML..EndHTML: the page as the source app framed it
+  Fragment,  // StartFragment..EndFragment: only what was selected
+};
+
+struct HtmlFormat {
+  std::string_view version;
+  std::string_view sourceUrl;  // the page the HTML was copied from, if the app said
+  std::string_view document;
+  std::string_view fragment;
+};
+
+// Reads header lines until the first line that is not one, the start of the
+// HTML or 64 KiB, whichever comes first. Offsets must be in range; an EndHTML
+// or EndFragment past the end (trailing NULs already trimmed) is clamped.
+// Without StartHTML (allowed as -1 in version 1.0) the document starts after
+// the header. Returns false when neither range is usable.
+bool ParseHtmlFormat(std::string_view data, HtmlFormat* out);
+
+// The requested part: an empty fragment falls back to the document, and an
+// empty document to the fragment, then to all of `data` (as when there is no
+// usable header). `header` (optional) receives what was parsed.
+std::string_view SelectHtmlPart(std::string_view data, HtmlPart part,
+                                HtmlFormat* header = nullptr);
+
+} // namespace ptf_helper
@@ -0,0 +1,1241 @@
+#include "HtmlMarkdown.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace ptf_helper {
+
+// What the converter does with each tag; see kElements.
+enum class HtmlElement : uint8_t {
+  Other,
+  Block,
+  Heading,
+  List,
+  OrderedList,
+  Item,
+  Quote,
+  Pre,
+  Code,
+  Bold,
+  Italic,
+  Strike,
+  Link,
+  Image,
+  Break,
+  Rule,
+  Table,
+  Row,
+  Cell,
+  Skip,  // content dropped, markup still parsed
+  Raw,   // content dropped without parsing (script, style, ...)
+};
+
+namespace {
+
+constexpr size_t kMaxNameLength = 16;
+constexpr size_t kMaxAttrLength = 8 * 1024;
+constexpr size_t kMaxEntityLength = 32;
+constexpr size_t kMaxDeclarationLength = 32;
+constexpr size_t kMaxContainers = 32;
+constexpr size_t kMaxHeldBlanks = 4 * 1024;
+
+bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+bool IsAlpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool IsAlnum(char c) {
+  return IsAlpha(c) || (c >= '0' && c <= '9');
+}
+
+char Lower(char c) {
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+struct ElementName {
+  const char* name;
+  HtmlElement element;
+};
+
+constexpr ElementName kElements[] = {
+    {"a", HtmlElement::Link},           {"address", HtmlElement::Block},
+    {"article", HtmlElement::Block},    {"aside", HtmlElement::Block},
+    {"b", HtmlElement::Bold},           {"blockquote", HtmlElement::Quote},
+    {"br", HtmlElement::Break},         {"caption", HtmlElement::Block},
+    {"center", HtmlElement::Block},     {"cite", HtmlElement::Italic},
+    {"code", HtmlElement::Code},        {"dd", HtmlElement::Block},
+    {"del", HtmlElement::Strike},       {"details", HtmlElement::Block},
+    {"dialog", HtmlElement::Block},     {"div", HtmlElement::Block},
+    {"dl", HtmlElement::Block},         {"dt", HtmlElement::Block},
+    {"em", HtmlElement::Italic},        {"fieldset", HtmlElement::Block},
+    {"figcaption", HtmlElement::Block}, {"figure", HtmlElement::Block},
+    {"footer", HtmlElement::Block},     {"form", HtmlElement::Block},
+    {"h1", HtmlElement::Heading},       {"h2", HtmlElement::Heading},
+    {"h3", HtmlElement::Heading},       {"h4", HtmlElement::Heading},
+    {"h5", HtmlElement::Heading},       {"h6", HtmlElement::Heading},
+    {"head", HtmlElement::Skip},        {"header", HtmlElement::Block},
+    {"hgroup", HtmlElement::Block},     {"hr", HtmlElement::Rule},
+    {"i", HtmlElement::Italic},         {"iframe", HtmlElement::Raw},
+    {"img", HtmlElement::Image},        {"kbd", HtmlElement::Code},
+    {"li", HtmlElement::Item},          {"listing", HtmlElement::Pre},
+    {"main", HtmlElement::Block},       {"math", HtmlElement::Skip},
+    {"nav", HtmlElement::Block},        {"noembed", HtmlElement::Raw},
+    {"noframes", HtmlElement::Raw},     {"noscript", HtmlElement::Raw},
+    {"ol", HtmlElement::OrderedList},   {"p", HtmlElement::Block},
+    {"plaintext", HtmlElement::Pre},    {"pre", HtmlElement::Pre},
+    {"s", HtmlElement::Strike},         {"samp", HtmlElement::Code},
+    {"script", HtmlElement::Raw},       {"section", HtmlElement::Block},
+    {"select", HtmlElement::Skip},      {"strike", HtmlElement::Strike},
+    {"strong", HtmlElement::Bold},      {"style", HtmlElement::Raw},
+    {"summary", HtmlElement::Block},    {"svg", HtmlElement::Skip},
+    {"table", HtmlElement::Table},      {"td", HtmlElement::Cell},
+    {"template", HtmlElement::Skip},    {"textarea", HtmlElement::Raw},
+    {"th", HtmlElement::Cell},          {"title", HtmlElement::Raw},
+    {"tr", HtmlElement::Row},           {"tt", HtmlElement::Code},
+    {"ul", HtmlElement::List},          {"var", HtmlElement::Italic},
+    {"xmp", HtmlElement::Raw},
+};
+
+// kElements is sorted by name.
+HtmlElement Classify(const std::string& name) {
+  size_t lo = 0;
+  size_t hi = sizeof(kElements) / sizeof(kElements[0]);
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    const int order = name[0] != kElements[mid].name[0]
+                          ? static_cast<unsigned char>(name[0]) - kElements[mid].name[0]
+                          : std::strcmp(name.c_str(), kElements[mid].name);
+    if (order == 0) return kElements[mid].element;
+    if (order < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return HtmlElement::Other;
+}
+
+struct NamedEntity {
+  const char* name;
+  uint32_t codePoint;
+};
+
+// The common named references; the rest are written out as they are. &nbsp; is
+// an ordinary (collapsible) space: Markdown has no use for layout spacing.
+constexpr NamedEntity kEntities[] = {
+    {"amp", '&'},       {"lt", '<'},         {"gt", '>'},        {"quot", '"'},
+    {"apos", '\''},     {"nbsp", ' '},       {"copy", 0xA9},     {"reg", 0xAE},
+    {"trade", 0x2122},  {"hellip", 0x2026},  {"mdash", 0x2014},  {"ndash", 0x2013},
+    {"lsquo", 0x2018},  {"rsquo", 0x2019},   {"sbquo", 0x201A},  {"ldquo", 0x201C},
+    {"rdquo", 0x201D},  {"bdquo", 0x201E},   {"laquo", 0xAB},    {"raquo", 0xBB},
+    {"bull", 0x2022},   {"middot", 0xB7},    {"deg", 0xB0},      {"plusmn", 0xB1},
+    {"times", 0xD7},    {"divide", 0xF7},    {"euro", 0x20AC},   {"pound", 0xA3},
+    {"yen", 0xA5},      {"cent", 0xA2},      {"sect", 0xA7},     {"para", 0xB6},
+    {"shy", 0xAD},      {"ensp", 0x2002},    {"emsp", 0x2003},   {"thinsp", 0x2009},
+    {"zwj", 0x200D},    {"zwnj", 0x200C},    {"larr", 0x2190},   {"uarr", 0x2191},
+    {"rarr", 0x2192},   {"darr", 0x2193},    {"harr", 0x2194},   {"check", 0x2713},
+    {"dagger", 0x2020}, {"Dagger", 0x2021},  {"permil", 0x2030}, {"prime", 0x2032},
+    {"iexcl", 0xA1},    {"iquest", 0xBF},    {"frac12", 0xBD},   {"frac14", 0xBC},
+    {"frac34", 0xBE},   {"sup2", 0xB2},      {"sup3", 0xB3},     {"micro", 0xB5},
+};
+
+// References without ';' that browsers still accept in text.
+constexpr const char* kLegacyEntities[] = {"amp", "lt", "gt", "quot", "nbsp", "copy", "reg"};
+
+// &#128; - &#159; are read as windows-1252, as browsers do.
+constexpr uint16_t kWindows1252[32] = {
+    0x20AC, 0x81,   0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x8D,   0x017D, 0x8F,
+    0x90,   0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x9D,   0x017E, 0x0178,
+};
+
+// Code point of a reference name (the part between '&' and ';').
+bool DecodeEntity(std::string_view name, uint32_t* codePoint) {
+  if (name.size() >= 2 && name[0] == '#') {
+    const bool hex = name[1] == 'x' || name[1] == 'X';
+    size_t i = hex ? 2 : 1;
+    if (i == name.size()) return false;
+    uint32_t value = 0;
+    for (; i < name.size(); i++) {
+      const char c = name[i];
+      uint32_t digit;
+      if (c >= '0' && c <= '9') {
+        digit = static_cast<uint32_t>(c - '0');
+      } else if (hex && Lower(c) >= 'a' && Lower(c) <= 'f') {
+        digit = static_cast<uint32_t>(Lower(c) - 'a' + 10);
+      } else {
+        return false;
+      }
+      value = value * (hex ? 16 : 10) + digit;
+      if (value > 0x10FFFF) value = 0x110000;  // saturate; replaced below
+    }
+    if (value >= 0x80 && value <= 0x9F) value = kWindows1252[value - 0x80];
+    if (value == 0 || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF)) value = 0xFFFD;
+    *codePoint = value;
+    return true;
+  }
+  for (const NamedEntity& e : kEntities) {
+    if (name == e.name) {
+      *codePoint = e.codePoint;
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t EncodeUtf8(uint32_t c, char* out) {
+  if (c < 0x80) {
+    out[0] = static_cast<char>(c);
+    return 1;
+  }
+  if (c < 0x800) {
+    out[0] = static_cast<char>(0xC0 | (c >> 6));
+    out[1] = static_cast<char>(0x80 | (c & 0x3F));
+    return 2;
+  }
+  if (c < 0x10000) {
+    out[0] = static_cast<char>(0xE0 | (c >> 12));
+    out[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (c & 0x3F));
+    return 3;
+  }
+  out[0] = static_cast<char>(0xF0 | (c >> 18));
+  out[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+  out[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+  out[3] = static_cast<char>(0x80 | (c & 0x3F));
+  return 4;
+}
+
+// Attribute values hold complete references, so they are decoded in place
+// (the UTF-8 form is never longer than the reference).
+void DecodeEntities(std::string* s) {
+  size_t o = 0;
+  for (size_t i = 0; i < s->size();) {
+    const char c = (*s)[i];
+    if (c == '&') {
+      const size_t semi = s->find(';', i + 1);
+      uint32_t codePoint;
+      if (semi != std::string::npos && semi - i - 1 <= kMaxEntityLength &&
+          DecodeEntity(std::string_view(*s).substr(i + 1, semi - i - 1), &codePoint)) {
+        o += EncodeUtf8(codePoint, &(*s)[o]);
+        i = semi + 1;
+        continue;
+      }
+    }
+    (*s)[o++] = c;
+    i++;
+  }
+  s->resize(o);
+}
+
+// Characters that are Markdown syntax anywhere in a line.
+bool NeedsEscape(char c) {
+  switch (c) {
+    case '\\':
+    case '`':
+    case '*':
+    case '_':
+    case '[':
+    case ']':
+    case '<':
+    case '~':
+      return true;
+    default:
+      return false;
+  }
+}
+
+} // namespace
+
+HtmlToMarkdown::HtmlToMarkdown(const TextEncodeOptions& options, ByteSink* sink,
+                               size_t chunkBytes)
+    : sink_(sink),
+      out_(chunkBytes < 64 ? 64 : chunkBytes),
+      newline_(options.eol == EolMode::Lf ? "\n" : "\r\n"),
+      trimTrailing_(options.trimTrailing) {
+  if (options.bom) Put("\xEF\xBB\xBF", 3);
+}
+
+bool HtmlToMarkdown::Feed(const char* html, size_t size) {
+  size_t i = 0;
+  while (i < size && ok_) i += Lex1(html + i, size - i);
+  return ok_;
+}
+
+bool HtmlToMarkdown::Finish() {
+  if (lex_ == Lex::Entity) FlushEntity(false);
+  lex_ = Lex::Text;
+  if (preDepth_ > 0) CloseFence();
+  if (rowOpen_) EndRow();
+  if (wroteAny_ && !atLineStart_) Newline();
+  return Flush() && ok_;
+}
+
+// ---------------------------------------------------------------------------
+// Tokenizer. Lex1 handles the input at `p` in the current state and returns
+// how much it consumed; 0 means the state changed and `p` is read again.
+
+size_t HtmlToMarkdown::Lex1(const char* p, size_t n) {
+  const char c = *p;
+  switch (lex_) {
+    case Lex::Text: {
+      size_t run = 0;
+      while (run < n && p[run] != '<' && p[run] != '&') run++;
+      if (run > 0) {
+        Text(p, run);
+        return run;
+      }
+      if (c == '<') {
+        lex_ = Lex::TagOpen;
+      } else {
+        lex_ = Lex::Entity;
+        entity_.clear();
+      }
+      return 1;
+    }
+
+    case Lex::Entity:
+      if (c == ';') {
+        FlushEntity(true);
+        return 1;
+      }
+      if ((IsAlnum(c) || (c == '#' && entity_.empty())) && entity_.size() < kMaxEntityLength) {
+        entity_ += c;
+        return 1;
+      }
+      FlushEntity(false);
+      return 0;
+
+    case Lex::TagOpen:
+      if (c == '/') {
+        lex_ = Lex::EndTagOpen;
+        return 1;
+      }
+      if (c == '!') {
+        lex_ = Lex::MarkupDecl;
+        markupDashes_ = 0;
+        return 1;
+      }
+      if (c == '?') {
+        lex_ = Lex::BogusComment;
+        bogus_.clear();
+        return 1;
+      }
+      if (IsAlpha(c)) {
+        BeginTag(false, c);
+        return 1;
+      }
+      Text("<", 1);
+      lex_ = Lex::Text;
+      return 0;
+
+    case Lex::EndTagOpen:
+      if (IsAlpha(c)) {
+        BeginTag(true, c);
+        return 1;
+      }
+      lex_ = c == '>' ? Lex::Text : Lex::BogusComment;
+      bogus_.clear();
+      return c == '>' ? 1 : 0;
+
+    case Lex::TagName: {
+      size_t run = 0;
+      for (; run < n && !IsSpace(p[run]) && p[run] != '/' && p[run] != '>'; run++) {
+        if (tagName_.size() < kMaxNameLength) tagName_ += Lower(p[run]);
+      }
+      if (run == n) return n;
+      if (p[run] == '>') {
+        EmitTag();
+      } else {
+        lex_ = p[run] == '/' ? Lex::SelfClosing : Lex::BeforeAttrName;
+      }
+      return run + 1;
+    }
+
+    case Lex::BeforeAttrName:
+    case Lex::AfterAttrName:
+      if (IsSpace(c)) return 1;
+      if (c == '/') {
+        lex_ = Lex::SelfClosing;
+      } else if (c == '>') {
+        EmitTag();
+      } else if (c == '=' && lex_ == Lex::AfterAttrName) {
+        lex_ = Lex::BeforeAttrValue;
+      } else {
+        attrName_.assign(1, Lower(c));
+        lex_ = Lex::AttrName;
+      }
+      return 1;
+
+    case Lex::AttrName: {
+      size_t run = 0;
+      for (; run < n && !IsSpace(p[run]) && p[run] != '/' && p[run] != '>' && p[run] != '=';
+           run++) {
+        if (attrName_.size() < kMaxNameLength) attrName_ += Lower(p[run]);
+      }
+      if (run == n) return n;
+      if (p[run] == '=') {
+        lex_ = Lex::BeforeAttrValue;
+        return run + 1;
+      }
+      lex_ = Lex::AfterAttrName;
+      return run;
+    }
+
+    case Lex::BeforeAttrValue:
+      if (IsSpace(c)) return 1;
+      if (c == '>') {
+        EmitTag();
+        return 1;
+      }
+      BeginAttrValue();
+      if (c == '"' || c == '\'') {
+        quote_ = c;
+        lex_ = Lex::AttrValueQuoted;
+        return 1;
+      }
+      lex_ = Lex::AttrValueUnquoted;
+      return 0;
+
+    case Lex::AttrValueQuoted: {
+      const void* end = std::memchr(p, quote_, n);
+      const size_t run = end ? static_cast<size_t>(static_cast<const char*>(end) - p) : n;
+      AppendAttrValue(p, run);
+      if (!end) return run;
+      lex_ = Lex::BeforeAttrName;
+      return run + 1;
+    }
+
+    case Lex::AttrValueUnquoted: {
+      size_t run = 0;
+      while (run < n && !IsSpace(p[run]) && p[run] != '>') run++;
+      AppendAttrValue(p, run);
+      if (run == n) return n;
+      if (p[run] == '>') {
+        EmitTag();
+      } else {
+        lex_ = Lex::BeforeAttrName;
+      }
+      return run + 1;
+    }
+
+    case Lex::SelfClosing:
+      if (c == '>') {
+        tagSelfClosing_ = true;
+        EmitTag();
+        return 1;
+      }
+      lex_ = Lex::BeforeAttrName;
+      return 0;
+
+    case Lex::MarkupDecl:
+      // "<!--" starts a comment; anything else (doctype, "<![if ...]>") is
+      // skipped up to the next '>'.
+      if (c == '-' && markupDashes_ == 0) {
+        markupDashes_ = 1;
+        return 1;
+      }
+      if (c == '-') {
+        lex_ = Lex::Comment;
+        commentDashes_ = 0;
+        commentChars_ = 0;
+        return 1;
+      }
+      lex_ = Lex::BogusComment;
+      bogus_.clear();
+      return 0;
+
+    case Lex::Comment:
+      if (c == '>' && (commentDashes_ >= 2 || commentDashes_ == commentChars_)) {
+        lex_ = Lex::Text;
+        return 1;
+      }
+      commentDashes_ = c == '-' ? commentDashes_ + 1 : 0;
+      commentChars_++;
+      return 1;
+
+    case Lex::BogusComment: {
+      const void* end = std::memchr(p, '>', n);
+      const size_t run = end ? static_cast<size_t>(static_cast<const char*>(end) - p) : n;
+      const size_t room = kMaxDeclarationLength - bogus_.size();
+      bogus_.append(p, run < room ? run : room);
+      if (!end) return n;
+      lex_ = Lex::Text;
+      WordListMarker();
+      return run + 1;
+    }
+
+    case Lex::RawText: {
+      const void* end = std::memchr(p, '<', n);
+      if (!end) return n;
+      lex_ = Lex::RawTextEnd;
+      rawSlash_ = false;
+      rawMatched_ = 0;
+      return static_cast<size_t>(static_cast<const char*>(end) - p) + 1;
+    }
+
+    case Lex::RawTextEnd:
+      // Looking for "</name" followed by a space, '/' or '>'.
+      if (!rawSlash_) {
+        if (c != '/') {
+          lex_ = Lex::RawText;
+          return 0;
+        }
+        rawSlash_ = true;
+        return 1;
+      }
+      if (rawMatched_ < rawName_.size()) {
+        if (Lower(c) != rawName_[rawMatched_]) {
+          lex_ = Lex::RawText;
+          return 0;
+        }
+        rawMatched_++;
+        return 1;
+      }
+      if (IsSpace(c) || c == '/' || c == '>') {
+        tagName_ = rawName_;
+        tagEnd_ = true;
+        tagSelfClosing_ = false;
+        for (AttrValue& a : attrs_) a.present = false;
+        lex_ = Lex::BeforeAttrName;
+        return 0;
+      }
+      lex_ = Lex::RawText;
+      return 0;
+  }
+  return 1;
+}
+
+void HtmlToMarkdown::BeginTag(bool end, char first) {
+  tagName_.assign(1, Lower(first));
+  tagEnd_ = end;
+  tagSelfClosing_ = false;
+  for (AttrValue& a : attrs_) a.present = false;
+  lex_ = Lex::TagName;
+}
+
+void HtmlToMarkdown::BeginAttrValue() {
+  static const char* const kNames[kAttrCount] = {"href", "src", "alt", "start", "class"};
+  attrTarget_ = nullptr;
+  if (tagEnd_) return;
+  for (int i = 0; i < kAttrCount; i++) {
+    if (attrName_ == kNames[i]) {
+      attrTarget_ = &attrs_[i];
+      attrTarget_->present = true;
+      attrTarget_->overflow = false;
+      attrTarget_->value.clear();
+      return;
+    }
+  }
+}
+
+void HtmlToMarkdown::AppendAttrValue(const char* p, size_t n) {
+  if (!attrTarget_ || attrTarget_->overflow) return;
+  if (attrTarget_->value.size() + n > kMaxAttrLength) {
+    attrTarget_->overflow = true;
+    attrTarget_->value.clear();
+    return;
+  }
+  attrTarget_->value.append(p, n);
+}
+
+void HtmlToMarkdown::EmitTag() {
+  lex_ = Lex::Text;
+  attrTarget_ = nullptr;
+  for (AttrValue& a : attrs_) {
+    if (a.overflow) a.present = false;
+    if (a.present) DecodeEntities(&a.value);
+  }
+  const HtmlElement element = Classify(tagName_);
+  if (!tagEnd_ && element == HtmlElement::Raw) {
+    rawName_ = tagName_;
+    lex_ = Lex::RawText;
+  }
+  HandleTag(element);
+}
+
+// Word writes list paragraphs as <p> with the bullet or number as text between
+// <![if !supportLists]> and <![endif]>. That text is held back and the
+// paragraph starts with a Markdown list marker instead.
+void HtmlToMarkdown::WordListMarker() {
+  if (bogus_.compare(0, 18, "[if !supportLists]") == 0 && preDepth_ == 0) {
+    wordBullet_ = true;
+    wordBulletText_.clear();
+    return;
+  }
+  if (!wordBullet_ || bogus_.compare(0, 7, "[endif]") != 0) return;
+  wordBullet_ = false;
+  const std::string& text = wordBulletText_;
+  size_t digits = 0;
+  while (digits < text.size() && text[digits] >= '0' && text[digits] <= '9') digits++;
+  const bool numbered = digits > 0 && digits + 1 == text.size() &&
+                        (text[digits] == '.' || text[digits] == ')');
+  // Only a marker at the start of the paragraph makes a list item.
+  if (!atLineStart_ && pendingBreak_ == 0) return;
+  lineMarker_ = numbered ? text + " " : "- ";
+}
+
+void HtmlToMarkdown::FlushEntity(bool terminated) {
+  lex_ = Lex::Text;
+  uint32_t codePoint = 0;
+  bool decoded = DecodeEntity(entity_, &codePoint);
+  if (decoded && !terminated && entity_[0] != '#') {
+    decoded = false;
+    for (const char* legacy : kLegacyEntities) decoded = decoded || entity_ == legacy;
+  }
+  if (decoded) {
+    char utf8[4];
+    Text(utf8, EncodeUtf8(codePoint, utf8));
+    return;
+  }
+  Text("&", 1);
+  Text(entity_.data(), entity_.size());
+  if (terminated) Text(";", 1);
+}
+
+// ---------------------------------------------------------------------------
+// Emitter.
+
+void HtmlToMarkdown::HandleTag(HtmlElement element) {
+  const bool end = tagEnd_;
+
+  if (element == HtmlElement::Skip) {
+    if (!tagSelfClosing_) skipDepth_ += end ? (skipDepth_ > 0 ? -1 : 0) : 1;
+    return;
+  }
+  if (skipDepth_ > 0) return;
+
+  // Table cells, headings and link text hold one line: block structure inside
+  // them is reduced to a space.
+  const bool oneLine = cellOpen_ || headingLevel_ > 0 || linkOpen_;
+  switch (element) {
+    case HtmlElement::Heading:
+    case HtmlElement::List:
+    case HtmlElement::OrderedList:
+    case HtmlElement::Item:
+    case HtmlElement::Quote:
+    case HtmlElement::Pre:
+    case HtmlElement::Rule:
+      if (oneLine && !(element == HtmlElement::Heading && end && headingLevel_ > 0)) {
+        pendingSpace_ = true;
+        return;
+      }
+      break;
+    default:
+      break;
+  }
+
+  switch (element) {
+    case HtmlElement::Block:
+      RequestBreak(2);
+      break;
+
+    case HtmlElement::Heading:
+      if (preDepth_ > 0) break;
+      if (!end) {
+        RequestBreak(2);
+        headingLevel_ = tagName_[1] - '0';
+        lineMarker_.assign(static_cast<size_t>(headingLevel_), '#');
+        lineMarker_ += ' ';
+      } else if (headingLevel_ > 0) {
+        headingLevel_ = 0;
+        RequestBreak(2);
+      }
+      break;
+
+    case HtmlElement::List:
+    case HtmlElement::OrderedList: {
+      bool nested = false;
+      for (const Container& box : containers_) nested = nested || box.kind == Box::Item;
+      if (!end) {
+        RequestBreak(nested ? 1 : 2);
+        if (containers_.size() < kMaxContainers) {
+          uint32_t start = 1;
+          if (attrs_[kStart].present) {
+            start = static_cast<uint32_t>(std::strtoul(attrs_[kStart].value.c_str(), nullptr, 10));
+          }
+          containers_.push_back({Box::List, element == HtmlElement::OrderedList, start, 0});
+        }
+      } else {
+        PopTo(Box::List);
+        nested = false;
+        for (const Container& box : containers_) nested = nested || box.kind == Box::Item;
+        RequestBreak(nested ? 1 : 2);
+      }
+      break;
+    }
+
+    case HtmlElement::Item:
+      if (!end) {
+        if (!containers_.empty() && containers_.back().kind == Box::Item) PopTo(Box::Item);
+        RequestBreak(1);
+        if (containers_.size() >= kMaxContainers) break;
+        Container* list = !containers_.empty() && containers_.back().kind == Box::List
+                              ? &containers_.back()
+                              : nullptr;
+        if (list && list->ordered) {
+          std::snprintf(marker_, sizeof(marker_), "%u. ", list->next++);
+        } else {
+          std::snprintf(marker_, sizeof(marker_), "- ");
+        }
+        containers_.push_back({Box::Item, false, 0, static_cast<uint8_t>(std::strlen(marker_))});
+        markerPending_ = true;
+        markerIndex_ = containers_.size() - 1;
+      } else {
+        if (!containers_.empty() && containers_.back().kind == Box::Item) PopTo(Box::Item);
+        RequestBreak(1);
+      }
+      break;
+
+    case HtmlElement::Quote:
+      RequestBreak(2);
+      if (!end && containers_.size() < kMaxContainers) {
+        containers_.push_back({Box::Quote, false, 0, 0});
+      } else if (end) {
+        PopTo(Box::Quote);
+      }
+      break;
+
+    case HtmlElement::Pre:
+      if (!end) {
+        if (preDepth_++ > 0) break;
+        RequestBreak(2);
+        fencePending_ = true;
+        preSkipNewline_ = true;
+        preCr_ = false;
+        fenceLanguage_.clear();
+        preBlank_.clear();
+      } else if (preDepth_ > 0 && --preDepth_ == 0) {
+        CloseFence();
+        RequestBreak(2);
+      }
+      if (!end && attrs_[kClass].present) {
+        const std::string& cls = attrs_[kClass].value;
+        const size_t at = cls.find("language-");
+        if (at != std::string::npos && fenceLanguage_.empty()) {
+          size_t stop = at + 9;
+          while (stop < cls.size() && !IsSpace(cls[stop]) && cls[stop] != '`') stop++;
+          fenceLanguage_ = cls.substr(at + 9, stop - at - 9);
+        }
+      }
+      break;
+
+    case HtmlElement::Code:
+      if (preDepth_ > 0) {
+        // <pre><code class="language-x">: the fence takes the language.
+        if (!end && fencePending_ && fenceLanguage_.empty() && attrs_[kClass].present) {
+          const std::string& cls = attrs_[kClass].value;
+          const size_t at = cls.find("language-");
+          if (at != std::string::npos) {
+            size_t stop = at + 9;
+            while (stop < cls.size() && !IsSpace(cls[stop]) && cls[stop] != '`') stop++;
+            fenceLanguage_ = cls.substr(at + 9, stop - at - 9);
+          }
+        }
+        break;
+      }
+      if (!end) {
+        OpenMark("`", &codeDepth_);
+      } else {
+        CloseMark("`", &codeDepth_);
+      }
+      break;
+
+    case HtmlElement::Bold:
+    case HtmlElement::Italic:
+    case HtmlElement::Strike: {
+      if (preDepth_ > 0 || codeDepth_ > 0) break;
+      const char* mark = element == HtmlElement::Bold     ? "**"
+                         : element == HtmlElement::Italic ? "*"
+                                                          : "~~";
+      int* depth = element == HtmlElement::Bold     ? &boldDepth_
+                   : element == HtmlElement::Italic ? &italicDepth_
+                                                : &strikeDepth_;
+      if (!end) {
+        OpenMark(mark, depth);
+      } else {
+        CloseMark(mark, depth);
+      }
+      break;
+    }
+
+    case HtmlElement::Link:
+      if (preDepth_ > 0) break;
+      if (!end) {
+        if (linkDepth_++ > 0) break;
+        const std::string& href = attrs_[kHref].value;
+        if (!attrs_[kHref].present || href.empty() || href[0] == '#' ||
+            href.compare(0, 11, "javascript:") == 0) {
+          break;
+        }
+        linkOpen_ = true;
+        linkHref_ = href;
+        pendingOpen_ += '[';
+      } else if (linkDepth_ > 0 && --linkDepth_ == 0 && linkOpen_) {
+        linkOpen_ = false;
+        if (!pendingOpen_.empty() && pendingOpen_.back() == '[') {
+          pendingOpen_.pop_back();  // no link text
+        } else {
+          Put("](", 2);
+          WriteUrl(linkHref_);
+          Put(")", 1);
+        }
+      }
+      break;
+
+    case HtmlElement::Image: {
+      if (end || preDepth_ > 0) break;
+      std::string& alt = attrs_[kAlt].value;
+      if (!attrs_[kAlt].present) alt.clear();
+      const std::string& src = attrs_[kSrc].value;
+      if (!attrs_[kSrc].present || src.empty() || src.compare(0, 5, "data:") == 0) {
+        Text(alt.data(), alt.size());
+        break;
+      }
+      StartContent();
+      Put("![", 2);
+      for (char& ch : alt) {
+        if (IsSpace(ch)) ch = ' ';
+      }
+      WriteEscaped(alt.data(), alt.size());
+      Put("](", 2);
+      WriteUrl(src);
+      Put(")", 1);
+      break;
+    }
+
+    case HtmlElement::Break:
+      if (end) break;
+      if (preDepth_ > 0) {
+        PreText("\n", 1);
+      } else {
+        HardBreak();
+      }
+      break;
+
+    case HtmlElement::Rule:
+      if (end || preDepth_ > 0) break;
+      RequestBreak(2);
+      FlushBreak();
+      if (!atLineStart_) Newline();
+      WritePrefix(false);
+      Put("---", 3);
+      atLineStart_ = false;
+      wroteAny_ = true;
+      RequestBreak(2);
+      break;
+
+    case HtmlElement::Table:
+      if (!end) {
+        if (tableDepth_++ == 0) {
+          RequestBreak(2);
+          rowIndex_ = 0;
+        }
+      } else if (tableDepth_ > 0 && --tableDepth_ == 0) {
+        if (rowOpen_) EndRow();
+        RequestBreak(2);
+      }
+      break;
+
+    case HtmlElement::Row:
+      if (tableDepth_ == 1 && rowOpen_) EndRow();
+      break;
+
+    case HtmlElement::Cell:
+      if (tableDepth_ != 1) {
+        pendingSpace_ = true;
+        break;
+      }
+      if (!end) {
+        if (cellOpen_) EndCell();
+        if (!rowOpen_) StartRow();
+        cellOpen_ = true;
+        pendingSpace_ = true;
+      } else if (cellOpen_) {
+        EndCell();
+      }
+      break;
+
+    case HtmlElement::Other:
+    case HtmlElement::Skip:
+    case HtmlElement::Raw:
+      break;
+  }
+}
+
+void HtmlToMarkdown::Text(const char* p, size_t n) {
+  if (skipDepth_ > 0) return;
+  if (wordBullet_) {
+    for (size_t i = 0; i < n && wordBulletText_.size() < kMaxNameLength; i++) {
+      if (!IsSpace(p[i])) wordBulletText_ += p[i];
+    }
+    return;
+  }
+  if (preDepth_ > 0) {
+    PreText(p, n);
+    return;
+  }
+  while (n > 0) {
+    if (IsSpace(*p)) {
+      pendingSpace_ = true;
+      p++;
+      n--;
+      continue;
+    }
+    // Words separated by single spaces need no collapsing and go out together.
+    size_t run = 1;
+    while (run < n &&
+           (!IsSpace(p[run]) || (p[run] == ' ' && run + 1 < n && !IsSpace(p[run + 1])))) {
+      run++;
+    }
+    StartContent();
+    if (codeDepth_ > 0) {
+      WriteCode(p, run);
+    } else {
+      WriteEscaped(p, run);
+    }
+    p += run;
+    n -= run;
+  }
+}
+
+void HtmlToMarkdown::PreText(const char* p, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    const char c = p[i];
+    if (c == '\n' && preCr_) {
+      preCr_ = false;
+      continue;  // second half of CRLF
+    }
+    preCr_ = c == '\r';
+    const bool lineBreak = c == '\n' || c == '\r';
+    if (preSkipNewline_) {
+      preSkipNewline_ = false;
+      if (lineBreak) continue;  // a newline right after <pre> is not content
+    }
+    if (fencePending_) OpenFence();
+    if (lineBreak) {
+      preBlank_.clear();
+      if (atLineStart_) WritePrefix(true);
+      Newline();
+      continue;
+    }
+    if (trimTrailing_ && (c == ' ' || c == '\t') && preBlank_.size() < kMaxHeldBlanks) {
+      preBlank_ += c;
+      continue;
+    }
+    if (atLineStart_) {
+      WritePrefix(false);
+      atLineStart_ = false;
+    }
+    if (!preBlank_.empty()) {
+      Put(preBlank_);
+      preBlank_.clear();
+    }
+    // The rest of the run up to the next break or blank goes out in one piece.
+    size_t run = 1;
+    while (i + run < n && p[i + run] != '\n' && p[i + run] != '\r' &&
+           !(trimTrailing_ && (p[i + run] == ' ' || p[i + run] == '\t'))) {
+      run++;
+    }
+    Put(p + i, run);
+    i += run - 1;
+  }
+}
+
+// Code spans take text literally; only a '|' in a table cell is escaped.
+void HtmlToMarkdown::WriteCode(const char* p, size_t n) {
+  lineLead_ = LineLead::Other;
+  size_t start = 0;
+  for (size_t i = 0; cellOpen_ && i < n; i++) {
+    if (p[i] != '|') continue;
+    Put(p + start, i - start);
+    Put("\\", 1);
+    start = i;
+  }
+  Put(p + start, n - start);
+}
+
+void HtmlToMarkdown::WriteEscaped(const char* p, size_t n) {
+  size_t start = 0;
+  for (size_t i = 0; i < n; i++) {
+    const char c = p[i];
+    bool escape = NeedsEscape(c) || (c == '|' && cellOpen_);
+    if (lineLead_ != LineLead::Other) {
+      // "# ", "> ", "- ", "+ ", "1. " or "1) " at the start of a line.
+      if (lineLead_ == LineLead::Start &&
+          (c == '#' || c == '>' || c == '-' || c == '+' || c == '=')) {
+        escape = true;
+        lineLead_ = LineLead::Other;
+      } else if (c >= '0' && c <= '9') {
+        lineLead_ = LineLead::Digits;
+      } else {
+        escape = escape || (lineLead_ == LineLead::Digits && (c == '.' || c == ')'));
+        lineLead_ = LineLead::Other;
+      }
+    }
+    if (escape) {
+      Put(p + start, i - start);
+      Put("\\", 1);
+      start = i;
+    }
+  }
+  Put(p + start, n - start);
+}
+
+// Characters that would end or split the link destination are percent-encoded.
+void HtmlToMarkdown::WriteUrl(const std::string& url) {
+  size_t start = 0;
+  for (size_t i = 0; i < url.size(); i++) {
+    const char c = url[i];
+    const char* code = c == ' '   ? "%20"
+                       : c == '(' ? "%28"
+                       : c == ')' ? "%29"
+                       : c == '<' ? "%3C"
+                       : c == '>' ? "%3E"
+                       : c == '\t' || c == '\n' || c == '\r' ? ""
+                                                            : nullptr;
+    if (!code) continue;
+    Put(url.data() + start, i - start);
+    Put(code, std::strlen(code));
+    start = i + 1;
+  }
+  Put(url.data() + start, url.size() - start);
+}
+
+// Everything visible goes through here: pending line breaks, the line prefix,
+// a collapsed space and emphasis openers are written just before it, so none
+// of them can end up at the end of a line.
+void HtmlToMarkdown::StartContent() {
+  if (pendingBreak_ > 0) FlushBreak();
+  if (atLineStart_) {
+    WritePrefix(false);
+    Put(lineMarker_);
+    lineMarker_.clear();
+    atLineStart_ = false;
+    pendingSpace_ = false;
+  } else if (pendingSpace_) {
+    Put(" ", 1);
+    pendingSpace_ = false;
+  }
+  if (!pendingOpen_.empty()) {
+    Put(pendingOpen_);
+    pendingOpen_.clear();
+  }
+  wroteAny_ = true;
+}
+
+// Inside a table cell, heading or link text a block boundary is just a space.
+void HtmlToMarkdown::RequestBreak(int lines) {
+  if (preDepth_ > 0) return;
+  if (cellOpen_ || headingLevel_ > 0 || linkOpen_) {
+    pendingSpace_ = true;
+    return;
+  }
+  if (pendingBreak_ == 0) breakDepth_ = containers_.size();
+  if (lines > pendingBreak_) pendingBreak_ = lines;
+  pendingSpace_ = false;
+  lineMarker_.clear();
+}
+
+void HtmlToMarkdown::FlushBreak() {
+  const int lines = pendingBreak_;
+  pendingBreak_ = 0;
+  if (!wroteAny_) return;
+  if (!atLineStart_) Newline();
+  if (lines == 2) {
+    // The blank line belongs to the containers the text before and after it
+    // share: it must not open a quote that only starts on the next line.
+    WritePrefix(true, breakDepth_);
+    Newline();
+  }
+}
+
+// Blockquote markers and list indentation for the line about to start. Blank
+// lines keep only the quote markers, without trailing spaces, of the first
+// `depth` containers.
+void HtmlToMarkdown::WritePrefix(bool blankLine, size_t depth) {
+  lineLead_ = LineLead::Start;
+  if (depth > containers_.size()) depth = containers_.size();
+  if (depth == 0) return;
+  char prefix[kMaxContainers * 16];
+  size_t length = 0;
+  for (size_t i = 0; i < depth; i++) {
+    const Container& box = containers_[i];
+    if (box.kind == Box::Quote) {
+      prefix[length++] = '>';
+      prefix[length++] = ' ';
+    } else if (box.kind == Box::Item) {
+      if (markerPending_ && i == markerIndex_ && !blankLine) {
+        std::memcpy(prefix + length, marker_, box.width);
+        markerPending_ = false;
+      } else {
+        std::memset(prefix + length, ' ', box.width);
+      }
+      length += box.width;
+    }
+  }
+  if (blankLine) {
+    while (length > 0 && prefix[length - 1] == ' ') length--;
+  }
+  Put(prefix, length);
+}
+
+void HtmlToMarkdown::Newline() {
+  Put(newline_);
+  atLineStart_ = true;
+}
+
+void HtmlToMarkdown::OpenMark(const char* mark, int* depth) {
+  if ((*depth)++ == 0) pendingOpen_ += mark;
+}
+
+void HtmlToMarkdown::CloseMark(const char* mark, int* depth) {
+  if (*depth == 0 || --*depth > 0) return;
+  const size_t length = std::strlen(mark);
+  if (pendingOpen_.size() >= length &&
+      pendingOpen_.compare(pendingOpen_.size() - length, length, mark) == 0) {
+    pendingOpen_.resize(pendingOpen_.size() - length);  // nothing in between
+  } else {
+    Put(mark, length);
+  }
+}
+
+void HtmlToMarkdown::HardBreak() {
+  if (cellOpen_) {
+    StartContent();
+    Put("<br>", 4);
+    return;
+  }
+  if (headingLevel_ > 0 || linkOpen_) {
+    pendingSpace_ = true;
+    return;
+  }
+  if (atLineStart_ || pendingBreak_ > 0) {
+    // A break on an empty line ends the paragraph.
+    RequestBreak(2);
+    return;
+  }
+  if (trimTrailing_) {
+    Put("\\", 1);
+  } else {
+    Put("  ", 2);
+  }
+  Newline();
+  pendingSpace_ = false;
+}
+
+void HtmlToMarkdown::OpenFence() {
+  fencePending_ = false;
+  FlushBreak();
+  if (!atLineStart_) Newline();
+  WritePrefix(false);
+  Put("```", 3);
+  Put(fenceLanguage_);
+  Newline();
+  wroteAny_ = true;
+}
+
+void HtmlToMarkdown::CloseFence() {
+  preDepth_ = 0;
+  if (fencePending_) {
+    fencePending_ = false;  // empty <pre>: nothing is written
+    return;
+  }
+  if (!atLineStart_) Newline();
+  WritePrefix(false);
+  Put("```", 3);
+  atLineStart_ = false;
+}
+
+void HtmlToMarkdown::StartRow() {
+  if (pendingBreak_ > 0) FlushBreak();
+  if (!atLineStart_) Newline();
+  WritePrefix(false);
+  Put("|", 1);
+  atLineStart_ = false;
+  wroteAny_ = true;
+  rowOpen_ = true;
+  rowCells_ = 0;
+}
+
+void HtmlToMarkdown::EndCell() {
+  // Emphasis left open in the cell is closed so it cannot run into the next.
+  if (linkOpen_) {
+    linkOpen_ = false;
+    linkDepth_ = 0;
+    if (!pendingOpen_.empty() && pendingOpen_.back() == '[') {
+      pendingOpen_.pop_back();
+    } else {
+      Put("](", 2);
+      WriteUrl(linkHref_);
+      Put(")", 1);
+    }
+  }
+  while (codeDepth_ > 0) CloseMark("`", &codeDepth_);
+  while (strikeDepth_ > 0) CloseMark("~~", &strikeDepth_);
+  while (italicDepth_ > 0) CloseMark("*", &italicDepth_);
+  while (boldDepth_ > 0) CloseMark("**", &boldDepth_);
+  pendingOpen_.clear();
+  Put(" |", 2);
+  cellOpen_ = false;
+  pendingSpace_ = false;
+  rowCells_++;
+}
+
+void HtmlToMarkdown::EndRow() {
+  if (cellOpen_) EndCell();
+  rowOpen_ = false;
+  Newline();
+  if (rowIndex_++ == 0) {
+    // GFM needs a delimiter row after the first (header) row.
+    WritePrefix(false);
+    Put("|", 1);
+    for (uint32_t i = 0; i < rowCells_; i++) Put(" --- |", 6);
+    Newline();
+  }
+}
+
+void HtmlToMarkdown::PopTo(Box kind) {
+  for (size_t i = containers_.size(); i > 0; i--) {
+    if (containers_[i - 1].kind != kind) continue;
+    containers_.resize(i - 1);
+    if (markerIndex_ >= containers_.size()) markerPending_ = false;
+    if (breakDepth_ > containers_.size()) breakDepth_ = containers_.size();
+    return;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Output.
+
+void HtmlToMarkdown::Put(const char* p, size_t n) {
+  while (n > 0) {
+    if (used_ == out_.size() && !Flush()) return;
+    const size_t take = n < out_.size() - used_ ? n : out_.size() - used_;
+    std::memcpy(out_.data() + used_, p, take);
+    used_ += take;
+    p += take;
+    n -= take;
+  }
+}
+
+bool HtmlToMarkdown::Flush() {
+  if (used_ > 0 && ok_) {
+    ok_ = sink_->Write(reinterpret_cast<const uint8_t*>(out_.data()), used_);
+  }
+  used_ = 0;
+  return ok_;
+}
+
+bool ConvertHtmlToMarkdown(std::string_view html, const TextEncodeOptions& options,
+                           ByteSink* sink) {
+  HtmlToMarkdown markdown(options, sink);
+  return markdown.Feed(html.data(), html.size()) && markdown.Finish();
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ByteSink.h"
+#include "TextEncode.h"
+
+// HTML to Markdown (CommonMark, plus GFM tables and strikethrough) for the
+// CF_HTML payload. Portable (no Windows headers): a tokenizer state machine
+// feeds an emitter that writes Markdown as it goes, so the input can arrive in
+// pieces and memory use does not depend on the size of the page.
+
+namespace ptf_helper {
+
+enum class HtmlElement : uint8_t;
+
+// Converts:
+//   - p/div/section/... to paragraphs, h1-h6 to ATX headings, br to hard breaks
+//   - ul/ol/li (nested, with ol start) to lists, blockquote to "> " blocks
+//   - pre to fenced code blocks (language from a "language-" class), code/kbd
+//     to code spans, b/strong, i/em and s/del to emphasis and strikethrough
+//   - a href to links and img to images (data: images keep only their alt text)
+//   - tables to pipe tables, with the first row as the header; nested tables
+//     are flattened into the enclosing cell
+//   - Word's list paragraphs (bullet text in <![if !supportLists]>) to list items
+// head, script, style, svg and similar content is dropped, as are comments.
+// Unknown tags are ignored and their text kept. Text is escaped so it is not
+// read back as Markdown syntax.
+//
+// TextEncodeOptions apply to the output: eol picks the line break (Keep writes
+// CRLF, like clipboard text), bom adds a UTF-8 BOM, and trimTrailing makes
+// hard breaks "\" instead of two spaces and trims code block lines.
+class HtmlToMarkdown {
+ public:
+  HtmlToMarkdown(const TextEncodeOptions& options, ByteSink* sink,
+                 size_t chunkBytes = 1024 * 1024);
+  HtmlToMarkdown(const HtmlToMarkdown&) = delete;
+  HtmlToMarkdown& operator=(const HtmlToMarkdown&) = delete;
+
+  // UTF-8 HTML, split anywhere. Returns false once the sink has failed.
+  bool Feed(const char* html, size_t size);
+
+  // Closes open code blocks and tables, ends the last line and flushes.
+  bool Finish();
+
+ private:
+  enum class Lex : uint8_t {
+    Text,
+    Entity,
+    TagOpen,
+    EndTagOpen,
+    TagName,
+    BeforeAttrName,
+    AttrName,
+    AfterAttrName,
+    BeforeAttrValue,
+    AttrValueQuoted,
+    AttrValueUnquoted,
+    SelfClosing,
+    MarkupDecl,
+    Comment,
+    BogusComment,
+    RawText,
+    RawTextEnd,
+  };
+
+  enum Attr { kHref, kSrc, kAlt, kStart, kClass, kAttrCount };
+
+  struct AttrValue {
+    std::string value;
+    bool present = false;
+    bool overflow = false;  // longer than the cap (e.g. a data: URI); ignored
+  };
+
+  enum class Box : uint8_t { Quote, List, Item };
+
+  struct Container {
+    Box kind;
+    bool ordered;
+    uint32_t next;  // List: number of the next ordered item
+    uint8_t width;  // Item: marker width, the indent of continuation lines
+  };
+
+  // First characters of a line that could be read as a block marker.
+  enum class LineLead : uint8_t { Start, Digits, Other };
+
+  // Tokenizer.
+  size_t Lex1(const char* p, size_t n);
+  void BeginTag(bool end, char first);
+  void BeginAttrValue();
+  void AppendAttrValue(const char* p, size_t n);
+  void EmitTag();
+  void FlushEntity(bool terminated);
+  void WordListMarker();
+
+  // Emitter.
+  void HandleTag(HtmlElement element);
+  void Text(const char* p, size_t n);
+  void PreText(const char* p, size_t n);
+  void WriteCode(const char* p, size_t n);
+  void WriteEscaped(const char* p, size_t n);
+  void WriteUrl(const std::string& url);
+  void StartContent();
+  void RequestBreak(int lines);
+  void FlushBreak();
+  void WritePrefix(bool blankLine, size_t depth = SIZE_MAX);
+  void Newline();
+  void OpenMark(const char* mark, int* depth);
+  void CloseMark(const char* mark, int* depth);
+  void HardBreak();
+  void OpenFence();
+  void CloseFence();
+  void StartRow();
+  void EndCell();
+  void EndRow();
+  void PopTo(Box kind);
+
+  // Output.
+  void Put(const char* p, size_t n);
+  void Put(std::string_view s) { Put(s.data(), s.size()); }
+  bool Flush();
+
+  ByteSink* sink_;
+  std::vector<char> out_;
+  size_t used_ = 0;
+  bool ok_ = true;
+  std::string_view newline_;
+  bool trimTrailing_;
+
+  Lex lex_ = Lex::Text;
+  std::string tagName_;
+  bool tagEnd_ = false;
+  bool tagSelfClosing_ = false;
+  std::string attrName_;
+  AttrValue attrs_[kAttrCount];
+  AttrValue* attrTarget_ = nullptr;
+  char quote_ = 0;
+  std::string entity_;
+  std::string rawName_;
+  size_t rawMatched_ = 0;
+  bool rawSlash_ = false;
+  int markupDashes_ = 0;
+  size_t commentDashes_ = 0;
+  size_t commentChars_ = 0;
+  std::string bogus_;  // start of a <!...>/<?...> declaration
+  bool wordBullet_ = false;
+  std::string wordBulletText_;
+
+  std::vector<Container> containers_;
+  bool markerPending_ = false;
+  size_t markerIndex_ = 0;
+  char marker_[16] = {};
+
+  std::string pendingOpen_;  // emphasis/link openers not yet followed by text
+  int pendingBreak_ = 0;     // 1 = new line, 2 = blank line
+  size_t breakDepth_ = 0;    // fewest containers open since the break was asked for
+  bool pendingSpace_ = false;
+  std::string lineMarker_;   // heading or Word list marker for the next line
+  bool atLineStart_ = true;
+  bool wroteAny_ = false;
+  LineLead lineLead_ = LineLead::Start;
+
+  int skipDepth_ = 0;
+  int headingLevel_ = 0;
+  int boldDepth_ = 0;
+  int italicDepth_ = 0;
+  int strikeDepth_ = 0;
+  int codeDepth_ = 0;
+  int linkDepth_ = 0;
+  bool linkOpen_ = false;
+  std::string linkHref_;
+
+  int preDepth_ = 0;
+  bool fencePending_ = false;
+  bool preSkipNewline_ = false;
+  bool preCr_ = false;
+  std::string fenceLanguage_;
+  std::string preBlank_;  // trimTrailing: spaces held until the line goes on
+
+  int tableDepth_ = 0;
+  bool rowOpen_ = false;
+  bool cellOpen_ = false;
+  uint32_t rowIndex_ = 0;
+  uint32_t rowCells_ = 0;
+};
+
+// One-shot form for a payload that is already in memory.
+bool ConvertHtmlToMarkdown(std::string_view html, const TextEncodeOptions& options,
+                           ByteSink* sink);
+
+} // namespace ptf_helper
@@ -0,0 +1,84 @@
+#include "ImageSniff.h"
+
+#include <cstring>
+
+namespace ptf_helper {
+
+namespace {
+
+bool StartsWith(const uint8_t* data, size_t size, const void* prefix, size_t prefixSize) {
+  return size >= prefixSize && std::memcmp(data, prefix, prefixSize) == 0;
+}
+
+uint32_t ReadBe32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+size_t PngLength(const uint8_t* data, size_t size) {
+  size_t pos = 8;  // signature
+  while (size - pos >= 12) {
+    const uint32_t length = ReadBe32(data + pos);
+    if (length > 0x7FFFFFFFu || length > size - pos - 12) return 0;
+    const size_t next = pos + 12 + length;  // length, type, data, CRC
+    if (std::memcmp(data + pos + 4, "IEND", 4) == 0) return next;
+    pos = next;
+  }
+  return 0;
+}
+
+size_t JpegLength(const uint8_t* data, size_t size) {
+  for (size_t end = size; end >= 4; end--) {
+    if (data[end - 2] == 0xFF && data[end - 1] == 0xD9) return end;
+  }
+  return size;
+}
+
+} // namespace
+
+ImageContainer SniffImageContainer(const uint8_t* data, size_t size) {
+  static const uint8_t kPng[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  static const uint8_t kJpeg[3] = {0xFF, 0xD8, 0xFF};
+  static const uint8_t kTiffLe[4] = {'I', 'I', 0x2A, 0x00};
+  static const uint8_t kTiffBe[4] = {'M', 'M', 0x00, 0x2A};
+
+  if (!data) return ImageContainer::Unknown;
+  if (StartsWith(data, size, kPng, sizeof(kPng))) return ImageContainer::Png;
+  if (StartsWith(data, size, kJpeg, sizeof(kJpeg))) return ImageContainer::Jpeg;
+  if (StartsWith(data, size, "GIF87a", 6) || StartsWith(data, size, "GIF89a", 6)) {
+    return ImageContainer::Gif;
+  }
+  // BITMAPFILEHEADER (14 bytes) followed by at least a BITMAPCOREHEADER.
+  if (StartsWith(data, size, "BM", 2) && size >= 14 + 12) return ImageContainer::Bmp;
+  if (StartsWith(data, size, kTiffLe, sizeof(kTiffLe)) ||
+      StartsWith(data, size, kTiffBe, sizeof(kTiffBe))) {
+    return ImageContainer::Tiff;
+  }
+  if (StartsWith(data, size, "RIFF", 4) && size >= 12 && std::memcmp(data + 8, "WEBP", 4) == 0) {
+    return ImageContainer::WebP;
+  }
+  return ImageContainer::Unknown;
+}
+
+size_t EncodedImageLength(const uint8_t* data, size_t size) {
+  switch (SniffImageContainer(data, size)) {
+    case ImageContainer::Png: return PngLength(data, size);
+    case ImageContainer::Jpeg: return JpegLength(data, size);
+    default: return size;
+  }
+}
+
+const wchar_t* ImageContainerExtension(ImageContainer container) {
+  switch (container) {
+    case ImageContainer::Png: return L".png";
+    case ImageContainer::Jpeg: return L".jpg";
+    case ImageContainer::Gif: return L".gif";
+    case ImageContainer::Bmp: return L".bmp";
+    case ImageContainer::Tiff: return L".tif";
+    case ImageContainer::WebP: return L".webp";
+    case ImageContainer::Unknown: break;
+  }
+  return L"";
+}
+
+} // namespace ptf_helper
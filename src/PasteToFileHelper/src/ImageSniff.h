@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Identifies encoded image containers by their leading signature bytes.
+// Portable (no Windows headers).
+
+namespace ptf_helper {
+
+enum class ImageContainer {
+  Unknown,
+  Png,
+  Jpeg,
+  Gif,
+  Bmp,
+  Tiff,
+  WebP,
+};
+
+ImageContainer SniffImageContainer(const uint8_t* data, size_t size);
+
+// Length of the encoded stream at the start of `data`, ignoring the padding
+// clipboard memory blocks are rounded up with. PNG ends after the IEND chunk
+// (0 when its chunk structure is broken or IEND is missing); JPEG ends after
+// the last EOI marker. Other containers report `size` unchanged.
+size_t EncodedImageLength(const uint8_t* data, size_t size);
+
+// Usual file extension including the dot (e.g. L".png"); empty for Unknown.
+const wchar_t* ImageContainerExtension(ImageContainer container);
+
+} // namespace ptf_helper
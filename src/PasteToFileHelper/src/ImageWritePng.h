@@ -4,16 +4,37 @@
 #include <vector>
 #include <windows.h>
 
+#include "ByteSink.h"
+#include "PngEncoder.h"
+
+#include "PasteToFileCommon/NameTemplate.h"
+
 namespace ptf_helper {
 
-bool WritePngFileUniqueFromHbitmap(const std::wstring& targetDir,
-                                   HBITMAP hbm,
-                                   std::wstring* outPath);
+// Encoder settings used by the PNG writers below. Defaults to PngEncodeOptions{}.
+void SetPngEncodeOptions(const PngEncodeOptions& options);
+
+// The writers keep one PNG encoder (buffers, deflate state, worker threads)
+// and one WIC factory for the whole run. Releases them; call before COM is
+// uninitialized.
+void EndPngWriteSession();
+
+// Encodes pixels in place (e.g. a locked clipboard DIB) without copying them.
+bool WritePngFileUniqueFromPixels(const std::wstring& targetDir, const PixelSource& source,
+                                  std::wstring* outPath);
+
+// Encodes an image read in bands of `bandRows` rows (see PixelBandReader).
+bool WritePngFileUniqueFromBands(const std::wstring& targetDir, PixelBandReader* reader,
+                                 uint32_t bandRows, std::wstring* outPath);
+
+// Decodes encoded image bytes (png/jpg/gif/...) via WIC and encodes a PNG into
+// `sink`. Like the writers, not thread-safe: it uses the run's shared encoder.
+bool EncodePngFromEncodedImageBytes(const std::vector<uint8_t>& bytes, ByteSink* sink);
 
 // Decodes the provided encoded image bytes (png/jpg/gif/...) via WIC and writes a PNG.
-// Uses an explicit base file name (without extension).
-bool WritePngFileUniqueFromEncodedImageBytesWithBase(const std::wstring& targetDir,
-                                                     const std::wstring& baseName,
+// Named from explicit fields (see ptf::NameTemplate).
+bool WritePngFileUniqueFromEncodedImageBytesWithName(const std::wstring& targetDir,
+                                                     const ptf::NameFields& name,
                                                      const std::vector<uint8_t>& bytes,
                                                      std::wstring* outPath);
 
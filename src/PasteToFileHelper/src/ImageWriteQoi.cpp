@@ -0,0 +1,26 @@
+#include "ImageWriteQoi.h"
+
+#include <windows.h>
+
+#include "FileSink.h"
+#include "QoiEncoder.h"
+
+#include "PasteToFileCommon/Filename.h"
+
+namespace ptf_helper {
+
+bool WriteQoiFileUniqueFromPixels(const std::wstring& targetDir, const PixelSource& source,
+                                  std::wstring* outPath) {
+  return WriteStreamFileUniqueWithName(
+      targetDir, ptf::CurrentNameFields(), L".qoi",
+      [&](ByteSink* sink) { return EncodeQoi(source, sink); }, outPath);
+}
+
+bool WriteQoiFileUniqueFromBands(const std::wstring& targetDir, PixelBandReader* reader,
+                                 uint32_t bandRows, std::wstring* outPath) {
+  return WriteStreamFileUniqueWithName(
+      targetDir, ptf::CurrentNameFields(), L".qoi",
+      [&](ByteSink* sink) { return EncodeQoiBands(reader, bandRows, sink); }, outPath);
+}
+
+} // namespace ptf_helper
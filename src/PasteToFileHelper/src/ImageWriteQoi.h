@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include "PixelSource.h"
+
+namespace ptf_helper {
+
+// Encodes pixels in place (e.g. a locked clipboard DIB) as a QOI file named
+// like the PNG output. Trades file size for much lower encode latency.
+bool WriteQoiFileUniqueFromPixels(const std::wstring& targetDir, const PixelSource& source,
+                                  std::wstring* outPath);
+
+// Encodes an image read in bands of `bandRows` rows (see PixelBandReader).
+bool WriteQoiFileUniqueFromBands(const std::wstring& targetDir, PixelBandReader* reader,
+                                 uint32_t bandRows, std::wstring* outPath);
+
+} // namespace ptf_helper
@@ -0,0 +1,312 @@
+#include "Inflate.h"
+
+#include <cstring>
+
+#include "Deflate.h"
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr int kMaxBits = 15;
+constexpr int kFastBits = 10;  // codes up to this length resolve with one lookup
+constexpr int kNumLitLen = 288;
+constexpr int kNumDist = 32;
+constexpr int kNumCodeLen = 19;
+
+constexpr uint16_t kLenBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,
+                                   15, 17, 19, 23, 27, 31, 35, 43, 51,  59,
+                                   67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLenExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                   2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,
+                                    17,   25,   33,   49,   65,   97,    129,   193,
+                                    257,  385,  513,  769,  1025, 1537,  2049,  3073,
+                                    4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,  4,  4,  5,  5,  6,
+                                    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr uint8_t kCodeLenOrder[kNumCodeLen] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                                11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+// Canonical Huffman code: a direct table for short codes, and per-length
+// counts for walking longer ones bit by bit.
+struct Huffman {
+  uint16_t fast[1 << kFastBits];  // symbol | length << 9; 0 = longer code
+  uint16_t count[kMaxBits + 1];
+  uint16_t symbol[kNumLitLen];
+
+  // Fails for over-subscribed codes; incomplete ones are allowed (RFC 1951
+  // permits a single distance code).
+  bool Build(const uint8_t* lengths, int n) {
+    std::memset(count, 0, sizeof(count));
+    for (int i = 0; i < n; i++) count[lengths[i]]++;
+    count[0] = 0;
+    int left = 1;
+    for (int len = 1; len <= kMaxBits; len++) {
+      left = (left << 1) - count[len];
+      if (left < 0) return false;
+    }
+
+    uint16_t offsets[kMaxBits + 2];
+    offsets[1] = 0;
+    for (int len = 1; len <= kMaxBits; len++) offsets[len + 1] = offsets[len] + count[len];
+    for (int i = 0; i < n; i++) {
+      if (lengths[i]) symbol[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+    }
+
+    std::memset(fast, 0, sizeof(fast));
+    uint32_t code = 0;
+    int index = 0;
+    for (int len = 1; len <= kFastBits; len++) {
+      for (int k = 0; k < count[len]; k++, code++, index++) {
+        // Deflate sends codes most significant bit first into an LSB-first
+        // stream, so the table is indexed by the bit-reversed code.
+        uint32_t reversed = 0;
+        for (int b = 0; b < len; b++) reversed |= ((code >> b) & 1u) << (len - 1 - b);
+        const uint16_t entry = static_cast<uint16_t>(symbol[index] | (len << 9));
+        for (uint32_t fill = reversed; fill < (1u << kFastBits); fill += 1u << len) {
+          fast[fill] = entry;
+        }
+      }
+      code <<= 1;
+    }
+    return true;
+  }
+};
+
+class Inflater {
+ public:
+  Inflater(const uint8_t* data, size_t size, size_t maxOutput, std::vector<uint8_t>* out)
+      : data_(data), size_(size), maxOutput_(maxOutput), out_(out) {}
+
+  bool Run() {
+    bool last = false;
+    while (!last) {
+      uint32_t header = 0;
+      if (!Bits(3, &header)) return false;
+      last = (header & 1) != 0;
+      bool ok = false;
+      switch (header >> 1) {
+        case 0: ok = Stored(); break;
+        case 1: ok = Fixed(); break;
+        case 2: ok = Dynamic(); break;
+        default: return false;
+      }
+      if (!ok) return false;
+    }
+    return true;
+  }
+
+  // Input bytes used, after returning the whole bytes still in the bit buffer.
+  size_t Consumed() const { return pos_ - bitCount_ / 8; }
+
+ private:
+  void Refill() {
+    while (bitCount_ <= 56 && pos_ < size_) {
+      bitBuf_ |= static_cast<uint64_t>(data_[pos_++]) << bitCount_;
+      bitCount_ += 8;
+    }
+  }
+
+  bool Bits(int n, uint32_t* value) {
+    if (bitCount_ < n) Refill();
+    if (bitCount_ < n) return false;
+    *value = static_cast<uint32_t>(bitBuf_ & ((1ull << n) - 1));
+    bitBuf_ >>= n;
+    bitCount_ -= n;
+    return true;
+  }
+
+  bool Decode(const Huffman& h, int* symbol) {
+    if (bitCount_ < kMaxBits) Refill();
+    const uint16_t entry = h.fast[bitBuf_ & ((1u << kFastBits) - 1)];
+    if (entry) {
+      const int len = entry >> 9;
+      if (len > bitCount_) return false;
+      bitBuf_ >>= len;
+      bitCount_ -= len;
+      *symbol = entry & 0x1FF;
+      return true;
+    }
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int len = 1; len <= kMaxBits && len <= bitCount_; len++) {
+      code |= static_cast<int>((bitBuf_ >> (len - 1)) & 1);
+      const int count = h.count[len];
+      if (code - first < count) {
+        bitBuf_ >>= len;
+        bitCount_ -= len;
+        *symbol = h.symbol[index + code - first];
+        return true;
+      }
+      index += count;
+      first = (first + count) << 1;
+      code <<= 1;
+    }
+    return false;
+  }
+
+  bool Stored() {
+    // Skip to the byte boundary, then hand back whole bytes still buffered.
+    bitBuf_ >>= bitCount_ & 7;
+    bitCount_ -= bitCount_ & 7;
+    pos_ -= bitCount_ / 8;
+    bitBuf_ = 0;
+    bitCount_ = 0;
+    if (size_ - pos_ < 4) return false;
+    const uint32_t len = data_[pos_] | (data_[pos_ + 1] << 8);
+    const uint32_t nlen = data_[pos_ + 2] | (data_[pos_ + 3] << 8);
+    pos_ += 4;
+    if ((len ^ 0xFFFF) != nlen || size_ - pos_ < len) return false;
+    if (len > maxOutput_ - out_->size()) return false;
+    out_->insert(out_->end(), data_ + pos_, data_ + pos_ + len);
+    pos_ += len;
+    return true;
+  }
+
+  bool Fixed() {
+    static const struct FixedCodes {
+      Huffman litLen;
+      Huffman dist;
+      FixedCodes() {
+        uint8_t lengths[kNumLitLen];
+        int i = 0;
+        for (; i < 144; i++) lengths[i] = 8;
+        for (; i < 256; i++) lengths[i] = 9;
+        for (; i < 280; i++) lengths[i] = 7;
+        for (; i < kNumLitLen; i++) lengths[i] = 8;
+        litLen.Build(lengths, kNumLitLen);
+        for (i = 0; i < 30; i++) lengths[i] = 5;
+        dist.Build(lengths, 30);
+      }
+    } codes;
+    return Codes(codes.litLen, codes.dist);
+  }
+
+  bool Dynamic() {
+    uint32_t nlen = 0;
+    uint32_t ndist = 0;
+    uint32_t ncode = 0;
+    if (!Bits(5, &nlen) || !Bits(5, &ndist) || !Bits(4, &ncode)) return false;
+    nlen += 257;
+    ndist += 1;
+    ncode += 4;
+    if (nlen > 286 || ndist > 30) return false;
+
+    uint8_t lengths[kNumLitLen + kNumDist] = {};
+    for (uint32_t i = 0; i < ncode; i++) {
+      uint32_t len = 0;
+      if (!Bits(3, &len)) return false;
+      lengths[kCodeLenOrder[i]] = static_cast<uint8_t>(len);
+    }
+    Huffman codeLen;
+    if (!codeLen.Build(lengths, kNumCodeLen)) return false;
+
+    std::memset(lengths, 0, sizeof(lengths));
+    uint32_t index = 0;
+    while (index < nlen + ndist) {
+      int symbol = 0;
+      if (!Decode(codeLen, &symbol)) return false;
+      if (symbol < 16) {
+        lengths[index++] = static_cast<uint8_t>(symbol);
+        continue;
+      }
+      uint8_t value = 0;
+      uint32_t repeat = 0;
+      if (symbol == 16) {
+        if (index == 0 || !Bits(2, &repeat)) return false;
+        value = lengths[index - 1];
+        repeat += 3;
+      } else if (symbol == 17) {
+        if (!Bits(3, &repeat)) return false;
+        repeat += 3;
+      } else {
+        if (!Bits(7, &repeat)) return false;
+        repeat += 11;
+      }
+      if (index + repeat > nlen + ndist) return false;
+      while (repeat--) lengths[index++] = value;
+    }
+    if (lengths[256] == 0) return false;  // no end-of-block code
+
+    Huffman litLen;
+    Huffman dist;
+    if (!litLen.Build(lengths, static_cast<int>(nlen))) return false;
+    if (!dist.Build(lengths + nlen, static_cast<int>(ndist))) return false;
+    return Codes(litLen, dist);
+  }
+
+  bool Codes(const Huffman& litLen, const Huffman& dist) {
+    std::vector<uint8_t>& out = *out_;
+    for (;;) {
+      int symbol = 0;
+      if (!Decode(litLen, &symbol)) return false;
+      if (symbol < 256) {
+        if (out.size() >= maxOutput_) return false;
+        out.push_back(static_cast<uint8_t>(symbol));
+        continue;
+      }
+      if (symbol == 256) return true;
+      symbol -= 257;
+      if (symbol >= 29) return false;
+      uint32_t extra = 0;
+      if (!Bits(kLenExtra[symbol], &extra)) return false;
+      const size_t length = kLenBase[symbol] + extra;
+
+      if (!Decode(dist, &symbol) || symbol >= 30) return false;
+      if (!Bits(kDistExtra[symbol], &extra)) return false;
+      const size_t distance = kDistBase[symbol] + extra;
+      if (distance > out.size() || length > maxOutput_ - out.size()) return false;
+
+      const size_t from = out.size() - distance;
+      const size_t to = out.size();
+      out.resize(to + length);
+      uint8_t* p = out.data();
+      if (distance >= length) {
+        std::memcpy(p + to, p + from, length);
+      } else {
+        for (size_t i = 0; i < length; i++) p[to + i] = p[from + i];  // overlapping run
+      }
+    }
+  }
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_ = 0;
+  uint64_t bitBuf_ = 0;
+  int bitCount_ = 0;
+  size_t maxOutput_;
+  std::vector<uint8_t>* out_;
+};
+
+} // namespace
+
+bool InflateRaw(const uint8_t* data, size_t size, size_t maxOutput, std::vector<uint8_t>* out,
+                size_t* consumed) {
+  Inflater inflater(data, size, maxOutput, out);
+  if (!inflater.Run()) return false;
+  if (consumed) *consumed = inflater.Consumed();
+  return true;
+}
+
+bool ZlibDecompress(const uint8_t* data, size_t size, size_t maxOutput,
+                    std::vector<uint8_t>* out) {
+  if (size < 6) return false;
+  // CM 8 (deflate), window <= 32 KiB, header checksum, no preset dictionary.
+  if ((data[0] & 0x0F) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 != 0 ||
+      (data[1] & 0x20) != 0) {
+    return false;
+  }
+  const size_t start = out->size();
+  size_t consumed = 0;
+  if (!InflateRaw(data + 2, size - 2, maxOutput, out, &consumed)) return false;
+  const size_t trailer = 2 + consumed;
+  if (size - trailer < 4) return false;
+  const uint32_t expected = (static_cast<uint32_t>(data[trailer]) << 24) |
+                            (static_cast<uint32_t>(data[trailer + 1]) << 16) |
+                            (static_cast<uint32_t>(data[trailer + 2]) << 8) | data[trailer + 3];
+  return Adler32Update(1, out->data() + start, out->size() - start) == expected;
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// DEFLATE (RFC 1951) decompressor, the counterpart of Deflate.h. Portable (no
+// Windows headers). Used to re-read PNGs the helper has written.
+
+namespace ptf_helper {
+
+// Decompresses a raw deflate stream, appending to `out`. Fails on malformed
+// input, on a stream that ends early, and before `out` would grow past
+// `maxOutput` bytes. `consumed` (optional) receives the input bytes used.
+bool InflateRaw(const uint8_t* data, size_t size, size_t maxOutput, std::vector<uint8_t>* out,
+                size_t* consumed = nullptr);
+
+// Decompresses a zlib (RFC 1950) stream and checks its Adler-32 trailer.
+bool ZlibDecompress(const uint8_t* data, size_t size, size_t maxOutput,
+                    std::vector<uint8_t>* out);
+
+} // namespace ptf_helper
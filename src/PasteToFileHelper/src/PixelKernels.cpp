@@ -0,0 +1,582 @@
+#include "PixelKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PTF_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PTF_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define PTF_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define PTF_KERNELS_X86 0
+#endif
+
+namespace ptf_helper {
+
+namespace {
+
+inline uint8_t PaethPredictor(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = std::abs(p - a);
+  int pb = std::abs(p - b);
+  int pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+  if (pb <= pc) return static_cast<uint8_t>(b);
+  return static_cast<uint8_t>(c);
+}
+
+// ---------------------------------------------------------------------------
+// Scalar reference. The vector versions call these for heads and tails.
+
+namespace scalar {
+
+void SwapRedBlue32(const uint8_t* src, uint8_t* dst, size_t pixels) {
+  for (size_t i = 0; i < pixels; i++, src += 4, dst += 4) {
+    uint8_t b = src[0];
+    uint8_t g = src[1];
+    uint8_t r = src[2];
+    uint8_t a = src[3];
+    dst[0] = r;
+    dst[1] = g;
+    dst[2] = b;
+    dst[3] = a;
+  }
+}
+
+void Bgrx32ToRgb24(const uint8_t* src, uint8_t* dst, size_t pixels) {
+  for (size_t i = 0; i < pixels; i++, src += 4, dst += 3) {
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+  }
+}
+
+void SwapRedBlue24(const uint8_t* src, uint8_t* dst, size_t pixels) {
+  for (size_t i = 0; i < pixels; i++, src += 3, dst += 3) {
+    uint8_t b = src[0];
+    uint8_t g = src[1];
+    uint8_t r = src[2];
+    dst[0] = r;
+    dst[1] = g;
+    dst[2] = b;
+  }
+}
+
+bool AnyAlpha32(const uint8_t* p, size_t pixels) {
+  for (size_t i = 0; i < pixels; i++) {
+    if (p[i * 4 + 3] != 0) return true;
+  }
+  return false;
+}
+
+void ScanOpaqueGray32(const uint8_t* p, size_t pixels, bool* allOpaque, bool* allGray) {
+  bool opaque = *allOpaque;
+  bool gray = *allGray;
+  for (size_t i = 0; i < pixels && (opaque || gray); i++, p += 4) {
+    opaque = opaque && p[3] == 0xFF;
+    gray = gray && p[0] == p[1] && p[1] == p[2];
+  }
+  *allOpaque = opaque;
+  *allGray = gray;
+}
+
+void FilterSub(const uint8_t* cur, size_t begin, size_t n, size_t bpp, uint8_t* out) {
+  for (size_t i = begin; i < n; i++) {
+    out[i] = static_cast<uint8_t>(cur[i] - (i >= bpp ? cur[i - bpp] : 0));
+  }
+}
+
+void FilterUp(const uint8_t* cur, const uint8_t* prev, size_t begin, size_t n, uint8_t* out) {
+  for (size_t i = begin; i < n; i++) out[i] = static_cast<uint8_t>(cur[i] - prev[i]);
+}
+
+void FilterAverage(const uint8_t* cur, const uint8_t* prev, size_t begin, size_t n,
+                   size_t bpp, uint8_t* out) {
+  for (size_t i = begin; i < n; i++) {
+    int left = i >= bpp ? cur[i - bpp] : 0;
+    out[i] = static_cast<uint8_t>(cur[i] - ((left + prev[i]) >> 1));
+  }
+}
+
+void FilterPaeth(const uint8_t* cur, const uint8_t* prev, size_t begin, size_t n, size_t bpp,
+                 uint8_t* out) {
+  for (size_t i = begin; i < n; i++) {
+    int left = i >= bpp ? cur[i - bpp] : 0;
+    int upLeft = i >= bpp ? prev[i - bpp] : 0;
+    out[i] = static_cast<uint8_t>(cur[i] - PaethPredictor(left, prev[i], upLeft));
+  }
+}
+
+uint64_t SumAbsSigned(const uint8_t* p, size_t n) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < n; i++) sum += p[i] < 128 ? p[i] : 256 - p[i];
+  return sum;
+}
+
+} // namespace scalar
+
+#if PTF_KERNELS_X86
+
+// ---------------------------------------------------------------------------
+// SSE2 (baseline on x64).
+
+namespace sse2 {
+
+void SwapRedBlue32(const uint8_t* src, uint8_t* dst, size_t pixels) {
+  const __m128i keep = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+  const __m128i low = _mm_set1_epi32(0x000000FF);
+  const __m128i high = _mm_set1_epi32(0x00FF0000);
+  size_t i = 0;
+  for (; i + 4 <= pixels; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+    __m128i r = _mm_or_si128(_mm_and_si128(v, keep),
+                             _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), low),
+                                          _mm_and_si128(_mm_slli_epi32(v, 16), high)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), r);
+  }
+  scalar::SwapRedBlue32(src + i * 4, dst + i * 4, pixels - i);
+}
+
+void FilterSub(const uint8_t* cur, size_t n, size_t bpp, uint8_t* out) {
+  size_t i = std::min(bpp, n);
+  scalar::FilterSub(cur, 0, i, bpp, out);
+  for (; i + 16 <= n; i += 16) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i - bpp));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_sub_epi8(c, a));
+  }
+  scalar::FilterSub(cur, i, n, bpp, out);
+}
+
+void FilterUp(const uint8_t* cur, const uint8_t* prev, size_t n, uint8_t* out) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_sub_epi8(c, b));
+  }
+  scalar::FilterUp(cur, prev, i, n, out);
+}
+
+void FilterAverage(const uint8_t* cur, const uint8_t* prev, size_t n, size_t bpp,
+                   uint8_t* out) {
+  size_t i = std::min(bpp, n);
+  scalar::FilterAverage(cur, prev, 0, i, bpp, out);
+  const __m128i one = _mm_set1_epi8(1);
+  for (; i + 16 <= n; i += 16) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i));
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + i - bpp));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+    // _mm_avg_epu8 rounds up; subtract the carry bit to get floor((a + b) / 2).
+    __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_sub_epi8(c, avg));
+  }
+  scalar::FilterAverage(cur, prev, i, n, bpp, out);
+}
+
+inline __m128i Abs16(__m128i v) { return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v)); }
+
+void FilterPaeth(const uint8_t* cur, const uint8_t* prev, size_t n, size_t bpp,
+                 uint8_t* out) {
+  size_t i = std::min(bpp, n);
+  scalar::FilterPaeth(cur, prev, 0, i, bpp, out);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lowByte = _mm_set1_epi16(0x00FF);
+  for (; i + 8 <= n; i += 8) {
+    auto load8 = [&](const uint8_t* p) {
+      return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+    };
+    __m128i x = load8(cur + i);
+    __m128i a = load8(cur + i - bpp);
+    __m128i b = load8(prev + i);
+    __m128i c = load8(prev + i - bpp);
+    __m128i pa = Abs16(_mm_sub_epi16(b, c));
+    __m128i pb = Abs16(_mm_sub_epi16(a, c));
+    __m128i pc = Abs16(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+    __m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    __m128i useC = _mm_cmpgt_epi16(pb, pc);
+    __m128i bc = _mm_or_si128(_mm_and_si128(useC, c), _mm_andnot_si128(useC, b));
+    __m128i pred = _mm_or_si128(_mm_and_si128(notA, bc), _mm_andnot_si128(notA, a));
+    __m128i r = _mm_and_si128(_mm_sub_epi16(x, pred), lowByte);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(r, r));
+  }
+  scalar::FilterPaeth(cur, prev, i, n, bpp, out);
+}
+
+uint64_t SumAbsSigned(const uint8_t* p, size_t n) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = zero;
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    // min(v, -v) as unsigned bytes is |v| for v interpreted as int8.
+    __m128i m = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(m, zero));
+  }
+  alignas(16) uint64_t lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+  return lanes[0] + lanes[1] + scalar::SumAbsSigned(p + i, n - i);
+}
+
+bool AnyAlpha32(const uint8_t* p, size_t pixels) {
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  // OR 64 pixels together between tests so the common "all zero" case stays
+  // a straight streaming loop.
+  for (; i + 64 <= pixels; i += 64) {
+    __m128i acc = zero;
+    for (size_t k = 0; k < 64; k += 4) {
+      acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + (i + k) * 4)));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(acc, alpha), zero)) != 0xFFFF) return true;
+  }
+  return scalar::AnyAlpha32(p + i * 4, pixels - i);
+}
+
+void ScanOpaqueGray32(const uint8_t* p, size_t pixels, bool* allOpaque, bool* allGray) {
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+  const __m128i colorPairs = _mm_set1_epi32(0x0000FFFF);
+  __m128i notOpaque = _mm_setzero_si128();
+  __m128i notGray = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 4 <= pixels; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 4));
+    notOpaque = _mm_or_si128(notOpaque, _mm_andnot_si128(v, alpha));
+    // Bytes 0/1 of (v ^ v >> 8) are c0^c1 and c1^c2: zero only when all equal.
+    __m128i pairs = _mm_xor_si128(v, _mm_srli_epi32(v, 8));
+    notGray = _mm_or_si128(notGray, _mm_and_si128(pairs, colorPairs));
+  }
+  const __m128i zero = _mm_setzero_si128();
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(notOpaque, zero)) != 0xFFFF) *allOpaque = false;
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(notGray, zero)) != 0xFFFF) *allGray = false;
+  scalar::ScanOpaqueGray32(p + i * 4, pixels - i, allOpaque, allGray);
+}
+
+} // namespace sse2
+
+// ---------------------------------------------------------------------------
+// AVX2.
+
+namespace avx2 {
+
+PTF_TARGET_AVX2 void SwapRedBlue32(const uint8_t* src, uint8_t* dst, size_t pixels) {
+  const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  size_t i = 0;
+  for (; i + 8 <= pixels; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(v, mask));
+  }
+  scalar::SwapRedBlue32(src + i * 4, dst + i * 4, pixels - i);
+}
+
+PTF_TARGET_AVX2 void Bgrx32ToRgb24(const uint8_t* src, uint8_t* dst, size_t pixels) {
+  const __m256i mask =
+      _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                       2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  size_t i = 0;
+  // Each iteration stores 28 bytes for 24 bytes of output, so stop while at
+  // least two more pixels remain to absorb the overhang.
+  for (; i + 10 <= pixels; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+    __m256i s = _mm256_shuffle_epi8(v, mask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3), _mm256_castsi256_si128(s));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3 + 12),
+                     _mm256_extracti128_si256(s, 1));
+  }
+  scalar::Bgrx32ToRgb24(src + i * 4, dst + i * 3, pixels - i);
+}
+
+PTF_TARGET_AVX2 void FilterSub(const uint8_t* cur, size_t n, size_t bpp, uint8_t* out) {
+  size_t i = std::min(bpp, n);
+  scalar::FilterSub(cur, 0, i, bpp, out);
+  for (; i + 32 <= n; i += 32) {
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + i));
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + i - bpp));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_sub_epi8(c, a));
+  }
+  scalar::FilterSub(cur, i, n, bpp, out);
+}
+
+PTF_TARGET_AVX2 void FilterUp(const uint8_t* cur, const uint8_t* prev, size_t n,
+                              uint8_t* out) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_sub_epi8(c, b));
+  }
+  scalar::FilterUp(cur, prev, i, n, out);
+}
+
+PTF_TARGET_AVX2 void FilterAverage(const uint8_t* cur, const uint8_t* prev, size_t n,
+                                   size_t bpp, uint8_t* out) {
+  size_t i = std::min(bpp, n);
+  scalar::FilterAverage(cur, prev, 0, i, bpp, out);
+  const __m256i one = _mm256_set1_epi8(1);
+  for (; i + 32 <= n; i += 32) {
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + i));
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cur + i - bpp));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i));
+    __m256i avg =
+        _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), one));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_sub_epi8(c, avg));
+  }
+  scalar::FilterAverage(cur, prev, i, n, bpp, out);
+}
+
+PTF_TARGET_AVX2 inline __m256i Load16Widened(const uint8_t* p) {
+  return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+PTF_TARGET_AVX2 void FilterPaeth(const uint8_t* cur, const uint8_t* prev, size_t n,
+                                 size_t bpp, uint8_t* out) {
+  size_t i = std::min(bpp, n);
+  scalar::FilterPaeth(cur, prev, 0, i, bpp, out);
+  const __m256i lowByte = _mm256_set1_epi16(0x00FF);
+  for (; i + 16 <= n; i += 16) {
+    __m256i x = Load16Widened(cur + i);
+    __m256i a = Load16Widened(cur + i - bpp);
+    __m256i b = Load16Widened(prev + i);
+    __m256i c = Load16Widened(prev + i - bpp);
+    __m256i pa = _mm256_abs_epi16(_mm256_sub_epi16(b, c));
+    __m256i pb = _mm256_abs_epi16(_mm256_sub_epi16(a, c));
+    __m256i pc = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_add_epi16(a, b), _mm256_add_epi16(c, c)));
+    __m256i notA = _mm256_or_si256(_mm256_cmpgt_epi16(pa, pb), _mm256_cmpgt_epi16(pa, pc));
+    __m256i useC = _mm256_cmpgt_epi16(pb, pc);
+    __m256i bc = _mm256_blendv_epi8(b, c, useC);
+    __m256i pred = _mm256_blendv_epi8(a, bc, notA);
+    __m256i r = _mm256_and_si256(_mm256_sub_epi16(x, pred), lowByte);
+    // packus works per 128-bit lane; gather the two low quadwords.
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, r), 0xD8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(packed));
+  }
+  scalar::FilterPaeth(cur, prev, i, n, bpp, out);
+}
+
+PTF_TARGET_AVX2 uint64_t SumAbsSigned(const uint8_t* p, size_t n) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc = zero;
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    __m256i m = _mm256_min_epu8(v, _mm256_sub_epi8(zero, v));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(m, zero));
+  }
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalar::SumAbsSigned(p + i, n - i);
+}
+
+} // namespace avx2
+
+#endif // PTF_KERNELS_X86
+
+KernelIsa DetectIsaUncached() {
+#if PTF_KERNELS_X86
+  unsigned int regs1[4]{};
+  unsigned int regs7[4]{};
+#if defined(_MSC_VER)
+  int r[4];
+  __cpuid(r, 0);
+  int maxLeaf = r[0];
+  __cpuid(r, 1);
+  for (int k = 0; k < 4; k++) regs1[k] = static_cast<unsigned int>(r[k]);
+  if (maxLeaf >= 7) {
+    __cpuidex(r, 7, 0);
+    for (int k = 0; k < 4; k++) regs7[k] = static_cast<unsigned int>(r[k]);
+  }
+#else
+  unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+  __get_cpuid(1, &regs1[0], &regs1[1], &regs1[2], &regs1[3]);
+  if (maxLeaf >= 7) __get_cpuid_count(7, 0, &regs7[0], &regs7[1], &regs7[2], &regs7[3]);
+#endif
+  const bool sse2 = (regs1[3] & (1u << 26)) != 0;
+  const bool osxsave = (regs1[2] & (1u << 27)) != 0;
+  const bool avx = (regs1[2] & (1u << 28)) != 0;
+  const bool avx2 = (regs7[1] & (1u << 5)) != 0;
+  if (osxsave && avx && avx2) {
+    // The OS must save YMM state across context switches.
+#if defined(_MSC_VER)
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int lo = 0;
+    unsigned int hi = 0;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    unsigned long long xcr0 = (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+    if ((xcr0 & 6) == 6) return KernelIsa::Avx2;
+  }
+  if (sse2) return KernelIsa::Sse2;
+#endif
+  return KernelIsa::Scalar;
+}
+
+std::atomic<int>& ActiveIsa() {
+  static std::atomic<int> isa{static_cast<int>(DetectKernelIsa())};
+  return isa;
+}
+
+inline KernelIsa Isa() {
+  return static_cast<KernelIsa>(ActiveIsa().load(std::memory_order_relaxed));
+}
+
+} // namespace
+
+KernelIsa DetectKernelIsa() {
+  static const KernelIsa detected = DetectIsaUncached();
+  return detected;
+}
+
+KernelIsa GetKernelIsa() { return Isa(); }
+
+void SetKernelIsa(KernelIsa isa) {
+  int wanted = std::min(static_cast<int>(isa), static_cast<int>(DetectKernelIsa()));
+  ActiveIsa().store(wanted, std::memory_order_relaxed);
+}
+
+void SwapRedBlue32(const uint8_t* src, uint8_t* dst, size_t pixels) {
+#if PTF_KERNELS_X86
+  switch (Isa()) {
+    case KernelIsa::Avx2: return avx2::SwapRedBlue32(src, dst, pixels);
+    case KernelIsa::Sse2: return sse2::SwapRedBlue32(src, dst, pixels);
+    case KernelIsa::Scalar: break;
+  }
+#endif
+  scalar::SwapRedBlue32(src, dst, pixels);
+}
+
+void Bgrx32ToRgb24(const uint8_t* src, uint8_t* dst, size_t pixels) {
+#if PTF_KERNELS_X86
+  // Packing 4 -> 3 bytes needs a byte shuffle, which SSE2 lacks.
+  if (Isa() == KernelIsa::Avx2) return avx2::Bgrx32ToRgb24(src, dst, pixels);
+#endif
+  scalar::Bgrx32ToRgb24(src, dst, pixels);
+}
+
+void SwapRedBlue24(const uint8_t* src, uint8_t* dst, size_t pixels) {
+  scalar::SwapRedBlue24(src, dst, pixels);
+}
+
+bool AnyAlpha32(const uint8_t* p, size_t pixels) {
+#if PTF_KERNELS_X86
+  // Memory bound; SSE2 already saturates bandwidth.
+  if (Isa() != KernelIsa::Scalar) return sse2::AnyAlpha32(p, pixels);
+#endif
+  return scalar::AnyAlpha32(p, pixels);
+}
+
+void ScanOpaqueGray32(const uint8_t* p, size_t pixels, bool* allOpaque, bool* allGray) {
+#if PTF_KERNELS_X86
+  if (Isa() != KernelIsa::Scalar) return sse2::ScanOpaqueGray32(p, pixels, allOpaque, allGray);
+#endif
+  scalar::ScanOpaqueGray32(p, pixels, allOpaque, allGray);
+}
+
+void FlipRowsInPlace(uint8_t* pixels, size_t stride, size_t rows) {
+  // memcpy is already vectorized by the CRT; swap through a small buffer.
+  uint8_t tmp[4096];
+  for (size_t top = 0, bottom = rows ? rows - 1 : 0; top < bottom; top++, bottom--) {
+    uint8_t* a = pixels + top * stride;
+    uint8_t* b = pixels + bottom * stride;
+    for (size_t off = 0; off < stride; off += sizeof(tmp)) {
+      size_t n = std::min(sizeof(tmp), stride - off);
+      std::memcpy(tmp, a + off, n);
+      std::memcpy(a + off, b + off, n);
+      std::memcpy(b + off, tmp, n);
+    }
+  }
+}
+
+void PngFilterSub(const uint8_t* cur, size_t n, size_t bpp, uint8_t* out) {
+#if PTF_KERNELS_X86
+  switch (Isa()) {
+    case KernelIsa::Avx2: return avx2::FilterSub(cur, n, bpp, out);
+    case KernelIsa::Sse2: return sse2::FilterSub(cur, n, bpp, out);
+    case KernelIsa::Scalar: break;
+  }
+#endif
+  scalar::FilterSub(cur, 0, n, bpp, out);
+}
+
+void PngFilterUp(const uint8_t* cur, const uint8_t* prev, size_t n, uint8_t* out) {
+#if PTF_KERNELS_X86
+  switch (Isa()) {
+    case KernelIsa::Avx2: return avx2::FilterUp(cur, prev, n, out);
+    case KernelIsa::Sse2: return sse2::FilterUp(cur, prev, n, out);
+    case KernelIsa::Scalar: break;
+  }
+#endif
+  scalar::FilterUp(cur, prev, 0, n, out);
+}
+
+void PngFilterAverage(const uint8_t* cur, const uint8_t* prev, size_t n, size_t bpp,
+                      uint8_t* out) {
+#if PTF_KERNELS_X86
+  switch (Isa()) {
+    case KernelIsa::Avx2: return avx2::FilterAverage(cur, prev, n, bpp, out);
+    case KernelIsa::Sse2: return sse2::FilterAverage(cur, prev, n, bpp, out);
+    case KernelIsa::Scalar: break;
+  }
+#endif
+  scalar::FilterAverage(cur, prev, 0, n, bpp, out);
+}
+
+void PngFilterPaeth(const uint8_t* cur, const uint8_t* prev, size_t n, size_t bpp,
+                    uint8_t* out) {
+#if PTF_KERNELS_X86
+  switch (Isa()) {
+    case KernelIsa::Avx2: return avx2::FilterPaeth(cur, prev, n, bpp, out);
+    case KernelIsa::Sse2: return sse2::FilterPaeth(cur, prev, n, bpp, out);
+    case KernelIsa::Scalar: break;
+  }
+#endif
+  scalar::FilterPaeth(cur, prev, 0, n, bpp, out);
+}
+
+uint64_t SumAbsSigned(const uint8_t* p, size_t n) {
+#if PTF_KERNELS_X86
+  switch (Isa()) {
+    case KernelIsa::Avx2: return avx2::SumAbsSigned(p, n);
+    case KernelIsa::Sse2: return sse2::SumAbsSigned(p, n);
+    case KernelIsa::Scalar: break;
+  }
+#endif
+  return scalar::SumAbsSigned(p, n);
+}
+
+const uint8_t* PngFilterRowAdaptive(const uint8_t* cur, const uint8_t* prev, size_t n,
+                                    size_t bpp, uint8_t* scratch) {
+  uint8_t* slots[5];
+  for (int f = 0; f < 5; f++) {
+    slots[f] = scratch + f * (n + 1);
+    slots[f][0] = static_cast<uint8_t>(f);
+  }
+  std::memcpy(slots[0] + 1, cur, n);
+  PngFilterSub(cur, n, bpp, slots[1] + 1);
+  PngFilterUp(cur, prev, n, slots[2] + 1);
+  PngFilterAverage(cur, prev, n, bpp, slots[3] + 1);
+  PngFilterPaeth(cur, prev, n, bpp, slots[4] + 1);
+
+  int best = 0;
+  uint64_t bestSum = UINT64_MAX;
+  for (int f = 0; f < 5; f++) {
+    uint64_t s = SumAbsSigned(slots[f] + 1, n);
+    if (s < bestSum) {
+      bestSum = s;
+      best = f;
+    }
+  }
+  return slots[best];
+}
+
+} // namespace ptf_helper
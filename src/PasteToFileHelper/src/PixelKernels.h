@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Row kernels for preparing clipboard pixels for PNG encoding. Each kernel has a
+// scalar reference plus SSE2 and AVX2 versions on x86/x64, picked at runtime.
+// Portable (no Windows headers).
+
+namespace ptf_helper {
+
+enum class KernelIsa {
+  Scalar,
+  Sse2,
+  Avx2,
+};
+
+// Best instruction set supported by this CPU.
+KernelIsa DetectKernelIsa();
+
+// Kernel set in use. SetKernelIsa clamps to what the CPU supports; it exists so
+// the vector paths can be compared against the scalar reference.
+KernelIsa GetKernelIsa();
+void SetKernelIsa(KernelIsa isa);
+
+// BGRA <-> RGBA (swaps bytes 0 and 2 of every pixel). src may equal dst.
+void SwapRedBlue32(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+// BGRA/BGRX -> RGB (swizzle and drop the fourth byte).
+void Bgrx32ToRgb24(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+// BGR -> RGB. src may equal dst.
+void SwapRedBlue24(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+// True if any 32-bit pixel has a non-zero fourth (alpha) byte.
+bool AnyAlpha32(const uint8_t* p, size_t pixels);
+
+// Clears *allOpaque if any pixel's fourth byte is not 0xFF and *allGray if any
+// pixel's first three bytes differ. Never sets them, so it can run row by row.
+void ScanOpaqueGray32(const uint8_t* p, size_t pixels, bool* allOpaque, bool* allGray);
+
+// Reverses row order in place (bottom-up DIB -> top-down).
+void FlipRowsInPlace(uint8_t* pixels, size_t stride, size_t rows);
+
+// PNG filters (encode side). `prev` is the previous unfiltered row (all zero
+// for the first row); `bpp` is bytes per pixel; `out` receives n bytes.
+void PngFilterSub(const uint8_t* cur, size_t n, size_t bpp, uint8_t* out);
+void PngFilterUp(const uint8_t* cur, const uint8_t* prev, size_t n, uint8_t* out);
+void PngFilterAverage(const uint8_t* cur, const uint8_t* prev, size_t n, size_t bpp,
+                      uint8_t* out);
+void PngFilterPaeth(const uint8_t* cur, const uint8_t* prev, size_t n, size_t bpp,
+                    uint8_t* out);
+
+// Sum of bytes interpreted as signed magnitudes (the usual filter heuristic).
+uint64_t SumAbsSigned(const uint8_t* p, size_t n);
+
+// Applies all five PNG filters into `scratch` (5 slots of filter-type byte + n
+// bytes each) and returns the slot with the smallest SumAbsSigned.
+const uint8_t* PngFilterRowAdaptive(const uint8_t* cur, const uint8_t* prev, size_t n,
+                                    size_t bpp, uint8_t* scratch);
+
+} // namespace ptf_helper
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Descriptions of caller pixel memory. Portable (no Windows headers).
+
+namespace ptf_helper {
+
+// Layout of the caller's input rows (8 bits per channel).
+enum class PixelFormat {
+  Bgra8,
+  Bgrx8,  // 32-bit BGR, alpha byte ignored (treated as opaque)
+  Rgba8,
+  Bgr8,
+  Rgb8,
+};
+
+inline size_t BytesPerPixel(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::Bgra8:
+    case PixelFormat::Bgrx8:
+    case PixelFormat::Rgba8:
+      return 4;
+    case PixelFormat::Bgr8:
+    case PixelFormat::Rgb8:
+      return 3;
+  }
+  return 4;
+}
+
+inline bool HasAlphaChannel(PixelFormat format) {
+  return format == PixelFormat::Bgra8 || format == PixelFormat::Rgba8;
+}
+
+// Packs one input pixel as 0xAARRGGBB (alpha 0xFF for formats without alpha).
+inline uint32_t PackArgb(const uint8_t* p, PixelFormat format) {
+  switch (format) {
+    case PixelFormat::Bgra8:
+      return (static_cast<uint32_t>(p[3]) << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+    case PixelFormat::Bgrx8:
+    case PixelFormat::Bgr8:
+      return 0xFF000000u | (p[2] << 16) | (p[1] << 8) | p[0];
+    case PixelFormat::Rgba8:
+      return (static_cast<uint32_t>(p[3]) << 24) | (p[0] << 16) | (p[1] << 8) | p[2];
+    case PixelFormat::Rgb8:
+      return 0xFF000000u | (p[0] << 16) | (p[1] << 8) | p[2];
+  }
+  return 0;
+}
+
+// Pixels that already sit in memory (for example a locked clipboard DIB),
+// described in place so they can be encoded without a copy.
+struct PixelSource {
+  const uint8_t* pixels = nullptr;  // first row in memory order
+  size_t stride = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  PixelFormat format = PixelFormat::Bgra8;
+  bool bottomUp = false;  // memory holds the bottom row first (usual for DIBs)
+
+  // Row `y` counted from the top of the image.
+  const uint8_t* Row(uint32_t y) const {
+    return pixels + static_cast<size_t>(bottomUp ? height - 1 - y : y) * stride;
+  }
+};
+
+// An image that is not held in memory as a whole (for example a GDI bitmap),
+// read as horizontal bands of rows so only one band is resident at a time.
+class PixelBandReader {
+ public:
+  virtual ~PixelBandReader() = default;
+
+  virtual uint32_t Width() const = 0;
+  virtual uint32_t Height() const = 0;
+  virtual PixelFormat Format() const = 0;
+
+  // Describes rows [y, y + rows), counted from the top, in `band` (whose
+  // height is `rows`). The memory stays valid until the next call. Bands may
+  // be read more than once, in any order.
+  virtual bool ReadBand(uint32_t y, uint32_t rows, PixelSource* band) = 0;
+};
+
+// Rows per band so that one band of `rowBytes`-sized rows fits in
+// `budgetBytes`; at least one row, at most `height`. A zero budget means one
+// band for the whole image.
+inline uint32_t BandRowsForBudget(size_t budgetBytes, size_t rowBytes, uint32_t height) {
+  if (budgetBytes == 0 || rowBytes == 0) return height;
+  const size_t rows = budgetBytes / rowBytes;
+  if (rows == 0) return 1;
+  return rows < height ? static_cast<uint32_t>(rows) : height;
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,495 @@
+#include "PngEncoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "PixelKernels.h"
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr size_t kIdatChunkSize = 64 * 1024;
+constexpr size_t kDeflateWindow = 32 * 1024;
+constexpr uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+void PutBe32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+} // namespace
+
+PngEncoder::PngEncoder(ByteSink* sink, const PngEncodeOptions& options)
+    : sink_(sink), options_(options), deflate_(options.compressionLevel) {}
+
+PngEncoder::~PngEncoder() { AbandonSegments(); }
+
+bool PngEncoder::WriteChunk(const char type[4], const uint8_t* data, size_t size) {
+  uint8_t header[8];
+  PutBe32(header, static_cast<uint32_t>(size));
+  std::memcpy(header + 4, type, 4);
+  uint32_t crc = Crc32Update(0, header + 4, 4);
+  crc = Crc32Update(crc, data, size);
+  uint8_t trailer[4];
+  PutBe32(trailer, crc);
+  if (!sink_->Write(header, sizeof(header)) || (size && !sink_->Write(data, size)) ||
+      !sink_->Write(trailer, sizeof(trailer))) {
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool PngEncoder::Begin(uint32_t width, uint32_t height, PixelFormat format,
+                       const PngColorPlan* plan) {
+  if (width == 0 || height == 0 || width > 0x7FFFFFFF || height > 0x7FFFFFFF) return false;
+  PngColorPlan defaultPlan;
+  if (!plan) {
+    defaultPlan.mode = HasAlphaChannel(format) ? PngColorMode::Rgba : PngColorMode::Rgb;
+    plan = &defaultPlan;
+  }
+  const bool needsAlpha = plan->mode == PngColorMode::Rgba || plan->mode == PngColorMode::GrayAlpha;
+  if (needsAlpha && !HasAlphaChannel(format)) return false;
+  if (plan->mode == PngColorMode::Palette &&
+      (plan->palette.empty() || plan->palette.size() > ColorSet::kMaxColors ||
+       plan->palette.size() > (size_t{1} << plan->bitDepth))) {
+    return false;
+  }
+
+  width_ = width;
+  height_ = height;
+  format_ = format;
+  mode_ = plan->mode;
+  bitDepth_ = plan->mode == PngColorMode::Palette ? plan->bitDepth : 8;
+  rowsWritten_ = 0;
+  failed_ = false;
+
+  size_t channels = 4;
+  uint8_t colorType = 6;
+  switch (mode_) {
+    case PngColorMode::Gray: channels = 1; colorType = 0; break;
+    case PngColorMode::Rgb: channels = 3; colorType = 2; break;
+    case PngColorMode::Palette: channels = 1; colorType = 3; break;
+    case PngColorMode::GrayAlpha: channels = 2; colorType = 4; break;
+    case PngColorMode::Rgba: channels = 4; colorType = 6; break;
+  }
+  outBpp_ = std::max<size_t>(1, channels * bitDepth_ / 8);
+  rowBytes_ = (static_cast<size_t>(width) * channels * bitDepth_ + 7) / 8;
+  prevRow_.assign(rowBytes_, 0);
+  curRow_.assign(rowBytes_, 0);
+  filtered_.assign(5 * (rowBytes_ + 1), 0);
+  deflate_.Reset(options_.compressionLevel);
+  adler_ = 1;
+  // CMF/FLG: deflate, 32 KiB window, no preset dictionary.
+  zlib_.assign({0x78, 0x9C});
+  drained_ = 0;
+
+  AbandonSegments();
+  parallel_ = false;
+  segment_.clear();
+  dictionary_.clear();
+  unsigned threads = options_.threads ? options_.threads : ThreadPool::DefaultThreadCount();
+  if (options_.memoryBudget > 0 && options_.segmentBytes > 0) {
+    // Up to two segments per thread are in flight, each with its output.
+    const size_t perThread = 4 * options_.segmentBytes;
+    threads = static_cast<unsigned>(
+        std::min<size_t>(threads, std::max<size_t>(1, options_.memoryBudget / perThread)));
+  }
+  const uint64_t filteredBytes = static_cast<uint64_t>(rowBytes_ + 1) * height;
+  if (threads > 1 && options_.segmentBytes > 0 && filteredBytes > options_.segmentBytes) {
+    if (!pool_ || pool_->Size() != threads) pool_ = std::make_unique<ThreadPool>(threads);
+    parallel_ = true;
+    inFlight_.reserve(2 * static_cast<size_t>(threads) + 2);
+    idleSegments_.reserve(2 * static_cast<size_t>(threads) + 2);
+    segment_.reserve(options_.segmentBytes + rowBytes_ + 1);
+  }
+
+  if (!sink_->Write(kPngSignature, sizeof(kPngSignature))) return false;
+
+  uint8_t ihdr[13];
+  PutBe32(ihdr, width);
+  PutBe32(ihdr + 4, height);
+  ihdr[8] = static_cast<uint8_t>(bitDepth_);  // bit depth
+  ihdr[9] = colorType;                         // color type
+  ihdr[10] = 0;                                // deflate
+  ihdr[11] = 0;                                // adaptive filtering
+  ihdr[12] = 0;                                // no interlace
+  if (!WriteChunk("IHDR", ihdr, sizeof(ihdr))) return false;
+
+  if (mode_ == PngColorMode::Palette) {
+    paletteIndex_.Clear();
+    uint8_t plte[ColorSet::kMaxColors * 3];
+    uint8_t trns[ColorSet::kMaxColors];
+    size_t entries = 0;
+    size_t translucent = 0;
+    for (uint32_t c : plan->palette) {
+      paletteIndex_.Insert(c);
+      plte[entries * 3] = static_cast<uint8_t>(c >> 16);
+      plte[entries * 3 + 1] = static_cast<uint8_t>(c >> 8);
+      plte[entries * 3 + 2] = static_cast<uint8_t>(c);
+      if (translucent < plan->translucentEntries) {
+        trns[translucent++] = static_cast<uint8_t>(c >> 24);
+      }
+      entries++;
+    }
+    if (!WriteChunk("PLTE", plte, entries * 3)) return false;
+    if (translucent && !WriteChunk("tRNS", trns, translucent)) return false;
+  }
+  return true;
+}
+
+bool PngEncoder::ConvertRow(const uint8_t* src, uint8_t* out) const {
+  const size_t w = width_;
+  const size_t inBpp = BytesPerPixel(format_);
+  switch (mode_) {
+    case PngColorMode::Rgba:
+      if (format_ == PixelFormat::Bgra8) {
+        SwapRedBlue32(src, out, w);
+      } else {
+        std::memcpy(out, src, rowBytes_);
+      }
+      return true;
+    case PngColorMode::Rgb:
+      switch (format_) {
+        case PixelFormat::Bgra8:
+        case PixelFormat::Bgrx8:
+          Bgrx32ToRgb24(src, out, w);
+          break;
+        case PixelFormat::Rgba8:
+          for (size_t x = 0; x < w; x++, src += 4, out += 3) std::memcpy(out, src, 3);
+          break;
+        case PixelFormat::Bgr8:
+          SwapRedBlue24(src, out, w);
+          break;
+        case PixelFormat::Rgb8:
+          std::memcpy(out, src, rowBytes_);
+          break;
+      }
+      return true;
+    case PngColorMode::Gray:
+      // R == G == B, so the green byte serves for every input layout.
+      for (size_t x = 0; x < w; x++) out[x] = src[x * inBpp + 1];
+      return true;
+    case PngColorMode::GrayAlpha:
+      for (size_t x = 0; x < w; x++) {
+        out[x * 2] = src[x * 4 + 1];
+        out[x * 2 + 1] = src[x * 4 + 3];
+      }
+      return true;
+    case PngColorMode::Palette:
+      return PackPaletteRow(src, out);
+  }
+  return false;
+}
+
+bool PngEncoder::PackPaletteRow(const uint8_t* src, uint8_t* out) const {
+  const size_t inBpp = BytesPerPixel(format_);
+  const int depth = bitDepth_;
+  const size_t perByte = static_cast<size_t>(8 / depth);
+  if (depth < 8) std::memset(out, 0, rowBytes_);
+
+  uint32_t lastColor = ~PackArgb(src, format_);
+  int lastIndex = -1;
+  for (size_t x = 0; x < width_; x++, src += inBpp) {
+    uint32_t c = PackArgb(src, format_);
+    if (c != lastColor) {
+      lastColor = c;
+      lastIndex = paletteIndex_.Find(c);
+      if (lastIndex < 0) return false;  // plan does not match the pixels
+    }
+    if (depth == 8) {
+      out[x] = static_cast<uint8_t>(lastIndex);
+    } else {
+      const int shift = 8 - depth * static_cast<int>(x % perByte + 1);
+      out[x / perByte] |= static_cast<uint8_t>(lastIndex << shift);
+    }
+  }
+  return true;
+}
+
+const uint8_t* PngFilterRow(PngFilterStrategy strategy, const uint8_t* cur,
+                            const uint8_t* prev, size_t n, size_t bpp, uint8_t* scratch) {
+  uint8_t* out = scratch;
+  switch (strategy) {
+    case PngFilterStrategy::None:
+      out[0] = 0;
+      std::memcpy(out + 1, cur, n);
+      return out;
+    case PngFilterStrategy::Sub:
+      out[0] = 1;
+      PngFilterSub(cur, n, bpp, out + 1);
+      return out;
+    case PngFilterStrategy::Up:
+      out[0] = 2;
+      PngFilterUp(cur, prev, n, out + 1);
+      return out;
+    case PngFilterStrategy::Average:
+      out[0] = 3;
+      PngFilterAverage(cur, prev, n, bpp, out + 1);
+      return out;
+    case PngFilterStrategy::Paeth:
+      out[0] = 4;
+      PngFilterPaeth(cur, prev, n, bpp, out + 1);
+      return out;
+    case PngFilterStrategy::Adaptive:
+      break;
+  }
+  return PngFilterRowAdaptive(cur, prev, n, bpp, out);
+}
+
+const uint8_t* PngEncoder::FilterRow() {
+  return PngFilterRow(options_.filter, curRow_.data(), prevRow_.data(), rowBytes_, outBpp_,
+                      filtered_.data());
+}
+
+void PngEncoder::Compress(const uint8_t* data, size_t size) {
+  adler_ = Adler32Update(adler_, data, size);
+  if (!parallel_) {
+    deflate_.Write(data, size);
+    std::vector<uint8_t>& out = deflate_.Output();
+    zlib_.insert(zlib_.end(), out.begin(), out.end());
+    out.clear();
+    return;
+  }
+  segment_.insert(segment_.end(), data, data + size);
+  if (segment_.size() >= options_.segmentBytes) SubmitSegment(false);
+}
+
+void PngEncoder::CompressSegment(Segment* segment) {
+  std::unique_ptr<DeflateEncoder> enc;
+  {
+    std::lock_guard<std::mutex> lock(deflatersMutex_);
+    if (!idleDeflaters_.empty()) {
+      enc = std::move(idleDeflaters_.back());
+      idleDeflaters_.pop_back();
+    }
+  }
+  if (enc) {
+    enc->Reset(segment->level);
+  } else {
+    enc = std::make_unique<DeflateEncoder>(segment->level);
+  }
+  if (!segment->dictionary.empty()) {
+    enc->SetDictionary(segment->dictionary.data(), segment->dictionary.size());
+  }
+  // Room for a full segment even if it does not compress, so output buffers
+  // reach their final size the first time they are used.
+  const size_t inputCapacity = segment->input.capacity();
+  enc->Output().reserve(inputCapacity + inputCapacity / 8 + 1024);
+  enc->Write(segment->input.data(), segment->input.size());
+  enc->Flush(segment->final);
+  // Trade buffers so the encoder keeps an already grown one for next time.
+  segment->output.clear();
+  segment->output.swap(enc->Output());
+
+  std::lock_guard<std::mutex> lock(deflatersMutex_);
+  idleDeflaters_.push_back(std::move(enc));
+}
+
+// Worker side: compresses the segment and hands it back. Notifies with the
+// lock held, since the caller may destroy the encoder as soon as it sees done.
+void PngEncoder::RunSegment(Segment* segment) {
+  bool ok = true;
+  try {
+    CompressSegment(segment);
+  } catch (...) {
+    ok = false;
+  }
+  std::lock_guard<std::mutex> lock(segmentsMutex_);
+  segment->failed = !ok;
+  segment->done = true;
+  segmentDone_.notify_all();
+}
+
+void PngEncoder::SubmitSegment(bool final) {
+  std::unique_ptr<Segment> segment;
+  if (idleSegments_.empty()) {
+    segment = std::make_unique<Segment>();
+    segment->dictionary.reserve(kDeflateWindow);
+  } else {
+    segment = std::move(idleSegments_.back());
+    idleSegments_.pop_back();
+  }
+  segment->encoder = this;
+  segment->level = options_.compressionLevel;
+  segment->final = final;
+  segment->done = false;
+  segment->failed = false;
+  segment->input.swap(segment_);
+  segment_.clear();
+  segment_.reserve(options_.segmentBytes + rowBytes_ + 1);
+
+  segment->dictionary.assign(dictionary_.begin(), dictionary_.end());
+  // The next segment may reference the last 32 KiB of everything before it.
+  const std::vector<uint8_t>& input = segment->input;
+  if (input.size() >= kDeflateWindow) {
+    dictionary_.assign(input.end() - kDeflateWindow, input.end());
+  } else {
+    dictionary_.insert(dictionary_.end(), input.begin(), input.end());
+    if (dictionary_.size() > kDeflateWindow) {
+      dictionary_.erase(dictionary_.begin(), dictionary_.end() - kDeflateWindow);
+    }
+  }
+
+  Segment* job = segment.get();
+  inFlight_.push_back(std::move(segment));
+  pool_->Post([job]() { job->encoder->RunSegment(job); });
+}
+
+bool PngEncoder::CollectSegments(size_t maxInFlight) {
+  while (inFlight_.size() > maxInFlight) {
+    Segment* oldest = inFlight_.front().get();
+    bool failed = false;
+    {
+      std::unique_lock<std::mutex> lock(segmentsMutex_);
+      segmentDone_.wait(lock, [oldest]() { return oldest->done; });
+      failed = oldest->failed;
+    }
+    if (!failed) zlib_.insert(zlib_.end(), oldest->output.begin(), oldest->output.end());
+    idleSegments_.push_back(std::move(inFlight_.front()));
+    inFlight_.erase(inFlight_.begin());
+    if (failed) {
+      failed_ = true;
+      return false;
+    }
+    if (!DrainIdat(false)) return false;
+  }
+  return true;
+}
+
+// Waits for segments of an image that was not finished, since the workers
+// still reference this encoder.
+void PngEncoder::AbandonSegments() {
+  {
+    std::unique_lock<std::mutex> lock(segmentsMutex_);
+    for (const std::unique_ptr<Segment>& segment : inFlight_) {
+      const Segment* pending = segment.get();
+      segmentDone_.wait(lock, [pending]() { return pending->done; });
+    }
+  }
+  for (std::unique_ptr<Segment>& segment : inFlight_) idleSegments_.push_back(std::move(segment));
+  inFlight_.clear();
+}
+
+bool PngEncoder::DrainIdat(bool all) {
+  std::vector<uint8_t>& out = zlib_;
+  while (out.size() - drained_ >= kIdatChunkSize) {
+    if (!WriteChunk("IDAT", out.data() + drained_, kIdatChunkSize)) return false;
+    drained_ += kIdatChunkSize;
+  }
+  if (all && out.size() > drained_) {
+    if (!WriteChunk("IDAT", out.data() + drained_, out.size() - drained_)) return false;
+    drained_ = out.size();
+  }
+  if (drained_ > 0 && (all || drained_ >= kIdatChunkSize * 4)) {
+    out.erase(out.begin(), out.begin() + drained_);
+    drained_ = 0;
+  }
+  return true;
+}
+
+bool PngEncoder::WriteRow(const uint8_t* pixels) {
+  if (failed_ || rowsWritten_ >= height_) return false;
+  if (!ConvertRow(pixels, curRow_.data())) {
+    failed_ = true;
+    return false;
+  }
+  Compress(FilterRow(), rowBytes_ + 1);
+  std::swap(prevRow_, curRow_);
+  rowsWritten_++;
+  if (parallel_) {
+    // Keep every worker busy while bounding buffered segments.
+    return CollectSegments(2 * static_cast<size_t>(pool_->Size()));
+  }
+  return DrainIdat(false);
+}
+
+bool PngEncoder::Finish() {
+  if (failed_ || rowsWritten_ != height_) return false;
+  if (parallel_) {
+    SubmitSegment(true);
+    if (!CollectSegments(0)) return false;
+  } else {
+    deflate_.Flush(true);
+    std::vector<uint8_t>& out = deflate_.Output();
+    zlib_.insert(zlib_.end(), out.begin(), out.end());
+    out.clear();
+  }
+  uint8_t trailer[4];
+  PutBe32(trailer, adler_);
+  zlib_.insert(zlib_.end(), trailer, trailer + 4);
+  if (!DrainIdat(true)) return false;
+  return WriteChunk("IEND", nullptr, 0);
+}
+
+void PngEncodeSession::SetOptions(const PngEncodeOptions& options) {
+  options_ = options;
+  encoder_.reset();
+}
+
+PngEncoder* PngEncodeSession::Encoder(ByteSink* sink) {
+  if (!encoder_) encoder_ = std::make_unique<PngEncoder>(sink, options_);
+  encoder_->SetSink(sink);
+  return encoder_.get();
+}
+
+bool PngEncodeSession::Encode(const PixelSource& source, ByteSink* sink) {
+  const PngColorPlan* planPtr = nullptr;
+  if (options_.reduceColors) {
+    ColorAnalyzer analyzer(source.width, source.format);
+    analyzer.AddRows(source);
+    analyzer.Plan(&plan_);
+    planPtr = &plan_;
+  }
+  PngEncoder* encoder = Encoder(sink);
+  if (!encoder->Begin(source.width, source.height, source.format, planPtr)) return false;
+  for (uint32_t y = 0; y < source.height; y++) {
+    if (!encoder->WriteRow(source.Row(y))) return false;
+  }
+  return encoder->Finish();
+}
+
+bool PngEncodeSession::EncodeBands(PixelBandReader* reader, uint32_t bandRows, ByteSink* sink) {
+  const uint32_t width = reader->Width();
+  const uint32_t height = reader->Height();
+  if (bandRows == 0) bandRows = 1;
+
+  const PngColorPlan* planPtr = nullptr;
+  if (options_.reduceColors) {
+    ColorAnalyzer analyzer(width, reader->Format());
+    for (uint32_t y = 0; y < height && !analyzer.Done(); y += bandRows) {
+      PixelSource band;
+      if (!reader->ReadBand(y, std::min(bandRows, height - y), &band)) return false;
+      analyzer.AddRows(band);
+    }
+    analyzer.Plan(&plan_);
+    planPtr = &plan_;
+  }
+
+  PngEncoder* encoder = Encoder(sink);
+  if (!encoder->Begin(width, height, reader->Format(), planPtr)) return false;
+  for (uint32_t y = 0; y < height; y += bandRows) {
+    PixelSource band;
+    if (!reader->ReadBand(y, std::min(bandRows, height - y), &band)) return false;
+    for (uint32_t row = 0; row < band.height; row++) {
+      if (!encoder->WriteRow(band.Row(row))) return false;
+    }
+  }
+  return encoder->Finish();
+}
+
+bool EncodePng(const PixelSource& source, ByteSink* sink, const PngEncodeOptions& options) {
+  PngEncodeSession session(options);
+  return session.Encode(source, sink);
+}
+
+bool EncodePngBands(PixelBandReader* reader, uint32_t bandRows, ByteSink* sink,
+                    const PngEncodeOptions& options) {
+  PngEncodeSession session(options);
+  return session.EncodeBands(reader, bandRows, sink);
+}
+
+} // namespace ptf_helper
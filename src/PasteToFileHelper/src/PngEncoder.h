@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ByteSink.h"
+#include "ColorAnalysis.h"
+#include "Deflate.h"
+#include "PixelSource.h"
+#include "ThreadPool.h"
+
+// Streaming PNG encoder. Portable (no Windows headers): rows go in one at a
+// time, are filtered and deflated, and IDAT chunks are written to a ByteSink as
+// soon as enough compressed data is available.
+
+namespace ptf_helper {
+
+enum class PngFilterStrategy {
+  None,
+  Sub,
+  Up,
+  Average,
+  Paeth,
+  Adaptive,  // per-row choice by minimum sum of absolute differences
+};
+
+// Filters one scanline (`n` bytes, filter distance `bpp`) into `scratch`, which
+// holds 5 * (n + 1) bytes, and returns the filter type byte followed by the
+// filtered bytes. `prev` is the previous unfiltered scanline (zeros for the first).
+const uint8_t* PngFilterRow(PngFilterStrategy strategy, const uint8_t* cur,
+                            const uint8_t* prev, size_t n, size_t bpp, uint8_t* scratch);
+
+struct PngEncodeOptions {
+  int compressionLevel = 6;
+  PngFilterStrategy filter = PngFilterStrategy::Adaptive;
+
+  // Deflate worker threads: 0 = one per core, 1 = compress on the calling
+  // thread. With more than one thread the filtered scanlines are cut into
+  // segments that are deflated independently (each primed with the previous
+  // 32 KiB, like pigz) and stitched into a single zlib stream.
+  unsigned threads = 0;
+  size_t segmentBytes = 1024 * 1024;
+
+  // Upper bound for the segments buffered in parallel mode (input plus
+  // compressed output, about 4 * segmentBytes per thread). Fewer threads are
+  // used when the budget is tight. 0 = no limit.
+  size_t memoryBudget = 0;
+
+  // EncodePng only: analyze the pixels first and write gray, RGB or palette
+  // output when that is lossless.
+  bool reduceColors = true;
+};
+
+// One encoder can write any number of images in turn: Begin() starts the next
+// one and keeps the deflate state, row and segment buffers and worker threads
+// of the previous, so a multi-image run allocates them about once.
+class PngEncoder {
+ public:
+  PngEncoder(ByteSink* sink, const PngEncodeOptions& options);
+  ~PngEncoder();
+  PngEncoder(const PngEncoder&) = delete;
+  PngEncoder& operator=(const PngEncoder&) = delete;
+
+  // Output for the next Begin().
+  void SetSink(ByteSink* sink) { sink_ = sink; }
+
+  // Writes the signature and IHDR (plus PLTE/tRNS for palettes). Discards any
+  // unfinished previous image. Without a
+  // plan, output is RGBA when the input carries alpha and RGB otherwise. A
+  // plan must come from AnalyzePixels over the same pixels.
+  bool Begin(uint32_t width, uint32_t height, PixelFormat format,
+             const PngColorPlan* plan = nullptr);
+
+  // Rows must be supplied top to bottom; `pixels` holds `width` pixels.
+  bool WriteRow(const uint8_t* pixels);
+
+  // Flushes the deflate stream and writes IEND. Fails if fewer than `height`
+  // rows were written.
+  bool Finish();
+
+ private:
+  // Parallel mode: a slice of filtered scanlines, the window it may reference
+  // and, once a worker is done, its compressed bytes. Segments and their
+  // buffers are recycled, so a warmed-up encoder allocates nothing per image.
+  struct Segment {
+    PngEncoder* encoder = nullptr;
+    int level = 0;
+    bool final = false;
+    bool done = false;    // guarded by segmentsMutex_
+    bool failed = false;  // guarded by segmentsMutex_
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> dictionary;
+    std::vector<uint8_t> output;
+  };
+
+  bool WriteChunk(const char type[4], const uint8_t* data, size_t size);
+  bool DrainIdat(bool all);
+  bool ConvertRow(const uint8_t* pixels, uint8_t* out) const;
+  bool PackPaletteRow(const uint8_t* pixels, uint8_t* out) const;
+  const uint8_t* FilterRow();
+  void Compress(const uint8_t* data, size_t size);
+  void SubmitSegment(bool final);
+  bool CollectSegments(size_t maxInFlight);
+  void AbandonSegments();
+  void CompressSegment(Segment* segment);
+  void RunSegment(Segment* segment);
+
+  ByteSink* sink_;
+  PngEncodeOptions options_;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint32_t rowsWritten_ = 0;
+  PixelFormat format_ = PixelFormat::Bgra8;
+  PngColorMode mode_ = PngColorMode::Rgba;
+  int bitDepth_ = 8;
+  ColorSet paletteIndex_;  // Palette mode only
+  size_t outBpp_ = 4;      // filter distance in bytes (1 for sub-byte depths)
+  size_t rowBytes_ = 0;
+  bool failed_ = false;
+
+  std::vector<uint8_t> prevRow_;
+  std::vector<uint8_t> curRow_;
+  std::vector<uint8_t> filtered_;  // filter byte + row, for each candidate filter
+  DeflateEncoder deflate_;
+  uint32_t adler_ = 1;
+  std::vector<uint8_t> zlib_;  // compressed bytes not yet written as IDAT
+  size_t drained_ = 0;
+
+  // Parallel mode only. The pool outlives an image and is rebuilt only when
+  // the thread count changes.
+  bool parallel_ = false;
+  std::unique_ptr<ThreadPool> pool_;
+  std::vector<uint8_t> segment_;
+  std::vector<uint8_t> dictionary_;  // tail of the previous segment
+  std::vector<std::unique_ptr<Segment>> inFlight_;      // oldest first
+  std::vector<std::unique_ptr<Segment>> idleSegments_;  // caller thread only
+  std::mutex segmentsMutex_;
+  std::condition_variable segmentDone_;
+  std::mutex deflatersMutex_;
+  std::vector<std::unique_ptr<DeflateEncoder>> idleDeflaters_;
+};
+
+// Keeps one PngEncoder for a whole run (see PngEncoder). Not thread-safe.
+class PngEncodeSession {
+ public:
+  explicit PngEncodeSession(const PngEncodeOptions& options = {}) : options_(options) {}
+
+  const PngEncodeOptions& Options() const { return options_; }
+  // Drops the encoder, so its buffers and threads are rebuilt on next use.
+  void SetOptions(const PngEncodeOptions& options);
+  void Release() { encoder_.reset(); }
+
+  bool Encode(const PixelSource& source, ByteSink* sink);
+  bool EncodeBands(PixelBandReader* reader, uint32_t bandRows, ByteSink* sink);
+
+  // For callers that supply rows themselves: Begin, WriteRow and Finish on
+  // the returned encoder, which now writes to `sink`.
+  PngEncoder* Encoder(ByteSink* sink);
+
+ private:
+  PngEncodeOptions options_;
+  std::unique_ptr<PngEncoder> encoder_;
+  PngColorPlan plan_;  // reused, so analysis does not allocate per image
+};
+
+// Encodes a whole PixelSource, reading rows straight from its memory.
+bool EncodePng(const PixelSource& source, ByteSink* sink, const PngEncodeOptions& options);
+
+// Encodes an image read `bandRows` rows at a time. With reduceColors the bands
+// are read twice: once for color analysis and once to encode.
+bool EncodePngBands(PixelBandReader* reader, uint32_t bandRows, ByteSink* sink,
+                    const PngEncodeOptions& options);
+
+} // namespace ptf_helper
@@ -0,0 +1,277 @@
+#include "PngOptimize.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Deflate.h"
+#include "Inflate.h"
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+constexpr size_t kIdatChunkSize = 256 * 1024;
+constexpr size_t kCancelPollBytes = 4 * 1024 * 1024;
+
+constexpr PngFilterStrategy kCandidates[] = {
+    PngFilterStrategy::Adaptive, PngFilterStrategy::None,    PngFilterStrategy::Sub,
+    PngFilterStrategy::Up,       PngFilterStrategy::Average, PngFilterStrategy::Paeth,
+};
+
+uint32_t ReadBe32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+void AppendBe32(std::vector<uint8_t>* out, uint32_t v) {
+  const uint8_t bytes[4] = {static_cast<uint8_t>(v >> 24), static_cast<uint8_t>(v >> 16),
+                            static_cast<uint8_t>(v >> 8), static_cast<uint8_t>(v)};
+  out->insert(out->end(), bytes, bytes + 4);
+}
+
+void AppendChunk(std::vector<uint8_t>* out, const char type[4], const uint8_t* data,
+                 size_t size) {
+  AppendBe32(out, static_cast<uint32_t>(size));
+  const size_t typeAt = out->size();
+  out->insert(out->end(), type, type + 4);
+  out->insert(out->end(), data, data + size);
+  AppendBe32(out, Crc32Update(0, out->data() + typeAt, size + 4));
+}
+
+struct Span {
+  size_t offset;
+  size_t size;
+};
+
+struct ParsedPng {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  int bitDepth = 0;
+  int colorType = 0;
+  int interlace = 0;
+  std::vector<Span> before;  // whole chunks ahead of IDAT, IHDR included
+  std::vector<Span> after;   // whole chunks after IDAT, IEND included
+  std::vector<uint8_t> zlib;
+};
+
+bool ParsePng(const uint8_t* data, size_t size, ParsedPng* png) {
+  if (size < sizeof(kPngSignature) || std::memcmp(data, kPngSignature, 8) != 0) return false;
+  size_t pos = sizeof(kPngSignature);
+  int state = 0;  // 0 = before IDAT, 1 = in IDAT, 2 = after IDAT
+  while (size - pos >= 12) {
+    const uint32_t length = ReadBe32(data + pos);
+    if (length > 0x7FFFFFFFu || length > size - pos - 12) return false;
+    const uint8_t* type = data + pos + 4;
+    const uint8_t* body = type + 4;
+    if (Crc32Update(0, type, length + 4) != ReadBe32(body + length)) return false;
+    const Span chunk{pos, length + 12};
+    pos += chunk.size;
+
+    if (chunk.offset == sizeof(kPngSignature)) {
+      if (std::memcmp(type, "IHDR", 4) != 0 || length != 13) return false;
+      png->width = ReadBe32(body);
+      png->height = ReadBe32(body + 4);
+      png->bitDepth = body[8];
+      png->colorType = body[9];
+      png->interlace = body[12];
+    }
+    if (std::memcmp(type, "IDAT", 4) == 0) {
+      if (state == 2) return false;  // IDAT chunks must be consecutive
+      state = 1;
+      png->zlib.insert(png->zlib.end(), body, body + length);
+      continue;
+    }
+    if (state == 1) state = 2;
+    (state == 0 ? png->before : png->after).push_back(chunk);
+    if (std::memcmp(type, "IEND", 4) == 0) return state == 2;
+  }
+  return false;
+}
+
+int Channels(int colorType) {
+  switch (colorType) {
+    case 0: return 1;  // gray
+    case 2: return 3;  // RGB
+    case 3: return 1;  // palette
+    case 4: return 2;  // gray + alpha
+    case 6: return 4;  // RGBA
+  }
+  return 0;
+}
+
+inline uint8_t Paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = p > a ? p - a : a - p;
+  const int pb = p > b ? p - b : b - p;
+  const int pc = p > c ? p - c : c - p;
+  if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+  return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+// Reverses the per-row filters in place. Each row keeps its filter byte; the
+// unfiltered bytes follow it.
+bool Unfilter(uint8_t* rows, uint32_t height, size_t rowBytes, size_t bpp) {
+  const std::vector<uint8_t> zeros(rowBytes, 0);
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t* row = rows + static_cast<size_t>(y) * (rowBytes + 1);
+    uint8_t* cur = row + 1;
+    const uint8_t* prev = y ? cur - (rowBytes + 1) : zeros.data();
+    switch (row[0]) {
+      case 0:
+        break;
+      case 1:
+        for (size_t i = bpp; i < rowBytes; i++) cur[i] += cur[i - bpp];
+        break;
+      case 2:
+        for (size_t i = 0; i < rowBytes; i++) cur[i] += prev[i];
+        break;
+      case 3:
+        for (size_t i = 0; i < rowBytes; i++) {
+          const int left = i >= bpp ? cur[i - bpp] : 0;
+          cur[i] += static_cast<uint8_t>((left + prev[i]) >> 1);
+        }
+        break;
+      case 4:
+        for (size_t i = 0; i < rowBytes; i++) {
+          const int left = i >= bpp ? cur[i - bpp] : 0;
+          const int upLeft = i >= bpp ? prev[i - bpp] : 0;
+          cur[i] += Paeth(left, prev[i], upLeft);
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+enum class Outcome {
+  Smaller,
+  NotSmaller,
+  Cancelled,
+};
+
+// Deflates the unfiltered rows into a zlib stream, giving up as soon as the
+// output reaches `limit` bytes.
+Outcome Compress(const uint8_t* rows, uint32_t height, size_t rowBytes, size_t bpp,
+                 PngFilterStrategy strategy, const PngOptimizeOptions& options, size_t limit,
+                 std::vector<uint8_t>* zlib) {
+  zlib->assign({0x78, 0xDA});  // deflate, 32 KiB window, maximum compression
+  DeflateEncoder deflate(options.compressionLevel);
+  uint32_t adler = 1;
+  std::vector<uint8_t> scratch(5 * (rowBytes + 1));
+  const std::vector<uint8_t> zeros(rowBytes, 0);
+  size_t sincePoll = 0;
+
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t* cur = rows + static_cast<size_t>(y) * (rowBytes + 1) + 1;
+    const uint8_t* prev = y ? cur - (rowBytes + 1) : zeros.data();
+    const uint8_t* filtered = PngFilterRow(strategy, cur, prev, rowBytes, bpp, scratch.data());
+    adler = Adler32Update(adler, filtered, rowBytes + 1);
+    deflate.Write(filtered, rowBytes + 1);
+    std::vector<uint8_t>& out = deflate.Output();
+    zlib->insert(zlib->end(), out.begin(), out.end());
+    out.clear();
+    if (zlib->size() >= limit) return Outcome::NotSmaller;
+
+    sincePoll += rowBytes + 1;
+    if (sincePoll >= kCancelPollBytes) {
+      sincePoll = 0;
+      if (options.cancelled && options.cancelled()) return Outcome::Cancelled;
+    }
+  }
+  deflate.Flush(true);
+  std::vector<uint8_t>& out = deflate.Output();
+  zlib->insert(zlib->end(), out.begin(), out.end());
+  out.clear();
+  AppendBe32(zlib, adler);
+  return zlib->size() < limit ? Outcome::Smaller : Outcome::NotSmaller;
+}
+
+} // namespace
+
+bool OptimizePng(const uint8_t* data, size_t size, const PngOptimizeOptions& options,
+                 std::vector<uint8_t>* out, PngOptimizeResult* result) {
+  *result = PngOptimizeResult{};
+  result->originalBytes = size;
+  result->optimizedBytes = size;
+  out->clear();
+
+  ParsedPng png;
+  if (!ParsePng(data, size, &png)) return false;
+  const int channels = Channels(png.colorType);
+  if (channels == 0 || png.width == 0 || png.height == 0 || png.interlace != 0) return false;
+  if (png.bitDepth != 1 && png.bitDepth != 2 && png.bitDepth != 4 && png.bitDepth != 8 &&
+      png.bitDepth != 16) {
+    return false;
+  }
+
+  const uint64_t rowBits = static_cast<uint64_t>(png.width) * channels * png.bitDepth;
+  const uint64_t filteredBytes = ((rowBits + 7) / 8 + 1) * png.height;
+  if (filteredBytes > SIZE_MAX / 2) return false;
+  if (options.maxImageBytes != 0 && filteredBytes > options.maxImageBytes) return false;
+  const size_t rowBytes = static_cast<size_t>((rowBits + 7) / 8);
+  const size_t bpp = std::max<size_t>(1, static_cast<size_t>(channels * png.bitDepth / 8));
+
+  std::vector<uint8_t> rows;
+  rows.reserve(static_cast<size_t>(filteredBytes));
+  if (!ZlibDecompress(png.zlib.data(), png.zlib.size(), static_cast<size_t>(filteredBytes),
+                      &rows) ||
+      rows.size() != filteredBytes || !Unfilter(rows.data(), png.height, rowBytes, bpp)) {
+    return false;
+  }
+
+  std::vector<uint8_t> best;
+  std::vector<uint8_t> candidate;
+  for (PngFilterStrategy strategy : kCandidates) {
+    if (options.cancelled && options.cancelled()) return false;
+    const size_t limit = best.empty() ? png.zlib.size() : best.size();
+    switch (Compress(rows.data(), png.height, rowBytes, bpp, strategy, options, limit,
+                     &candidate)) {
+      case Outcome::Smaller:
+        best.swap(candidate);
+        result->filter = strategy;
+        break;
+      case Outcome::NotSmaller:
+        break;
+      case Outcome::Cancelled:
+        return false;
+    }
+  }
+  if (best.empty()) return true;
+
+  // Decode the winner again before it may replace the original.
+  std::vector<uint8_t> check;
+  check.reserve(rows.size());
+  if (!ZlibDecompress(best.data(), best.size(), rows.size(), &check) ||
+      check.size() != rows.size() || !Unfilter(check.data(), png.height, rowBytes, bpp)) {
+    return false;
+  }
+  for (uint32_t y = 0; y < png.height; y++) {
+    const size_t at = static_cast<size_t>(y) * (rowBytes + 1) + 1;
+    if (std::memcmp(check.data() + at, rows.data() + at, rowBytes) != 0) return false;
+  }
+
+  out->reserve(size);
+  out->insert(out->end(), kPngSignature, kPngSignature + sizeof(kPngSignature));
+  for (const Span& chunk : png.before) {
+    out->insert(out->end(), data + chunk.offset, data + chunk.offset + chunk.size);
+  }
+  for (size_t at = 0; at < best.size(); at += kIdatChunkSize) {
+    const size_t n = best.size() - at < kIdatChunkSize ? best.size() - at : kIdatChunkSize;
+    AppendChunk(out, "IDAT", best.data() + at, n);
+  }
+  for (const Span& chunk : png.after) {
+    out->insert(out->end(), data + chunk.offset, data + chunk.offset + chunk.size);
+  }
+  if (out->size() >= size) {
+    out->clear();
+    result->filter = PngFilterStrategy::Adaptive;
+    return true;
+  }
+  result->optimizedBytes = out->size();
+  return true;
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "PngEncoder.h"
+
+// Slow, thorough recompression of an existing PNG: the image data is inflated,
+// unfiltered and deflated again with every filter strategy at the highest
+// level. Portable (no Windows headers).
+
+namespace ptf_helper {
+
+struct PngOptimizeOptions {
+  int compressionLevel = 9;
+
+  // Images whose unfiltered data is larger than this are left alone (the data
+  // is held in memory about twice). 0 = no limit.
+  size_t maxImageBytes = 0;
+
+  // Polled between candidates and every few MiB of input; returning true
+  // stops the search and OptimizePng fails.
+  std::function<bool()> cancelled;
+};
+
+struct PngOptimizeResult {
+  size_t originalBytes = 0;
+  size_t optimizedBytes = 0;  // equals originalBytes when nothing smaller was found
+  PngFilterStrategy filter = PngFilterStrategy::Adaptive;  // winning strategy
+};
+
+// Recompresses a non-interlaced PNG. All chunks other than IDAT are copied
+// unchanged. On success `out` holds the new file only when it is smaller than
+// the input (check result->optimizedBytes); the candidate is decoded again and
+// compared before it is returned. Fails on malformed or interlaced input, on
+// images above maxImageBytes, and when cancelled.
+bool OptimizePng(const uint8_t* data, size_t size, const PngOptimizeOptions& options,
+                 std::vector<uint8_t>* out, PngOptimizeResult* result);
+
+} // namespace ptf_helper
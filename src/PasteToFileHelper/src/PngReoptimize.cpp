@@ -0,0 +1,135 @@
+#include "PngReoptimize.h"
+
+#include <windows.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "FileSink.h"
+#include "PngOptimize.h"
+
+#include "PasteToFileCommon/Logging.h"
+
+namespace ptf_helper {
+
+namespace {
+
+struct FileStamp {
+  FILETIME lastWrite{};
+  uint64_t size = 0;
+};
+
+bool ReadStamp(HANDLE h, FileStamp* stamp) {
+  BY_HANDLE_FILE_INFORMATION info{};
+  if (!GetFileInformationByHandle(h, &info)) return false;
+  stamp->lastWrite = info.ftLastWriteTime;
+  stamp->size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+  return true;
+}
+
+// True when nobody else has the file open (an open without sharing succeeds)
+// and it still has the size and write time it had when it was read.
+bool Untouched(const std::wstring& path, const FileStamp& expected) {
+  HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (h == INVALID_HANDLE_VALUE) return false;
+  FileStamp now;
+  bool same = ReadStamp(h, &now) && now.size == expected.size &&
+              CompareFileTime(&now.lastWrite, &expected.lastWrite) == 0;
+  CloseHandle(h);
+  return same;
+}
+
+bool ReadWholeFile(const std::wstring& path, std::vector<uint8_t>* bytes, FileStamp* stamp) {
+  HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (h == INVALID_HANDLE_VALUE) return false;
+  bool ok = ReadStamp(h, stamp) && stamp->size <= SIZE_MAX;
+  if (ok) {
+    bytes->resize(static_cast<size_t>(stamp->size));
+    size_t done = 0;
+    while (ok && done < bytes->size()) {
+      DWORD chunk = static_cast<DWORD>(
+          bytes->size() - done > 0x40000000 ? 0x40000000 : bytes->size() - done);
+      DWORD read = 0;
+      ok = ReadFile(h, bytes->data() + done, chunk, &read, nullptr) && read == chunk;
+      done += read;
+    }
+  }
+  CloseHandle(h);
+  return ok;
+}
+
+bool WriteTempFile(const std::wstring& path, const std::vector<uint8_t>& bytes) {
+  HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+                         FILE_ATTRIBUTE_HIDDEN, nullptr);
+  if (h == INVALID_HANDLE_VALUE) return false;
+  HandleSink sink(h);
+  // Flush before the swap so a crash cannot leave a short file under the real name.
+  bool ok = sink.Write(bytes.data(), bytes.size()) && FlushFileBuffers(h);
+  CloseHandle(h);
+  if (!ok) DeleteFileW(path.c_str());
+  return ok;
+}
+
+} // namespace
+
+bool ReoptimizePngFile(const std::wstring& path, size_t maxImageBytes) {
+  const ULONGLONG start = GetTickCount64();
+  auto elapsed = [&]() { return std::to_wstring(GetTickCount64() - start) + L" ms"; };
+
+  DWORD attributes = GetFileAttributesW(path.c_str());
+  std::vector<uint8_t> original;
+  FileStamp stamp;
+  if (attributes == INVALID_FILE_ATTRIBUTES || !ReadWholeFile(path, &original, &stamp)) {
+    ptf::LogLine(L"Re-optimize: cannot read " + path);
+    return false;
+  }
+
+  PngOptimizeOptions options;
+  options.maxImageBytes = maxImageBytes;
+  options.cancelled = [&]() { return !Untouched(path, stamp); };
+  std::vector<uint8_t> optimized;
+  PngOptimizeResult result;
+  bool ok = OptimizePng(original.data(), original.size(), options, &optimized, &result);
+  original.clear();
+  original.shrink_to_fit();
+  if (!ok) {
+    ptf::LogLine(L"Re-optimize stopped (file in use, changed, too large or unsupported): " +
+                 path + L" after " + elapsed());
+    return false;
+  }
+  if (optimized.empty()) {
+    ptf::LogLine(L"Re-optimize: no smaller encoding for " + path + L" (" + elapsed() + L")");
+    return true;
+  }
+
+  const std::wstring tempPath = path + L".ptf-tmp";
+  if (!WriteTempFile(tempPath, optimized)) {
+    ptf::LogLine(L"Re-optimize: cannot write " + tempPath + L" err=" +
+                 std::to_wstring(GetLastError()));
+    return false;
+  }
+  // ReplaceFileW swaps the data in under the original name and keeps its
+  // creation time and security; it fails if the file is open elsewhere.
+  if (!Untouched(path, stamp) ||
+      !ReplaceFileW(path.c_str(), tempPath.c_str(), nullptr, REPLACEFILE_IGNORE_MERGE_ERRORS,
+                    nullptr, nullptr)) {
+    DeleteFileW(tempPath.c_str());
+    ptf::LogLine(L"Re-optimize stopped (file in use or changed): " + path + L" after " +
+                 elapsed());
+    return false;
+  }
+  SetFileAttributesW(path.c_str(), attributes);
+
+  wchar_t saved[64]{};
+  swprintf_s(saved, L"%.1f%%",
+             100.0 * static_cast<double>(result.originalBytes - result.optimizedBytes) /
+                 static_cast<double>(result.originalBytes));
+  ptf::LogLine(L"Re-optimized: " + path + L" " + std::to_wstring(result.originalBytes) +
+               L" -> " + std::to_wstring(result.optimizedBytes) + L" bytes (-" + saved +
+               L") in " + elapsed());
+  return true;
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace ptf_helper {
+
+// Optional second phase for a PNG the helper has just written: recompresses it
+// with OptimizePng and swaps the result in (ReplaceFileW) only when it is
+// smaller. Gives up as soon as the file is modified or opened by someone else.
+// Images whose raw data exceed maxImageBytes (0 = no limit) are skipped.
+// Logs the outcome, savings and time spent. Call at background priority.
+bool ReoptimizePngFile(const std::wstring& path, size_t maxImageBytes);
+
+} // namespace ptf_helper
@@ -0,0 +1,165 @@
+#include "QoiEncoder.h"
+
+#include <cstring>
+
+namespace ptf_helper {
+
+namespace {
+
+constexpr uint8_t kOpIndex = 0x00;
+constexpr uint8_t kOpDiff = 0x40;
+constexpr uint8_t kOpLuma = 0x80;
+constexpr uint8_t kOpRun = 0xC0;
+constexpr uint8_t kOpRgb = 0xFE;
+constexpr uint8_t kOpRgba = 0xFF;
+constexpr int kMaxRun = 62;
+constexpr uint8_t kEndMarker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+// Output is handed to the sink in blocks of about this size.
+constexpr size_t kFlushBytes = 64 * 1024;
+
+inline uint32_t Hash(uint32_t argb) {
+  uint32_t a = argb >> 24;
+  uint32_t r = (argb >> 16) & 0xFF;
+  uint32_t g = (argb >> 8) & 0xFF;
+  uint32_t b = argb & 0xFF;
+  return (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+}
+
+void PutBe32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+} // namespace
+
+QoiEncoder::QoiEncoder(ByteSink* sink) : sink_(sink) {}
+
+bool QoiEncoder::Begin(uint32_t width, uint32_t height, PixelFormat format) {
+  if (width == 0 || height == 0) return false;
+  // The format allows at most 400 million pixels.
+  if (static_cast<uint64_t>(width) * height > 400000000ull) return false;
+  width_ = width;
+  height_ = height;
+  format_ = format;
+  rowsWritten_ = 0;
+  failed_ = false;
+  std::memset(index_, 0, sizeof(index_));
+  prev_ = 0xFF000000u;
+  run_ = 0;
+
+  uint8_t header[14] = {'q', 'o', 'i', 'f'};
+  PutBe32(header + 4, width);
+  PutBe32(header + 8, height);
+  header[12] = HasAlphaChannel(format) ? 4 : 3;  // channels
+  header[13] = 0;                                // sRGB with linear alpha
+  out_.assign(header, header + sizeof(header));
+  out_.reserve(kFlushBytes + static_cast<size_t>(width) * 5 + 16);
+  return true;
+}
+
+bool QoiEncoder::WriteRow(const uint8_t* pixels) {
+  if (failed_ || rowsWritten_ >= height_) return false;
+  const size_t bpp = BytesPerPixel(format_);
+  uint32_t prev = prev_;
+  int run = run_;
+
+  for (uint32_t x = 0; x < width_; x++, pixels += bpp) {
+    const uint32_t px = PackArgb(pixels, format_);
+    if (px == prev) {
+      if (++run == kMaxRun) {
+        out_.push_back(static_cast<uint8_t>(kOpRun | (run - 1)));
+        run = 0;
+      }
+      continue;
+    }
+    if (run > 0) {
+      out_.push_back(static_cast<uint8_t>(kOpRun | (run - 1)));
+      run = 0;
+    }
+
+    const uint32_t slot = Hash(px);
+    if (index_[slot] == px) {
+      out_.push_back(static_cast<uint8_t>(kOpIndex | slot));
+    } else {
+      index_[slot] = px;
+      if ((px >> 24) == (prev >> 24)) {
+        const int8_t dr = static_cast<int8_t>(((px >> 16) & 0xFF) - ((prev >> 16) & 0xFF));
+        const int8_t dg = static_cast<int8_t>(((px >> 8) & 0xFF) - ((prev >> 8) & 0xFF));
+        const int8_t db = static_cast<int8_t>((px & 0xFF) - (prev & 0xFF));
+        const int drg = dr - dg;
+        const int dbg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+          out_.push_back(static_cast<uint8_t>(kOpDiff | ((dr + 2) << 4) | ((dg + 2) << 2) |
+                                              (db + 2)));
+        } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7) {
+          out_.push_back(static_cast<uint8_t>(kOpLuma | (dg + 32)));
+          out_.push_back(static_cast<uint8_t>(((drg + 8) << 4) | (dbg + 8)));
+        } else {
+          const uint8_t rgb[4] = {kOpRgb, static_cast<uint8_t>(px >> 16),
+                                  static_cast<uint8_t>(px >> 8), static_cast<uint8_t>(px)};
+          out_.insert(out_.end(), rgb, rgb + 4);
+        }
+      } else {
+        const uint8_t rgba[5] = {kOpRgba, static_cast<uint8_t>(px >> 16),
+                                 static_cast<uint8_t>(px >> 8), static_cast<uint8_t>(px),
+                                 static_cast<uint8_t>(px >> 24)};
+        out_.insert(out_.end(), rgba, rgba + 5);
+      }
+    }
+    prev = px;
+  }
+
+  prev_ = prev;
+  run_ = run;
+  rowsWritten_++;
+  return out_.size() < kFlushBytes || Flush();
+}
+
+bool QoiEncoder::Finish() {
+  if (failed_ || rowsWritten_ != height_) return false;
+  if (run_ > 0) {
+    out_.push_back(static_cast<uint8_t>(kOpRun | (run_ - 1)));
+    run_ = 0;
+  }
+  out_.insert(out_.end(), kEndMarker, kEndMarker + sizeof(kEndMarker));
+  return Flush();
+}
+
+bool QoiEncoder::Flush() {
+  if (!out_.empty() && !sink_->Write(out_.data(), out_.size())) {
+    failed_ = true;
+    return false;
+  }
+  out_.clear();
+  return true;
+}
+
+bool EncodeQoi(const PixelSource& source, ByteSink* sink) {
+  QoiEncoder encoder(sink);
+  if (!encoder.Begin(source.width, source.height, source.format)) return false;
+  for (uint32_t y = 0; y < source.height; y++) {
+    if (!encoder.WriteRow(source.Row(y))) return false;
+  }
+  return encoder.Finish();
+}
+
+bool EncodeQoiBands(PixelBandReader* reader, uint32_t bandRows, ByteSink* sink) {
+  const uint32_t height = reader->Height();
+  if (bandRows == 0) bandRows = 1;
+  QoiEncoder encoder(sink);
+  if (!encoder.Begin(reader->Width(), height, reader->Format())) return false;
+  for (uint32_t y = 0; y < height; y += bandRows) {
+    PixelSource band;
+    const uint32_t rows = height - y < bandRows ? height - y : bandRows;
+    if (!reader->ReadBand(y, rows, &band)) return false;
+    for (uint32_t row = 0; row < band.height; row++) {
+      if (!encoder.WriteRow(band.Row(row))) return false;
+    }
+  }
+  return encoder.Finish();
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ByteSink.h"
+#include "PixelSource.h"
+
+// Streaming QOI ("Quite OK Image") encoder. Portable (no Windows headers).
+// Single pass, no entropy coding: much faster than PNG at a larger file size.
+
+namespace ptf_helper {
+
+class QoiEncoder {
+ public:
+  explicit QoiEncoder(ByteSink* sink);
+
+  // Writes the header. Output has 4 channels when the input carries alpha and
+  // 3 otherwise.
+  bool Begin(uint32_t width, uint32_t height, PixelFormat format);
+
+  // Rows must be supplied top to bottom; `pixels` holds `width` pixels.
+  bool WriteRow(const uint8_t* pixels);
+
+  // Flushes the pending run and writes the end marker. Fails if fewer than
+  // `height` rows were written.
+  bool Finish();
+
+ private:
+  bool Flush();
+
+  ByteSink* sink_;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint32_t rowsWritten_ = 0;
+  PixelFormat format_ = PixelFormat::Bgra8;
+  bool failed_ = false;
+
+  uint32_t index_[64];  // 0xAARRGGBB, indexed by the QOI color hash
+  uint32_t prev_ = 0xFF000000u;
+  int run_ = 0;
+  std::vector<uint8_t> out_;
+};
+
+bool EncodeQoi(const PixelSource& source, ByteSink* sink);
+
+// Encodes an image read `bandRows` rows at a time.
+bool EncodeQoiBands(PixelBandReader* reader, uint32_t bandRows, ByteSink* sink);
+
+} // namespace ptf_helper
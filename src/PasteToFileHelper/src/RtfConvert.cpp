@@ -0,0 +1,1034 @@
+#include "RtfConvert.h"
+
+#include <cstring>
+
+#include "CodePage.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define PTF_RTF_SSE2 1
+#include <emmintrin.h>
+#else
+#define PTF_RTF_SSE2 0
+#endif
+
+namespace ptf_helper {
+
+// What the converter does with each control word; see kWords.
+enum class RtfWord : uint8_t {
+  Other,
+  Skip,  // destination whose content is dropped
+  FontTable,
+  Font,
+  FontCharset,
+  FontCodePage,
+  DefaultFont,
+  AnsiCodePage,  // \ansicpgN; \pc and \pca carry their code page in codePoint
+  FieldInstruction,
+  FieldResult,
+  Paragraph,
+  ParagraphDefault,
+  Line,
+  Tab,
+  Cell,
+  NestedCell,
+  Row,
+  InTable,
+  Plain,
+  Bold,
+  Italic,
+  Underline,
+  UnderlineNone,
+  Strike,
+  Super,
+  Sub,
+  NoSuperSub,
+  Unicode,
+  UnicodeSkip,
+  Bin,
+  Char,  // a named character (\emdash, \bullet, ...)
+};
+
+namespace {
+
+constexpr size_t kMaxGroupDepth = 256;
+constexpr size_t kMaxFieldInstruction = 2 * 1024;
+constexpr size_t kMaxHeldBlanks = 4 * 1024;
+constexpr size_t kMaxFonts = 4 * 1024;
+
+bool IsAlpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Bytes that end a run of plain text. Line breaks in the source are not text.
+bool IsSpecial(char c) {
+  return c == '\\' || c == '{' || c == '}' || c == '\r' || c == '\n' || c == '\0';
+}
+
+// Index of the first special byte in [p, p + n), or n. Text and the hex of
+// embedded pictures, most of a large document, go 16 bytes at a time.
+size_t FindSpecial(const char* p, size_t n) {
+  size_t i = 0;
+#if PTF_RTF_SSE2
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i open = _mm_set1_epi8('{');
+  const __m128i close = _mm_set1_epi8('}');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    const __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, backslash), _mm_cmpeq_epi8(v, open)),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, close), _mm_cmpeq_epi8(v, cr)),
+                     _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, zero))));
+    if (_mm_movemask_epi8(hits) != 0) break;
+  }
+#endif
+  // The block that stopped the vector loop, or the tail.
+  for (; i < n; i++) {
+    if (IsSpecial(p[i])) return i;
+  }
+  return n;
+}
+
+// Index of the first byte >= 0x80 in [p, p + n), or n.
+size_t FindNonAscii(const char* p, size_t n) {
+  size_t i = 0;
+#if PTF_RTF_SSE2
+  for (; i + 16 <= n; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    if (_mm_movemask_epi8(v) != 0) break;
+  }
+#endif
+  for (; i < n; i++) {
+    if (static_cast<unsigned char>(p[i]) >= 0x80) return i;
+  }
+  return n;
+}
+
+struct WordName {
+  const char* name;
+  RtfWord word;
+  uint32_t codePoint;
+};
+
+constexpr WordName kWords[] = {
+    {"aftnsep", RtfWord::Skip, 0}, {"aftnsepc", RtfWord::Skip, 0},
+    {"ansicpg", RtfWord::AnsiCodePage, 0}, {"b", RtfWord::Bold, 0}, {"bin", RtfWord::Bin, 0},
+    {"bullet", RtfWord::Char, 0x2022}, {"cell", RtfWord::Cell, 0},
+    {"colorschememapping", RtfWord::Skip, 0}, {"colortbl", RtfWord::Skip, 0},
+    {"cpg", RtfWord::FontCodePage, 0}, {"datastore", RtfWord::Skip, 0},
+    {"deff", RtfWord::DefaultFont, 0}, {"emdash", RtfWord::Char, 0x2014},
+    {"emspace", RtfWord::Char, 0x2003}, {"endash", RtfWord::Char, 0x2013},
+    {"enspace", RtfWord::Char, 0x2002}, {"f", RtfWord::Font, 0},
+    {"fcharset", RtfWord::FontCharset, 0}, {"fldinst", RtfWord::FieldInstruction, 0},
+    {"fldrslt", RtfWord::FieldResult, 0}, {"fonttbl", RtfWord::FontTable, 0},
+    {"footer", RtfWord::Skip, 0}, {"footerf", RtfWord::Skip, 0}, {"footerl", RtfWord::Skip, 0},
+    {"footerr", RtfWord::Skip, 0}, {"footnote", RtfWord::Skip, 0}, {"ftnsep", RtfWord::Skip, 0},
+    {"ftnsepc", RtfWord::Skip, 0}, {"generator", RtfWord::Skip, 0}, {"header", RtfWord::Skip, 0},
+    {"headerf", RtfWord::Skip, 0}, {"headerl", RtfWord::Skip, 0}, {"headerr", RtfWord::Skip, 0},
+    {"i", RtfWord::Italic, 0}, {"info", RtfWord::Skip, 0}, {"intbl", RtfWord::InTable, 0},
+    {"latentstyles", RtfWord::Skip, 0}, {"ldblquote", RtfWord::Char, 0x201C},
+    {"line", RtfWord::Line, 0}, {"listoverridetable", RtfWord::Skip, 0},
+    {"listtable", RtfWord::Skip, 0}, {"lquote", RtfWord::Char, 0x2018},
+    {"ltrmark", RtfWord::Char, 0x200E}, {"mmathPr", RtfWord::Skip, 0},
+    {"nestcell", RtfWord::NestedCell, 0}, {"nonesttables", RtfWord::Skip, 0},
+    {"nosupersub", RtfWord::NoSuperSub, 0}, {"object", RtfWord::Skip, 0},
+    {"page", RtfWord::Paragraph, 0}, {"par", RtfWord::Paragraph, 0},
+    {"pard", RtfWord::ParagraphDefault, 0}, {"pc", RtfWord::AnsiCodePage, 437},
+    {"pca", RtfWord::AnsiCodePage, 850}, {"pgdsctbl", RtfWord::Skip, 0},
+    {"pict", RtfWord::Skip, 0}, {"plain", RtfWord::Plain, 0}, {"pn", RtfWord::Skip, 0},
+    {"qmspace", RtfWord::Char, 0x2005}, {"rdblquote", RtfWord::Char, 0x201D},
+    {"row", RtfWord::Row, 0}, {"rquote", RtfWord::Char, 0x2019}, {"rsidtbl", RtfWord::Skip, 0},
+    {"rtlmark", RtfWord::Char, 0x200F}, {"sect", RtfWord::Paragraph, 0}, {"shp", RtfWord::Skip, 0},
+    {"strike", RtfWord::Strike, 0}, {"striked", RtfWord::Strike, 0},
+    {"stylesheet", RtfWord::Skip, 0}, {"sub", RtfWord::Sub, 0}, {"super", RtfWord::Super, 0},
+    {"tab", RtfWord::Tab, 0}, {"tc", RtfWord::Skip, 0}, {"themedata", RtfWord::Skip, 0},
+    {"u", RtfWord::Unicode, 0}, {"uc", RtfWord::UnicodeSkip, 0}, {"ul", RtfWord::Underline, 0},
+    {"uld", RtfWord::Underline, 0}, {"uldash", RtfWord::Underline, 0},
+    {"uldb", RtfWord::Underline, 0}, {"ulnone", RtfWord::UnderlineNone, 0},
+    {"ulth", RtfWord::Underline, 0}, {"ulw", RtfWord::Underline, 0},
+    {"ulwave", RtfWord::Underline, 0}, {"xe", RtfWord::Skip, 0}, {"xmlnstbl", RtfWord::Skip, 0},
+    {"zwj", RtfWord::Char, 0x200D}, {"zwnj", RtfWord::Char, 0x200C},
+};
+
+const WordName kOtherWord = {"", RtfWord::Other, 0};
+
+// kWords is sorted by name.
+const WordName& Classify(const char* name) {
+  size_t lo = 0;
+  size_t hi = sizeof(kWords) / sizeof(kWords[0]);
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    const int order = std::strcmp(name, kWords[mid].name);
+    if (order == 0) return kWords[mid];
+    if (order < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return kOtherWord;
+}
+
+// Code page of a \fcharsetN font, or 0 for DEFAULT_CHARSET, SYMBOL_CHARSET
+// and unknown values, which leave the document's code page in effect.
+uint32_t CharsetCodePage(int64_t charset) {
+  switch (charset) {
+    case 0: return 1252;
+    case 77: return 10000;
+    case 128: return 932;
+    case 129: return 949;
+    case 130: return 1361;
+    case 134: return 936;
+    case 136: return 950;
+    case 161: return 1253;
+    case 162: return 1254;
+    case 163: return 1258;
+    case 177: return 1255;
+    case 178: return 1256;
+    case 186: return 1257;
+    case 204: return 1251;
+    case 222: return 874;
+    case 238: return 1250;
+    case 254: return 437;
+    case 255: return 850;
+    default: return 0;
+  }
+}
+
+size_t EncodeUtf8(uint32_t c, char* out) {
+  if (c < 0x80) {
+    out[0] = static_cast<char>(c);
+    return 1;
+  }
+  if (c < 0x800) {
+    out[0] = static_cast<char>(0xC0 | (c >> 6));
+    out[1] = static_cast<char>(0x80 | (c & 0x3F));
+    return 2;
+  }
+  if (c < 0x10000) {
+    out[0] = static_cast<char>(0xE0 | (c >> 12));
+    out[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (c & 0x3F));
+    return 3;
+  }
+  out[0] = static_cast<char>(0xF0 | (c >> 18));
+  out[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+  out[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+  out[3] = static_cast<char>(0x80 | (c & 0x3F));
+  return 4;
+}
+
+struct FormatTag {
+  uint8_t bit;
+  const char* open;
+  const char* close;
+};
+
+constexpr FormatTag kFormatTags[] = {
+    {1, "<b>", "</b>"},  {2, "<i>", "</i>"},      {4, "<u>", "</u>"},
+    {8, "<s>", "</s>"},  {16, "<sup>", "</sup>"}, {32, "<sub>", "</sub>"},
+};
+
+constexpr size_t kFormatTagCount = sizeof(kFormatTags) / sizeof(kFormatTags[0]);
+
+// Next token of a field instruction: a quoted string or a run of non-blanks.
+bool NextFieldToken(const std::string& s, size_t* pos, std::string* token) {
+  size_t i = *pos;
+  while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) i++;
+  if (i == s.size()) return false;
+  token->clear();
+  if (s[i] == '"') {
+    const size_t end = s.find('"', i + 1);
+    const size_t stop = end == std::string::npos ? s.size() : end;
+    token->assign(s, i + 1, stop - i - 1);
+    *pos = stop == s.size() ? stop : stop + 1;
+    return true;
+  }
+  const size_t start = i;
+  while (i < s.size() && s[i] != ' ' && s[i] != '\t') i++;
+  token->assign(s, start, i - start);
+  *pos = i;
+  return true;
+}
+
+} // namespace
+
+RtfConverter::RtfConverter(RtfOutput output, const TextEncodeOptions& options, ByteSink* sink,
+                           size_t chunkBytes)
+    : output_(output),
+      sink_(sink),
+      out_(chunkBytes < 64 ? 64 : chunkBytes),
+      newline_(output == RtfOutput::Text && options.eol == EolMode::Lf ? "\n" : "\r\n"),
+      trimTrailing_(output == RtfOutput::Text && options.trimTrailing) {
+  groups_.reserve(kMaxGroupDepth);
+  groups_.push_back(Group{Destination::Text, 0, 1, false, false, -1});
+  if (output_ == RtfOutput::Html) {
+    Put("<!DOCTYPE html>\r\n<html>\r\n<head>\r\n<meta charset=\"utf-8\">\r\n</head>\r\n"
+        "<body>\r\n");
+  } else if (options.bom) {
+    Put("\xEF\xBB\xBF", 3);
+  }
+}
+
+bool RtfConverter::Feed(const char* rtf, size_t size) {
+  size_t i = 0;
+  while (i < size && ok_) i += Lex1(rtf + i, size - i);
+  return ok_;
+}
+
+bool RtfConverter::Finish() {
+  if (lex_ == Lex::Word || lex_ == Lex::Param) {
+    if (lex_ == Lex::Param && paramNegative_) param_ = -param_;
+    lex_ = Lex::Text;
+    ControlWord();
+  }
+  lex_ = Lex::Text;
+  if (output_ == RtfOutput::Html) {
+    if (paragraphOpen_) CloseParagraph();
+    if (tableOpen_) CloseTable();
+    Put("</body>\r\n</html>\r\n");
+  }
+  return Flush() && ok_;
+}
+
+// ---------------------------------------------------------------------------
+// Tokenizer. Lex1 handles the input at `p` in the current state and returns
+// how much it consumed; 0 means the state changed and `p` is read again.
+
+size_t RtfConverter::Lex1(const char* p, size_t n) {
+  const char c = *p;
+  switch (lex_) {
+    case Lex::Text: {
+      if (c == '\\') {
+        lex_ = Lex::Backslash;
+        return 1;
+      }
+      if (c == '{') {
+        OpenGroup();
+        return 1;
+      }
+      if (c == '}') {
+        CloseGroup();
+        return 1;
+      }
+      if (c == '\r' || c == '\n' || c == '\0') return 1;
+      const size_t i = 1 + FindSpecial(p + 1, n - 1);
+      Text(p, i);
+      return i;
+    }
+
+    case Lex::Backslash:
+      if (IsAlpha(c)) {
+        word_[0] = c;
+        wordLength_ = 1;
+        hasParam_ = false;
+        paramNegative_ = false;
+        param_ = 0;
+        lex_ = Lex::Word;
+      } else if (c == '\'') {
+        lex_ = Lex::Hex1;
+      } else {
+        lex_ = Lex::Text;
+        ControlSymbol(c);
+      }
+      return 1;
+
+    case Lex::Word: {
+      if (IsAlpha(c)) {
+        // Overlong names are cut short; they match nothing and are ignored.
+        if (wordLength_ + 1 < sizeof(word_)) word_[wordLength_++] = c;
+        return 1;
+      }
+      if (c == '-' || IsDigit(c)) {
+        paramNegative_ = c == '-';
+        if (!paramNegative_) {
+          param_ = c - '0';
+          hasParam_ = true;
+        }
+        lex_ = Lex::Param;
+        return 1;
+      }
+      lex_ = Lex::Text;
+      ControlWord();
+      return c == ' ' ? 1 : 0;  // a space only delimits the word
+    }
+
+    case Lex::Param:
+      if (IsDigit(c)) {
+        if (param_ < 100000000000) param_ = param_ * 10 + (c - '0');
+        hasParam_ = true;
+        return 1;
+      }
+      if (paramNegative_) param_ = -param_;
+      lex_ = Lex::Text;
+      ControlWord();
+      return c == ' ' ? 1 : 0;
+
+    case Lex::Hex1: {
+      const int v = HexValue(c);
+      if (v < 0) {
+        lex_ = Lex::Text;
+        return 0;
+      }
+      hex_ = v;
+      lex_ = Lex::Hex2;
+      return 1;
+    }
+
+    case Lex::Hex2: {
+      const int v = HexValue(c);
+      lex_ = Lex::Text;
+      if (v >= 0) hex_ = hex_ * 16 + v;
+      // Control characters other than tab would break the output's lines.
+      if (!SkipFallback() && (hex_ >= 0x20 || hex_ == '\t')) {
+        const char b = static_cast<char>(hex_);
+        Literal(&b, 1);
+      }
+      return v >= 0 ? 1 : 0;
+    }
+
+    case Lex::Binary: {
+      const size_t take = n < binaryLeft_ ? n : static_cast<size_t>(binaryLeft_);
+      binaryLeft_ -= take;
+      if (binaryLeft_ == 0) lex_ = Lex::Text;
+      return take;
+    }
+  }
+  return 1;
+}
+
+void RtfConverter::OpenGroup() {
+  fallbackLeft_ = 0;
+  ignorable_ = false;
+  if (groups_.size() < kMaxGroupDepth) {
+    groups_.push_back(groups_.back());
+  } else {
+    overflowDepth_++;
+  }
+}
+
+void RtfConverter::CloseGroup() {
+  fallbackLeft_ = 0;
+  ignorable_ = false;
+  if (overflowDepth_ > 0) {
+    overflowDepth_--;
+    return;
+  }
+  // The outermost state stays: a stray '}' does not end the document.
+  if (groups_.size() > 1) groups_.pop_back();
+  if (fieldInstructionDepth_ > groups_.size()) {
+    fieldInstructionDepth_ = 0;
+    FieldInstructionDone();
+  }
+  if (linkOpen_ && !groups_.back().link) CloseLink();
+}
+
+// A control word or \'hh right after \uN is the fallback for readers without
+// Unicode, and is dropped.
+bool RtfConverter::SkipFallback() {
+  if (fallbackLeft_ == 0) return false;
+  fallbackLeft_--;
+  return true;
+}
+
+void RtfConverter::ControlWord() {
+  word_[wordLength_] = '\0';
+  const WordName& entry = Classify(word_);
+  if (entry.word == RtfWord::Bin) {
+    // The data is skipped even when it stands in for a \uN character.
+    if (hasParam_ && param_ > 0) {
+      binaryLeft_ = static_cast<uint64_t>(param_);
+      lex_ = Lex::Binary;
+    }
+    return;
+  }
+  if (SkipFallback()) return;
+
+  Group& group = groups_.back();
+  if (ignorable_) {
+    ignorable_ = false;
+    if (entry.word != RtfWord::FieldInstruction) {
+      group.destination = Destination::Skip;
+      return;
+    }
+  }
+  if (group.destination == Destination::Skip) return;
+  if (group.destination == Destination::FontTable) {
+    // Only the font numbers and their code pages are needed.
+    if (!hasParam_) return;
+    if (entry.word == RtfWord::Font && fonts_.size() < kMaxFonts && param_ >= 0 &&
+        param_ <= INT32_MAX) {
+      fonts_.push_back(Font{static_cast<int32_t>(param_), 0});
+      tableValid_ = false;
+    } else if (entry.word == RtfWord::FontCharset || entry.word == RtfWord::FontCodePage) {
+      FontWord(param_, entry.word == RtfWord::FontCharset);
+    }
+    return;
+  }
+
+  const bool on = !hasParam_ || param_ != 0;
+  const bool inText = group.destination == Destination::Text;
+  switch (entry.word) {
+    case RtfWord::Other:
+    case RtfWord::Bin:
+      break;
+    case RtfWord::Skip:
+      group.destination = Destination::Skip;
+      break;
+    case RtfWord::FontTable:
+      group.destination = Destination::FontTable;
+      break;
+    case RtfWord::Font:
+      if (hasParam_ && param_ >= 0 && param_ <= INT32_MAX) {
+        group.font = static_cast<int32_t>(param_);
+      }
+      break;
+    case RtfWord::FontCharset:
+    case RtfWord::FontCodePage:
+      break;
+    case RtfWord::DefaultFont:
+      if (hasParam_ && param_ >= 0 && param_ <= INT32_MAX) {
+        defaultFont_ = static_cast<int32_t>(param_);
+        tableValid_ = false;
+      }
+      break;
+    case RtfWord::AnsiCodePage:
+      if (entry.codePoint != 0 || (hasParam_ && param_ > 0 && param_ <= 65535)) {
+        ansiCodePage_ = entry.codePoint != 0 ? entry.codePoint : static_cast<uint32_t>(param_);
+        tableValid_ = false;
+      }
+      break;
+    case RtfWord::FieldInstruction:
+      group.destination = Destination::FieldInstruction;
+      fieldInstruction_.clear();
+      fieldInstructionDepth_ = groups_.size();
+      break;
+    case RtfWord::FieldResult:
+      group.link = !linkHref_.empty();
+      break;
+    case RtfWord::Paragraph:
+      if (inText) Paragraph();
+      break;
+    case RtfWord::ParagraphDefault:
+      group.inTable = false;
+      break;
+    case RtfWord::Line:
+      if (inText) LineBreak();
+      break;
+    case RtfWord::Tab:
+      if (inText) Tab();
+      break;
+    case RtfWord::Cell:
+      if (inText) EndCell();
+      break;
+    case RtfWord::NestedCell:
+      if (inText) Tab();
+      break;
+    case RtfWord::Row:
+      if (inText) EndRow();
+      break;
+    case RtfWord::InTable:
+      group.inTable = true;
+      break;
+    case RtfWord::Plain:
+      group.format = 0;
+      group.font = -1;
+      break;
+    case RtfWord::Bold:
+      group.format = static_cast<uint8_t>(on ? group.format | kBold : group.format & ~kBold);
+      break;
+    case RtfWord::Italic:
+      group.format = static_cast<uint8_t>(on ? group.format | kItalic : group.format & ~kItalic);
+      break;
+    case RtfWord::Underline:
+      group.format =
+          static_cast<uint8_t>(on ? group.format | kUnderline : group.format & ~kUnderline);
+      break;
+    case RtfWord::UnderlineNone:
+      group.format = static_cast<uint8_t>(group.format & ~kUnderline);
+      break;
+    case RtfWord::Strike:
+      group.format = static_cast<uint8_t>(on ? group.format | kStrike : group.format & ~kStrike);
+      break;
+    case RtfWord::Super:
+      group.format = static_cast<uint8_t>((group.format & ~kSub) | kSuper);
+      break;
+    case RtfWord::Sub:
+      group.format = static_cast<uint8_t>((group.format & ~kSuper) | kSub);
+      break;
+    case RtfWord::NoSuperSub:
+      group.format = static_cast<uint8_t>(group.format & ~(kSuper | kSub));
+      break;
+    case RtfWord::Unicode:
+      if (hasParam_) {
+        // Written as a signed 16-bit number; some writers use larger values.
+        int64_t cp = param_ < 0 ? param_ + 65536 : param_;
+        if (cp < 0 || cp > 0x10FFFF) cp = 0xFFFD;
+        CodePoint(static_cast<uint32_t>(cp));
+        fallbackLeft_ = group.unicodeSkip;
+      }
+      break;
+    case RtfWord::UnicodeSkip:
+      if (hasParam_) {
+        group.unicodeSkip = static_cast<uint8_t>(param_ < 0 ? 0 : param_ > 255 ? 255 : param_);
+      }
+      break;
+    case RtfWord::Char:
+      CodePoint(entry.codePoint);
+      break;
+  }
+}
+
+// \fcharsetN or \cpgN for the font the table entry last named; \cpg wins.
+void RtfConverter::FontWord(int64_t value, bool charset) {
+  if (fonts_.empty()) return;
+  Font& font = fonts_.back();
+  if (charset) {
+    if (font.codePage == 0) font.codePage = CharsetCodePage(value);
+  } else if (value > 0 && value <= 65535) {
+    font.codePage = static_cast<uint32_t>(value);
+  }
+  tableValid_ = false;
+}
+
+// Table for bytes 0x80-0xFF in the current font, or nullptr when its code
+// page has none. Nothing declared means windows-1252.
+const uint16_t* RtfConverter::AnsiTable() {
+  const int32_t font = groups_.back().font >= 0 ? groups_.back().font : defaultFont_;
+  if (tableValid_ && font == tableFont_) return table_;
+  uint32_t codePage = 0;
+  for (const Font& entry : fonts_) {
+    if (entry.number == font) codePage = entry.codePage;
+  }
+  if (codePage == 0) codePage = ansiCodePage_ != 0 ? ansiCodePage_ : 1252;
+  table_ = SingleByteCodePage(codePage);
+  tableFont_ = font;
+  tableValid_ = true;
+  return table_;
+}
+
+void RtfConverter::ControlSymbol(char c) {
+  if (c == '*') {
+    ignorable_ = true;
+    return;
+  }
+  if (SkipFallback()) return;
+  ignorable_ = false;
+  switch (c) {
+    case '\\':
+    case '{':
+    case '}':
+      Literal(&c, 1);
+      break;
+    case '~':
+      CodePoint(0xA0);
+      break;
+    case '_':
+      CodePoint(0x2011);
+      break;
+    case '\r':
+    case '\n':
+      // "\" at the end of a source line is an old spelling of \par.
+      if (groups_.back().destination == Destination::Text) Paragraph();
+      break;
+    case '\t':
+      if (groups_.back().destination == Destination::Text) Tab();
+      break;
+    default:  // \- (optional hyphen), \| and \: (formula and index marks)
+      break;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Emitter.
+
+// Plain bytes from the source; the first ones may be a \uN fallback.
+void RtfConverter::Text(const char* p, size_t n) {
+  ignorable_ = false;
+  while (n > 0 && SkipFallback()) {
+    p++;
+    n--;
+  }
+  if (n > 0) Literal(p, n);
+}
+
+// Bytes in the document's ANSI code page.
+void RtfConverter::Literal(const char* p, size_t n) {
+  const Destination destination = groups_.back().destination;
+  if (destination == Destination::Skip || destination == Destination::FontTable) return;
+  size_t i = 0;
+  while (i < n) {
+    const size_t ascii = i + FindNonAscii(p + i, n - i);
+    if (ascii > i) {
+      if (highSurrogate_ != 0) {
+        highSurrogate_ = 0;
+        Emit(0xFFFD);
+      }
+      if (destination == Destination::FieldInstruction) {
+        const size_t room = kMaxFieldInstruction - fieldInstruction_.size();
+        fieldInstruction_.append(p + i, ascii - i < room ? ascii - i : room);
+      } else {
+        WriteAscii(p + i, ascii - i);
+      }
+      i = ascii;
+    }
+    if (i < n) {
+      const uint16_t* table = AnsiTable();
+      const uint8_t b = static_cast<uint8_t>(p[i++]);
+      CodePoint(table ? table[b - 0x80] : 0xFFFD);
+    }
+  }
+}
+
+// Joins \uN surrogate pairs; a half without its partner becomes U+FFFD.
+void RtfConverter::CodePoint(uint32_t cp) {
+  const Destination destination = groups_.back().destination;
+  if (destination == Destination::Skip || destination == Destination::FontTable) return;
+  if (cp >= 0xD800 && cp <= 0xDBFF) {
+    if (highSurrogate_ != 0) Emit(0xFFFD);
+    highSurrogate_ = cp;
+    return;
+  }
+  if (cp >= 0xDC00 && cp <= 0xDFFF) {
+    if (highSurrogate_ == 0) {
+      cp = 0xFFFD;
+    } else {
+      cp = 0x10000 + ((highSurrogate_ - 0xD800) << 10) + (cp - 0xDC00);
+      highSurrogate_ = 0;
+    }
+  } else if (highSurrogate_ != 0) {
+    highSurrogate_ = 0;
+    Emit(0xFFFD);
+  }
+  if (cp == 0) return;
+  Emit(cp);
+}
+
+void RtfConverter::Emit(uint32_t cp) {
+  if (groups_.back().destination == Destination::FieldInstruction) {
+    char utf8[4];
+    const size_t length = EncodeUtf8(cp, utf8);
+    if (fieldInstruction_.size() + length <= kMaxFieldInstruction) {
+      fieldInstruction_.append(utf8, length);
+    }
+    return;
+  }
+  if (cp < 0x80) {
+    const char c = static_cast<char>(cp);
+    WriteAscii(&c, 1);
+    return;
+  }
+  StartContent();
+  FlushBlanks();
+  PutCodePoint(cp);
+}
+
+void RtfConverter::WriteAscii(const char* p, size_t n) {
+  StartContent();
+  if (output_ == RtfOutput::Html) {
+    PutEscaped(p, n);
+    return;
+  }
+  if (!trimTrailing_) {
+    Put(p, n);
+    return;
+  }
+  size_t content = n;
+  while (content > 0 && (p[content - 1] == ' ' || p[content - 1] == '\t')) content--;
+  if (content > 0) {
+    FlushBlanks();
+    Put(p, content);
+  }
+  blanks_.append(p + content, n - content);
+  if (blanks_.size() >= kMaxHeldBlanks) FlushBlanks();
+}
+
+void RtfConverter::Paragraph() {
+  const bool inTable = groups_.back().inTable;
+  if (output_ == RtfOutput::Text) {
+    // Paragraphs inside a table cell stay on the row's line.
+    if (inTable && cellSeparators_ == 0 && rowHasContent_) {
+      WriteAscii(" ", 1);
+    } else if (!inTable) {
+      Newline();
+    }
+    return;
+  }
+  if (inTable) {
+    if (cellOpen_ && cellHasContent_) Put("<br>");
+    return;
+  }
+  if (tableOpen_) CloseTable();
+  if (paragraphOpen_) {
+    CloseParagraph();
+  } else {
+    Put("<p>&nbsp;</p>\r\n");
+  }
+}
+
+void RtfConverter::LineBreak() {
+  if (output_ == RtfOutput::Text) {
+    if (groups_.back().inTable) {
+      WriteAscii(" ", 1);
+    } else {
+      Newline();
+    }
+    return;
+  }
+  StartContent();
+  Put("<br>");
+  previousSpace_ = true;
+}
+
+void RtfConverter::Tab() {
+  if (output_ == RtfOutput::Text) {
+    WriteAscii("\t", 1);
+    return;
+  }
+  StartContent();
+  Put("&emsp;");
+  previousSpace_ = true;
+}
+
+void RtfConverter::EndCell() {
+  if (output_ == RtfOutput::Text) {
+    // Cells are separated, not terminated, by tabs: they are written once the
+    // next cell has content.
+    cellSeparators_++;
+    return;
+  }
+  if (!cellOpen_) {
+    const bool inTable = groups_.back().inTable;
+    groups_.back().inTable = true;
+    StartContent();
+    groups_.back().inTable = inTable;
+  }
+  CloseFormat();
+  if (linkOpen_) CloseLink();
+  Put("</td>");
+  cellOpen_ = false;
+}
+
+void RtfConverter::EndRow() {
+  if (output_ == RtfOutput::Text) {
+    cellSeparators_ = 0;
+    rowHasContent_ = false;
+    Newline();
+    return;
+  }
+  if (cellOpen_) EndCell();
+  if (rowOpen_) {
+    Put("</tr>\r\n");
+    rowOpen_ = false;
+  }
+}
+
+// Opens whatever the next piece of text needs: a pending cell separator in
+// Text; the table, row and cell or the paragraph, the link and the character
+// formatting in Html.
+void RtfConverter::StartContent() {
+  const Group& group = groups_.back();
+  if (output_ == RtfOutput::Text) {
+    if (group.inTable) {
+      // Held like other blanks, so a row of empty cells leaves no tabs.
+      for (; cellSeparators_ > 0; cellSeparators_--) {
+        if (trimTrailing_) {
+          blanks_ += '\t';
+          if (blanks_.size() >= kMaxHeldBlanks) FlushBlanks();
+        } else {
+          Put("\t", 1);
+        }
+      }
+      rowHasContent_ = true;
+    }
+    return;
+  }
+  if (group.inTable) {
+    if (!tableOpen_) {
+      if (paragraphOpen_) CloseParagraph();
+      Put("<table>\r\n");
+      tableOpen_ = true;
+    }
+    if (!rowOpen_) {
+      Put("<tr>");
+      rowOpen_ = true;
+    }
+    if (!cellOpen_) {
+      Put("<td>");
+      cellOpen_ = true;
+      cellHasContent_ = false;
+      previousSpace_ = true;
+    }
+    cellHasContent_ = true;
+  } else {
+    if (tableOpen_) CloseTable();
+    if (!paragraphOpen_) {
+      Put("<p>");
+      paragraphOpen_ = true;
+      previousSpace_ = true;
+    }
+  }
+  if (group.link && !linkOpen_) {
+    CloseFormat();
+    Put("<a href=\"");
+    PutEscaped(linkHref_.data(), linkHref_.size());
+    Put("\">");
+    linkOpen_ = true;
+  }
+  SyncFormat();
+}
+
+// Tags are opened in kFormatTags order, so only those from the first one that
+// changes need to be closed and reopened.
+void RtfConverter::SyncFormat() {
+  const uint8_t want = groups_.back().format;
+  if (want == openFormat_) return;
+  size_t first = 0;
+  while (first < kFormatTagCount && ((want ^ openFormat_) & kFormatTags[first].bit) == 0) first++;
+  for (size_t i = kFormatTagCount; i-- > first;) {
+    if (openFormat_ & kFormatTags[i].bit) Put(kFormatTags[i].close);
+  }
+  for (size_t i = first; i < kFormatTagCount; i++) {
+    if (want & kFormatTags[i].bit) Put(kFormatTags[i].open);
+  }
+  openFormat_ = want;
+}
+
+void RtfConverter::CloseFormat() {
+  for (size_t i = kFormatTagCount; i-- > 0;) {
+    if (openFormat_ & kFormatTags[i].bit) Put(kFormatTags[i].close);
+  }
+  openFormat_ = 0;
+}
+
+void RtfConverter::CloseLink() {
+  CloseFormat();
+  Put("</a>");
+  linkOpen_ = false;
+}
+
+void RtfConverter::CloseParagraph() {
+  CloseFormat();
+  if (linkOpen_) CloseLink();
+  Put("</p>\r\n");
+  paragraphOpen_ = false;
+}
+
+void RtfConverter::CloseTable() {
+  if (cellOpen_) EndCell();
+  if (rowOpen_) {
+    Put("</tr>\r\n");
+    rowOpen_ = false;
+  }
+  Put("</table>\r\n");
+  tableOpen_ = false;
+}
+
+// HYPERLINK "url" [\l "anchor"] [\o "tooltip"] ...; other fields keep only
+// their result text.
+void RtfConverter::FieldInstructionDone() {
+  linkHref_.clear();
+  size_t pos = 0;
+  std::string token;
+  if (!NextFieldToken(fieldInstruction_, &pos, &token) || token != "HYPERLINK") return;
+  std::string url;
+  std::string anchor;
+  while (NextFieldToken(fieldInstruction_, &pos, &token)) {
+    if (token == "\\l") {
+      NextFieldToken(fieldInstruction_, &pos, &anchor);
+    } else if (token == "\\o" || token == "\\t") {
+      NextFieldToken(fieldInstruction_, &pos, &token);
+    } else if (token[0] != '\\' && url.empty()) {
+      url = token;
+    }
+  }
+  linkHref_ = url;
+  if (!anchor.empty()) linkHref_ += "#" + anchor;
+}
+
+// ---------------------------------------------------------------------------
+// Output.
+
+void RtfConverter::Put(const char* p, size_t n) {
+  while (n > 0) {
+    if (used_ == out_.size() && !Flush()) return;
+    const size_t take = n < out_.size() - used_ ? n : out_.size() - used_;
+    std::memcpy(out_.data() + used_, p, take);
+    used_ += take;
+    p += take;
+    n -= take;
+  }
+}
+
+// Html text: markup characters become references, and a space that follows
+// another (or starts a line) becomes &nbsp; so the RTF's spacing is kept.
+void RtfConverter::PutEscaped(const char* p, size_t n) {
+  size_t run = 0;
+  for (size_t i = 0; i < n; i++) {
+    const char c = p[i];
+    const char* reference = nullptr;
+    if (c == '&') {
+      reference = "&amp;";
+    } else if (c == '<') {
+      reference = "&lt;";
+    } else if (c == '>') {
+      reference = "&gt;";
+    } else if (c == '"') {
+      reference = "&quot;";
+    } else if (c == ' ' && previousSpace_) {
+      reference = "&nbsp;";
+    }
+    previousSpace_ = c == ' ';
+    if (!reference) continue;
+    Put(p + run, i - run);
+    Put(reference);
+    run = i + 1;
+  }
+  Put(p + run, n - run);
+}
+
+void RtfConverter::PutCodePoint(uint32_t cp) {
+  char utf8[4];
+  Put(utf8, EncodeUtf8(cp, utf8));
+  previousSpace_ = false;
+}
+
+void RtfConverter::Newline() {
+  blanks_.clear();
+  Put(newline_);
+}
+
+void RtfConverter::FlushBlanks() {
+  if (blanks_.empty()) return;
+  Put(blanks_);
+  blanks_.clear();
+}
+
+bool RtfConverter::Flush() {
+  if (used_ > 0 && ok_) {
+    ok_ = sink_->Write(reinterpret_cast<const uint8_t*>(out_.data()), used_);
+  }
+  used_ = 0;
+  return ok_;
+}
+
+bool ConvertRtf(std::string_view rtf, RtfOutput output, const TextEncodeOptions& options,
+                ByteSink* sink) {
+  RtfConverter converter(output, options, sink);
+  return converter.Feed(rtf.data(), rtf.size()) && converter.Finish();
+}
+
+} // namespace ptf_helper
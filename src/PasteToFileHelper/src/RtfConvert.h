@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ByteSink.h"
+#include "TextEncode.h"
+
+// RTF to plain text or HTML for the clipboard's "Rich Text Format" payload.
+// Portable (no Windows headers): a tokenizer state machine reads control
+// words, groups and escapes as the bytes arrive and writes the output as it
+// goes. The group stack, the buffers and the output chunk have fixed limits,
+// so memory use does not depend on the size of the document.
+
+namespace ptf_helper {
+
+enum class RtfOutput {
+  Text,  // UTF-8 plain text; TextEncodeOptions apply
+  Html,  // a UTF-8 HTML document
+};
+
+// Converts:
+//   - text, with \'hh and \uN escapes; \ucN fallbacks are skipped and
+//     surrogate pairs are joined
+//   - \'hh and 8-bit text in the code page of the current font (\fcharsetN or
+//     \cpgN in the font table), else of the document (\ansicpgN, \pc, \pca),
+//     else windows-1252; bytes in a code page without a table (double-byte,
+//     Mac) become U+FFFD
+//   - \par, \line, \tab and the named characters (\emdash, \bullet, \~, ...)
+//   - Html: \b, \i, \ul, \strike, \super and \sub to b/i/u/s/sup/sub,
+//     paragraphs to p, HYPERLINK fields to links and tables to table/tr/td
+//   - Text: table cells to tab-separated lines
+// Colour and style tables, pictures, objects, headers and footers and every
+// "\*" destination that is not understood are skipped, as is the font table
+// apart from code pages; \binN data is skipped by length.
+//
+// For Text, eol picks the line break (Keep writes CRLF, like clipboard text),
+// bom adds a UTF-8 BOM and trimTrailing drops blanks at line ends. Html
+// ignores the options.
+class RtfConverter {
+ public:
+  RtfConverter(RtfOutput output, const TextEncodeOptions& options, ByteSink* sink,
+               size_t chunkBytes = 1024 * 1024);
+  RtfConverter(const RtfConverter&) = delete;
+  RtfConverter& operator=(const RtfConverter&) = delete;
+
+  // RTF bytes, split anywhere. Returns false once the sink has failed.
+  bool Feed(const char* rtf, size_t size);
+
+  // Closes open formatting, links and tables, ends the document and flushes.
+  bool Finish();
+
+ private:
+  enum class Lex : uint8_t {
+    Text,
+    Backslash,
+    Word,
+    Param,
+    Hex1,
+    Hex2,
+    Binary,
+  };
+
+  enum class Destination : uint8_t {
+    Text,
+    Skip,
+    FieldInstruction,
+    FontTable,
+  };
+
+  // Character formatting bits, in the order the HTML tags are opened.
+  enum Format : uint8_t {
+    kBold = 1,
+    kItalic = 2,
+    kUnderline = 4,
+    kStrike = 8,
+    kSuper = 16,
+    kSub = 32,
+  };
+
+  struct Group {
+    Destination destination;
+    uint8_t format;
+    uint8_t unicodeSkip;  // \ucN: fallback characters after each \uN
+    bool inTable;         // \intbl
+    bool link;            // inside the result of a HYPERLINK field
+    int32_t font;         // \fN, or -1 for the default font (\deffN)
+  };
+
+  struct Font {
+    int32_t number;
+    uint32_t codePage;  // 0 when the font declares none
+  };
+
+  // Tokenizer.
+  size_t Lex1(const char* p, size_t n);
+  void OpenGroup();
+  void CloseGroup();
+  void ControlWord();
+  void ControlSymbol(char c);
+  bool SkipFallback();
+  void FontWord(int64_t value, bool charset);
+  const uint16_t* AnsiTable();
+
+  // Emitter.
+  void Text(const char* p, size_t n);
+  void Literal(const char* p, size_t n);
+  void CodePoint(uint32_t cp);
+  void Emit(uint32_t cp);
+  void WriteAscii(const char* p, size_t n);
+  void Paragraph();
+  void LineBreak();
+  void Tab();
+  void EndCell();
+  void EndRow();
+  void StartContent();
+  void SyncFormat();
+  void CloseFormat();
+  void CloseLink();
+  void CloseParagraph();
+  void CloseTable();
+  void FieldInstructionDone();
+
+  // Output.
+  void Put(const char* p, size_t n);
+  void Put(std::string_view s) { Put(s.data(), s.size()); }
+  void PutEscaped(const char* p, size_t n);
+  void PutCodePoint(uint32_t cp);
+  void Newline();
+  void FlushBlanks();
+  bool Flush();
+
+  RtfOutput output_;
+  ByteSink* sink_;
+  std::vector<char> out_;
+  size_t used_ = 0;
+  bool ok_ = true;
+  std::string_view newline_;
+  bool trimTrailing_;
+  std::string blanks_;  // trimTrailing: spaces and tabs not yet written
+
+  Lex lex_ = Lex::Text;
+  char word_[32] = {};
+  size_t wordLength_ = 0;
+  bool paramNegative_ = false;
+  bool hasParam_ = false;
+  int64_t param_ = 0;
+  int hex_ = 0;
+  uint64_t binaryLeft_ = 0;
+  bool ignorable_ = false;  // "\*" seen: an unknown destination is skipped
+  uint32_t fallbackLeft_ = 0;
+  uint32_t highSurrogate_ = 0;
+
+  std::vector<Group> groups_;
+  size_t overflowDepth_ = 0;  // groups nested past the stack limit
+  std::string fieldInstruction_;
+  std::string linkHref_;
+  size_t fieldInstructionDepth_ = 0;
+
+  // Code pages for \'hh: the font table, \deffN and \ansicpgN. The table for
+  // the current font is looked up again only when one of them changes.
+  std::vector<Font> fonts_;
+  int32_t defaultFont_ = -1;
+  uint32_t ansiCodePage_ = 0;
+  int32_t tableFont_ = -1;
+  bool tableValid_ = false;
+  const uint16_t* table_ = nullptr;
+
+  // Text: tabs owed to the next cell with content.
+  uint32_t cellSeparators_ = 0;
+  bool rowHasContent_ = false;
+
+  // Html state of what has been written.
+  bool paragraphOpen_ = false;
+  bool tableOpen_ = false;
+  bool rowOpen_ = false;
+  bool cellOpen_ = false;
+  bool cellHasContent_ = false;
+  bool linkOpen_ = false;
+  uint8_t openFormat_ = 0;
+  bool previousSpace_ = false;
+};
+
+// One-shot form for a payload that is already in memory.
+bool ConvertRtf(std::string_view rtf, RtfOutput output, const TextEncodeOptions& options,
+                ByteSink* sink);
+
+} // namespace ptf_helper
@@ -0,0 +1,97 @@
+#include "SaveFlow.h"
+
+#include <mutex>
+
+#include "ContentHash.h"
+
+namespace ptf_helper {
+
+namespace {
+
+// DedupStore is not thread-safe, and a lookup must see equal saves made on
+// other threads (history export) up to the moment they are recorded.
+std::mutex g_dedupMutex;
+
+// Set per save; callers read it on the thread that saved.
+thread_local bool t_lastSaveSkipped = false;
+
+// The same bytes saved under another extension are a different save.
+uint64_t DedupKey(const Xxh64& content, const std::wstring& extension) {
+  Xxh64 key(content.Digest());
+  key.Update(reinterpret_cast<const uint8_t*>(extension.data()),
+             extension.size() * sizeof(wchar_t));
+  return key.Digest();
+}
+
+} // namespace
+
+bool LastSaveSkipped() { return t_lastSaveSkipped; }
+
+std::wstring SaveLogMessage(const std::wstring& saved, const std::wstring& path) {
+  return t_lastSaveSkipped ? L"Already saved as " + path : saved + path;
+}
+
+SaveReport RunSave(SaveTarget* target, const SaveSettings& settings,
+                   const std::function<bool(ByteSink*)>& write) {
+  t_lastSaveSkipped = false;
+  SaveReport report;
+  ByteSink* file = target->Temp();
+  if (!file) return report;
+
+  // Hashing runs at several GB/s, but is only done when dedup needs it.
+  HashingSink hashed(file);
+  ByteSink* sink = settings.dedup != DedupMode::Off ? static_cast<ByteSink*>(&hashed) : file;
+  bool saved = false;
+  if (settings.compress) {
+    GzipSink gzip(sink, settings.gzip);
+    saved = write(&gzip) && gzip.Finish();
+    report.gzipInputBytes = gzip.InputBytes();
+    report.gzipOutputBytes = gzip.OutputBytes();
+  } else {
+    saved = write(sink);
+  }
+  if (saved && settings.durability != WriteDurability::Fast) saved = target->FlushTemp();
+  if (!saved) {
+    target->Discard();
+    report.result = SaveResult::WriteFailed;
+    return report;
+  }
+
+  std::unique_lock<std::mutex> dedupLock(g_dedupMutex, std::defer_lock);
+  uint64_t key = 0;
+  if (settings.dedup != DedupMode::Off) {
+    dedupLock.lock();
+    key = DedupKey(hashed.Hash(), settings.extension);
+    // Link falls back to a plain save where the file system has no hard links.
+    if (target->FindSaved(key, hashed.Hash().Bytes(), &report.existingPath)) {
+      if (settings.dedup == DedupMode::Skip) {
+        target->Discard();
+        t_lastSaveSkipped = true;
+        report.result = SaveResult::Skipped;
+        report.path = report.existingPath;
+        return report;
+      }
+      if (target->Link(report.existingPath, &report.path)) {
+        target->Discard();
+        if (settings.durability == WriteDurability::Paranoid) target->FlushDirectory();
+        report.result = SaveResult::Linked;
+        return report;
+      }
+      report.existingPath.clear();
+    }
+  }
+
+  if (!target->Commit(&report.path)) {
+    target->Discard();
+    report.result = SaveResult::NoName;
+    report.path.clear();
+    return report;
+  }
+  if (settings.durability == WriteDurability::Paranoid) target->FlushDirectory();
+  report.result = SaveResult::Written;
+  // Recorded once committed, so the index has the file's final write time.
+  if (dedupLock.owns_lock()) target->RecordSaved(key, report.path);
+  return report;
+}
+
+} // namespace ptf_helper
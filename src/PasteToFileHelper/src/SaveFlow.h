@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "ByteSink.h"
+#include "GzipSink.h"
+
+// The order of one save, apart from the file system that carries it out:
+// stream into a temp file, flush as the durability mode asks, then either
+// reuse a file with the same content (dedup) or give the temp file its final
+// name, deleting it whatever goes wrong. FileSink runs it on Win32 handles.
+// Portable (no Windows headers).
+
+namespace ptf_helper {
+
+// What a save waits for before its file appears under the final name.
+enum class WriteDurability {
+  Fast,      // nothing: the rename is atomic, but after a power loss the file may be empty
+  Safe,      // the data is flushed to disk before the rename
+  Paranoid,  // as Safe, and the directory is flushed after the rename
+};
+
+// What a save does when the folder already holds a file with the same bytes
+// (saved earlier with dedup on; see DedupStore).
+enum class DedupMode {
+  Off,   // always write a new file
+  Skip,  // write nothing: the existing file stands for the save
+  Link,  // give the save its own name as a hard link to the existing file
+};
+
+// The file operations of one save in its target folder.
+class SaveTarget {
+ public:
+  virtual ~SaveTarget() = default;
+
+  // The temp file the save streams into; null when it could not be created.
+  virtual ByteSink* Temp() = 0;
+  // Flushes the temp file's data to disk.
+  virtual bool FlushTemp() = 0;
+  // Renames the temp file to the first free name for the save, never
+  // replacing a file; `path` gets the name.
+  virtual bool Commit(std::wstring* path) = 0;
+  // Creates the first free name as a hard link to `existingPath`.
+  virtual bool Link(const std::wstring& existingPath, std::wstring* path) = 0;
+  // Deletes the temp file.
+  virtual void Discard() = 0;
+  // Makes the folder's entries (renames, links) durable.
+  virtual void FlushDirectory() = 0;
+  // The folder's dedup index. Both are called under one process-wide lock,
+  // held from the lookup until the save is recorded.
+  virtual bool FindSaved(uint64_t key, uint64_t size, std::wstring* existingPath) = 0;
+  virtual void RecordSaved(uint64_t key, const std::wstring& path) = 0;
+};
+
+struct SaveSettings {
+  WriteDurability durability = WriteDurability::Fast;
+  DedupMode dedup = DedupMode::Off;
+  bool compress = false;  // write through a GzipSink with `gzip`
+  GzipOptions gzip;
+  std::wstring extension;  // of the final name; part of the dedup key
+};
+
+enum class SaveResult {
+  NoTempFile,
+  WriteFailed,  // the write, the gzip stream or the flush failed
+  NoName,       // Commit failed
+  Written,      // under a new name
+  Linked,       // a new name, linked to an earlier file with the same content
+  Skipped,      // nothing: an earlier file has the same content
+};
+
+struct SaveReport {
+  SaveResult result = SaveResult::NoTempFile;
+  std::wstring path;            // the new name; for Skipped, the earlier file
+  std::wstring existingPath;    // Linked and Skipped: the earlier file
+  uint64_t gzipInputBytes = 0;  // when compressed
+  uint64_t gzipOutputBytes = 0;
+};
+
+// Runs one save: `write` streams the content into the sink it is given. The
+// temp file is gone afterwards, renamed or deleted, and no existing file is
+// ever replaced.
+SaveReport RunSave(SaveTarget* target, const SaveSettings& settings,
+                   const std::function<bool(ByteSink*)>& write);
+
+// Whether the last RunSave on this thread wrote nothing because dedup (Skip)
+// found the content already saved; its path then names that earlier file.
+bool LastSaveSkipped();
+
+// The log line for a save: `saved` followed by the path, or "Already saved as
+// <path>" when LastSaveSkipped().
+std::wstring SaveLogMessage(const std::wstring& saved, const std::wstring& path);
+
+} // namespace ptf_helper
@@ -0,0 +1,217 @@
+#include "TextEncode.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "PasteToFileCommon/Utf.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define PTF_TEXT_SSE2 1
+#include <emmintrin.h>
+#else
+#define PTF_TEXT_SSE2 0
+#endif
+
+namespace ptf_helper {
+
+namespace {
+
+// Index of the first byte >= 0x80 in [p, p + n), or n.
+size_t AsciiLength(const char* p, size_t n) {
+  size_t i = 0;
+#if PTF_TEXT_SSE2
+  for (; i + 16 <= n; i += 16) {
+    if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))) != 0) break;
+  }
+#endif
+  for (; i < n; i++) {
+    if (static_cast<unsigned char>(p[i]) >= 0x80) return i;
+  }
+  return n;
+}
+
+// Collects UTF-8 in a fixed buffer and hands it to the sink whenever it fills.
+// Narrow input is UTF-8 (copied) or, with a table, a single-byte code page.
+class ChunkWriter {
+ public:
+  ChunkWriter(ByteSink* sink, size_t capacity, const uint16_t* table = nullptr)
+      : sink_(sink), buffer_(capacity < 4 ? 4 : capacity), table_(table) {}
+
+  bool Text(const wchar_t* p, size_t n) {
+    while (n > 0) {
+      // Segments end at line breaks or before trailing blanks, never inside a
+      // surrogate pair, so each can be converted as complete input.
+      ptf::UtfChunkResult r = ptf::WideToUtf8Chunk(p, n, buffer_.data() + used_,
+                                                   buffer_.size() - used_, true);
+      used_ += r.written;
+      p += r.consumed;
+      n -= r.consumed;
+      if (n > 0 && !Flush()) return false;
+    }
+    return true;
+  }
+
+  bool Text(const char* p, size_t n) {
+    while (n > 0) {
+      if (buffer_.size() - used_ < 3 && !Flush()) return false;
+      char* out = buffer_.data() + used_;
+      const size_t room = buffer_.size() - used_;
+      size_t i = 0;
+      size_t o = 0;
+      if (!table_) {
+        i = o = n < room ? n : room;
+        std::memcpy(out, p, i);
+      } else {
+        while (i < n && room - o >= 3) {
+          const size_t limit = n - i < room - o ? n - i : room - o;
+          const size_t run = AsciiLength(p + i, limit);
+          std::memcpy(out + o, p + i, run);
+          i += run;
+          o += run;
+          if (run == limit || room - o < 3) continue;
+          const uint32_t c = table_[static_cast<unsigned char>(p[i++]) - 0x80];
+          if (c < 0x800) {
+            out[o++] = static_cast<char>(0xC0 | (c >> 6));
+          } else {
+            out[o++] = static_cast<char>(0xE0 | (c >> 12));
+            out[o++] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+          }
+          out[o++] = static_cast<char>(0x80 | (c & 0x3F));
+        }
+      }
+      used_ += o;
+      p += i;
+      n -= i;
+    }
+    return true;
+  }
+
+  bool Bytes(const char* p, size_t n) {
+    if (buffer_.size() - used_ < n && !Flush()) return false;
+    std::memcpy(buffer_.data() + used_, p, n);
+    used_ += n;
+    return true;
+  }
+
+  bool Flush() {
+    const bool ok = sink_->Write(reinterpret_cast<const uint8_t*>(buffer_.data()), used_);
+    used_ = 0;
+    return ok;
+  }
+
+ private:
+  ByteSink* sink_;
+  std::vector<char> buffer_;
+  const uint16_t* table_;
+  size_t used_ = 0;
+};
+
+// Index of the first CR or LF in [p, p + n), or n.
+template <typename Unit>
+size_t FindLineBreak(const Unit* p, size_t n) {
+  size_t i = 0;
+#if PTF_TEXT_SSE2
+  if constexpr (sizeof(Unit) == 1) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; i + 16 <= n; i += 16) {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(a, lf))) != 0) {
+        break;
+      }
+    }
+  } else if constexpr (sizeof(Unit) == 2) {
+    const __m128i cr = _mm_set1_epi16('\r');
+    const __m128i lf = _mm_set1_epi16('\n');
+    for (; i + 16 <= n; i += 16) {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 8));
+      const __m128i hitsA = _mm_or_si128(_mm_cmpeq_epi16(a, cr), _mm_cmpeq_epi16(a, lf));
+      const __m128i hitsB = _mm_or_si128(_mm_cmpeq_epi16(b, cr), _mm_cmpeq_epi16(b, lf));
+      if (_mm_movemask_epi8(_mm_or_si128(hitsA, hitsB)) != 0) break;
+    }
+  } else {
+    const __m128i cr = _mm_set1_epi32('\r');
+    const __m128i lf = _mm_set1_epi32('\n');
+    for (; i + 8 <= n; i += 8) {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 4));
+      const __m128i hitsA = _mm_or_si128(_mm_cmpeq_epi32(a, cr), _mm_cmpeq_epi32(a, lf));
+      const __m128i hitsB = _mm_or_si128(_mm_cmpeq_epi32(b, cr), _mm_cmpeq_epi32(b, lf));
+      if (_mm_movemask_epi8(_mm_or_si128(hitsA, hitsB)) != 0) break;
+    }
+  }
+#endif
+  // The block that stopped the vector loop, or the tail.
+  for (; i < n; i++) {
+    if (p[i] == '\r' || p[i] == '\n') return i;
+  }
+  return n;
+}
+
+constexpr size_t kRunUnits = 8 * 1024;
+
+template <typename Unit>
+bool EncodeLines(const Unit* p, size_t n, const TextEncodeOptions& options, ChunkWriter& out) {
+  if (options.bom && !out.Bytes("\xEF\xBB\xBF", 3)) return false;
+  if (options.Plain()) return out.Text(p, n) && out.Flush();
+
+  // Lines that need no change are not written one by one: `run` marks the
+  // start of unchanged text that goes to the transcoder in one piece, once it
+  // is long enough to be worth the call but still in cache from the scan.
+  size_t run = 0;
+  size_t pos = 0;
+  while (pos < n) {
+    const size_t lineEnd = pos + FindLineBreak(p + pos, n - pos);
+    size_t contentEnd = lineEnd;
+    if (options.trimTrailing) {
+      while (contentEnd > pos && (p[contentEnd - 1] == ' ' || p[contentEnd - 1] == '\t')) {
+        contentEnd--;
+      }
+    }
+    if (lineEnd == n) {
+      if (!out.Text(p + run, contentEnd - run)) return false;
+      run = n;
+      break;
+    }
+
+    const bool cr = p[lineEnd] == '\r';
+    const size_t breakLength = cr && lineEnd + 1 < n && p[lineEnd + 1] == '\n' ? 2 : 1;
+    const char* eol = nullptr;
+    if (options.eol == EolMode::Lf && cr) eol = "\n";
+    if (options.eol == EolMode::Crlf && breakLength == 1) eol = "\r\n";
+    if (contentEnd != lineEnd && !eol) {
+      eol = breakLength == 2 ? "\r\n" : cr ? "\r" : "\n";
+    }
+    if (eol) {
+      if (!out.Text(p + run, contentEnd - run) || !out.Bytes(eol, std::strlen(eol))) {
+        return false;
+      }
+      run = lineEnd + breakLength;
+    }
+    pos = lineEnd + breakLength;
+    if (pos - run >= kRunUnits) {
+      if (!out.Text(p + run, pos - run)) return false;
+      run = pos;
+    }
+  }
+  if (run < n && !out.Text(p + run, n - run)) return false;
+  return out.Flush();
+}
+
+} // namespace
+
+bool EncodeUtf8Text(std::wstring_view text, const TextEncodeOptions& options, ByteSink* sink,
+                    size_t chunkBytes) {
+  ChunkWriter out(sink, chunkBytes);
+  return EncodeLines(text.data(), text.size(), options, out);
+}
+
+bool EncodeNarrowText(std::string_view text, const uint16_t* table,
+                      const TextEncodeOptions& options, ByteSink* sink, size_t chunkBytes) {
+  ChunkWriter out(sink, chunkBytes, table);
+  return EncodeLines(text.data(), text.size(), options, out);
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "ByteSink.h"
+
+// Writes wide or narrow text to a ByteSink as UTF-8, applying the optional clean-ups in
+// the same pass as the transcoding. Portable (no Windows headers).
+
+namespace ptf_helper {
+
+enum class EolMode {
+  Keep,  // line breaks are written as they are
+  Lf,    // CRLF and lone CR become LF
+  Crlf,  // LF and lone CR become CRLF
+};
+
+struct TextEncodeOptions {
+  EolMode eol = EolMode::Keep;
+  bool bom = false;           // start the file with EF BB BF
+  bool trimTrailing = false;  // drop spaces and tabs at the end of every line
+
+  bool Plain() const { return eol == EolMode::Keep && !trimTrailing; }
+};
+
+// Output goes to the sink in chunks of about `chunkBytes`, so memory use does
+// not depend on the size of the text. With Plain() options the text is only
+// transcoded; otherwise it is also scanned for line breaks, 8 or 16 code units
+// at a time.
+bool EncodeUtf8Text(std::wstring_view text, const TextEncodeOptions& options, ByteSink* sink,
+                    size_t chunkBytes = 1024 * 1024);
+
+// The same for 8-bit text: with a null `table` the bytes are UTF-8 and are
+// copied; otherwise `table` (from SingleByteCodePage) maps bytes 0x80-0xFF and
+// ASCII runs are copied 16 bytes at a time.
+bool EncodeNarrowText(std::string_view text, const uint16_t* table,
+                      const TextEncodeOptions& options, ByteSink* sink,
+                      size_t chunkBytes = 1024 * 1024);
+
+} // namespace ptf_helper
@@ -1,32 +1,55 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "TextEncode.h"
+
+#include "PasteToFileCommon/NameTemplate.h"
+
 namespace ptf_helper {
 
+// Text is transcoded to UTF-8 and written in fixed-size chunks, so it can be
+// passed straight from locked clipboard memory (see ClipboardTextLock).
+// `options` selects line-break, BOM and trailing-blank handling.
 bool WriteUtf8TextFileUnique(const std::wstring& targetDir,
                              const std::wstring& extensionWithDot,
-                             const std::wstring& text,
-                             std::wstring* outPath);
+                             std::wstring_view text,
+                             std::wstring* outPath,
+                             const TextEncodeOptions& options = {});
+
+// 8-bit clipboard text (CF_TEXT/CF_OEMTEXT): UTF-8 as it is when `table` is
+// null, otherwise converted through a SingleByteCodePage() table.
+bool WriteNarrowTextFileUnique(const std::wstring& targetDir,
+                               const std::wstring& extensionWithDot,
+                               std::string_view text,
+                               const uint16_t* table,
+                               std::wstring* outPath,
+                               const TextEncodeOptions& options = {});
 
+// `compressible` lets large data (RTF, not images) be gzipped; see
+// SetOutputCompression. Text is always compressible.
 bool WriteBinaryFileUnique(const std::wstring& targetDir,
                            const std::wstring& extensionWithDot,
                            const std::vector<uint8_t>& bytes,
-                           std::wstring* outPath);
+                           std::wstring* outPath,
+                           bool compressible = false);
 
-// Same as above, but uses an explicit base file name (without extension).
-// Example baseName: "PTF-2026-feb-23-HIST-0001"
-bool WriteUtf8TextFileUniqueWithBase(const std::wstring& targetDir,
-                                     const std::wstring& baseName,
+// Same as above, but named from explicit fields, e.g. a history item's
+// (ptf::CurrentNameFields(1) gives "PTF-2026-feb-23-HIST-0001" by default).
+bool WriteUtf8TextFileUniqueWithName(const std::wstring& targetDir,
+                                     const ptf::NameFields& name,
                                      const std::wstring& extensionWithDot,
-                                     const std::wstring& text,
-                                     std::wstring* outPath);
+                                     std::wstring_view text,
+                                     std::wstring* outPath,
+                                     const TextEncodeOptions& options = {});
 
-bool WriteBinaryFileUniqueWithBase(const std::wstring& targetDir,
-                                   const std::wstring& baseName,
+bool WriteBinaryFileUniqueWithName(const std::wstring& targetDir,
+                                   const ptf::NameFields& name,
                                    const std::wstring& extensionWithDot,
                                    const std::vector<uint8_t>& bytes,
-                                   std::wstring* outPath);
+                                   std::wstring* outPath,
+                                   bool compressible = false);
 
 } // namespace ptf_helper
@@ -0,0 +1,62 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace ptf_helper {
+
+unsigned ThreadPool::DefaultThreadCount() {
+  unsigned n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+  if (threadCount == 0) threadCount = DefaultThreadCount();
+  workers_.reserve(threadCount);
+  for (unsigned i = 0; i < threadCount; i++) {
+    workers_.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& t : workers_) t.join();
+}
+
+void ThreadPool::Enqueue(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queued_ == jobs_.size()) {
+      std::vector<std::function<void()>> grown(std::max<size_t>(16, jobs_.size() * 2));
+      for (size_t i = 0; i < queued_; i++) {
+        grown[i] = std::move(jobs_[(head_ + i) % jobs_.size()]);
+      }
+      jobs_.swap(grown);
+      head_ = 0;
+    }
+    jobs_[(head_ + queued_) % jobs_.size()] = std::move(job);
+    queued_++;
+  }
+  cv_.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stopping_ || queued_ > 0; });
+      if (queued_ == 0) return;  // stopping and drained
+      job = std::move(jobs_[head_]);
+      jobs_[head_] = nullptr;
+      head_ = (head_ + 1) % jobs_.size();
+      queued_--;
+    }
+    job();
+  }
+}
+
+} // namespace ptf_helper
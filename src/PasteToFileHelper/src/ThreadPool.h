@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Minimal fixed-size worker pool. Portable (std::thread only).
+
+namespace ptf_helper {
+
+class ThreadPool {
+ public:
+  // threadCount == 0 picks std::thread::hardware_concurrency().
+  explicit ThreadPool(unsigned threadCount);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned Size() const { return static_cast<unsigned>(workers_.size()); }
+
+  template <typename Fn>
+  auto Submit(Fn fn) -> std::future<decltype(fn())> {
+    using Result = decltype(fn());
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+    std::future<Result> result = task->get_future();
+    Enqueue([task]() { (*task)(); });
+    return result;
+  }
+
+  // Runs `job`, which must not throw, without a future. Once the queue has
+  // grown to its working size this allocates nothing for a callable that
+  // fits std::function's inline storage (a lambda capturing one pointer).
+  void Post(std::function<void()> job) { Enqueue(std::move(job)); }
+
+  static unsigned DefaultThreadCount();
+
+ private:
+  void Enqueue(std::function<void()> job);
+  void WorkerLoop();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  // Ring buffer of queued jobs; grows when full and keeps its size.
+  std::vector<std::function<void()>> jobs_;
+  size_t head_ = 0;
+  size_t queued_ = 0;
+  std::vector<std::thread> workers_;
+  bool stopping_ = false;
+};
+
+} // namespace ptf_helper
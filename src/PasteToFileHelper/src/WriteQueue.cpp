@@ -0,0 +1,43 @@
+#include "WriteQueue.h"
+
+namespace ptf_helper {
+
+WriteQueue::WriteQueue(unsigned writers, size_t maxBytesInFlight)
+    : maxBytes_(maxBytesInFlight), pool_(writers) {}
+
+WriteQueue::~WriteQueue() { Wait(); }
+
+void WriteQueue::Submit(size_t bytes, std::function<bool()> job) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&]() {
+      return maxBytes_ == 0 || jobsInFlight_ == 0 || bytesInFlight_ + bytes <= maxBytes_;
+    });
+    bytesInFlight_ += bytes;
+    jobsInFlight_++;
+  }
+  // The future is not kept: completion is tracked by the counters above.
+  pool_.Submit([this, bytes, job = std::move(job)]() {
+    // A throwing job (out of memory) counts as failed rather than never ending.
+    bool ok = false;
+    try {
+      ok = job();
+    } catch (...) {
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      bytesInFlight_ -= bytes;
+      jobsInFlight_--;
+      if (!ok) failed_ = true;
+    }
+    done_.notify_all();
+  });
+}
+
+bool WriteQueue::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this]() { return jobsInFlight_ == 0; });
+  return !failed_;
+}
+
+} // namespace ptf_helper
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+#include "ThreadPool.h"
+
+// Lets multi-file saves (history export, "Save All") overlap reading and
+// encoding the next item with writing the previous ones. Portable (std::thread
+// only): the caller produces jobs that each write one file, and a few writer
+// threads run them, so several writes are in flight while the caller works.
+
+namespace ptf_helper {
+
+class WriteQueue {
+ public:
+  // `maxBytesInFlight` bounds the data held by queued and running jobs, as
+  // declared to Submit(); 0 = no limit.
+  WriteQueue(unsigned writers, size_t maxBytesInFlight);
+  ~WriteQueue();
+  WriteQueue(const WriteQueue&) = delete;
+  WriteQueue& operator=(const WriteQueue&) = delete;
+
+  // Runs `job` on a writer thread. Blocks first while `bytes` more would go
+  // over the budget; a job larger than the whole budget waits until nothing
+  // else is in flight.
+  void Submit(size_t bytes, std::function<bool()> job);
+
+  // Waits for every job submitted so far; true when all of them succeeded.
+  bool Wait();
+
+ private:
+  size_t maxBytes_;
+  std::mutex mutex_;
+  std::condition_variable done_;
+  size_t bytesInFlight_ = 0;
+  size_t jobsInFlight_ = 0;
+  bool failed_ = false;
+  ThreadPool pool_;  // last: its workers stop before the members they use
+};
+
+} // namespace ptf_helper
@@ -1,8 +1,17 @@
 #include <windows.h>
+#include <psapi.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
+#include <cwchar>
+#include <cwctype>
 #include <limits>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include <winrt/Windows.ApplicationModel.DataTransfer.h>
@@ -10,12 +19,22 @@
 #include <winrt/base.h>
 
 #include "ClipboardRead.h"
+#include "CodePage.h"
+#include "FileSink.h"
+#include "HtmlFormat.h"
+#include "HtmlMarkdown.h"
 #include "ImageWritePng.h"
+#include "ImageSniff.h"
+#include "ImageWriteQoi.h"
+#include "PngReoptimize.h"
+#include "RtfConvert.h"
 #include "TextWrite.h"
+#include "WriteQueue.h"
 
 #include "PasteToFileCommon/ClipboardFormats.h"
 #include "PasteToFileCommon/Filename.h"
 #include "PasteToFileCommon/Logging.h"
+#include "PasteToFileCommon/Utf.h"
 
 namespace {
 
@@ -25,7 +44,10 @@ enum class Action {
   TextMd,
   Html,
   Rtf,
+  RtfTxt,
+  RtfHtml,
   ImagePng,
+  ImageQoi,
   SaveAll,
   HistoryAll,
   ClearAll,
@@ -42,72 +64,312 @@ static std::wstring GetArgValue(int argc, wchar_t** argv, const wchar_t* name) {
   return L"";
 }
 
+// Command-line value, falling back to an environment variable so settings also
+// apply when the helper is launched by the shell extension.
+static std::wstring GetOptionValue(int argc, wchar_t** argv, const wchar_t* name,
+                                   const wchar_t* envName) {
+  std::wstring value = GetArgValue(argc, argv, name);
+  if (!value.empty()) return value;
+  wchar_t buf[256]{};
+  DWORD n = GetEnvironmentVariableW(envName, buf, ARRAYSIZE(buf));
+  if (n == 0 || n >= ARRAYSIZE(buf)) return L"";
+  return buf;
+}
+
+// Per-action form of GetOptionValue: "--eol-text-md" / PTF_EOL_TEXT_MD wins over
+// "--eol" / PTF_EOL when the helper runs --action text-md.
+static std::wstring GetActionOptionValue(int argc, wchar_t** argv, const wchar_t* name,
+                                         const wchar_t* envName, std::wstring actionName) {
+  if (actionName.empty()) actionName = L"auto";
+  std::wstring envSuffix;
+  for (wchar_t c : actionName) envSuffix += c == L'-' ? L'_' : static_cast<wchar_t>(towupper(c));
+  std::wstring value = GetOptionValue(argc, argv, (std::wstring(name) + L"-" + actionName).c_str(),
+                                      (std::wstring(envName) + L"_" + envSuffix).c_str());
+  if (!value.empty()) return value;
+  return GetOptionValue(argc, argv, name, envName);
+}
+
+static bool IsOn(const std::wstring& v) {
+  return _wcsicmp(v.c_str(), L"on") == 0 || _wcsicmp(v.c_str(), L"1") == 0;
+}
+
+// Parses a whole decimal number in [minValue, maxValue]. False, with `value`
+// untouched, for empty, non-numeric, trailing-garbage or out-of-range input.
+static bool ParseInteger(const std::wstring& s, long long minValue, long long maxValue,
+                         long long* value) {
+  if (s.empty()) return false;
+  errno = 0;
+  wchar_t* end = nullptr;
+  const long long parsed = wcstoll(s.c_str(), &end, 10);
+  if (errno == ERANGE || end == s.c_str() || *end != L'\0') return false;
+  if (parsed < minValue || parsed > maxValue) return false;
+  *value = parsed;
+  return true;
+}
+
+// Upper bound for --threads, whatever the core count.
+constexpr unsigned kMaxThreads = 64;
+
+// Upper bound for --mem-budget-mb (1 TiB), far below where scaling to bytes
+// could overflow.
+constexpr long long kMaxMemBudgetMb = 1024 * 1024;
+
+// Upper bound for --gzip-above-mb (1 PiB), for the same reason.
+constexpr long long kMaxGzipAboveMb = 1024LL * 1024 * 1024;
+
 static Action ParseAction(const std::wstring& s) {
   if (_wcsicmp(s.c_str(), L"auto") == 0) return Action::AutoBest;
   if (_wcsicmp(s.c_str(), L"text-txt") == 0) return Action::TextTxt;
   if (_wcsicmp(s.c_str(), L"text-md") == 0) return Action::TextMd;
   if (_wcsicmp(s.c_str(), L"html") == 0) return Action::Html;
   if (_wcsicmp(s.c_str(), L"rtf") == 0) return Action::Rtf;
+  if (_wcsicmp(s.c_str(), L"rtf-txt") == 0) return Action::RtfTxt;
+  if (_wcsicmp(s.c_str(), L"rtf-html") == 0) return Action::RtfHtml;
   if (_wcsicmp(s.c_str(), L"png") == 0) return Action::ImagePng;
+  if (_wcsicmp(s.c_str(), L"qoi") == 0) return Action::ImageQoi;
   if (_wcsicmp(s.c_str(), L"all") == 0) return Action::SaveAll;
   if (_wcsicmp(s.c_str(), L"history-all") == 0) return Action::HistoryAll;
   if (_wcsicmp(s.c_str(), L"clear-all") == 0) return Action::ClearAll;
   return Action::AutoBest;
 }
 
-// HTML clipboard format includes a header; try to extract the actual HTML section.
-static std::vector<uint8_t> ExtractHtmlPayloadOrOriginal(const std::vector<uint8_t>& bytes) {
-  auto asString = std::string(bytes.begin(), bytes.end());
-  auto findNum = [&](const char* key) -> int {
-    size_t pos = asString.find(key);
-    if (pos == std::string::npos) return -1;
-    pos += strlen(key);
-    while (pos < asString.size() && (asString[pos] == ' ')) pos++;
-    int val = 0;
-    bool any = false;
-    while (pos < asString.size() && asString[pos] >= '0' && asString[pos] <= '9') {
-      any = true;
-      val = (val * 10) + (asString[pos] - '0');
-      pos++;
-    }
-    return any ? val : -1;
-  };
+// Line-break, BOM and trailing-blank handling for plain text (.txt/.md) files.
+// Set from --eol, --bom and --trim-trailing; HTML and RTF are never changed.
+static ptf_helper::TextEncodeOptions g_textOptions;
 
-  int startHtml = findNum("StartHTML:");
-  int endHtml = findNum("EndHTML:");
-  if (startHtml >= 0 && endHtml > startHtml &&
-      endHtml <= static_cast<int>(bytes.size())) {
-    return std::vector<uint8_t>(bytes.begin() + startHtml, bytes.begin() + endHtml);
+// Which part of the "HTML Format" data is saved or converted. Set from
+// --html-part; the default keeps the page as the source app framed it.
+static ptf_helper::HtmlPart g_htmlPart = ptf_helper::HtmlPart::Document;
+
+static std::string_view BytesView(const std::vector<uint8_t>& bytes) {
+  return std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+// " (source: <url>)" when the app said where the HTML came from.
+static std::wstring HtmlSourceNote(const ptf_helper::HtmlFormat& header) {
+  if (header.sourceUrl.empty()) return L"";
+  return L" (source: " + ptf::Utf8ToWide(header.sourceUrl) + L")";
+}
+
+// Writes the selected part of "HTML Format" data straight from `data`; the
+// header is only read, never copied.
+static bool SaveHtmlWithName(const std::wstring& dir, const ptf::NameFields& name,
+                             std::string_view data) {
+  ptf_helper::HtmlFormat header;
+  std::string_view html = ptf_helper::SelectHtmlPart(data, g_htmlPart, &header);
+  std::wstring outPath;
+  bool ok = ptf_helper::WriteStreamFileUniqueWithName(
+      dir, name, L".html",
+      [&](ptf_helper::ByteSink* sink) {
+        return sink->Write(reinterpret_cast<const uint8_t*>(html.data()), html.size());
+      },
+      &outPath, html.size());
+  if (ok) {
+    ptf::LogLine(ptf_helper::SaveLogMessage(L"Saved HTML: ", outPath) + HtmlSourceNote(header));
   }
+  return ok;
+}
 
-  return bytes;
+static bool SaveClipboardHtml(const std::wstring& dir) {
+  auto html = ptf_helper::ReadClipboardHtmlFormat();
+  return html && SaveHtmlWithName(dir, ptf::CurrentNameFields(), BytesView(html->bytes));
+}
+
+static ptf_helper::EolMode ParseEolMode(const std::wstring& s) {
+  if (_wcsicmp(s.c_str(), L"lf") == 0) return ptf_helper::EolMode::Lf;
+  if (_wcsicmp(s.c_str(), L"crlf") == 0) return ptf_helper::EolMode::Crlf;
+  return ptf_helper::EolMode::Keep;
+}
+
+// Streams the clipboard text from its locked memory into the file. `found`
+// reports whether there was text at all. Lossless 8-bit text that is UTF-8 or
+// in a single-byte code page is converted here; anything else is saved from
+// CF_UNICODETEXT.
+static bool SaveClipboardText(const std::wstring& dir, const std::wstring& ext, bool* found) {
+  ptf_helper::ClipboardTextLock text;
+  *found = text.Acquire();
+  if (!*found) return false;
+  std::wstring outPath;
+  if (text.IsNarrow()) {
+    const bool utf8 = text.Encoding() == ptf_helper::NarrowTextEncoding::Utf8;
+    const uint16_t* table = utf8 ? nullptr : ptf_helper::SingleByteCodePage(text.CodePage());
+    bool ok = ptf_helper::WriteNarrowTextFileUnique(dir, ext, text.Narrow(), table, &outPath,
+                                                    g_textOptions);
+    if (ok) {
+      const std::wstring source =
+          utf8 ? std::wstring(L"UTF-8") : L"code page " + std::to_wstring(text.CodePage());
+      ptf::LogLine(ptf_helper::SaveLogMessage(L"Saved text (" + source + L"): ", outPath));
+    }
+    return ok;
+  }
+  bool ok = ptf_helper::WriteUtf8TextFileUnique(dir, ext, text.Text(), &outPath, g_textOptions);
+  if (ok) ptf::LogLine(ptf_helper::SaveLogMessage(L"Saved text: ", outPath));
+  return ok;
 }
 
-static bool SaveText(const std::wstring& dir, const std::wstring& ext, const std::wstring& text) {
+// "Markdown (.md)" converts the HTML format when there is one, so links,
+// headings, lists and tables survive; otherwise the plain text is saved as is.
+static bool SaveClipboardMarkdown(const std::wstring& dir, bool* found) {
+  auto html = ptf_helper::ReadClipboardHtmlFormat();
+  if (!html) return SaveClipboardText(dir, L".md", found);
+  *found = true;
+  ptf_helper::HtmlFormat header;
+  std::string_view source = ptf_helper::SelectHtmlPart(BytesView(html->bytes), g_htmlPart, &header);
   std::wstring outPath;
-  bool ok = ptf_helper::WriteUtf8TextFileUnique(dir, ext, text, &outPath);
-  if (ok) ptf::LogLine(L"Saved text: " + outPath);
+  bool ok = ptf_helper::WriteStreamFileUniqueWithName(
+      dir, ptf::CurrentNameFields(), L".md",
+      [&](ptf_helper::ByteSink* sink) {
+        return ptf_helper::ConvertHtmlToMarkdown(source, g_textOptions, sink);
+      },
+      &outPath, source.size());
+  if (ok) {
+    ptf::LogLine(ptf_helper::SaveLogMessage(L"Saved Markdown from HTML: ", outPath) +
+                 HtmlSourceNote(header));
+  }
+  return ok;
+}
+
+// "RTF as text" / "RTF as HTML" convert the RTF format as it is written out,
+// for apps (WordPad, Outlook, Visual Studio) whose plain text loses tables or
+// whose HTML is missing.
+static bool SaveClipboardRtfConverted(const std::wstring& dir, ptf_helper::RtfOutput output) {
+  auto rtf = ptf_helper::ReadClipboardRtfFormat();
+  if (!rtf) return false;
+  std::string_view source = BytesView(rtf->bytes);
+  const bool html = output == ptf_helper::RtfOutput::Html;
+  std::wstring outPath;
+  bool ok = ptf_helper::WriteStreamFileUniqueWithName(
+      dir, ptf::CurrentNameFields(), html ? L".html" : L".txt",
+      [&](ptf_helper::ByteSink* sink) {
+        return ptf_helper::ConvertRtf(source, output, g_textOptions, sink);
+      },
+      &outPath, source.size());
+  if (ok) {
+    ptf::LogLine(ptf_helper::SaveLogMessage(
+        html ? L"Saved HTML from RTF: " : L"Saved text from RTF: ", outPath));
+  }
   return ok;
 }
 
 static bool SaveBytes(const std::wstring& dir, const std::wstring& ext, const std::vector<uint8_t>& bytes) {
   std::wstring outPath;
-  bool ok = ptf_helper::WriteBinaryFileUnique(dir, ext, bytes, &outPath);
-  if (ok) ptf::LogLine(L"Saved bytes: " + outPath);
+  bool ok = ptf_helper::WriteBinaryFileUnique(dir, ext, bytes, &outPath, true);
+  if (ok) ptf::LogLine(ptf_helper::SaveLogMessage(L"Saved bytes: ", outPath));
   return ok;
 }
 
-static bool SaveImagePng(const std::wstring& dir, HBITMAP hbm) {
+enum class ImageFileType {
+  Png,
+  Qoi,
+};
+
+// Bytes of pixels copied per band when an image has to be read out of GDI
+// (0 = whole image at once). Set from --mem-budget-mb.
+static size_t g_imageBandBytes = 0;
+
+// PNGs encoded by this run, for the optional re-optimization pass.
+static std::vector<std::wstring> g_savedPngs;
+
+static bool SaveImagePixels(const std::wstring& dir, ImageFileType type,
+                            const ptf_helper::PixelSource& pixels) {
   std::wstring outPath;
-  bool ok = ptf_helper::WritePngFileUniqueFromHbitmap(dir, hbm, &outPath);
-  if (ok) ptf::LogLine(L"Saved png: " + outPath);
+  bool ok = type == ImageFileType::Qoi
+                ? ptf_helper::WriteQoiFileUniqueFromPixels(dir, pixels, &outPath)
+                : ptf_helper::WritePngFileUniqueFromPixels(dir, pixels, &outPath);
+  if (ok) {
+    ptf::LogLine(ptf_helper::SaveLogMessage(
+        type == ImageFileType::Qoi ? L"Saved qoi: " : L"Saved png: ", outPath));
+    if (type == ImageFileType::Png && !ptf_helper::LastSaveSkipped()) {
+      g_savedPngs.push_back(outPath);
+    }
+  }
   return ok;
 }
 
-static std::wstring HistoryBaseName(int index1Based) {
-  wchar_t buf[96]{};
-  swprintf_s(buf, L"%s-HIST-%04d", ptf::BuildDatedBaseName().c_str(), index1Based);
-  return buf;
+static bool SaveImageBands(const std::wstring& dir, ImageFileType type,
+                           ptf_helper::PixelBandReader* reader, uint32_t bandRows) {
+  std::wstring outPath;
+  bool ok = type == ImageFileType::Qoi
+                ? ptf_helper::WriteQoiFileUniqueFromBands(dir, reader, bandRows, &outPath)
+                : ptf_helper::WritePngFileUniqueFromBands(dir, reader, bandRows, &outPath);
+  if (ok) {
+    ptf::LogLine(ptf_helper::SaveLogMessage(
+        type == ImageFileType::Qoi ? L"Saved qoi: " : L"Saved png: ", outPath));
+    if (type == ImageFileType::Png && !ptf_helper::LastSaveSkipped()) {
+      g_savedPngs.push_back(outPath);
+    }
+  }
+  return ok;
+}
+
+// A BI_PNG/BI_JPEG DIB carries an encoded stream instead of pixels. PNG is
+// written as-is, JPEG as-is when `allowJpeg` and through WIC for the png action.
+static bool SaveEmbeddedDibImage(const std::wstring& dir, ImageFileType type, bool allowJpeg,
+                                 const ptf_helper::DibDecoder& dib) {
+  const std::vector<uint8_t> bytes(dib.EmbeddedData(), dib.EmbeddedData() + dib.EmbeddedSize());
+  std::wstring outPath;
+  bool ok = false;
+  if (type == ImageFileType::Qoi) {
+    ptf::LogLine(L"Clipboard DIB holds an encoded image; not converting it to qoi");
+    return false;
+  }
+  const bool isPng = dib.Embedded() == ptf_helper::ImageContainer::Png;
+  if (isPng || allowJpeg) {
+    ok = ptf_helper::WriteBinaryFileUnique(
+        dir, ptf_helper::ImageContainerExtension(dib.Embedded()), bytes, &outPath);
+    if (ok) ptf::LogLine(ptf_helper::SaveLogMessage(L"Saved encoded image: ", outPath));
+  } else {
+    ok = ptf_helper::WritePngFileUniqueFromEncodedImageBytesWithName(
+        dir, ptf::CurrentNameFields(), bytes, &outPath);
+    if (ok) ptf::LogLine(ptf_helper::SaveLogMessage(L"Saved png: ", outPath));
+  }
+  if (ok && (isPng || !allowJpeg) && !ptf_helper::LastSaveSkipped()) {
+    g_savedPngs.push_back(outPath);
+  }
+  return ok;
+}
+
+// Writes an image the source application already encoded byte for byte when
+// the clipboard offers one ("PNG"/"image/png", or "JFIF" with `allowJpeg`).
+// Otherwise encodes straight from the locked clipboard DIB when its layout
+// allows, or decodes it band by band (DibDecoder), and falls back to reading
+// CF_BITMAP band by band. `found` reports whether an image could be read at all.
+static bool SaveClipboardImage(const std::wstring& dir, ImageFileType type, bool allowJpeg,
+                               bool* found) {
+  *found = false;
+  if (type == ImageFileType::Png) {
+    auto encoded = ptf_helper::ReadClipboardEncodedImage(allowJpeg);
+    if (encoded) {
+      *found = true;
+      std::wstring outPath;
+      bool ok = ptf_helper::WriteBinaryFileUnique(
+          dir, ptf_helper::ImageContainerExtension(encoded->container), encoded->bytes, &outPath);
+      if (ok) ptf::LogLine(ptf_helper::SaveLogMessage(L"Saved encoded image: ", outPath));
+      return ok;
+    }
+  }
+  {
+    ptf_helper::ClipboardDibLock dib;
+    if (dib.Acquire()) {
+      *found = true;
+      if (dib.InPlace()) return SaveImagePixels(dir, type, dib.Pixels());
+      ptf_helper::DibDecoder& decoder = dib.Decoder();
+      if (decoder.Embedded() != ptf_helper::ImageContainer::Unknown) {
+        return SaveEmbeddedDibImage(dir, type, allowJpeg, decoder);
+      }
+      return SaveImageBands(dir, type, &decoder,
+                            ptf_helper::BandRowsForBudget(g_imageBandBytes,
+                                                          static_cast<size_t>(decoder.Width()) * 4,
+                                                          decoder.Height()));
+    }
+  }
+
+  ptf_helper::ClipboardBitmapLock bitmap;
+  if (!bitmap.Acquire()) return false;
+  ptf_helper::HbitmapBandReader reader(bitmap.Bitmap());
+  if (!reader.Open(g_imageBandBytes)) return false;
+  *found = true;
+  return SaveImageBands(dir, type, &reader, reader.BandRows());
 }
 
 static std::vector<uint8_t> ReadAllBytesFromRandomAccessStream(
@@ -131,7 +393,55 @@ static std::vector<uint8_t> ReadAllBytesFromRandomAccessStream(
   return bytes;
 }
 
-static bool SaveClipboardHistoryAll(const std::wstring& targetDir) {
+// How history bitmaps are written: Keep stores PNG/JPEG/GIF/... bytes as they
+// are under their own extension; Png transcodes everything that is not already
+// a PNG. Unrecognized containers are always transcoded.
+enum class HistoryImageMode {
+  Keep,
+  Png,
+};
+
+static HistoryImageMode ParseHistoryImageMode(const std::wstring& s) {
+  if (_wcsicmp(s.c_str(), L"png") == 0) return HistoryImageMode::Png;
+  return HistoryImageMode::Keep;
+}
+
+// Multi-file saves ("all", history export) hand finished data to a few writer
+// threads so the next item is read and encoded while earlier files are written
+// (a network folder spends most of each save waiting on round trips). Data
+// waiting to be written is bounded by g_imageBandBytes.
+constexpr unsigned kWriteQueueWriters = 4;
+
+// WIC and the PNG encoder stay on this thread; only writing the file is queued.
+static bool QueueHistoryImage(ptf_helper::WriteQueue* queue, const std::wstring& targetDir,
+                              const ptf::NameFields& name, std::vector<uint8_t> bytes,
+                              HistoryImageMode mode) {
+  auto container = ptf_helper::SniffImageContainer(bytes.data(), bytes.size());
+  bool passThrough = container == ptf_helper::ImageContainer::Png ||
+                     (mode == HistoryImageMode::Keep &&
+                      container != ptf_helper::ImageContainer::Unknown);
+  ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
+                    L"[Helper] history-all: bitmap container=" +
+                        std::to_wstring(static_cast<int>(container)) +
+                        (passThrough ? L" (as is)" : L" (transcode)"));
+  std::wstring ext = L".png";
+  auto file = std::make_shared<std::vector<uint8_t>>();
+  if (passThrough) {
+    ext = ptf_helper::ImageContainerExtension(container);
+    *file = std::move(bytes);
+  } else {
+    ptf_helper::MemorySink png;
+    if (!ptf_helper::EncodePngFromEncodedImageBytes(bytes, &png)) return false;
+    *file = std::move(png.bytes);
+  }
+  queue->Submit(file->size(), [targetDir, name, ext, file]() {
+    return ptf_helper::WriteBinaryFileUniqueWithName(targetDir, name, ext, *file, nullptr);
+  });
+  return true;
+}
+
+static bool SaveClipboardHistoryAll(const std::wstring& targetDir,
+                                    HistoryImageMode imageMode) {
   using namespace winrt::Windows::ApplicationModel::DataTransfer;
 
   ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
@@ -154,33 +464,40 @@ static bool SaveClipboardHistoryAll(const std::wstring& targetDir) {
 
     bool any = false;
     bool allOk = true;
+    // On an exception its destructor still waits for the queued writes.
+    ptf_helper::WriteQueue queue(kWriteQueueWriters, g_imageBandBytes);
 
     for (uint32_t i = 0; i < count; i++) {
       int index1 = static_cast<int>(i) + 1;
       auto item = items.GetAt(i);
       auto content = item.Content();
-      std::wstring baseName = HistoryBaseName(index1);
+      const ptf::NameFields name = ptf::CurrentNameFields(index1);
 
       if (content.Contains(StandardDataFormats::Text())) {
         any = true;
-        auto text = content.GetTextAsync().get();
-        allOk = ptf_helper::WriteUtf8TextFileUniqueWithBase(
-                    targetDir, baseName, L".txt", text.c_str(), nullptr) &&
-                allOk;
+        winrt::hstring text = content.GetTextAsync().get();
+        queue.Submit(text.size() * sizeof(wchar_t), [&targetDir, name, text]() {
+          return ptf_helper::WriteUtf8TextFileUniqueWithName(targetDir, name, L".txt", text,
+                                                             nullptr, g_textOptions);
+        });
       }
       if (content.Contains(StandardDataFormats::Html())) {
         any = true;
-        auto html = content.GetHtmlFormatAsync().get();
-        allOk = ptf_helper::WriteUtf8TextFileUniqueWithBase(
-                    targetDir, baseName, L".html", html.c_str(), nullptr) &&
-                allOk;
+        // History hands back the whole "HTML Format" block, header included;
+        // its offsets count UTF-8 bytes.
+        auto html = std::make_shared<std::string>(
+            ptf::WideToUtf8(content.GetHtmlFormatAsync().get()));
+        queue.Submit(html->size(), [&targetDir, name, html]() {
+          return SaveHtmlWithName(targetDir, name, *html);
+        });
       }
       if (content.Contains(StandardDataFormats::Rtf())) {
         any = true;
-        auto rtf = content.GetRtfAsync().get();
-        allOk = ptf_helper::WriteUtf8TextFileUniqueWithBase(
-                    targetDir, baseName, L".rtf", rtf.c_str(), nullptr) &&
-                allOk;
+        winrt::hstring rtf = content.GetRtfAsync().get();
+        queue.Submit(rtf.size() * sizeof(wchar_t), [&targetDir, name, rtf]() {
+          return ptf_helper::WriteUtf8TextFileUniqueWithName(targetDir, name, L".rtf", rtf,
+                                                             nullptr);
+        });
       }
       if (content.Contains(StandardDataFormats::Bitmap())) {
         any = true;
@@ -190,15 +507,15 @@ static bool SaveClipboardHistoryAll(const std::wstring& targetDir) {
         if (bytes.empty()) {
           ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
                             L"[Helper] history-all: bitmap empty");
-          allOk = false && allOk;
+          allOk = false;
         } else {
-          allOk = ptf_helper::WritePngFileUniqueFromEncodedImageBytesWithBase(
-                      targetDir, baseName, bytes, nullptr) &&
+          allOk = QueueHistoryImage(&queue, targetDir, name, std::move(bytes), imageMode) &&
                   allOk;
         }
       }
     }
 
+    allOk = queue.Wait() && allOk;
     return any && allOk;
   } catch (const winrt::hresult_error& e) {
     ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
@@ -209,6 +526,14 @@ static bool SaveClipboardHistoryAll(const std::wstring& targetDir) {
   }
 }
 
+static void LogPeakWorkingSet(const std::wstring& action) {
+  PROCESS_MEMORY_COUNTERS pmc{};
+  pmc.cb = sizeof(pmc);
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return;
+  ptf::LogLine(L"Peak working set: " + std::to_wstring(pmc.PeakWorkingSetSize / (1024 * 1024)) +
+               L" MB (action=" + (action.empty() ? L"auto" : action) + L")");
+}
+
 static bool ClearClipboardAndHistory() {
   using namespace winrt::Windows::ApplicationModel::DataTransfer;
 
@@ -251,12 +576,113 @@ int wmain(int argc, wchar_t** argv) {
   ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
                     L"[Helper] start argc=" + std::to_wstring(argc));
 
-  Action action = ParseAction(GetArgValue(argc, argv, L"--action"));
+  std::wstring actionName = GetArgValue(argc, argv, L"--action");
+  Action action = ParseAction(actionName);
   ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
                     L"[Helper] action=" +
                         std::to_wstring(static_cast<int>(action)) +
                         L" (parsed)");
 
+  ptf_helper::PngEncodeOptions pngOptions;
+  std::wstring threads = GetOptionValue(argc, argv, L"--threads", L"PTF_THREADS");
+  if (!threads.empty()) {
+    // At most one per core (and never more than kMaxThreads); 0, negative and
+    // non-numeric values keep the default of one per core.
+    long long threadCount = 0;
+    if (ParseInteger(threads, 1, std::numeric_limits<long long>::max(), &threadCount)) {
+      unsigned cores = std::thread::hardware_concurrency();
+      if (cores == 0) cores = 1;
+      pngOptions.threads = static_cast<unsigned>(
+          std::min<long long>(threadCount, std::min(cores, kMaxThreads)));
+    } else {
+      ptf::LogLine(L"Ignoring --threads " + threads + L": expected a number from 1 to " +
+                   std::to_wstring(kMaxThreads));
+    }
+  }
+
+  // Helper-owned image buffers: half for the band being encoded, half for the
+  // PNG encoder's in-flight segments. The clipboard's own copy is not counted.
+  size_t memBudgetMb = 256;
+  std::wstring memBudget = GetOptionValue(argc, argv, L"--mem-budget-mb", L"PTF_MEM_BUDGET_MB");
+  if (!memBudget.empty()) {
+    long long mb = 0;
+    if (ParseInteger(memBudget, 0, kMaxMemBudgetMb, &mb)) {
+      memBudgetMb = static_cast<size_t>(mb);
+    } else {
+      ptf::LogLine(L"Ignoring --mem-budget-mb " + memBudget + L": expected a number from 0 to " +
+                   std::to_wstring(kMaxMemBudgetMb));
+    }
+  }
+  g_imageBandBytes = memBudgetMb * 1024 * 1024 / 2;
+  pngOptions.memoryBudget = g_imageBandBytes;
+  ptf_helper::SetPngEncodeOptions(pngOptions);
+
+  // Text, HTML and RTF saves at least this large are written as .gz; unset
+  // (the default) never compresses.
+  ptf_helper::OutputCompression compression;
+  compression.gzip.threads = pngOptions.threads;
+  std::wstring gzipAbove =
+      GetActionOptionValue(argc, argv, L"--gzip-above-mb", L"PTF_GZIP_ABOVE_MB", actionName);
+  if (!gzipAbove.empty()) {
+    long long mb = 0;
+    if (ParseInteger(gzipAbove, 0, kMaxGzipAboveMb, &mb)) {
+      compression.minBytes = static_cast<uint64_t>(mb) * 1024 * 1024;
+    } else {
+      ptf::LogLine(L"Ignoring --gzip-above-mb " + gzipAbove + L": expected a number from 0 to " +
+                   std::to_wstring(kMaxGzipAboveMb));
+    }
+  }
+  ptf_helper::SetOutputCompression(compression);
+
+  std::wstring durability = GetOptionValue(argc, argv, L"--durability", L"PTF_DURABILITY");
+  if (_wcsicmp(durability.c_str(), L"safe") == 0) {
+    ptf_helper::SetWriteDurability(ptf_helper::WriteDurability::Safe);
+  } else if (_wcsicmp(durability.c_str(), L"paranoid") == 0) {
+    ptf_helper::SetWriteDurability(ptf_helper::WriteDurability::Paranoid);
+  } else if (!durability.empty() && _wcsicmp(durability.c_str(), L"fast") != 0) {
+    ptf::LogLine(L"Ignoring --durability " + durability + L": expected fast, safe or paranoid");
+  }
+
+  std::wstring dedup = GetActionOptionValue(argc, argv, L"--dedup", L"PTF_DEDUP", actionName);
+  if (_wcsicmp(dedup.c_str(), L"skip") == 0) {
+    ptf_helper::SetDedupMode(ptf_helper::DedupMode::Skip);
+  } else if (_wcsicmp(dedup.c_str(), L"link") == 0) {
+    ptf_helper::SetDedupMode(ptf_helper::DedupMode::Link);
+  } else if (!dedup.empty() && _wcsicmp(dedup.c_str(), L"off") != 0) {
+    ptf::LogLine(L"Ignoring --dedup " + dedup + L": expected off, skip or link");
+  }
+
+  std::wstring nameTemplate = GetActionOptionValue(argc, argv, L"--name-template",
+                                                   L"PTF_NAME_TEMPLATE", actionName);
+  if (!nameTemplate.empty()) {
+    ptf::NameTemplate name;
+    std::wstring error;
+    if (name.Compile(nameTemplate, &error)) {
+      ptf_helper::SetNameTemplate(name);
+    } else {
+      ptf::LogLine(L"Ignoring --name-template: " + error);
+    }
+  }
+
+  std::wstring reoptimize = GetOptionValue(argc, argv, L"--reoptimize", L"PTF_REOPTIMIZE");
+  bool reoptimizePngs = IsOn(reoptimize);
+
+  g_textOptions.eol = ParseEolMode(
+      GetActionOptionValue(argc, argv, L"--eol", L"PTF_EOL", actionName));
+  g_textOptions.bom = IsOn(GetActionOptionValue(argc, argv, L"--bom", L"PTF_BOM", actionName));
+  g_textOptions.trimTrailing = IsOn(
+      GetActionOptionValue(argc, argv, L"--trim-trailing", L"PTF_TRIM_TRAILING", actionName));
+
+  std::wstring htmlPart = GetOptionValue(argc, argv, L"--html-part", L"PTF_HTML_PART");
+  if (_wcsicmp(htmlPart.c_str(), L"fragment") == 0) {
+    g_htmlPart = ptf_helper::HtmlPart::Fragment;
+  } else if (!htmlPart.empty() && _wcsicmp(htmlPart.c_str(), L"document") != 0) {
+    ptf::LogLine(L"Ignoring --html-part " + htmlPart + L": expected document or fragment");
+  }
+
+  HistoryImageMode historyImages = ParseHistoryImageMode(
+      GetOptionValue(argc, argv, L"--history-images", L"PTF_HISTORY_IMAGES"));
+
   std::wstring targetDir = GetArgValue(argc, argv, L"--target");
   if (targetDir.empty() && action != Action::ClearAll) {
     ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
@@ -273,31 +699,24 @@ int wmain(int argc, wchar_t** argv) {
                     L"[Helper] clipboard avail text=" + std::to_wstring(avail.hasText) +
                         L" html=" + std::to_wstring(avail.hasHtml) +
                         L" rtf=" + std::to_wstring(avail.hasRtf) +
-                        L" img=" + std::to_wstring(avail.hasImage));
+                        L" img=" + std::to_wstring(avail.hasImage) +
+                        L" png=" + std::to_wstring(avail.hasPng) +
+                        L" jfif=" + std::to_wstring(avail.hasJpeg));
 
   auto doAuto = [&]() -> bool {
     if (avail.hasImage) {
-      auto hbm = ptf_helper::ReadClipboardImageAsHbitmap();
-      if (!hbm) return false;
-      bool ok = SaveImagePng(targetDir, *hbm);
-      DeleteObject(*hbm);
-      return ok;
-    }
-    if (avail.hasHtml) {
-      auto html = ptf_helper::ReadClipboardHtmlFormat();
-      if (!html) return false;
-      auto payload = ExtractHtmlPayloadOrOriginal(html->bytes);
-      return SaveBytes(targetDir, L".html", payload);
+      bool found = false;
+      return SaveClipboardImage(targetDir, ImageFileType::Png, true, &found);
     }
+    if (avail.hasHtml) return SaveClipboardHtml(targetDir);
     if (avail.hasRtf) {
       auto rtf = ptf_helper::ReadClipboardRtfFormat();
       if (!rtf) return false;
       return SaveBytes(targetDir, L".rtf", rtf->bytes);
     }
     if (avail.hasText) {
-      auto text = ptf_helper::ReadClipboardText();
-      if (!text) return false;
-      return SaveText(targetDir, L".txt", text->text);
+      bool found = false;
+      return SaveClipboardText(targetDir, L".txt", &found);
     }
     return false;
   };
@@ -308,70 +727,90 @@ int wmain(int argc, wchar_t** argv) {
       ok = doAuto();
       break;
     case Action::TextTxt: {
-      auto text = ptf_helper::ReadClipboardText();
-      ok = text && SaveText(targetDir, L".txt", text->text);
+      bool found = false;
+      ok = SaveClipboardText(targetDir, L".txt", &found);
       break;
     }
     case Action::TextMd: {
-      auto text = ptf_helper::ReadClipboardText();
-      ok = text && SaveText(targetDir, L".md", text->text);
+      bool found = false;
+      ok = SaveClipboardMarkdown(targetDir, &found);
       break;
     }
-    case Action::Html: {
-      auto html = ptf_helper::ReadClipboardHtmlFormat();
-      ok = html && SaveBytes(targetDir, L".html", ExtractHtmlPayloadOrOriginal(html->bytes));
+    case Action::Html:
+      ok = SaveClipboardHtml(targetDir);
       break;
-    }
     case Action::Rtf: {
       auto rtf = ptf_helper::ReadClipboardRtfFormat();
       ok = rtf && SaveBytes(targetDir, L".rtf", rtf->bytes);
       break;
     }
+    case Action::RtfTxt:
+      ok = SaveClipboardRtfConverted(targetDir, ptf_helper::RtfOutput::Text);
+      break;
+    case Action::RtfHtml:
+      ok = SaveClipboardRtfConverted(targetDir, ptf_helper::RtfOutput::Html);
+      break;
     case Action::ImagePng: {
-      auto hbm = ptf_helper::ReadClipboardImageAsHbitmap();
-      ok = hbm && SaveImagePng(targetDir, *hbm);
-      if (hbm) DeleteObject(*hbm);
+      bool found = false;
+      ok = SaveClipboardImage(targetDir, ImageFileType::Png, false, &found);
+      break;
+    }
+    case Action::ImageQoi: {
+      bool found = false;
+      ok = SaveClipboardImage(targetDir, ImageFileType::Qoi, false, &found);
       break;
     }
     case Action::SaveAll: {
       bool any = false;
       bool allOk = true;
 
-      if (avail.hasText) {
-        auto text = ptf_helper::ReadClipboardText();
-        if (text) {
-          any = true;
-          allOk = SaveText(targetDir, L".txt", text->text) && allOk;
-        }
-      }
+      // HTML and RTF are copied out of the clipboard and written on the queue
+      // while the text streams from its locked memory and the image encodes.
+      ptf_helper::WriteQueue queue(kWriteQueueWriters, g_imageBandBytes);
       if (avail.hasHtml) {
         auto html = ptf_helper::ReadClipboardHtmlFormat();
         if (html) {
           any = true;
-          allOk = SaveBytes(targetDir, L".html", ExtractHtmlPayloadOrOriginal(html->bytes)) && allOk;
+          auto data = std::make_shared<ptf_helper::ClipboardBytes>(std::move(*html));
+          const ptf::NameFields name = ptf::CurrentNameFields();
+          queue.Submit(data->bytes.size(), [&targetDir, name, data]() {
+            return SaveHtmlWithName(targetDir, name, BytesView(data->bytes));
+          });
         }
       }
       if (avail.hasRtf) {
         auto rtf = ptf_helper::ReadClipboardRtfFormat();
         if (rtf) {
           any = true;
-          allOk = SaveBytes(targetDir, L".rtf", rtf->bytes) && allOk;
+          auto data = std::make_shared<ptf_helper::ClipboardBytes>(std::move(*rtf));
+          queue.Submit(data->bytes.size(), [&targetDir, data]() {
+            return SaveBytes(targetDir, L".rtf", data->bytes);
+          });
+        }
+      }
+      if (avail.hasText) {
+        bool found = false;
+        bool saved = SaveClipboardText(targetDir, L".txt", &found);
+        if (found) {
+          any = true;
+          allOk = saved && allOk;
         }
       }
       if (avail.hasImage) {
-        auto hbm = ptf_helper::ReadClipboardImageAsHbitmap();
-        if (hbm) {
+        bool found = false;
+        bool saved = SaveClipboardImage(targetDir, ImageFileType::Png, true, &found);
+        if (found) {
           any = true;
-          allOk = SaveImagePng(targetDir, *hbm) && allOk;
-          DeleteObject(*hbm);
+          allOk = saved && allOk;
         }
       }
 
+      allOk = queue.Wait() && allOk;
       ok = any && allOk;
       break;
     }
     case Action::HistoryAll:
-      ok = SaveClipboardHistoryAll(targetDir);
+      ok = SaveClipboardHistoryAll(targetDir, historyImages);
       break;
     case Action::ClearAll:
       ok = ClearClipboardAndHistory();
@@ -382,6 +821,14 @@ int wmain(int argc, wchar_t** argv) {
     ptf::LogLineDebug(GetModuleHandleW(nullptr), L"ptf-debug.log",
                       L"[Helper] failed");
   }
+  ptf_helper::EndPngWriteSession();
+  LogPeakWorkingSet(actionName);
+
+  if (reoptimizePngs && !g_savedPngs.empty()) {
+    // The paste itself is done; recompress at background CPU and I/O priority.
+    SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN);
+    for (const auto& path : g_savedPngs) ptf_helper::ReoptimizePngFile(path, g_imageBandBytes);
+  }
   winrt::uninit_apartment();
   return ok ? 0 : 1;
 }
@@ -18,11 +18,14 @@ constexpr UINT kCmdTextTxt = 1;
 constexpr UINT kCmdTextMd = 2;
 constexpr UINT kCmdHtml = 3;
 constexpr UINT kCmdRtf = 4;
-constexpr UINT kCmdPng = 5;
-constexpr UINT kCmdAll = 6;
-constexpr UINT kCmdHistoryAll = 7;
-constexpr UINT kCmdClearAll = 8;
-constexpr UINT kCmdCount = 9;
+constexpr UINT kCmdRtfTxt = 5;
+constexpr UINT kCmdRtfHtml = 6;
+constexpr UINT kCmdPng = 7;
+constexpr UINT kCmdQoi = 8;
+constexpr UINT kCmdAll = 9;
+constexpr UINT kCmdHistoryAll = 10;
+constexpr UINT kCmdClearAll = 11;
+constexpr UINT kCmdCount = 12;
 
 static void InsertItem(HMENU menu, const wchar_t* text, UINT id, bool enabled = true) {
   MENUITEMINFOW mii{};
@@ -200,8 +203,15 @@ STDMETHODIMP CPasteToFileContextMenu::QueryContextMenu(HMENU hMenu, UINT indexMe
       InsertItem(asPopup, L"Markdown (.md)", idCmdFirst + kCmdTextMd, true);
     }
     if (avail.hasHtml) InsertItem(asPopup, L"HTML (.html)", idCmdFirst + kCmdHtml, true);
-    if (avail.hasRtf) InsertItem(asPopup, L"RTF (.rtf)", idCmdFirst + kCmdRtf, true);
-    if (avail.hasImage) InsertItem(asPopup, L"Image (PNG)", idCmdFirst + kCmdPng, true);
+    if (avail.hasRtf) {
+      InsertItem(asPopup, L"RTF (.rtf)", idCmdFirst + kCmdRtf, true);
+      InsertItem(asPopup, L"RTF as Text (.txt)", idCmdFirst + kCmdRtfTxt, true);
+      InsertItem(asPopup, L"RTF as HTML (.html)", idCmdFirst + kCmdRtfHtml, true);
+    }
+    if (avail.hasImage) {
+      InsertItem(asPopup, L"Image (PNG)", idCmdFirst + kCmdPng, true);
+      InsertItem(asPopup, L"Image (QOI)", idCmdFirst + kCmdQoi, true);
+    }
 
     InsertPopup(rootPopup, L"Paste as...", asPopup);
 
@@ -262,7 +272,10 @@ STDMETHODIMP CPasteToFileContextMenu::InvokeCommand(LPCMINVOKECOMMANDINFO pici)
     case kCmdTextMd: action = L"text-md"; break;
     case kCmdHtml: action = L"html"; break;
     case kCmdRtf: action = L"rtf"; break;
+    case kCmdRtfTxt: action = L"rtf-txt"; break;
+    case kCmdRtfHtml: action = L"rtf-html"; break;
     case kCmdPng: action = L"png"; break;
+    case kCmdQoi: action = L"qoi"; break;
     case kCmdAll: action = L"all"; break;
     case kCmdHistoryAll: action = L"history-all"; break;
     case kCmdClearAll: action = L"clear-all"; break;
@@ -0,0 +1,174 @@
+// Banded image reads: a 16384 x 8192 DIB (512 MB once decoded to RGBA) is
+// decoded and PNG-encoded in bands, and the process's peak RSS may grow by
+// no more than the band budget plus a fixed allowance. Smaller images check
+// that band size never changes the output.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "DibDecode.h"
+#include "PngEncoder.h"
+#include "QoiEncoder.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+void Put16(std::vector<uint8_t>* out, uint32_t v) {
+  out->push_back(static_cast<uint8_t>(v));
+  out->push_back(static_cast<uint8_t>(v >> 8));
+}
+
+void Put32(std::vector<uint8_t>* out, uint32_t v) {
+  Put16(out, v & 0xFFFF);
+  Put16(out, v >> 16);
+}
+
+// A bottom-up 4-bit palettized packed DIB with screenshot-like content:
+// horizontal bars, a side panel and scattered "text" pixels.
+std::vector<uint8_t> MakeDib4(uint32_t width, uint32_t height, uint32_t seed) {
+  std::vector<uint8_t> dib;
+  Put32(&dib, 40);  // BITMAPINFOHEADER
+  Put32(&dib, width);
+  Put32(&dib, height);
+  Put16(&dib, 1);
+  Put16(&dib, 4);
+  Put32(&dib, 0);  // BI_RGB
+  Put32(&dib, 0);
+  Put32(&dib, 2835);
+  Put32(&dib, 2835);
+  Put32(&dib, 16);
+  Put32(&dib, 0);
+  for (uint32_t i = 0; i < 16; i++) Put32(&dib, (i * 0x0F0F0F) ^ 0x203040);
+
+  const size_t stride = ((static_cast<size_t>(width) * 4 + 31) / 32) * 4;
+  const size_t header = dib.size();
+  dib.resize(header + stride * height);
+  Random random(seed);
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t* row = &dib[header + static_cast<size_t>(y) * stride];
+    const uint8_t bar = static_cast<uint8_t>((y / 64) % 3);
+    for (uint32_t x = 0; x < width; x += 2) {
+      uint8_t hi = x < width / 6 ? 5 : bar, lo = hi;
+      if ((y / 12) % 2 == 0 && random.Below(4) == 0) hi = 15;
+      if ((y / 12) % 2 == 0 && random.Below(4) == 0) lo = 15;
+      row[x / 2] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+  }
+  return dib;
+}
+
+class CountingSink : public ByteSink {
+ public:
+  bool Write(const uint8_t*, size_t size) override {
+    bytes += size;
+    return true;
+  }
+  size_t bytes = 0;
+};
+
+#if defined(__linux__)
+size_t PeakRssBytes() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;  // KiB on Linux
+}
+#endif
+
+// Band size must not change what is written.
+void TestBandsMatchWholeImage() {
+  const std::vector<uint8_t> dib = MakeDib4(301, 157, 4);
+  DibDecoder whole;
+  CHECK(whole.Open(dib.data(), dib.size()));
+  PixelSource all;
+  CHECK(whole.ReadBand(0, whole.Height(), &all));
+  std::vector<uint8_t> pixels(all.stride * all.height);
+  for (uint32_t y = 0; y < all.height; y++) {
+    std::memcpy(&pixels[y * all.stride], all.Row(y), all.stride);
+  }
+  PixelSource source = all;
+  source.pixels = pixels.data();
+  source.bottomUp = false;
+
+  for (bool reduce : {false, true}) {
+    PngEncodeOptions options;
+    options.reduceColors = reduce;
+    options.threads = 1;
+    MemorySink expected;
+    CHECK(EncodePng(source, &expected, options));
+    for (uint32_t bandRows : {1u, 7u, 64u, 157u, 1000u}) {
+      DibDecoder reader;
+      CHECK(reader.Open(dib.data(), dib.size()));
+      MemorySink actual;
+      CHECK(EncodePngBands(&reader, bandRows, &actual, options));
+      CHECK(actual.bytes == expected.bytes);
+    }
+  }
+
+  MemorySink expectedQoi;
+  CHECK(EncodeQoi(source, &expectedQoi));
+  for (uint32_t bandRows : {1u, 10u, 157u}) {
+    DibDecoder reader;
+    CHECK(reader.Open(dib.data(), dib.size()));
+    MemorySink actual;
+    CHECK(EncodeQoiBands(&reader, bandRows, &actual));
+    CHECK(actual.bytes == expectedQoi.bytes);
+  }
+}
+
+void TestBandRowsForBudget() {
+  CHECK(BandRowsForBudget(0, 4000, 100) == 100);
+  CHECK(BandRowsForBudget(1, 4000, 100) == 1);
+  CHECK(BandRowsForBudget(40000, 4000, 100) == 10);
+  CHECK(BandRowsForBudget(size_t{1} << 40, 4000, 100) == 100);
+}
+
+// The helper's default budget is 256 MB; a tighter one makes the ceiling
+// meaningful against the 512 MB a whole-image decode would need.
+void TestGiantDibUnderRssCeiling() {
+#if defined(__linux__)
+  constexpr uint32_t kWidth = 16384;
+  constexpr uint32_t kHeight = 8192;
+  constexpr size_t kBudget = 32u << 20;
+  constexpr size_t kAllowance = 48u << 20;  // code, allocator slack, deflate state
+
+  const std::vector<uint8_t> dib = MakeDib4(kWidth, kHeight, 1);  // 64 MB, like the clipboard's
+  const size_t before = PeakRssBytes();
+
+  DibDecoder reader;
+  CHECK(reader.Open(dib.data(), dib.size()));
+  PngEncodeOptions options;
+  options.compressionLevel = 1;
+  options.memoryBudget = kBudget / 2;
+  const size_t rowBytes = static_cast<size_t>(kWidth) * 4;
+  CountingSink sink;
+  CHECK(EncodePngBands(&reader, BandRowsForBudget(kBudget / 2, rowBytes, kHeight), &sink,
+                       options));
+  CHECK(sink.bytes > 0);
+
+  const size_t growth = PeakRssBytes() - before;
+  std::printf("decoded %zu MB in bands; peak RSS grew by %zu MB (ceiling %zu MB)\n",
+              rowBytes * kHeight >> 20, growth >> 20, (kBudget + kAllowance) >> 20);
+  CHECK(growth <= kBudget + kAllowance);
+#else
+  std::printf("peak RSS is only measured on Linux; skipped\n");
+#endif
+}
+
+} // namespace
+
+int main() {
+  TestBandRowsForBudget();
+  TestBandsMatchWholeImage();
+  TestGiantDibUnderRssCeiling();
+  return TestResult();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal assertions for the portable tests: a failed CHECK prints where it
+// failed and the test keeps going; main() returns TestResult().
+
+namespace ptf_test {
+
+inline int g_failures = 0;
+
+inline bool Check(bool ok, const char* expr, const char* file, int line) {
+  if (!ok) {
+    std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+    g_failures++;
+  }
+  return ok;
+}
+
+inline int TestResult() {
+  if (g_failures > 0) {
+    std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace ptf_test
+
+#define CHECK(expr) ::ptf_test::Check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
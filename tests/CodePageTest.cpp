@@ -0,0 +1,129 @@
+// Legacy 8-bit clipboard text against byte samples of CF_TEXT/CF_OEMTEXT
+// (data/cf_text, see gen_cf_text.py): which copy ChooseNarrowTextEncoding
+// saves, and that the UTF-8 written from it is the text the app copied, with
+// and without a CF_UNICODETEXT to compare against.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "Check.h"
+
+#include "CodePage.h"
+#include "TextEncode.h"
+#include "PasteToFileCommon/Utf.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+std::string ReadSample(const std::string& file) {
+  std::ifstream in(PTF_TEST_DATA_DIR "/cf_text/" + file, std::ios::binary);
+  CHECK(in.good());
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// What Windows synthesizes from the 8-bit block in a single-byte code page.
+std::wstring Synthesize(const std::string& bytes, const uint16_t* table) {
+  std::wstring wide;
+  for (char c : bytes) {
+    const uint8_t b = static_cast<uint8_t>(c);
+    wide.push_back(static_cast<wchar_t>(b < 0x80 ? b : table[b - 0x80]));
+  }
+  return wide;
+}
+
+NarrowTextEncoding ParseEncoding(const std::string& name) {
+  if (name == "Utf8") return NarrowTextEncoding::Utf8;
+  if (name == "SingleByte") return NarrowTextEncoding::SingleByte;
+  CHECK(name == "System");
+  return NarrowTextEncoding::System;
+}
+
+std::string Saved(const MemorySink& sink) {
+  return std::string(sink.bytes.begin(), sink.bytes.end());
+}
+
+void TestSamples() {
+  std::ifstream list(PTF_TEST_DATA_DIR "/cf_text/samples.txt");
+  std::string line;
+  int cases = 0;
+  while (std::getline(list, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream fields(line);
+    std::string name, wideSource, encodingName;
+    uint32_t codePage = 0;
+    fields >> name >> codePage >> wideSource >> encodingName;
+    cases++;
+    const std::string bytes = ReadSample(name + ".bin");
+    std::string expected = ReadSample(name + ".txt");
+    const uint16_t* table = SingleByteCodePage(codePage);
+
+    std::wstring wide;
+    if (wideSource == "synthesized") {
+      wide = table ? Synthesize(bytes, table) : ptf::Utf8ToWide(bytes);
+    } else if (wideSource != "none") {
+      wide = ptf::Utf8ToWide(ReadSample(wideSource));
+    }
+    const std::wstring_view view = wide;
+    const NarrowTextEncoding encoding =
+        ChooseNarrowTextEncoding(bytes, codePage, wideSource == "none" ? nullptr : &view);
+    if (!CHECK(encoding == ParseEncoding(encodingName))) {
+      std::fprintf(stderr, "  sample: %s\n", line.c_str());
+      continue;
+    }
+
+    // What SaveClipboardText writes, in small chunks: the app's own
+    // CF_UNICODETEXT for System, nothing when there is none.
+    MemorySink sink;
+    TextEncodeOptions options;
+    if (encoding == NarrowTextEncoding::System) {
+      if (wideSource == "none") continue;
+      expected = ptf::WideToUtf8(wide);
+      CHECK(EncodeUtf8Text(wide, options, &sink, 7));
+    } else {
+      const uint16_t* used = encoding == NarrowTextEncoding::Utf8 ? nullptr : table;
+      CHECK(NarrowTextMatches(bytes, used, ptf::Utf8ToWide(expected)));
+      CHECK(EncodeNarrowText(bytes, used, options, &sink, 7));
+    }
+    if (!CHECK(Saved(sink) == expected)) std::fprintf(stderr, "  sample: %s\n", line.c_str());
+  }
+  CHECK(cases == 14);
+}
+
+// One character off anywhere, or one more or fewer, is not a match.
+void TestMatchesIsExact() {
+  const uint16_t* cp1252 = SingleByteCodePage(1252);
+  const std::string bytes = "caf\xE9 \x80";
+  const std::wstring wide = {L'c', L'a', L'f', wchar_t(0xE9), L' ', wchar_t(0x20AC)};
+  CHECK(NarrowTextMatches(bytes, cp1252, wide));
+  CHECK(!NarrowTextMatches(bytes, cp1252, wide.substr(1)));
+  CHECK(!NarrowTextMatches(bytes, cp1252, wide + L"x"));
+  for (size_t i = 0; i < wide.size(); i++) {
+    std::wstring changed = wide;
+    changed[i] = L'?';
+    CHECK(!NarrowTextMatches(bytes, cp1252, changed));
+  }
+  CHECK(!NarrowTextMatches(bytes, nullptr, wide));
+
+  // UTF-8 past the converter's buffer, and a prefix of it.
+  const std::string utf8 = std::string(3000, 'a') + "\xC3\xA9";
+  const std::wstring utf8Wide = std::wstring(3000, L'a') + wchar_t(0xE9);
+  CHECK(NarrowTextMatches(utf8, nullptr, utf8Wide));
+  CHECK(!NarrowTextMatches(utf8, nullptr, utf8Wide.substr(0, 2000)));
+  CHECK(!NarrowTextMatches(utf8.substr(0, 2000), nullptr, utf8Wide));
+  CHECK(NarrowTextMatches("", nullptr, L""));
+  CHECK(NarrowTextMatches("", cp1252, L""));
+}
+
+} // namespace
+
+int main() {
+  TestSamples();
+  TestMatchesIsExact();
+  return TestResult();
+}
@@ -0,0 +1,247 @@
+// Color reduction: the PNG color type and bit depth EncodePng writes (read
+// back from IHDR) for opaque gray, gray with alpha, few colors (palettes of
+// 1, 2, 4 and 8 bits, translucent entries first for a short tRNS), opaque
+// RGBA written as RGB, and 257 colors, one more than a palette holds. Every
+// encode must decode to the input pixels, and feeding the rows one at a time
+// to ColorAnalyzer must give the plan AnalyzePixels gives.
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "ColorAnalysis.h"
+#include "PngEncoder.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+constexpr int kGray = 0;
+constexpr int kRgb = 2;
+constexpr int kPalette = 3;
+constexpr int kGrayAlpha = 4;
+constexpr int kRgba = 6;
+
+const PixelFormat kFormats[] = {PixelFormat::Bgra8, PixelFormat::Bgrx8, PixelFormat::Rgba8,
+                                PixelFormat::Bgr8, PixelFormat::Rgb8};
+
+// An image whose pixel (x, y) is color(x, y) as 0xAARRGGBB; formats without
+// alpha drop it, and Bgrx8 gets a varying fourth byte that must be ignored.
+TestImage MakeImage(uint32_t width, uint32_t height, PixelFormat format,
+                    const std::function<uint32_t(uint32_t, uint32_t)>& color) {
+  TestImage image;
+  image.width = width;
+  image.height = height;
+  image.format = format;
+  image.pixels.resize(image.Stride() * height);
+  const size_t bpp = BytesPerPixel(format);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      const uint32_t c = color(x, y);
+      const uint8_t a = static_cast<uint8_t>(c >> 24);
+      const uint8_t r = static_cast<uint8_t>(c >> 16);
+      const uint8_t g = static_cast<uint8_t>(c >> 8);
+      const uint8_t b = static_cast<uint8_t>(c);
+      uint8_t* p = &image.pixels[y * image.Stride() + x * bpp];
+      switch (format) {
+        case PixelFormat::Bgra8:
+        case PixelFormat::Bgrx8:
+          p[0] = b;
+          p[1] = g;
+          p[2] = r;
+          p[3] = format == PixelFormat::Bgra8 ? a : static_cast<uint8_t>(x * 7 + y);
+          break;
+        case PixelFormat::Rgba8:
+          p[0] = r;
+          p[1] = g;
+          p[2] = b;
+          p[3] = a;
+          break;
+        case PixelFormat::Bgr8:
+          p[0] = b;
+          p[1] = g;
+          p[2] = r;
+          break;
+        case PixelFormat::Rgb8:
+          p[0] = r;
+          p[1] = g;
+          p[2] = b;
+          break;
+      }
+    }
+  }
+  return image;
+}
+
+uint32_t Gray(uint32_t level, uint32_t alpha = 0xFF) {
+  return (alpha << 24) | (level << 16) | (level << 8) | level;
+}
+
+// The `i`th of a set of distinct colors (i < 48K), none of them gray.
+uint32_t Color(uint32_t i, uint32_t alpha = 0xFF) {
+  const uint32_t low = i & 0xFF;
+  return (alpha << 24) | (low << 16) | ((0x40 + (i >> 8)) << 8) | (low ^ 0x80);
+}
+
+// Encodes `image` with color reduction and checks IHDR, the pixels and that
+// the plan does not depend on how the rows arrive.
+bool Writes(const TestImage& image, int colorType, int bitDepth) {
+  PngEncodeOptions options;
+  options.threads = 1;
+  MemorySink png;
+  if (!CHECK(EncodePng(image.Source(), &png, options)) || !CHECK(png.bytes.size() > 26)) {
+    return false;
+  }
+  // Signature, IHDR length and type, width, height, then depth and type.
+  const int depth = png.bytes[24];
+  const int type = png.bytes[25];
+  bool ok = CHECK(type == colorType && depth == bitDepth);
+  if (!ok) {
+    std::printf("  format %d: color type %d depth %d, expected %d depth %d\n",
+                static_cast<int>(image.format), type, depth, colorType, bitDepth);
+  }
+  uint32_t width = 0, height = 0;
+  std::vector<uint32_t> decoded;
+  ok = CHECK(DecodePng(png.bytes, &width, &height, &decoded)) && ok;
+  ok = CHECK(decoded == ToArgb(image)) && ok;
+
+  const PngColorPlan whole = AnalyzePixels(image.Source());
+  ColorAnalyzer analyzer(image.width, image.format);
+  for (uint32_t y = 0; y < image.height; y++) analyzer.AddRow(image.Source().Row(y));
+  PngColorPlan byRow;
+  analyzer.Plan(&byRow);
+  ok = CHECK(byRow.mode == whole.mode && byRow.bitDepth == whole.bitDepth &&
+             byRow.palette == whole.palette) &&
+       ok;
+  return ok;
+}
+
+// More than 16 gray levels: gray 8-bit in every format; up to 16, a palette
+// is smaller.
+void TestGray() {
+  for (PixelFormat format : kFormats) {
+    CHECK(Writes(
+        MakeImage(16, 16, format, [](uint32_t x, uint32_t y) { return Gray(y * 16 + x); }),
+        kGray, 8));
+    CHECK(Writes(MakeImage(17, 3, format, [](uint32_t x, uint32_t) { return Gray(x * 15); }),
+                 kGray, 8));
+    CHECK(Writes(MakeImage(16, 3, format, [](uint32_t x, uint32_t) { return Gray(x * 17); }),
+                 kPalette, 4));
+    CHECK(Writes(
+        MakeImage(8, 8, format, [](uint32_t x, uint32_t) { return Gray(x % 2 * 255); }),
+        kPalette, 1));
+  }
+  // One pixel off gray rules gray out.
+  CHECK(Writes(MakeImage(32, 32, PixelFormat::Bgra8,
+                         [](uint32_t x, uint32_t y) {
+                           return x == 31 && y == 31 ? 0xFF102030u : Gray(x * 8 + y % 8);
+                         }),
+               kRgb, 8));
+}
+
+// Translucent gray with more than 256 gray/alpha pairs; with fewer, a palette.
+void TestGrayAlpha() {
+  for (PixelFormat format : {PixelFormat::Bgra8, PixelFormat::Rgba8}) {
+    CHECK(Writes(MakeImage(32, 32, format,
+                           [](uint32_t x, uint32_t y) { return Gray(x * 8, y * 8 + 7); }),
+                 kGrayAlpha, 8));
+    CHECK(Writes(MakeImage(32, 32, format,
+                           [](uint32_t x, uint32_t y) { return Gray(x * 8, y < 16 ? 0 : 255); }),
+                 kPalette, 8));
+  }
+  // No alpha channel: never GrayAlpha.
+  CHECK(Writes(MakeImage(32, 32, PixelFormat::Bgrx8,
+                         [](uint32_t x, uint32_t y) { return Gray(x * 8, y * 8 + 7); }),
+               kGray, 8));
+}
+
+// Up to 256 colors: a palette at the smallest depth that indexes them, with
+// translucent entries first in first-seen order.
+void TestPalette() {
+  struct Size {
+    uint32_t colors;
+    int depth;
+  };
+  const Size sizes[] = {{1, 1}, {2, 1}, {3, 2}, {4, 2}, {5, 4}, {16, 4}, {17, 8}, {256, 8}};
+  for (PixelFormat format : kFormats) {
+    for (const Size& size : sizes) {
+      const uint32_t n = size.colors;
+      CHECK(Writes(MakeImage(64, 20, format,
+                             [n](uint32_t x, uint32_t y) { return Color((y * 64 + x) % n); }),
+                   kPalette, size.depth));
+      // In runs, which the analysis skips over.
+      auto runs = [n](uint32_t x, uint32_t y) { return Color((y * 256 + x) / 8 % n); };
+      CHECK(Writes(MakeImage(256, 8, format, runs), kPalette, size.depth));
+    }
+  }
+
+  const TestImage image = MakeImage(4, 2, PixelFormat::Bgra8, [](uint32_t x, uint32_t y) {
+    const uint32_t colors[] = {Color(1), Color(2, 0x80), Color(3), Color(4, 0)};
+    return colors[(x + y) % 4];
+  });
+  const PngColorPlan plan = AnalyzePixels(image.Source());
+  CHECK(plan.mode == PngColorMode::Palette && plan.bitDepth == 2);
+  CHECK(plan.palette == (std::vector<uint32_t>{Color(2, 0x80), Color(4, 0), Color(1), Color(3)}));
+  CHECK(plan.translucentEntries == 2);
+  CHECK(Writes(image, kPalette, 2));
+}
+
+// Alpha channel, every pixel opaque: written as RGB; one pixel at 0xFE keeps
+// RGBA.
+void TestOpaqueRgba() {
+  for (PixelFormat format : {PixelFormat::Bgra8, PixelFormat::Rgba8}) {
+    CHECK(Writes(MakeImage(40, 40, format,
+                           [](uint32_t x, uint32_t y) { return Color(x * 40 + y); }),
+                 kRgb, 8));
+    CHECK(Writes(MakeImage(40, 40, format,
+                           [](uint32_t x, uint32_t y) {
+                             return Color(x * 40 + y, x == 39 && y == 39 ? 0xFE : 0xFF);
+                           }),
+                 kRgba, 8));
+  }
+  CHECK(Writes(MakeNoise(33, 17, PixelFormat::Bgrx8), kRgb, 8));
+  CHECK(Writes(MakeNoise(33, 17, PixelFormat::Bgra8), kRgba, 8));
+}
+
+// 256 colors fit a palette; the 257th, wherever it first appears, does not.
+void TestPaletteOverflow() {
+  for (PixelFormat format : kFormats) {
+    const bool alpha = HasAlphaChannel(format);
+    for (uint32_t at : {256u, 300u, 64u * 64 - 1}) {
+      auto color = [at](uint32_t x, uint32_t y) {
+        const uint32_t i = y * 64 + x;
+        return i == at ? Color(1000) : Color(i < 256 ? i : i % 255);
+      };
+      CHECK(Writes(MakeImage(64, 64, format, color), kRgb, 8));
+      auto translucent = [&color](uint32_t x, uint32_t y) {
+        return x == 0 && y == 0 ? Color(0, 0x80) : color(x, y);
+      };
+      CHECK(Writes(MakeImage(64, 64, format, translucent), alpha ? kRgba : kRgb, 8));
+    }
+    // Exactly 256, counting a translucent one.
+    auto full = [](uint32_t x, uint32_t y) {
+      return x == 0 && y == 0 ? Color(0, 0x80) : Color((y * 64 + x) % 255 + 1);
+    };
+    CHECK(Writes(MakeImage(64, 64, format, full), kPalette, 8));
+  }
+  // 257 gray levels cannot happen; 257 gray/alpha pairs fall back to GrayAlpha.
+  CHECK(Writes(MakeImage(257, 1, PixelFormat::Bgra8,
+                         [](uint32_t x, uint32_t) { return Gray(x % 256, x < 256 ? 0xFF : 0); }),
+               kGrayAlpha, 8));
+}
+
+} // namespace
+
+int main() {
+  TestGray();
+  TestGrayAlpha();
+  TestPalette();
+  TestOpaqueRgba();
+  TestPaletteOverflow();
+  return TestResult();
+}
@@ -0,0 +1,131 @@
+// Xxh64 against the reference xxHash results: the sanity vectors xxhsum
+// checks itself with (its generated buffer, seeds 0 and PRIME32, covering the
+// empty input, the tail-only path under 32 bytes and the 4-lane stripes
+// above it), plus short strings. Every input is also fed in pieces, which
+// must not change the digest.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Check.h"
+#include "ContentHash.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+constexpr uint64_t kPrime32 = 2654435761u;
+
+// xxhsum's sanity buffer.
+std::vector<uint8_t> SanityBuffer(size_t size) {
+  std::vector<uint8_t> buffer(size);
+  uint64_t gen = kPrime32;
+  for (uint8_t& b : buffer) {
+    b = static_cast<uint8_t>(gen >> 56);
+    gen *= 11400714785074694797ULL;
+  }
+  return buffer;
+}
+
+uint64_t Hash(const uint8_t* data, size_t size, uint64_t seed) {
+  Xxh64 hash(seed);
+  hash.Update(data, size);
+  CHECK(hash.Bytes() == size);
+  return hash.Digest();
+}
+
+// The same input in random pieces, some of them empty.
+uint64_t HashInPieces(const uint8_t* data, size_t size, uint64_t seed, uint32_t random) {
+  Random pieces(random);
+  Xxh64 hash(seed);
+  for (size_t pos = 0; pos < size;) {
+    const size_t piece = std::min<size_t>(size - pos, pieces.Below(40));
+    hash.Update(data + pos, piece);
+    pos += piece;
+  }
+  return hash.Digest();
+}
+
+void TestSanityVectors() {
+  struct Vector {
+    size_t size;
+    uint64_t seed;
+    uint64_t expected;
+  };
+  const Vector vectors[] = {
+      {0, 0, 0xEF46DB3751D8E999ULL},
+      {0, kPrime32, 0xAC75FDA2929B17EFULL},
+      {1, 0, 0xE934A84ADB052768ULL},
+      {1, kPrime32, 0x5014607643A9B4C3ULL},
+      {4, 0, 0x9136A0DCA57457EEULL},
+      {14, 0, 0x8282DCC4994E35C8ULL},
+      {14, kPrime32, 0xC3BD6BF63DEB6DF0ULL},
+      {222, 0, 0xB641AE8CB691C174ULL},
+      {222, kPrime32, 0x20CB8AB7AE10C14AULL},
+  };
+  const std::vector<uint8_t> buffer = SanityBuffer(222);
+  uint32_t random = 1;
+  for (const Vector& v : vectors) {
+    CHECK(Hash(buffer.data(), v.size, v.seed) == v.expected);
+    CHECK(HashInPieces(buffer.data(), v.size, v.seed, random++) == v.expected);
+  }
+}
+
+void TestStrings() {
+  struct Vector {
+    const char* text;
+    uint64_t seed;
+    uint64_t expected;
+  };
+  const Vector vectors[] = {
+      {"a", 0, 0xD24EC4F1A98C6E5BULL},
+      {"abc", 0, 0x44BC2CF5AD770999ULL},
+      {"message digest", 0, 0x066ED728FCEEB3BEULL},
+      {"abcdefghijklmnopqrstuvwxyz", 0, 0xCFE1F278FA89835CULL},
+      {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", 0,
+       0xAAA46907D3047814ULL},
+      {"12345678901234567890123456789012345678901234567890"
+       "123456789012345678901234567890",
+       0, 0xE04A477F19EE145DULL},
+      {"", 1, 0xD5AFBA1336A3BE4BULL},
+      {"abc", 0x9E3779B185EBCA8DULL, 0x7E49C9D7E85A4AB6ULL},
+  };
+  uint32_t random = 100;
+  for (const Vector& v : vectors) {
+    const auto* data = reinterpret_cast<const uint8_t*>(v.text);
+    const size_t size = std::strlen(v.text);
+    CHECK(Hash(data, size, v.seed) == v.expected);
+    CHECK(HashInPieces(data, size, v.seed, random++) == v.expected);
+  }
+}
+
+// Many stripes, fed in pieces that straddle the 32-byte buffer.
+void TestLongInput() {
+  const std::vector<uint8_t> input(100000, 'x');
+  CHECK(Hash(input.data(), input.size(), 0) == 0x7C37A271025B345BULL);
+  CHECK(HashInPieces(input.data(), input.size(), 0, 7) == 0x7C37A271025B345BULL);
+}
+
+// HashingSink passes the bytes through unchanged and hashes what it passed.
+void TestHashingSink() {
+  const std::vector<uint8_t> buffer = SanityBuffer(222);
+  MemorySink out;
+  HashingSink sink(&out);
+  CHECK(sink.Write(buffer.data(), 100) && sink.Write(buffer.data() + 100, 122));
+  CHECK(out.bytes == buffer);
+  CHECK(sink.Hash().Bytes() == 222 && sink.Hash().Digest() == 0xB641AE8CB691C174ULL);
+}
+
+} // namespace
+
+int main() {
+  TestSanityVectors();
+  TestStrings();
+  TestLongInput();
+  TestHashingSink();
+  return TestResult();
+}
@@ -0,0 +1,227 @@
+// DedupIndex: entries found by key and size (a key collision with another size
+// is a different entry), replaced in place, moved to a larger index when full,
+// and read back from a saved copy as DedupStore reopens its mapped file.
+// Truncated or damaged bytes are refused by Attach, or fail the lookup, and
+// never read outside the block.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "DedupIndex.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+// Field offsets of the on-disk layout (DedupIndex.h).
+constexpr size_t kHeaderBytes = 32;
+constexpr size_t kSlotBytes = 32;
+constexpr size_t kVersionOffset = 8;
+constexpr size_t kSlotCountOffset = 12;
+constexpr size_t kUsedOffset = 16;
+constexpr size_t kHeapUsedOffset = 24;
+constexpr size_t kNameOffsetInSlot = 24;
+
+struct Image {
+  std::vector<uint8_t> bytes;
+  DedupIndex index;
+
+  Image(uint32_t slots, uint32_t heapBytes) : bytes(DedupIndex::ImageBytes(slots, heapBytes)) {
+    DedupIndex::Format(bytes.data(), slots, heapBytes);
+    CHECK(index.Attach(bytes.data(), bytes.size()));
+  }
+};
+
+void Put32(std::vector<uint8_t>* bytes, size_t offset, uint32_t v) {
+  std::memcpy(bytes->data() + offset, &v, sizeof(v));
+}
+
+DedupEntry Entry(uint64_t key, uint64_t size, const char* name) {
+  DedupEntry entry;
+  entry.key = key;
+  entry.size = size;
+  entry.writeTime = key ^ size;
+  entry.name = name;
+  return entry;
+}
+
+bool Finds(const DedupIndex& index, uint64_t key, uint64_t size, const char* name) {
+  DedupEntry entry;
+  return index.Find(key, size, &entry) && entry.name == name && entry.writeTime == (key ^ size);
+}
+
+void TestInsertFind() {
+  Image image(16, 256);
+  CHECK(image.index.Count() == 0);
+  CHECK(!Finds(image.index, 42, 10, "a.png"));
+  CHECK(image.index.Insert(Entry(42, 10, "a.png")));
+  CHECK(image.index.Insert(Entry(7, 3, "b.txt")));
+  CHECK(Finds(image.index, 42, 10, "a.png") && Finds(image.index, 7, 3, "b.txt"));
+  CHECK(image.index.Count() == 2);
+  // Key 0 is stored as 1 (0 marks an empty slot) and is still found.
+  CHECK(image.index.Insert(Entry(0, 5, "zero.txt")));
+  CHECK(Finds(image.index, 0, 5, "zero.txt"));
+  // Empty and over-long names are refused.
+  CHECK(!image.index.Insert(Entry(9, 1, "")));
+  const std::string longName(0x10000, 'n');
+  CHECK(!image.index.Insert(Entry(9, 1, longName.c_str())));
+  CHECK(image.index.Count() == 3);
+}
+
+// The same key with another size (a hash collision, or the same hash of
+// another length) is its own entry; the same key and size replaces.
+void TestCollisions() {
+  Image image(16, 256);
+  CHECK(image.index.Insert(Entry(42, 10, "ten.png")));
+  CHECK(image.index.Insert(Entry(42, 11, "eleven.png")));
+  // Another key on the same probe chain: the low bits decide the first slot.
+  CHECK(image.index.Insert(Entry(42 + 16, 10, "chained.png")));
+  CHECK(Finds(image.index, 42, 10, "ten.png"));
+  CHECK(Finds(image.index, 42, 11, "eleven.png"));
+  CHECK(Finds(image.index, 42 + 16, 10, "chained.png"));
+  CHECK(!Finds(image.index, 42, 12, "ten.png"));
+  CHECK(image.index.Count() == 3);
+
+  CHECK(image.index.Insert(Entry(42, 10, "again.png")));
+  CHECK(Finds(image.index, 42, 10, "again.png") && Finds(image.index, 42, 11, "eleven.png"));
+  CHECK(image.index.Count() == 3);
+}
+
+// Inserts fail at 70% of the slots or when the heap is out; the entries then
+// move to an index sized by GrowSize, without the names of replaced entries.
+void TestGrow() {
+  Image image(16, 64);
+  uint32_t inserted = 0;
+  char name[16];
+  for (; inserted < 16; inserted++) {
+    std::snprintf(name, sizeof(name), "f%02u.txt", inserted);
+    if (!image.index.Insert(Entry(1000 + inserted * 16, 1, name))) break;
+  }
+  CHECK(inserted == 9);  // 64 heap bytes / 7-byte names
+  CHECK(!image.index.Insert(Entry(1000, 1, "xy")));  // heap full, even to replace
+
+  uint32_t slots = 0;
+  uint32_t heapBytes = 0;
+  image.index.GrowSize(7, &slots, &heapBytes);
+  CHECK(slots == 16 && heapBytes >= 64 + 7 + heapBytes / 4);
+  Image larger(slots, heapBytes);
+  image.index.CopyTo(&larger.index);
+  CHECK(larger.index.Count() == inserted);
+  for (uint32_t i = 0; i < inserted; i++) {
+    std::snprintf(name, sizeof(name), "f%02u.txt", i);
+    CHECK(Finds(larger.index, 1000 + i * 16, 1, name));
+  }
+  // Up to 11 of 16 slots; a 12th entry would be over 70%.
+  CHECK(larger.index.Insert(Entry(5000, 1, "g1.txt")));
+  CHECK(larger.index.Insert(Entry(5001, 1, "g2.txt")));
+  CHECK(!larger.index.Insert(Entry(5002, 1, "g3.txt")));
+  larger.index.GrowSize(7, &slots, &heapBytes);
+  CHECK(slots == 32);
+
+  // A replaced entry's old name is not copied.
+  Image replaced(16, 256);
+  CHECK(replaced.index.Insert(Entry(1, 1, "old-name.txt")));
+  CHECK(replaced.index.Insert(Entry(1, 1, "new.txt")));
+  Image copy(16, 256);
+  replaced.index.CopyTo(&copy.index);
+  CHECK(Finds(copy.index, 1, 1, "new.txt") && copy.index.Count() == 1);
+  CHECK(copy.index.Bytes() == DedupIndex::ImageBytes(16, 256));
+}
+
+// DedupStore maps the file it wrote on an earlier run: the same bytes, read
+// back, attach with every entry in place.
+void TestReopen() {
+  Image image(DedupIndex::kInitialSlots, DedupIndex::kInitialHeapBytes);
+  char name[32];
+  for (uint32_t i = 0; i < 500; i++) {
+    std::snprintf(name, sizeof(name), "PTF-2026-feb-23-%03u.png", i);
+    CHECK(image.index.Insert(Entry(0x9E3779B97F4A7C15ULL * (i + 1), 1000 + i, name)));
+  }
+  FILE* f = std::tmpfile();
+  if (!CHECK(f)) return;
+  CHECK(std::fwrite(image.bytes.data(), 1, image.bytes.size(), f) == image.bytes.size());
+  std::rewind(f);
+  std::vector<uint8_t> reread(image.bytes.size());
+  CHECK(std::fread(reread.data(), 1, reread.size(), f) == reread.size());
+  std::fclose(f);
+
+  DedupIndex reopened;
+  CHECK(reopened.Attach(reread.data(), reread.size()));
+  CHECK(reopened.Count() == 500 && reopened.Bytes() == image.index.Bytes());
+  for (uint32_t i = 0; i < 500; i++) {
+    std::snprintf(name, sizeof(name), "PTF-2026-feb-23-%03u.png", i);
+    CHECK(Finds(reopened, 0x9E3779B97F4A7C15ULL * (i + 1), 1000 + i, name));
+  }
+  // A mapping may be larger than the index (it is rounded up); that is fine.
+  reread.resize(reread.size() + 4096);
+  CHECK(reopened.Attach(reread.data(), reread.size()));
+  CHECK(reopened.Bytes() == image.index.Bytes());
+}
+
+void TestTruncatedOrCorrupt() {
+  Image image(16, 256);
+  CHECK(image.index.Insert(Entry(42, 10, "a.png")));
+  const std::vector<uint8_t> good = image.bytes;
+  DedupIndex index;
+
+  // Shorter than the header, or than the slots and heap it declares.
+  CHECK(!index.Attach(nullptr, 0));
+  std::vector<uint8_t> bytes = good;
+  CHECK(!index.Attach(bytes.data(), kHeaderBytes - 1));
+  CHECK(!index.Attach(bytes.data(), bytes.size() - 1));
+  CHECK(index.Bytes() == 0 && index.Count() == 0 && !Finds(index, 42, 10, "a.png"));
+  CHECK(!index.Insert(Entry(1, 1, "b")));
+
+  struct Damage {
+    size_t offset;
+    uint32_t value;
+  };
+  const Damage refused[] = {
+      {0, 0x12345678},               // magic
+      {kVersionOffset, 2},           // version
+      {kSlotCountOffset, 0},         // no slots
+      {kSlotCountOffset, 24},        // not a power of two
+      {kSlotCountOffset, 1u << 25},  // too many
+      {kUsedOffset, 16},             // no empty slot left
+      {kHeapUsedOffset, 257},        // heap used past its end
+  };
+  for (const Damage& damage : refused) {
+    bytes = good;
+    Put32(&bytes, damage.offset, damage.value);
+    CHECK(!index.Attach(bytes.data(), bytes.size()));
+  }
+
+  // A slot whose name lies past the used heap (a write cut short) is not read.
+  bytes = good;
+  CHECK(index.Attach(bytes.data(), bytes.size()));
+  const size_t slot = kHeaderBytes + (42 & 15) * kSlotBytes;
+  Put32(&bytes, slot + kNameOffsetInSlot, 250);
+  DedupEntry entry;
+  CHECK(!index.Find(42, 10, &entry));
+
+  // Every slot taken (the count says otherwise): the probe still ends.
+  bytes = good;
+  CHECK(index.Attach(bytes.data(), bytes.size()));
+  for (uint32_t i = 0; i < 16; i++) {
+    uint64_t key = 100 + i;
+    std::memcpy(bytes.data() + kHeaderBytes + i * kSlotBytes, &key, sizeof(key));
+  }
+  CHECK(!index.Find(42, 10, &entry));
+  CHECK(!index.Insert(Entry(7, 7, "c")));
+}
+
+} // namespace
+
+int main() {
+  TestInsertFind();
+  TestCollisions();
+  TestGrow();
+  TestReopen();
+  TestTruncatedOrCorrupt();
+  return TestResult();
+}
@@ -0,0 +1,275 @@
+// DibDecoder on hand-built DIBs: BI_RLE8/BI_RLE4 streams with encoded and
+// absolute runs, padding, deltas, end-of-line/bitmap escapes and runs, deltas
+// and streams that overrun the image or the data; and 16- and 32-bit
+// BI_BITFIELDS/BI_ALPHABITFIELDS masks, on the dedicated unpackers and the
+// generic one, against a reference that scales every channel the slow way.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "Check.h"
+#include "DibDecode.h"
+#include "TestDibs.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+// Decodes in bands of 3 rows into top-down RGBA; empty when Open fails.
+std::vector<uint8_t> Decode(const std::vector<uint8_t>& dib) {
+  DibDecoder decoder;
+  if (!decoder.Open(dib.data(), dib.size())) return {};
+  std::vector<uint8_t> rgba;
+  for (uint32_t y = 0; y < decoder.Height(); y += 3) {
+    const uint32_t rows = std::min(3u, decoder.Height() - y);
+    PixelSource band;
+    if (!CHECK(decoder.ReadBand(y, rows, &band))) return {};
+    CHECK(band.width == decoder.Width() && band.height == rows && !band.bottomUp);
+    CHECK(band.format == PixelFormat::Rgba8 && band.stride == decoder.Width() * 4u);
+    rgba.insert(rgba.end(), band.pixels, band.pixels + band.stride * rows);
+  }
+  CHECK(!decoder.ReadBand(decoder.Height(), 1, nullptr));
+  return rgba;
+}
+
+uint32_t PaletteColor(uint32_t index) {
+  return ((index * 16) << 16) | ((255 - index * 16) << 8) | (index * 7);
+}
+
+std::vector<uint32_t> Palette16() {
+  std::vector<uint32_t> palette;
+  for (uint32_t i = 0; i < 16; i++) palette.push_back(PaletteColor(i));
+  return palette;
+}
+
+// RGBA for palette indices given top row first, as `rows` strings of hex digits.
+std::vector<uint8_t> Expected(const std::vector<const char*>& rows) {
+  std::vector<uint8_t> rgba;
+  for (const char* row : rows) {
+    for (const char* c = row; *c; c++) {
+      const uint32_t color = PaletteColor(*c <= '9' ? *c - '0' : *c - 'a' + 10);
+      rgba.insert(rgba.end(), {static_cast<uint8_t>(color >> 16), static_cast<uint8_t>(color >> 8),
+                               static_cast<uint8_t>(color), 0xFF});
+    }
+  }
+  return rgba;
+}
+
+std::vector<uint8_t> RleDib(int32_t width, int32_t height, bool rle4,
+                            const std::vector<uint8_t>& stream) {
+  DibSpec spec;
+  spec.width = width;
+  spec.height = height;
+  spec.bitCount = rle4 ? 4 : 8;
+  spec.compression = rle4 ? kBiRle4 : kBiRle8;
+  spec.imageSize = static_cast<uint32_t>(stream.size());
+  spec.colorsUsed = 16;
+  return MakeDib(spec, Palette16(), stream);
+}
+
+void TestRle8() {
+  // Rows are listed bottom first in the stream, top first in the expectation.
+  const std::vector<uint8_t> stream = {
+      3, 1, 0, 3, 2, 3, 4, 0,  // run of 3, absolute run of 3 padded to 4 bytes
+      0, 0,                    // end of line
+      2, 5, 0, 2, 2, 1,        // run of 2, delta right 2 and up 1
+      2, 6, 0, 0,              // run ending the row, end of line
+      10, 7,                   // run past the end of the row: clipped, not wrapped
+      0, 1,                    // end of bitmap
+      5, 9,                    // after the end: ignored
+  };
+  CHECK(Decode(RleDib(6, 4, false, stream)) ==
+        Expected({"777777", "000066", "550000", "111234"}));
+
+  // Absolute run past the row end, then a run with no room left, and a delta
+  // past the top: the rest stays index 0.
+  CHECK(Decode(RleDib(4, 3, false, {0, 6, 1, 2, 3, 4, 5, 6, 1, 9, 0, 0, 0, 2, 0, 5, 2, 8})) ==
+        Expected({"0000", "0000", "1234"}));
+  // Streams that stop early: mid absolute run, mid delta, mid record.
+  CHECK(Decode(RleDib(4, 2, false, {2, 3, 0, 4, 1, 2})) == Expected({"0000", "3300"}));
+  CHECK(Decode(RleDib(4, 2, false, {2, 3, 0, 2, 1})) == Expected({"0000", "3300"}));
+  CHECK(Decode(RleDib(4, 2, false, {2, 3, 4})) == Expected({"0000", "3300"}));
+  CHECK(Decode(RleDib(4, 2, false, {})) == Expected({"0000", "0000"}));
+
+  // RLE is bottom-up only, and its expanded size is capped.
+  CHECK(Decode(RleDib(4, -2, false, {2, 3})).empty());
+  CHECK(Decode(RleDib(100000, 100000, false, {0, 1})).empty());
+}
+
+void TestRle4() {
+  // Runs alternate their two nibbles; absolute runs hold two pixels a byte.
+  CHECK(Decode(RleDib(5, 2, true, {5, 0x12, 0, 0, 0, 3, 0x34, 0x50, 2, 0x67, 0, 1})) ==
+        Expected({"34567", "12121"}));
+  // 5 pixels take 3 bytes, padded to 4.
+  CHECK(Decode(RleDib(6, 1, true, {0, 5, 0x12, 0x34, 0x50, 0xEE, 1, 0x9F})) ==
+        Expected({"123459"}));
+  // Runs past the row, deltas and truncation as for RLE8.
+  CHECK(Decode(RleDib(3, 2, true, {7, 0xAB, 0, 0, 0, 2, 1, 0, 2, 0xCD})) ==
+        Expected({"0cd", "aba"}));
+  CHECK(Decode(RleDib(4, 1, true, {0, 8, 0x12, 0x34})) == Expected({"0000"}));
+}
+
+// The slow reference for one channel: masked, shifted, scaled to 0..255.
+uint8_t Channel(uint32_t px, uint32_t mask) {
+  if (mask == 0) return 0;
+  int shift = 0;
+  while (!((mask >> shift) & 1)) shift++;
+  const uint64_t max = mask >> shift;
+  return static_cast<uint8_t>((((px & mask) >> shift) * 255 + max / 2) / max);
+}
+
+struct MaskCase {
+  const char* name;
+  uint16_t bitCount;
+  uint32_t headerSize;
+  uint32_t compression;
+  uint32_t masks[4];
+};
+
+// Random pixels (or with alpha bits cleared) through the layout; compares with
+// Channel(), taking alpha only when the mask is set and some pixel uses it.
+bool CheckMasks(const MaskCase& c, bool zeroAlpha, int32_t height) {
+  const uint32_t width = 7;
+  const uint32_t rows = static_cast<uint32_t>(height < 0 ? -height : height);
+  const size_t bytes = c.bitCount / 8;
+  DibSpec spec;
+  spec.headerSize = c.headerSize;
+  spec.width = static_cast<int32_t>(width);
+  spec.height = height;
+  spec.bitCount = c.bitCount;
+  spec.compression = c.compression;
+  for (int i = 0; i < 4; i++) spec.masks[i] = c.masks[i];
+  uint32_t masks[4] = {c.masks[0], c.masks[1], c.masks[2], c.masks[3]};
+  if (c.compression == kBiRgb) {
+    const bool is16 = c.bitCount == 16;
+    masks[0] = is16 ? 0x7C00 : 0x00FF0000;
+    masks[1] = is16 ? 0x03E0 : 0x0000FF00;
+    masks[2] = is16 ? 0x001F : 0x000000FF;
+    masks[3] = is16 ? 0 : 0xFF000000;
+  }
+
+  Random random(c.bitCount * 31 + c.masks[0]);
+  const size_t stride = DibStride(width, c.bitCount);
+  std::vector<uint8_t> bits(stride * rows);
+  std::vector<uint32_t> pixels;  // top row first
+  for (uint32_t y = 0; y < rows; y++) {
+    const uint32_t stored = height > 0 ? rows - 1 - y : y;
+    for (uint32_t x = 0; x < width; x++) {
+      uint32_t px = random.Next() & (bytes == 2 ? 0xFFFF : 0xFFFFFFFF);
+      if (zeroAlpha) px &= ~masks[3];
+      pixels.push_back(px);
+      for (size_t k = 0; k < bytes; k++) {
+        bits[stored * stride + x * bytes + k] = static_cast<uint8_t>(px >> (8 * k));
+      }
+    }
+  }
+  bool anyAlpha = false;
+  for (uint32_t px : pixels) anyAlpha = anyAlpha || (px & masks[3]) != 0;
+  std::vector<uint8_t> expected;
+  for (uint32_t px : pixels) {
+    expected.insert(expected.end(), {Channel(px, masks[0]), Channel(px, masks[1]),
+                                     Channel(px, masks[2]),
+                                     anyAlpha ? Channel(px, masks[3]) : uint8_t{0xFF}});
+  }
+  const bool ok = Decode(MakeDib(spec, {}, bits)) == expected;
+  if (!ok) std::fprintf(stderr, "  masks: %s%s\n", c.name, zeroAlpha ? " (zero alpha)" : "");
+  return ok;
+}
+
+void TestBitfields() {
+  const MaskCase cases[] = {
+      // 16-bit: R5G6B5, X1R5G5B5, A1R5G5B5 and A4R4G4B4 have their own
+      // unpackers; the rest go through the generic one.
+      {"565 after header", 16, 40, kBiBitfields, {0xF800, 0x07E0, 0x001F, 0}},
+      {"565 in V5", 16, 124, kBiBitfields, {0xF800, 0x07E0, 0x001F, 0}},
+      {"16-bit BI_RGB", 16, 40, kBiRgb, {}},
+      {"555 in V3", 16, 56, kBiBitfields, {0x7C00, 0x03E0, 0x001F, 0}},
+      {"1555 in V5", 16, 124, kBiBitfields, {0x7C00, 0x03E0, 0x001F, 0x8000}},
+      {"4444 after header", 16, 40, kBiAlphaBitfields, {0x0F00, 0x00F0, 0x000F, 0xF000}},
+      {"BGR555", 16, 40, kBiBitfields, {0x001F, 0x03E0, 0x7C00, 0}},
+      {"X4B4G4R4", 16, 108, kBiBitfields, {0x000F, 0x00F0, 0x0F00, 0}},
+      {"3-bit alpha", 16, 40, kBiAlphaBitfields, {0x001F, 0x03E0, 0x1C00, 0xE000}},
+      // 32-bit.
+      {"BGRA in V5", 32, 124, kBiBitfields, {0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000}},
+      {"BGRX after header", 32, 40, kBiBitfields, {0x00FF0000, 0x0000FF00, 0x000000FF, 0}},
+      {"32-bit BI_RGB", 32, 40, kBiRgb, {}},
+      {"RGBA", 32, 40, kBiAlphaBitfields, {0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000}},
+      {"A2R10G10B10", 32, 108, kBiBitfields, {0x3FF00000, 0x000FFC00, 0x000003FF, 0xC0000000}},
+      {"R10G10B10X2", 32, 52, kBiBitfields, {0xFFC00000, 0x003FF000, 0x00000FFC, 0}},
+      {"16-bit channels", 32, 56, kBiBitfields, {0xFFFF0000, 0x0000FFFF, 0, 0}},
+      {"1-bit channels", 32, 56, kBiBitfields, {0x4, 0x2, 0x1, 0x80000000}},
+  };
+  for (const MaskCase& c : cases) {
+    for (bool zeroAlpha : {false, true}) {
+      CHECK(CheckMasks(c, zeroAlpha, 5));
+      CHECK(CheckMasks(c, zeroAlpha, -4));
+    }
+  }
+}
+
+void TestBadMasks() {
+  DibSpec spec;
+  spec.width = 2;
+  spec.height = 2;
+  spec.bitCount = 16;
+  spec.compression = kBiBitfields;
+  const std::vector<uint8_t> bits(DibStride(2, 16) * 2);
+  const uint32_t bad16[][3] = {
+      {0x1F800, 0x07E0, 0x001F},  // wider than the pixel
+      {0xF00F, 0x07E0, 0x001F},   // not contiguous
+  };
+  for (const auto& masks : bad16) {
+    for (int i = 0; i < 3; i++) spec.masks[i] = masks[i];
+    CHECK(Decode(MakeDib(spec, {}, bits)).empty());
+  }
+  // BI_BITFIELDS needs the masks: 40-byte header and no room after it, or a
+  // header too short to hold them.
+  spec.masks[0] = 0xF800;
+  spec.masks[1] = 0x07E0;
+  spec.masks[2] = 0x001F;
+  std::vector<uint8_t> dib = MakeDib(spec, {}, {});
+  dib.resize(40 + 8);
+  CHECK(Decode(dib).empty());
+  spec.headerSize = 44;
+  CHECK(Decode(MakeDib(spec, {}, bits)).empty());
+  spec.headerSize = 52;
+  spec.compression = kBiAlphaBitfields;
+  CHECK(Decode(MakeDib(spec, {}, bits)).empty());
+  // Bitfields only apply to 16 and 32 bits.
+  spec.headerSize = 124;
+  spec.bitCount = 24;
+  spec.compression = kBiBitfields;
+  CHECK(Decode(MakeDib(spec, {}, std::vector<uint8_t>(DibStride(2, 24) * 2))).empty());
+}
+
+// A V5 header followed by the three masks again, as some producers write it:
+// the copy is skipped when the block has exactly that much extra room.
+void TestMasksRepeatedAfterV5() {
+  DibSpec spec;
+  spec.headerSize = 124;
+  spec.width = 1;
+  spec.height = 1;
+  spec.bitCount = 32;
+  spec.compression = kBiBitfields;
+  spec.masks[0] = 0x00FF0000;
+  spec.masks[1] = 0x0000FF00;
+  spec.masks[2] = 0x000000FF;
+  std::vector<uint8_t> bits;
+  for (uint32_t v : {0x00FF0000u, 0x0000FF00u, 0x000000FFu, 0x00123456u}) PutLe32(&bits, v);
+  CHECK(Decode(MakeDib(spec, {}, bits)) == std::vector<uint8_t>({0x12, 0x34, 0x56, 0xFF}));
+}
+
+} // namespace
+
+int main() {
+  TestRle8();
+  TestRle4();
+  TestBitfields();
+  TestBadMasks();
+  TestMasksRepeatedAfterV5();
+  return TestResult();
+}
@@ -0,0 +1,229 @@
+// ParsePackedDib: where the pixels start and how they are described for
+// BITMAPINFOHEADER, V2-V5 headers and BI_BITFIELDS masks after a 40-byte
+// header (or repeated after a V5 one), with and without a color table; which
+// layouts are left to DibDecoder; and truncated or oversized headers and
+// sizes, which must fail without reading past the block.
+
+#include <cstdint>
+#include <vector>
+
+#include "Check.h"
+#include "DibParse.h"
+#include "TestDibs.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+constexpr uint32_t kBgraMasks[4] = {0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000};
+
+DibSpec Spec(uint32_t headerSize, int32_t width, int32_t height, uint16_t bitCount,
+             uint32_t compression = kBiRgb) {
+  DibSpec spec;
+  spec.headerSize = headerSize;
+  spec.width = width;
+  spec.height = height;
+  spec.bitCount = bitCount;
+  spec.compression = compression;
+  return spec;
+}
+
+void SetMasks(DibSpec* spec, const uint32_t (&masks)[4]) {
+  for (int i = 0; i < 4; i++) spec->masks[i] = masks[i];
+}
+
+// Bits for `spec`, every byte `fill`.
+std::vector<uint8_t> Bits(const DibSpec& spec, uint8_t fill) {
+  const uint32_t rows = static_cast<uint32_t>(spec.height < 0 ? -spec.height : spec.height);
+  return std::vector<uint8_t>(DibStride(spec.width, spec.bitCount) * rows, fill);
+}
+
+// Parses `dib` and checks the pixels start `offset` bytes in.
+bool ParsesAt(const std::vector<uint8_t>& dib, size_t offset, PixelSource* out) {
+  return CHECK(ParsePackedDib(dib.data(), dib.size(), out)) &&
+         CHECK(out->pixels == dib.data() + offset);
+}
+
+void TestInfoHeader() {
+  PixelSource src;
+  DibSpec spec = Spec(40, 3, 2, 24);
+  std::vector<uint8_t> dib = MakeDib(spec, {}, Bits(spec, 7));
+  if (ParsesAt(dib, 40, &src)) {
+    CHECK(src.width == 3 && src.height == 2 && src.stride == 12);
+    CHECK(src.format == PixelFormat::Bgr8 && src.bottomUp);
+  }
+
+  spec.height = -2;
+  dib = MakeDib(spec, {}, Bits(spec, 7));
+  if (ParsesAt(dib, 40, &src)) CHECK(src.height == 2 && !src.bottomUp);
+
+  // 32-bit BI_RGB: alpha counts only when some pixel has it.
+  spec = Spec(40, 5, 3, 32);
+  dib = MakeDib(spec, {}, Bits(spec, 0));
+  if (ParsesAt(dib, 40, &src)) CHECK(src.format == PixelFormat::Bgrx8 && src.stride == 20);
+  std::vector<uint8_t> bits = Bits(spec, 0);
+  bits[4 * 7 + 3] = 0x80;
+  dib = MakeDib(spec, {}, bits);
+  if (ParsesAt(dib, 40, &src)) CHECK(src.format == PixelFormat::Bgra8);
+}
+
+// V4 and V5 carry the masks (and alpha mask) in the header; a 52-byte (V2)
+// header has no alpha mask, a 56-byte (V3) one does.
+void TestMasksInHeader() {
+  PixelSource src;
+  for (uint32_t headerSize : {52u, 56u, 108u, 124u}) {
+    DibSpec spec = Spec(headerSize, 4, 4, 32, kBiBitfields);
+    SetMasks(&spec, kBgraMasks);
+    const std::vector<uint8_t> dib = MakeDib(spec, {}, Bits(spec, 0x80));
+    if (ParsesAt(dib, headerSize, &src)) {
+      CHECK(src.format == (headerSize >= 56 ? PixelFormat::Bgra8 : PixelFormat::Bgrx8));
+    }
+
+    // No alpha mask: the fourth byte is padding, whatever it holds.
+    spec.masks[3] = 0;
+    if (ParsesAt(MakeDib(spec, {}, Bits(spec, 0x80)), headerSize, &src)) {
+      CHECK(src.format == PixelFormat::Bgrx8);
+    }
+  }
+
+  // Masks repeated after a V5 header: skipped only when exactly 12 bytes are
+  // left over.
+  DibSpec spec = Spec(124, 4, 4, 32, kBiBitfields);
+  SetMasks(&spec, kBgraMasks);
+  std::vector<uint8_t> extra;
+  for (int i = 0; i < 3; i++) PutLe32(&extra, kBgraMasks[i]);
+  const std::vector<uint8_t> bits = Bits(spec, 0x80);
+  extra.insert(extra.end(), bits.begin(), bits.end());
+  std::vector<uint8_t> dib = MakeDib(spec, {}, extra);
+  ParsesAt(dib, 124 + 12, &src);
+  dib.push_back(0);  // 13 extra bytes: trailing data, not masks
+  ParsesAt(dib, 124, &src);
+}
+
+// BI_BITFIELDS after a 40-byte header: three masks, then the pixels (no
+// alpha mask, so opaque); BI_ALPHABITFIELDS: four.
+void TestMasksAfterHeader() {
+  PixelSource src;
+  DibSpec spec = Spec(40, 4, 4, 32, kBiBitfields);
+  SetMasks(&spec, kBgraMasks);
+  if (ParsesAt(MakeDib(spec, {}, Bits(spec, 0x80)), 52, &src)) {
+    CHECK(src.format == PixelFormat::Bgrx8);
+  }
+  spec.compression = kBiAlphaBitfields;
+  if (ParsesAt(MakeDib(spec, {}, Bits(spec, 0x80)), 56, &src)) {
+    CHECK(src.format == PixelFormat::Bgra8);
+  }
+
+  // Masks other than BGRA need converting: left to DibDecoder.
+  const uint32_t others[][4] = {
+      {0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000},  // RGBA
+      {0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF},  // ARGB, alpha low
+      {0x3FF00000, 0x000FFC00, 0x000003FF, 0xC0000000},  // 2-10-10-10
+      {0x00FF0000, 0x0000FF00, 0x000000FF, 0x0F000000},  // partial alpha
+  };
+  for (const auto& masks : others) {
+    for (uint32_t headerSize : {40u, 124u}) {
+      spec = Spec(headerSize, 4, 4, 32, kBiAlphaBitfields);
+      SetMasks(&spec, masks);
+      const std::vector<uint8_t> dib = MakeDib(spec, {}, Bits(spec, 0));
+      CHECK(!ParsePackedDib(dib.data(), dib.size(), &src));
+    }
+  }
+  // BI_BITFIELDS on 24 bits is not a thing.
+  spec = Spec(40, 4, 4, 24, kBiBitfields);
+  SetMasks(&spec, kBgraMasks);
+  const std::vector<uint8_t> dib = MakeDib(spec, {}, Bits(spec, 0));
+  CHECK(!ParsePackedDib(dib.data(), dib.size(), &src));
+}
+
+// biClrUsed = 0 means no color table above 8 bpp; a table that is there is
+// skipped. Palettized, 16-bit, RLE and embedded images are DibDecoder's.
+void TestColorTable() {
+  PixelSource src;
+  DibSpec spec = Spec(40, 2, 2, 24);
+  ParsesAt(MakeDib(spec, {}, Bits(spec, 1)), 40, &src);
+  spec.colorsUsed = 3;
+  ParsesAt(MakeDib(spec, {1, 2, 3}, Bits(spec, 1)), 40 + 12, &src);
+  spec = Spec(124, 2, 2, 32, kBiBitfields);
+  SetMasks(&spec, kBgraMasks);
+  spec.colorsUsed = 2;
+  ParsesAt(MakeDib(spec, {1, 2}, Bits(spec, 1)), 124 + 8, &src);
+
+  struct Layout {
+    uint16_t bitCount;
+    uint32_t compression;
+  };
+  const Layout declined[] = {
+      {1, kBiRgb},  {4, kBiRgb},  {8, kBiRgb},       {8, kBiRle8},
+      {4, kBiRle4}, {16, kBiRgb}, {16, kBiBitfields}, {0, kBiPng},
+  };
+  for (const Layout& layout : declined) {
+    spec = Spec(40, 2, 2, layout.bitCount, layout.compression);
+    const std::vector<uint8_t> dib =
+        MakeDib(spec, std::vector<uint32_t>(256, 0x123456), std::vector<uint8_t>(64, 0));
+    CHECK(!ParsePackedDib(dib.data(), dib.size(), &src));
+  }
+}
+
+void TestTruncatedOrOversized() {
+  PixelSource src;
+  CHECK(!ParsePackedDib(nullptr, 100, &src));
+  DibSpec spec = Spec(124, 4, 4, 32, kBiBitfields);
+  SetMasks(&spec, kBgraMasks);
+  const std::vector<uint8_t> good = MakeDib(spec, {}, Bits(spec, 0x80));
+  CHECK(ParsePackedDib(good.data(), good.size(), &src));
+  CHECK(!ParsePackedDib(good.data(), good.size(), nullptr));
+
+  // Any shorter block: the bits, the header or the fixed fields cut short.
+  for (size_t size : {good.size() - 1, size_t{150}, size_t{124}, size_t{100}, size_t{39}}) {
+    CHECK(!ParsePackedDib(good.data(), size, &src));
+  }
+
+  // The masks after a 40-byte header cut short.
+  spec = Spec(40, 1, 1, 32, kBiAlphaBitfields);
+  SetMasks(&spec, kBgraMasks);
+  std::vector<uint8_t> dib = MakeDib(spec, {}, {});
+  CHECK(dib.size() == 56 && !ParsePackedDib(dib.data(), 55, &src));
+
+  struct Field {
+    size_t offset;
+    uint32_t value;
+  };
+  const Field bad[] = {
+      {0, 12},           // BITMAPCOREHEADER
+      {0, 39},           // header size below BITMAPINFOHEADER
+      {0, 0x10000000},   // header larger than the block
+      {0, 44},           // a V2+ header too small for its masks
+      {4, 0},            // width 0
+      {4, 0x80000000},   // negative width
+      {8, 0},            // height 0
+      {8, 0x80000000},   // INT32_MIN height, which cannot be negated
+      {8, 0x7FFFFFFF},   // more rows than the block holds
+      {4, 0x7FFFFFFF},   // a row larger than the block
+      {32, 0xFFFFFFFF},  // a color table larger than the block
+      {32, 1},           // a color table that leaves the bits short
+  };
+  for (const Field& field : bad) {
+    dib = good;
+    dib[field.offset] = static_cast<uint8_t>(field.value);
+    dib[field.offset + 1] = static_cast<uint8_t>(field.value >> 8);
+    dib[field.offset + 2] = static_cast<uint8_t>(field.value >> 16);
+    dib[field.offset + 3] = static_cast<uint8_t>(field.value >> 24);
+    CHECK(!ParsePackedDib(dib.data(), dib.size(), &src));
+  }
+  dib = good;
+  dib[12] = 2;  // planes
+  CHECK(!ParsePackedDib(dib.data(), dib.size(), &src));
+}
+
+} // namespace
+
+int main() {
+  TestInfoHeader();
+  TestMasksInHeader();
+  TestMasksAfterHeader();
+  TestColorTable();
+  TestTruncatedOrOversized();
+  return TestResult();
+}
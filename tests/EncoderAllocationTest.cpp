@@ -0,0 +1,138 @@
+// A PngEncodeSession reused across a run keeps its deflate state, row and
+// segment buffers, deflaters and worker threads, so once warmed up it makes
+// no heap allocations per image. Counted by replacing operator new in this
+// test binary only.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "PngEncoder.h"
+#include "TestImages.h"
+
+namespace {
+std::atomic<long> g_allocations{0};
+} // namespace
+
+void* operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+// Writes into memory reserved up front, so the sink itself never allocates.
+class FixedSink : public ByteSink {
+ public:
+  explicit FixedSink(size_t capacity) : bytes_(capacity) {}
+  bool Write(const uint8_t* data, size_t size) override {
+    if (size > bytes_.size() - used_) return false;
+    std::memcpy(bytes_.data() + used_, data, size);
+    used_ += size;
+    return true;
+  }
+  void Clear() { used_ = 0; }
+
+ private:
+  std::vector<uint8_t> bytes_;
+  size_t used_ = 0;
+};
+
+// A run of kCycles passes over kKinds different images. Buffers grow to the
+// largest image and the palette to its largest size during the first pass.
+constexpr int kKinds = 6;
+constexpr int kCycles = 5;
+
+// Screenshots of varying size. Bgrx8 ones have few enough colors for a
+// palette, Bgra8 ones carry alpha.
+std::vector<TestImage> MakeRun() {
+  std::vector<TestImage> kinds;
+  for (int i = 0; i < kKinds; i++) {
+    const PixelFormat format = i % 2 ? PixelFormat::Bgrx8 : PixelFormat::Bgra8;
+    kinds.push_back(MakeScreenshot(800 - (i % 5) * 60, 600 + (i % 3) * 50, format,
+                                   static_cast<uint32_t>(i) + 1));
+  }
+  std::vector<TestImage> run;
+  for (int cycle = 0; cycle < kCycles; cycle++) run.insert(run.end(), kinds.begin(), kinds.end());
+  return run;
+}
+
+// Allocations made while encoding each image of the run with one session.
+std::vector<long> CountPerImage(const std::vector<TestImage>& images,
+                                const PngEncodeOptions& options) {
+  PngEncodeSession session(options);
+  FixedSink sink(64u << 20);
+  std::vector<long> counts;
+  counts.reserve(images.size());
+  for (const TestImage& image : images) {
+    sink.Clear();
+    const long before = g_allocations.load();
+    const bool ok = session.Encode(image.Source(), &sink);
+    counts.push_back(g_allocations.load() - before);
+    CHECK(ok);
+  }
+  return counts;
+}
+
+long CountFromCycle(const std::vector<long>& counts, int firstCycle) {
+  long total = 0;
+  for (size_t i = static_cast<size_t>(firstCycle) * kKinds; i < counts.size(); i++) {
+    total += counts[i];
+  }
+  return total;
+}
+
+void Report(const char* label, const std::vector<long>& counts) {
+  std::printf("%-22s", label);
+  for (size_t i = 0; i < counts.size(); i++) {
+    std::printf(i % kKinds == 0 ? " | %ld" : " %ld", counts[i]);
+  }
+  std::printf("\n");
+}
+
+void TestSerialSession() {
+  const std::vector<TestImage> images = MakeRun();
+  for (bool reduce : {false, true}) {
+    PngEncodeOptions options;
+    options.threads = 1;
+    options.reduceColors = reduce;
+    const std::vector<long> counts = CountPerImage(images, options);
+    Report(reduce ? "serial, reduce colors" : "serial", counts);
+    CHECK(counts[0] > 0);
+    CHECK(CountFromCycle(counts, 1) == 0);
+  }
+}
+
+// Workers pick up segments in whatever order the scheduler runs them, so the
+// pools of segments and deflaters may reach their size (bounded by the thread
+// count) a little after the first pass; allow one more.
+void TestParallelSession() {
+  const std::vector<TestImage> images = MakeRun();
+  PngEncodeOptions options;
+  options.threads = 4;
+  options.segmentBytes = 64 * 1024;
+  const std::vector<long> counts = CountPerImage(images, options);
+  Report("4 threads", counts);
+  CHECK(counts[0] > 0);
+  CHECK(CountFromCycle(counts, 2) == 0);
+}
+
+} // namespace
+
+int main() {
+  TestSerialSession();
+  TestParallelSession();
+  return TestResult();
+}
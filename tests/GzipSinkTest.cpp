@@ -0,0 +1,186 @@
+// GzipSink round trip through InflateRaw on the serial path (one thread), the
+// single-segment path (threads, but input below one segment) and the parallel
+// path (many segments, Crc32Combine, each primed with the previous 32 KiB).
+// The header, CRC-32 (against a bitwise reference) and ISIZE are checked on
+// every stream, with input written in random pieces.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "GzipSink.h"
+#include "Inflate.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+uint32_t ReferenceCrc32(const std::vector<uint8_t>& data) {
+  uint32_t crc = 0xFFFFFFFFu;
+  for (uint8_t b : data) {
+    crc ^= b;
+    for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+uint32_t ReadLe32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Log-like text: repeated line shapes with varying numbers.
+std::vector<uint8_t> MakeLog(size_t size, uint32_t seed) {
+  static const char* const kWords[] = {"INFO", "WARN", "request", "served", "cache", "miss",
+                                       "GET",  "/api/items", "in", "ms", "user", "retry"};
+  Random random(seed);
+  std::vector<uint8_t> text;
+  while (text.size() < size) {
+    char number[16];
+    std::snprintf(number, sizeof(number), "%u ", random.Below(100000));
+    for (const char* c = number; *c; c++) text.push_back(static_cast<uint8_t>(*c));
+    for (uint32_t n = 3 + random.Below(6); n > 0; n--) {
+      for (const char* c = kWords[random.Below(12)]; *c; c++) {
+        text.push_back(static_cast<uint8_t>(*c));
+      }
+      text.push_back(' ');
+    }
+    text.push_back('\n');
+  }
+  text.resize(size);
+  return text;
+}
+
+// Compresses `input` in random pieces and returns the gzip stream.
+std::vector<uint8_t> Compress(const std::vector<uint8_t>& input, const GzipOptions& options,
+                              uint32_t seed) {
+  MemorySink out;
+  GzipSink gzip(&out, options);
+  Random random(seed);
+  for (size_t pos = 0; pos < input.size();) {
+    const size_t piece = std::min<size_t>(input.size() - pos, 1 + random.Below(100000));
+    CHECK(gzip.Write(input.data() + pos, piece));
+    pos += piece;
+  }
+  CHECK(gzip.Finish());
+  CHECK(!gzip.Write(input.data(), 0));
+  CHECK(gzip.InputBytes() == input.size());
+  CHECK(gzip.OutputBytes() == out.bytes.size());
+  return out.bytes;
+}
+
+// Checks the member's header and trailer and that it inflates to `input`.
+bool RoundTrips(const std::vector<uint8_t>& gz, const std::vector<uint8_t>& input) {
+  if (!CHECK(gz.size() >= 18)) return false;
+  bool ok = CHECK(gz[0] == 0x1F && gz[1] == 0x8B && gz[2] == 8 && gz[3] == 0);
+  std::vector<uint8_t> inflated;
+  size_t consumed = 0;
+  ok = CHECK(InflateRaw(gz.data() + 10, gz.size() - 10, input.size(), &inflated, &consumed)) &&
+       ok;
+  ok = CHECK(inflated == input) && ok;
+  ok = CHECK(10 + consumed + 8 == gz.size()) && ok;
+  const uint8_t* trailer = gz.data() + gz.size() - 8;
+  ok = CHECK(ReadLe32(trailer) == ReferenceCrc32(input)) && ok;
+  ok = CHECK(ReadLe32(trailer + 4) == static_cast<uint32_t>(input.size())) && ok;
+  return ok;
+}
+
+void TestSerial() {
+  GzipOptions options;
+  options.threads = 1;
+  for (size_t size : {size_t{0}, size_t{1}, size_t{100}, size_t{3} << 20}) {
+    const std::vector<uint8_t> input = MakeLog(size, 1);
+    CHECK(RoundTrips(Compress(input, options, 2), input));
+  }
+}
+
+// Threads requested, but everything fits in one segment, which Finish
+// compresses on the calling thread.
+void TestSingleSegment() {
+  GzipOptions options;
+  options.threads = 4;
+  for (size_t size : {size_t{0}, size_t{5000}, options.segmentBytes - 1, options.segmentBytes}) {
+    const std::vector<uint8_t> input = MakeLog(size, 3);
+    CHECK(RoundTrips(Compress(input, options, 4), input));
+  }
+}
+
+void TestParallel() {
+  GzipOptions options;
+  options.threads = 4;
+  options.segmentBytes = 64 * 1024;
+  // Exact multiples of the segment size and one byte either side.
+  for (size_t size : {options.segmentBytes * 40 - 1, options.segmentBytes * 40,
+                      options.segmentBytes * 40 + 1, size_t{5} << 20}) {
+    const std::vector<uint8_t> input = MakeLog(size, 5);
+    CHECK(RoundTrips(Compress(input, options, 6), input));
+  }
+  // More threads than segments, and segments below the window (raised to 32 KiB).
+  options.threads = 16;
+  options.segmentBytes = 1000;
+  const std::vector<uint8_t> input = MakeLog(100000, 7);
+  CHECK(RoundTrips(Compress(input, options, 8), input));
+}
+
+// A random 24 KiB block repeated: the first copy in each 64 KiB segment only
+// matches data in the previous segment, so the stream is small only if every
+// segment is primed with that segment's tail.
+void TestDictionaryPriming() {
+  Random random(9);
+  std::vector<uint8_t> block(24 * 1024);
+  for (uint8_t& b : block) b = static_cast<uint8_t>(random.Next());
+  std::vector<uint8_t> input;
+  while (input.size() < (size_t{2} << 20)) input.insert(input.end(), block.begin(), block.end());
+
+  GzipOptions options;
+  options.threads = 4;
+  options.segmentBytes = 64 * 1024;
+  const std::vector<uint8_t> gz = Compress(input, options, 10);
+  CHECK(RoundTrips(gz, input));
+  std::printf("primed: %zu -> %zu bytes\n", input.size(), gz.size());
+  CHECK(gz.size() < block.size() + input.size() / 50);
+}
+
+class FailingSink : public ByteSink {
+ public:
+  explicit FailingSink(size_t limit) : limit_(limit) {}
+  bool Write(const uint8_t*, size_t size) override {
+    if (size > limit_) return false;
+    limit_ -= size;
+    return true;
+  }
+
+ private:
+  size_t limit_;
+};
+
+// A write error downstream fails the sink and is not retried.
+void TestSinkFailure() {
+  const std::vector<uint8_t> input = MakeLog(size_t{2} << 20, 11);
+  for (unsigned threads : {1u, 4u}) {
+    FailingSink out(1000);
+    GzipOptions options;
+    options.threads = threads;
+    options.segmentBytes = 64 * 1024;
+    GzipSink gzip(&out, options);
+    bool ok = gzip.Write(input.data(), input.size());
+    ok = ok && gzip.Finish();
+    CHECK(!ok);
+    CHECK(!gzip.Write(input.data(), 1));
+  }
+}
+
+} // namespace
+
+int main() {
+  TestSerial();
+  TestSingleSegment();
+  TestParallel();
+  TestDictionaryPriming();
+  TestSinkFailure();
+  return TestResult();
+}
@@ -0,0 +1,89 @@
+// HTML to Markdown against golden files in data/markdown: each <name>.html
+// must convert to <name>.md (LF line breaks). The converter is a streaming
+// state machine, so every fixture is also fed split at each byte offset and
+// in random small pieces, through a sink flushed every few bytes, and must
+// give the same output as the one-shot conversion.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "HtmlMarkdown.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+constexpr const char* kFixtures[] = {"lists", "tables", "links", "code", "word"};
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  CHECK(in.good());
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+TextEncodeOptions LfOptions() {
+  TextEncodeOptions options;
+  options.eol = EolMode::Lf;
+  return options;
+}
+
+std::string Convert(const std::string& html) {
+  MemorySink sink;
+  CHECK(ConvertHtmlToMarkdown(html, LfOptions(), &sink));
+  return std::string(sink.bytes.begin(), sink.bytes.end());
+}
+
+// Feeds `html` in pieces whose sizes come from `next`, through a converter
+// that flushes every 7 bytes.
+template <typename NextSize>
+std::string ConvertInPieces(const std::string& html, NextSize next) {
+  MemorySink sink;
+  HtmlToMarkdown converter(LfOptions(), &sink, 7);
+  for (size_t pos = 0; pos < html.size();) {
+    const size_t piece = std::min(html.size() - pos, next(pos));
+    CHECK(converter.Feed(html.data() + pos, piece));
+    pos += piece;
+  }
+  CHECK(converter.Finish());
+  return std::string(sink.bytes.begin(), sink.bytes.end());
+}
+
+void TestFixture(const char* name) {
+  const std::string base = std::string(PTF_TEST_DATA_DIR) + "/markdown/" + name;
+  const std::string html = ReadFile(base + ".html");
+  const std::string expected = ReadFile(base + ".md");
+  const std::string actual = Convert(html);
+  if (!CHECK(actual == expected)) {
+    std::printf("%s.md differs; got:\n%s\n", name, actual.c_str());
+    return;
+  }
+
+  for (size_t split = 1; split < html.size(); split++) {
+    const std::string twoPieces =
+        ConvertInPieces(html, [&](size_t pos) { return pos == 0 ? split : html.size(); });
+    if (!CHECK(twoPieces == expected)) {
+      std::printf("%s: split at byte %zu differs\n", name, split);
+      return;
+    }
+  }
+  CHECK(ConvertInPieces(html, [](size_t) { return size_t{1}; }) == expected);
+  Random random(11);
+  for (int i = 0; i < 20; i++) {
+    CHECK(ConvertInPieces(html, [&](size_t) { return size_t{1} + random.Below(16); }) ==
+          expected);
+  }
+}
+
+} // namespace
+
+int main() {
+  for (const char* name : kFixtures) TestFixture(name);
+  return TestResult();
+}
@@ -0,0 +1,85 @@
+// NameIndex::NextFree: names compare case-insensitively, the cursor moves
+// past names marked used, and -1 comes back once the kMaxSuffix sequence
+// numbers from the template's first one are all taken.
+
+#include <string>
+
+#include "Check.h"
+
+#include "PasteToFileCommon/NameIndex.h"
+#include "PasteToFileCommon/NameTemplate.h"
+
+using namespace ptf_test;
+
+namespace {
+
+ptf::NameFields Feb23() {
+  ptf::NameFields fields;
+  fields.year = 2026;
+  fields.month = 2;
+  fields.day = 23;
+  fields.hour = 9;
+  return fields;
+}
+
+std::wstring Name(const ptf::NameTemplate& name, int seq, const wchar_t* ext) {
+  std::wstring out;
+  name.Append(Feb23(), seq, ext, &out);
+  return out;
+}
+
+void TestCaseFolding() {
+  const ptf::NameTemplate name;
+  ptf::NameIndex index;
+  index.Add(L"PTF-2026-FEB-23.TXT");
+  CHECK(Name(name, 0, L".txt") == L"PTF-2026-feb-23.txt");
+  CHECK(index.NextFree(name, Feb23(), L".txt") == 1);
+  index.MarkUsed(L"ptf-2026-Feb-23-01.Txt");
+  CHECK(index.NextFree(name, Feb23(), L".txt") == 2);
+  // Another extension, in any case, is a different name.
+  CHECK(index.NextFree(name, Feb23(), L".PNG") == 0);
+  index.MarkUsed(L"PTF-2026-feb-23.png");
+  CHECK(index.NextFree(name, Feb23(), L".PNG") == 1);
+  // Cursors are shared however the extension is spelled.
+  CHECK(index.NextFree(name, Feb23(), L".TXT") == 2);
+}
+
+void TestCursorSkipsGaps() {
+  const ptf::NameTemplate name;
+  ptf::NameIndex index;
+  for (int seq : {0, 1, 2, 4}) index.Add(Name(name, seq, L".txt"));
+  CHECK(index.NextFree(name, Feb23(), L".txt") == 3);
+  CHECK(index.NextFree(name, Feb23(), L".txt") == 3);  // not used until marked
+  index.MarkUsed(Name(name, 3, L".txt"));
+  CHECK(index.NextFree(name, Feb23(), L".txt") == 5);
+  CHECK(index.Size() == 5);
+}
+
+void TestMaxSuffix(const wchar_t* pattern, int first) {
+  ptf::NameTemplate name;
+  std::wstring error;
+  CHECK(name.Compile(pattern, &error));
+  CHECK(name.FirstSeq() == first);
+  ptf::NameIndex index;
+  for (int seq = first; seq < first + ptf::NameIndex::kMaxSuffix - 1; seq++) {
+    index.Add(Name(name, seq, L".txt"));
+  }
+  const int last = first + ptf::NameIndex::kMaxSuffix - 1;
+  CHECK(index.NextFree(name, Feb23(), L".txt") == last);
+  index.MarkUsed(Name(name, last, L".txt"));
+  CHECK(index.NextFree(name, Feb23(), L".txt") == -1);
+  CHECK(index.NextFree(name, Feb23(), L".txt") == -1);
+  // Names past the range are not tried, and do not change the answer.
+  index.Add(Name(name, last + 1, L".txt"));
+  CHECK(index.NextFree(name, Feb23(), L".txt") == -1);
+}
+
+} // namespace
+
+int main() {
+  TestCaseFolding();
+  TestCursorSkipsGaps();
+  TestMaxSuffix(ptf::NameTemplate::kDefault, 0);
+  TestMaxSuffix(L"clip-{seq:03}{ext}", 1);
+  return TestResult();
+}
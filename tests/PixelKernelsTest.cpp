@@ -0,0 +1,288 @@
+// The SSE2 and AVX2 pixel kernels must give the same bytes as the scalar
+// ones, which are themselves checked against a plain reference here, for every
+// kernel, filter, bytes-per-pixel, length and alignment. The encoder's output
+// must then be identical under each instruction set for every pixel format
+// and filter strategy.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "PixelKernels.h"
+#include "PngEncoder.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+const KernelIsa kVectorIsas[] = {KernelIsa::Sse2, KernelIsa::Avx2};
+const size_t kBpps[] = {1, 2, 3, 4, 6, 8};
+
+const char* IsaName(KernelIsa isa) {
+  switch (isa) {
+    case KernelIsa::Scalar: return "scalar";
+    case KernelIsa::Sse2: return "sse2";
+    case KernelIsa::Avx2: return "avx2";
+  }
+  return "?";
+}
+
+// Lengths around every vector width and unroll boundary, plus a few long ones.
+std::vector<size_t> Lengths() {
+  std::vector<size_t> lengths;
+  for (size_t n = 0; n <= 130; n++) lengths.push_back(n);
+  for (size_t n : {191, 192, 193, 255, 256, 257, 1000, 4099}) lengths.push_back(n);
+  return lengths;
+}
+
+std::vector<uint8_t> RandomBytes(size_t n, uint32_t seed) {
+  Random random(seed);
+  std::vector<uint8_t> bytes(n);
+  for (uint8_t& b : bytes) b = static_cast<uint8_t>(random.Next() >> 24);
+  return bytes;
+}
+
+// --- Plain references, written from the PNG specification ---
+
+void RefFilter(int type, const uint8_t* cur, const uint8_t* prev, size_t n, size_t bpp,
+               uint8_t* out) {
+  for (size_t i = 0; i < n; i++) {
+    const int a = i >= bpp ? cur[i - bpp] : 0;
+    const int b = prev[i];
+    const int c = i >= bpp ? prev[i - bpp] : 0;
+    int predictor = 0;
+    switch (type) {
+      case 1: predictor = a; break;
+      case 2: predictor = b; break;
+      case 3: predictor = (a + b) / 2; break;
+      case 4: predictor = Paeth(a, b, c); break;
+    }
+    out[i] = static_cast<uint8_t>(cur[i] - predictor);
+  }
+}
+
+uint64_t RefSumAbsSigned(const uint8_t* p, size_t n) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < n; i++) sum += p[i] < 128 ? p[i] : 256 - p[i];
+  return sum;
+}
+
+// Output of every kernel for one input, so ISAs can be compared as a whole.
+struct KernelOutputs {
+  std::vector<uint8_t> swap32, swap32InPlace, rgb24, swap24, swap24InPlace;
+  std::vector<std::vector<uint8_t>> filters;  // [bpp][type 1-4], then adaptive
+  std::vector<uint64_t> sums;
+  bool anyAlpha = false;
+  bool allOpaque = false, allGray = false;
+
+  bool operator==(const KernelOutputs& o) const {
+    return swap32 == o.swap32 && swap32InPlace == o.swap32InPlace && rgb24 == o.rgb24 &&
+           swap24 == o.swap24 && swap24InPlace == o.swap24InPlace && filters == o.filters &&
+           sums == o.sums && anyAlpha == o.anyAlpha && allOpaque == o.allOpaque &&
+           allGray == o.allGray;
+  }
+};
+
+// Runs every kernel on `n` pixels / bytes starting `offset` bytes into the
+// buffers, so unaligned loads and stores are covered.
+KernelOutputs RunKernels(const std::vector<uint8_t>& cur, const std::vector<uint8_t>& prev,
+                         size_t n, size_t offset) {
+  KernelOutputs out;
+  const uint8_t* src = cur.data() + offset;
+  const uint8_t* above = prev.data() + offset;
+
+  out.swap32.assign(n * 4 + offset, 0);
+  SwapRedBlue32(src, out.swap32.data() + offset, n);
+  out.swap32InPlace.assign(cur.begin(), cur.begin() + offset + n * 4);
+  SwapRedBlue32(out.swap32InPlace.data() + offset, out.swap32InPlace.data() + offset, n);
+  out.rgb24.assign(n * 3 + offset, 0);
+  Bgrx32ToRgb24(src, out.rgb24.data() + offset, n);
+  out.swap24.assign(n * 3 + offset, 0);
+  SwapRedBlue24(src, out.swap24.data() + offset, n);
+  out.swap24InPlace.assign(cur.begin(), cur.begin() + offset + n * 3);
+  SwapRedBlue24(out.swap24InPlace.data() + offset, out.swap24InPlace.data() + offset, n);
+
+  std::vector<uint8_t> scratch(5 * (n + 1));
+  for (size_t bpp : kBpps) {
+    std::vector<uint8_t> filtered(n + offset);
+    uint8_t* dst = filtered.data() + offset;
+    PngFilterSub(src, n, bpp, dst);
+    out.filters.push_back(filtered);
+    PngFilterUp(src, above, n, dst);
+    out.filters.push_back(filtered);
+    PngFilterAverage(src, above, n, bpp, dst);
+    out.filters.push_back(filtered);
+    PngFilterPaeth(src, above, n, bpp, dst);
+    out.filters.push_back(filtered);
+    const uint8_t* best = PngFilterRowAdaptive(src, above, n, bpp, scratch.data());
+    out.filters.emplace_back(best, best + n + 1);
+  }
+  out.sums.push_back(SumAbsSigned(src, n));
+  out.sums.push_back(SumAbsSigned(src, n * 4));
+  out.anyAlpha = AnyAlpha32(src, n);
+  out.allOpaque = out.allGray = true;
+  ScanOpaqueGray32(src, n, &out.allOpaque, &out.allGray);
+  return out;
+}
+
+void TestScalarAgainstReference() {
+  SetKernelIsa(KernelIsa::Scalar);
+  for (size_t n : Lengths()) {
+    const std::vector<uint8_t> cur = RandomBytes(n + 8, static_cast<uint32_t>(n) + 1);
+    const std::vector<uint8_t> prev = RandomBytes(n + 8, static_cast<uint32_t>(n) + 1000);
+    for (size_t bpp : kBpps) {
+      std::vector<uint8_t> expected(n), actual(n);
+      for (int type = 1; type <= 4; type++) {
+        RefFilter(type, cur.data(), prev.data(), n, bpp, expected.data());
+        switch (type) {
+          case 1: PngFilterSub(cur.data(), n, bpp, actual.data()); break;
+          case 2: PngFilterUp(cur.data(), prev.data(), n, actual.data()); break;
+          case 3: PngFilterAverage(cur.data(), prev.data(), n, bpp, actual.data()); break;
+          case 4: PngFilterPaeth(cur.data(), prev.data(), n, bpp, actual.data()); break;
+        }
+        if (!CHECK(actual == expected)) {
+          std::fprintf(stderr, "  filter %d, n=%zu, bpp=%zu\n", type, n, bpp);
+        }
+      }
+    }
+    CHECK(SumAbsSigned(cur.data(), n) == RefSumAbsSigned(cur.data(), n));
+  }
+}
+
+void TestVectorAgainstScalar() {
+  for (KernelIsa isa : kVectorIsas) {
+    SetKernelIsa(isa);
+    if (GetKernelIsa() != isa) {
+      std::printf("%s not supported on this CPU; skipped\n", IsaName(isa));
+      continue;
+    }
+    int mismatches = 0;
+    for (size_t n : Lengths()) {
+      const size_t bytes = n * 4 + 8;
+      const std::vector<uint8_t> cur = RandomBytes(bytes, static_cast<uint32_t>(n) * 7 + 3);
+      const std::vector<uint8_t> prev = RandomBytes(bytes, static_cast<uint32_t>(n) * 7 + 4);
+      for (size_t offset = 0; offset < 4; offset++) {
+        SetKernelIsa(KernelIsa::Scalar);
+        const KernelOutputs expected = RunKernels(cur, prev, n, offset);
+        SetKernelIsa(isa);
+        if (!(RunKernels(cur, prev, n, offset) == expected) && mismatches++ < 10) {
+          std::fprintf(stderr, "%s differs from scalar: n=%zu offset=%zu\n", IsaName(isa), n,
+                       offset);
+        }
+      }
+    }
+    CHECK(mismatches == 0);
+  }
+  SetKernelIsa(DetectKernelIsa());
+}
+
+// AnyAlpha32 and ScanOpaqueGray32 on random data almost always answer "no";
+// these buffers differ from the "yes" case in exactly one byte, at every
+// position of every vector lane.
+void TestScansAgainstScalar() {
+  for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::Sse2, KernelIsa::Avx2}) {
+    SetKernelIsa(isa);
+    if (GetKernelIsa() != isa) continue;
+    for (size_t n = 0; n <= 70; n++) {
+      std::vector<uint8_t> transparent(n * 4, 0x55);
+      std::vector<uint8_t> opaqueGray(n * 4, 0x80);
+      for (size_t i = 0; i < n; i++) transparent[i * 4 + 3] = 0, opaqueGray[i * 4 + 3] = 0xFF;
+
+      bool opaque = true, gray = true;
+      CHECK(!AnyAlpha32(transparent.data(), n));
+      ScanOpaqueGray32(opaqueGray.data(), n, &opaque, &gray);
+      CHECK(opaque && gray);
+
+      for (size_t i = 0; i < n * 4; i++) {
+        std::vector<uint8_t> changed = opaqueGray;
+        changed[i] ^= 0x01;
+        opaque = gray = true;
+        ScanOpaqueGray32(changed.data(), n, &opaque, &gray);
+        const bool alphaByte = i % 4 == 3;
+        if (!CHECK(opaque == !alphaByte && gray == alphaByte)) {
+          std::fprintf(stderr, "  %s ScanOpaqueGray32 n=%zu byte=%zu\n", IsaName(isa), n, i);
+        }
+        if (alphaByte) {
+          changed = transparent;
+          changed[i] = 1;
+          if (!CHECK(AnyAlpha32(changed.data(), n))) {
+            std::fprintf(stderr, "  %s AnyAlpha32 n=%zu byte=%zu\n", IsaName(isa), n, i);
+          }
+        }
+      }
+    }
+  }
+  SetKernelIsa(DetectKernelIsa());
+}
+
+void TestFlipRows() {
+  for (size_t rows : {0, 1, 2, 3, 10}) {
+    const size_t stride = 37;
+    std::vector<uint8_t> pixels = RandomBytes(stride * rows, static_cast<uint32_t>(rows) + 9);
+    const std::vector<uint8_t> original = pixels;
+    FlipRowsInPlace(pixels.data(), stride, rows);
+    bool flipped = true;
+    for (size_t y = 0; y < rows; y++) {
+      flipped &= std::memcmp(&pixels[y * stride], &original[(rows - 1 - y) * stride], stride) == 0;
+    }
+    CHECK(flipped);
+  }
+}
+
+// Whole encodes: the vector kernels run inside conversion, analysis and
+// filtering, so the PNG bytes must not depend on the instruction set.
+void TestEncoderAcrossIsas() {
+  const PixelFormat formats[] = {PixelFormat::Bgra8, PixelFormat::Bgrx8, PixelFormat::Rgba8,
+                                 PixelFormat::Bgr8, PixelFormat::Rgb8};
+  const PngFilterStrategy filters[] = {PngFilterStrategy::None,    PngFilterStrategy::Sub,
+                                       PngFilterStrategy::Up,      PngFilterStrategy::Average,
+                                       PngFilterStrategy::Paeth,   PngFilterStrategy::Adaptive};
+  for (PixelFormat format : formats) {
+    const TestImage images[] = {MakeScreenshot(131, 47, format, 5), MakeNoise(67, 29, format, 6)};
+    for (const TestImage& image : images) {
+      for (PngFilterStrategy filter : filters) {
+        for (bool reduce : {false, true}) {
+          PngEncodeOptions options;
+          options.filter = filter;
+          options.reduceColors = reduce;
+          options.threads = 1;
+          SetKernelIsa(KernelIsa::Scalar);
+          MemorySink expected;
+          CHECK(EncodePng(image.Source(), &expected, options));
+          uint32_t width = 0, height = 0;
+          std::vector<uint32_t> decoded;
+          CHECK(DecodePng(expected.bytes, &width, &height, &decoded));
+          CHECK(decoded == ToArgb(image));
+          for (KernelIsa isa : kVectorIsas) {
+            SetKernelIsa(isa);
+            if (GetKernelIsa() != isa) continue;
+            MemorySink actual;
+            CHECK(EncodePng(image.Source(), &actual, options));
+            if (!CHECK(actual.bytes == expected.bytes)) {
+              std::fprintf(stderr, "  %s: format %d filter %d reduce %d\n", IsaName(isa),
+                           static_cast<int>(format), static_cast<int>(filter), reduce);
+            }
+          }
+        }
+      }
+    }
+  }
+  SetKernelIsa(DetectKernelIsa());
+}
+
+} // namespace
+
+int main() {
+  std::printf("detected: %s\n", IsaName(DetectKernelIsa()));
+  TestScalarAgainstReference();
+  TestVectorAgainstScalar();
+  TestScansAgainstScalar();
+  TestFlipRows();
+  TestEncoderAcrossIsas();
+  return TestResult();
+}
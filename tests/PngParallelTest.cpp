@@ -0,0 +1,85 @@
+// Parallel PNG compression: every thread count and segment size must produce
+// a valid PNG that decodes to the input pixels.
+
+#include <cstdio>
+#include <vector>
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "PngEncoder.h"
+#include "TestImages.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+bool RoundTrips(const TestImage& image, const PngEncodeOptions& options) {
+  MemorySink sink;
+  if (!EncodePng(image.Source(), &sink, options)) return false;
+  uint32_t width = 0, height = 0;
+  std::vector<uint32_t> decoded;
+  if (!DecodePng(sink.bytes, &width, &height, &decoded)) return false;
+  return width == image.width && height == image.height && decoded == ToArgb(image);
+}
+
+void TestThreadCounts() {
+  const TestImage screenshot = MakeScreenshot(700, 500, PixelFormat::Bgra8);
+  const TestImage noise = MakeNoise(300, 200, PixelFormat::Bgrx8);
+  for (unsigned threads : {1u, 2u, 3u, 8u}) {
+    for (size_t segmentBytes : {size_t{1}, size_t{4096}, size_t{64 * 1024}, size_t{1} << 20}) {
+      PngEncodeOptions options;
+      options.threads = threads;
+      options.segmentBytes = segmentBytes;
+      options.reduceColors = false;
+      CHECK(RoundTrips(screenshot, options));
+      CHECK(RoundTrips(noise, options));
+    }
+  }
+}
+
+void TestLevelsAndReduction() {
+  const TestImage image = MakeScreenshot(400, 300, PixelFormat::Rgb8, 7);
+  for (int level : {0, 1, 6, 9}) {
+    PngEncodeOptions options;
+    options.threads = 4;
+    options.segmentBytes = 16 * 1024;
+    options.compressionLevel = level;
+    CHECK(RoundTrips(image, options));
+  }
+}
+
+void TestMemoryBudget() {
+  const TestImage image = MakeScreenshot(1000, 400, PixelFormat::Bgra8, 3);
+  PngEncodeOptions options;
+  options.threads = 8;
+  options.segmentBytes = 32 * 1024;
+  options.memoryBudget = 64 * 1024;  // less than one segment per thread
+  CHECK(RoundTrips(image, options));
+}
+
+void TestSessionReuse() {
+  PngEncodeOptions options;
+  options.threads = 4;
+  options.segmentBytes = 8 * 1024;
+  PngEncodeSession session(options);
+  for (uint32_t i = 0; i < 5; i++) {
+    const TestImage image = MakeScreenshot(120 + i * 70, 90 + i * 40, PixelFormat::Bgra8, i + 1);
+    MemorySink sink;
+    CHECK(session.Encode(image.Source(), &sink));
+    uint32_t width = 0, height = 0;
+    std::vector<uint32_t> decoded;
+    CHECK(DecodePng(sink.bytes, &width, &height, &decoded));
+    CHECK(decoded == ToArgb(image));
+  }
+}
+
+} // namespace
+
+int main() {
+  TestThreadCounts();
+  TestLevelsAndReduction();
+  TestMemoryBudget();
+  TestSessionReuse();
+  return TestResult();
+}
@@ -0,0 +1,86 @@
+// RTF to text: \'hh escapes and 8-bit text decode in the code page the
+// document or the current font declares, with windows-1252 only when neither
+// declares one.
+
+#include <cstdio>
+#include <string>
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "RtfConvert.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+std::string ToText(const std::string& rtf) {
+  TextEncodeOptions options;
+  options.eol = EolMode::Lf;
+  MemorySink sink;
+  CHECK(ConvertRtf(rtf, RtfOutput::Text, options, &sink));
+  return std::string(sink.bytes.begin(), sink.bytes.end());
+}
+
+// Fed one byte at a time, which splits every control word and escape.
+std::string ToTextByteByByte(const std::string& rtf) {
+  TextEncodeOptions options;
+  options.eol = EolMode::Lf;
+  MemorySink sink;
+  RtfConverter converter(RtfOutput::Text, options, &sink);
+  for (char c : rtf) CHECK(converter.Feed(&c, 1));
+  CHECK(converter.Finish());
+  return std::string(sink.bytes.begin(), sink.bytes.end());
+}
+
+bool Converts(const std::string& rtf, const std::string& expected) {
+  const std::string actual = ToText(rtf);
+  if (actual == expected && ToTextByteByByte(rtf) == expected) return true;
+  std::printf("%s\n  gave \"%s\", expected \"%s\"\n", rtf.c_str(), actual.c_str(),
+              expected.c_str());
+  return false;
+}
+
+void TestDocumentCodePage() {
+  CHECK(Converts(R"({\rtf1\ansi\ansicpg1251 \'cf\'f0\'e8\'e2\'e5\'f2\par})",
+                 "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82\n"));  // Привет
+  CHECK(Converts(R"({\rtf1\ansi\ansicpg1253 \'e1\'e2})", "\xCE\xB1\xCE\xB2"));  // αβ
+  CHECK(Converts("{\\rtf1\\ansi\\ansicpg1251 \xcf}", "\xD0\x9F"));  // raw 8-bit text
+  CHECK(Converts(R"({\rtf1\pc \'82})", "\xC3\xA9"));                  // 437: é
+  CHECK(Converts(R"({\rtf1\pca \'9b})", "\xC3\xB8"));                 // 850: ø
+}
+
+void TestDefaultIsWindows1252() {
+  CHECK(Converts(R"({\rtf1\ansi \'80\'e9\'81})", "\xE2\x82\xAC\xC3\xA9\xC2\x81"));
+  CHECK(Converts(R"({\rtf1\ansi\ansicpg0 \'e9})", "\xC3\xA9"));
+}
+
+void TestFontCharsets() {
+  const std::string fonts =
+      R"({\rtf1\ansi\ansicpg1252\deff0{\fonttbl{\f0\fswiss\fcharset0 Arial;})"
+      R"({\f1\fnil\fcharset238{\*\panose 020b0604020202020204}Arial CE;})"
+      R"({\f2\fnil\fcharset161 Greek;}{\f3\fnil\fcharset0\cpg1251 Cyr;}{\f4\fnil\fcharset2 Sym;}})";
+  // Font names and panose data are not text.
+  CHECK(Converts(fonts + R"(\f1 \'b9\f0 \'e9 {\f2 \'e1}\'e9\par})",
+                 "\xC4\x85\xC3\xA9 \xCE\xB1\xC3\xA9\n"));  // ąé αé
+  CHECK(Converts(fonts + R"(\f3 \'cf\f4 \'e9})", "\xD0\x9F\xC3\xA9"));  // \cpg wins; symbol
+  CHECK(Converts(fonts + R"(\f1 \'b9\plain \'b9})", "\xC4\x85\xC2\xB9"));  // \plain: \deff0
+  CHECK(Converts(R"({\rtf1\ansi\deff1{\fonttbl{\f1\fcharset204 Times;}}\'cf})", "\xD0\x9F"));
+  CHECK(Converts(R"({\rtf1\ansi\ansicpg1251{\fonttbl{\f0\fnil Courier;}}\f0 \'cf})",
+                 "\xD0\x9F"));  // no charset: the document's
+}
+
+void TestCodePagesWithoutTable() {
+  CHECK(Converts(R"({\rtf1\ansi\ansicpg932 \'82\'a0})", "\xEF\xBF\xBD\xEF\xBF\xBD"));
+  CHECK(Converts(R"({\rtf1\ansi\ansicpg932\uc2 \u12354\'82\'a0})", "\xE3\x81\x82"));  // あ
+}
+
+} // namespace
+
+int main() {
+  TestDocumentCodePage();
+  TestDefaultIsWindows1252();
+  TestFontCharsets();
+  TestCodePagesWithoutTable();
+  return TestResult();
+}
@@ -0,0 +1,293 @@
+// RunSave against a folder kept in memory: with dedup, a repeated save is
+// skipped (and reported as "Already saved as ...") or linked, while new
+// content, another extension or dedup off writes a new file; the skip flag
+// belongs to the thread that saved.
+//
+// Then against a real folder (TestSaveFolder): in every durability mode the
+// flushes come where the mode puts them, and a save that fails at any step
+// (the write, a full disk, the flush, finding a name) leaves no "~ptf-*.tmp"
+// behind and never touches a file already under the final name.
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "DedupIndex.h"
+#include "SaveFlow.h"
+#include "TestImages.h"
+#include "TestSaveFolder.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+// Files by name, the temp file of the save in progress, and a dedup index in
+// a DedupIndex image, as DedupStore keeps one per folder. New names are
+// "save.txt", "save-1.txt", ...
+class MemoryFolder : public SaveTarget {
+ public:
+  std::map<std::wstring, std::vector<uint8_t>> files;
+  bool hardLinks = true;
+  bool tempOpen = false;
+  std::wstring extension = L".txt";
+
+  MemoryFolder() : index_(DedupIndex::ImageBytes(64, 4096)) {
+    DedupIndex::Format(index_.data(), 64, 4096);
+    dedup_.Attach(index_.data(), index_.size());
+  }
+
+  ByteSink* Temp() override {
+    temp_.bytes.clear();
+    tempOpen = true;
+    return &temp_;
+  }
+  bool FlushTemp() override { return true; }
+  bool Commit(std::wstring* path) override {
+    *path = FreeName();
+    files[*path] = temp_.bytes;
+    tempOpen = false;
+    return true;
+  }
+  bool Link(const std::wstring& existingPath, std::wstring* path) override {
+    if (!hardLinks) return false;
+    *path = FreeName();
+    files[*path] = files[existingPath];
+    return true;
+  }
+  void Discard() override { tempOpen = false; }
+  void FlushDirectory() override {}
+
+  // Like DedupStore, only a file still there with the recorded size counts.
+  bool FindSaved(uint64_t key, uint64_t size, std::wstring* existingPath) override {
+    DedupEntry entry;
+    if (!dedup_.Find(key, size, &entry)) return false;
+    const std::wstring name(entry.name.begin(), entry.name.end());
+    auto file = files.find(name);
+    if (file == files.end() || file->second.size() != size) return false;
+    *existingPath = name;
+    return true;
+  }
+  void RecordSaved(uint64_t key, const std::wstring& path) override {
+    const std::string name(path.begin(), path.end());  // ASCII names
+    DedupEntry entry;
+    entry.key = key;
+    entry.size = files[path].size();
+    entry.name = name;
+    CHECK(dedup_.Insert(entry));
+  }
+
+ private:
+  std::wstring FreeName() const {
+    for (int n = 0;; n++) {
+      const std::wstring name = L"save" + (n > 0 ? L"-" + std::to_wstring(n) : L"") + extension;
+      if (files.count(name) == 0) return name;
+    }
+  }
+
+  MemorySink temp_;
+  std::vector<uint8_t> index_;
+  DedupIndex dedup_;
+};
+
+SaveReport Save(MemoryFolder* folder, DedupMode dedup, const std::string& text) {
+  SaveSettings settings;
+  settings.dedup = dedup;
+  settings.extension = folder->extension;
+  const SaveReport report = RunSave(folder, settings, [&](ByteSink* sink) {
+    return sink->Write(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+  });
+  CHECK(!folder->tempOpen);
+  return report;
+}
+
+void TestSkip() {
+  MemoryFolder folder;
+  SaveReport report = Save(&folder, DedupMode::Skip, "hello");
+  CHECK(report.result == SaveResult::Written && report.path == L"save.txt");
+  CHECK(!LastSaveSkipped());
+  CHECK(SaveLogMessage(L"Saved text: ", report.path) == L"Saved text: save.txt");
+
+  report = Save(&folder, DedupMode::Skip, "hello");
+  CHECK(report.result == SaveResult::Skipped);
+  CHECK(report.path == L"save.txt" && report.existingPath == L"save.txt");
+  CHECK(LastSaveSkipped());
+  CHECK(SaveLogMessage(L"Saved text: ", report.path) == L"Already saved as save.txt");
+  CHECK(folder.files.size() == 1);
+
+  // The next save that writes clears the flag.
+  report = Save(&folder, DedupMode::Skip, "hello, again");
+  CHECK(report.result == SaveResult::Written && report.path == L"save-1.txt");
+  CHECK(!LastSaveSkipped());
+  CHECK(SaveLogMessage(L"Saved text: ", report.path) == L"Saved text: save-1.txt");
+
+  // A recorded file that has since changed is not a duplicate.
+  folder.files[L"save.txt"].push_back('!');
+  report = Save(&folder, DedupMode::Skip, "hello");
+  CHECK(report.result == SaveResult::Written && report.path == L"save-2.txt");
+  CHECK(!LastSaveSkipped());
+}
+
+void TestLink() {
+  MemoryFolder folder;
+  CHECK(Save(&folder, DedupMode::Link, "hello").result == SaveResult::Written);
+  SaveReport report = Save(&folder, DedupMode::Link, "hello");
+  CHECK(report.result == SaveResult::Linked);
+  CHECK(report.path == L"save-1.txt" && report.existingPath == L"save.txt");
+  CHECK(folder.files[L"save-1.txt"] == folder.files[L"save.txt"]);
+  // A linked save has its own name: reported as saved.
+  CHECK(!LastSaveSkipped());
+  CHECK(SaveLogMessage(L"Saved text: ", report.path) == L"Saved text: save-1.txt");
+
+  // No hard links on this file system: saved as usual.
+  folder.hardLinks = false;
+  report = Save(&folder, DedupMode::Link, "hello");
+  CHECK(report.result == SaveResult::Written && report.existingPath.empty());
+  CHECK(report.path == L"save-2.txt" && folder.files.size() == 3);
+}
+
+// The dedup key covers the extension, and dedup off never looks.
+void TestNotDuplicates() {
+  MemoryFolder folder;
+  CHECK(Save(&folder, DedupMode::Skip, "hello").result == SaveResult::Written);
+  folder.extension = L".md";
+  CHECK(Save(&folder, DedupMode::Skip, "hello").result == SaveResult::Written);
+  folder.extension = L".txt";
+  CHECK(Save(&folder, DedupMode::Off, "hello").result == SaveResult::Written);
+  CHECK(!LastSaveSkipped());
+  CHECK(folder.files.size() == 3);
+  CHECK(Save(&folder, DedupMode::Skip, "hello").result == SaveResult::Skipped);
+}
+
+// Saves on other threads (history export) neither see nor change this
+// thread's flag.
+void TestPerThread() {
+  MemoryFolder folder;
+  CHECK(Save(&folder, DedupMode::Skip, "hello").result == SaveResult::Written);
+  CHECK(Save(&folder, DedupMode::Skip, "hello").result == SaveResult::Skipped);
+  bool otherSkipped = true;
+  std::thread other([&] { otherSkipped = LastSaveSkipped(); });
+  other.join();
+  CHECK(!otherSkipped);
+  CHECK(LastSaveSkipped());
+
+  MemoryFolder otherFolder;
+  std::thread writer([&] { Save(&otherFolder, DedupMode::Skip, "something else"); });
+  writer.join();
+  CHECK(LastSaveSkipped());
+}
+
+const WriteDurability kModes[] = {WriteDurability::Fast, WriteDurability::Safe,
+                                  WriteDurability::Paranoid};
+
+std::filesystem::path EmptyDir(const char* name) {
+  const std::filesystem::path dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+// A folder that already holds "save.txt".
+void WriteOriginal(TestSaveFolder* folder) {
+  FILE* f = std::fopen((folder->Dir() / "save.txt").string().c_str(), "wb");
+  if (!CHECK(f)) return;
+  std::fputs("original", f);
+  std::fclose(f);
+}
+
+SaveReport SaveTo(TestSaveFolder* folder, WriteDurability durability, bool compress,
+                  const std::string& text, bool writeOk = true) {
+  SaveSettings settings;
+  settings.durability = durability;
+  settings.compress = compress;
+  settings.extension = folder->extension;
+  folder->calls.clear();
+  return RunSave(folder, settings, [&](ByteSink* sink) {
+    return sink->Write(reinterpret_cast<const uint8_t*>(text.data()), text.size()) && writeOk;
+  });
+}
+
+using Calls = std::vector<std::string>;
+
+void TestDurabilityOrder() {
+  TestSaveFolder folder(EmptyDir("ptf_save_flow_order"));
+  SaveReport report = SaveTo(&folder, WriteDurability::Fast, false, "fast");
+  CHECK(report.result == SaveResult::Written);
+  CHECK(folder.calls == (Calls{"Temp", "Commit"}));
+  report = SaveTo(&folder, WriteDurability::Safe, false, "safe");
+  CHECK(folder.calls == (Calls{"Temp", "FlushTemp", "Commit"}));
+  report = SaveTo(&folder, WriteDurability::Paranoid, false, "paranoid");
+  CHECK(folder.calls == (Calls{"Temp", "FlushTemp", "Commit", "FlushDirectory"}));
+  CHECK(folder.Names() == (std::vector<std::string>{"save-1.txt", "save-2.txt", "save.txt"}));
+  CHECK(folder.Read("save-2.txt") == "paranoid");
+  std::filesystem::remove_all(folder.Dir());
+}
+
+// Nothing is left behind and "save.txt" keeps its bytes, in every mode,
+// compressed or not.
+void TestFailedSaves() {
+  // Random bytes: still over the fault's 1000 bytes once compressed.
+  Random random(1);
+  std::string text(100000, ' ');
+  for (char& c : text) c = static_cast<char>(random.Next());
+  for (WriteDurability mode : kModes) {
+    for (bool compress : {false, true}) {
+      TestSaveFolder folder(EmptyDir("ptf_save_flow_failed"));
+      WriteOriginal(&folder);
+      const std::vector<std::string> before = folder.Names();
+
+      // The content could not be produced.
+      CHECK(SaveTo(&folder, mode, compress, text, false).result == SaveResult::WriteFailed);
+      CHECK(folder.Names() == before && folder.Read("save.txt") == "original");
+      CHECK(folder.calls.back() == "Discard");
+
+      // The disk filled up part way.
+      folder.failWriteAfter = 1000;
+      SaveReport report = SaveTo(&folder, mode, compress, text);
+      CHECK(report.result == SaveResult::WriteFailed && report.path.empty());
+      CHECK(folder.Names() == before && folder.Read("save.txt") == "original");
+      folder.failWriteAfter = SIZE_MAX;
+
+      // The flush failed (Safe, Paranoid); never reached in Fast.
+      folder.failFlush = true;
+      report = SaveTo(&folder, mode, compress, text);
+      CHECK(report.result == (mode == WriteDurability::Fast ? SaveResult::Written
+                                                            : SaveResult::WriteFailed));
+      folder.failFlush = false;
+      if (mode == WriteDurability::Fast) std::filesystem::remove(folder.Dir() / "save-1.txt");
+      CHECK(folder.Names() == before && folder.Read("save.txt") == "original");
+
+      // No free name.
+      folder.failCommit = true;
+      report = SaveTo(&folder, mode, compress, text);
+      CHECK(report.result == SaveResult::NoName && report.path.empty());
+      CHECK(folder.Names() == before && folder.Read("save.txt") == "original");
+      CHECK(folder.calls.back() == "Discard");
+      folder.failCommit = false;
+
+      // And a save that works takes the next name.
+      report = SaveTo(&folder, mode, compress, "new");
+      CHECK(report.result == SaveResult::Written);
+      CHECK(folder.Names() == (std::vector<std::string>{"save-1.txt", "save.txt"}));
+      CHECK(folder.Read("save.txt") == "original");
+      CHECK(compress || folder.Read("save-1.txt") == "new");
+      std::filesystem::remove_all(folder.Dir());
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  TestSkip();
+  TestLink();
+  TestNotDuplicates();
+  TestPerThread();
+  TestDurabilityOrder();
+  TestFailedSaves();
+  return TestResult();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packed DIBs (the layout of a CF_DIB/CF_DIBV5 block) for the DIB tests and
+// benchmarks: header, masks, color table and bits, as GDI and other
+// producers write them.
+
+namespace ptf_test {
+
+// wingdi.h values.
+constexpr uint32_t kBiRgb = 0;
+constexpr uint32_t kBiRle8 = 1;
+constexpr uint32_t kBiRle4 = 2;
+constexpr uint32_t kBiBitfields = 3;
+constexpr uint32_t kBiPng = 5;
+constexpr uint32_t kBiAlphaBitfields = 6;
+
+inline void PutLe16(std::vector<uint8_t>* out, uint32_t v) {
+  out->push_back(static_cast<uint8_t>(v));
+  out->push_back(static_cast<uint8_t>(v >> 8));
+}
+
+inline void PutLe32(std::vector<uint8_t>* out, uint32_t v) {
+  PutLe16(out, v & 0xFFFF);
+  PutLe16(out, v >> 16);
+}
+
+struct DibSpec {
+  uint32_t headerSize = 40;  // 12 (core), 40 (info), 52, 56, 108 (V4) or 124 (V5)
+  int32_t width = 0;
+  int32_t height = 0;        // negative for top-down
+  uint16_t bitCount = 32;
+  uint32_t compression = kBiRgb;
+  uint32_t imageSize = 0;
+  uint32_t colorsUsed = 0;
+  // Red, green, blue, alpha. In the header from 52 bytes on (alpha from 56);
+  // after a 40-byte header for BI_BITFIELDS (3) and BI_ALPHABITFIELDS (4).
+  uint32_t masks[4] = {};
+};
+
+// Bytes per stored row: whole 32-bit words.
+inline size_t DibStride(uint32_t width, int bitCount) {
+  return (static_cast<size_t>(width) * bitCount + 31) / 32 * 4;
+}
+
+// The DIB with `palette` entries (0x00RRGGBB) and `bits` after the header.
+inline std::vector<uint8_t> MakeDib(const DibSpec& spec, const std::vector<uint32_t>& palette,
+                                    const std::vector<uint8_t>& bits) {
+  std::vector<uint8_t> dib;
+  PutLe32(&dib, spec.headerSize);
+  if (spec.headerSize == 12) {
+    PutLe16(&dib, static_cast<uint32_t>(spec.width));
+    PutLe16(&dib, static_cast<uint32_t>(spec.height));
+    PutLe16(&dib, 1);
+    PutLe16(&dib, spec.bitCount);
+  } else {
+    PutLe32(&dib, static_cast<uint32_t>(spec.width));
+    PutLe32(&dib, static_cast<uint32_t>(spec.height));
+    PutLe16(&dib, 1);
+    PutLe16(&dib, spec.bitCount);
+    PutLe32(&dib, spec.compression);
+    PutLe32(&dib, spec.imageSize);
+    PutLe32(&dib, 2835);  // 72 dpi
+    PutLe32(&dib, 2835);
+    PutLe32(&dib, spec.colorsUsed);
+    PutLe32(&dib, 0);
+    for (int i = 0; i < 4 && dib.size() < spec.headerSize; i++) PutLe32(&dib, spec.masks[i]);
+    dib.resize(spec.headerSize, 0);  // V4/V5 color space fields: none
+    if (spec.headerSize == 40 && spec.compression == kBiBitfields) {
+      for (int i = 0; i < 3; i++) PutLe32(&dib, spec.masks[i]);
+    } else if (spec.headerSize == 40 && spec.compression == kBiAlphaBitfields) {
+      for (int i = 0; i < 4; i++) PutLe32(&dib, spec.masks[i]);
+    }
+  }
+  for (uint32_t color : palette) {
+    dib.push_back(static_cast<uint8_t>(color));
+    dib.push_back(static_cast<uint8_t>(color >> 8));
+    dib.push_back(static_cast<uint8_t>(color >> 16));
+    if (spec.headerSize != 12) dib.push_back(0);
+  }
+  dib.insert(dib.end(), bits.begin(), bits.end());
+  return dib;
+}
+
+} // namespace ptf_test
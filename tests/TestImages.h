@@ -0,0 +1,280 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Inflate.h"
+#include "PixelSource.h"
+
+// Synthetic images for the tests and benchmarks, and a small PNG reader to
+// check what the encoder wrote.
+
+namespace ptf_test {
+
+// Deterministic pseudo-random numbers (xorshift32), the same on every platform.
+class Random {
+ public:
+  explicit Random(uint32_t seed) : state_(seed ? seed : 0x9E3779B9u) {}
+  uint32_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+  }
+  uint32_t Below(uint32_t n) { return n ? Next() % n : 0; }
+
+ private:
+  uint32_t state_;
+};
+
+struct TestImage {
+  std::vector<uint8_t> pixels;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  ptf_helper::PixelFormat format = ptf_helper::PixelFormat::Bgra8;
+
+  size_t Stride() const { return width * ptf_helper::BytesPerPixel(format); }
+  ptf_helper::PixelSource Source() const {
+    ptf_helper::PixelSource source;
+    source.pixels = pixels.data();
+    source.stride = Stride();
+    source.width = width;
+    source.height = height;
+    source.format = format;
+    return source;
+  }
+};
+
+// Something like a desktop screenshot: flat panels, a gradient, and runs of
+// small "glyphs", so it compresses about as well as real ones.
+inline TestImage MakeScreenshot(uint32_t width, uint32_t height, ptf_helper::PixelFormat format,
+                                uint32_t seed = 1) {
+  TestImage image;
+  image.width = width;
+  image.height = height;
+  image.format = format;
+  const size_t bpp = ptf_helper::BytesPerPixel(format);
+  image.pixels.resize(image.Stride() * height);
+  Random random(seed);
+  const uint32_t panel = 0xFFF0F0F0u;
+  const uint32_t accent = 0xFF000000u | (random.Next() & 0xFFFFFFu);
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t* row = image.pixels.data() + y * image.Stride();
+    for (uint32_t x = 0; x < width; x++) {
+      uint32_t argb = panel;
+      if (y < height / 16) {
+        const uint32_t v = 0x40 + (x * 0x80) / (width ? width : 1);
+        argb = 0xFF000000u | (v << 16) | (v << 8) | 0xC0;
+      } else if (x < width / 5) {
+        argb = accent;
+      } else if ((y / 14) % 2 == 0 && random.Below(5) == 0) {
+        argb = 0xFF202020u + random.Below(3) * 0x00101010u;
+      }
+      if (ptf_helper::HasAlphaChannel(format) && x % 97 == 0) {
+        argb = (argb & 0xFFFFFFu) | (random.Next() & 0xFF000000u);
+      }
+      uint8_t* p = row + x * bpp;
+      const uint8_t a = static_cast<uint8_t>(argb >> 24);
+      const uint8_t r = static_cast<uint8_t>(argb >> 16);
+      const uint8_t g = static_cast<uint8_t>(argb >> 8);
+      const uint8_t b = static_cast<uint8_t>(argb);
+      switch (format) {
+        case ptf_helper::PixelFormat::Bgra8:
+        case ptf_helper::PixelFormat::Bgrx8:
+          p[0] = b, p[1] = g, p[2] = r, p[3] = a;
+          break;
+        case ptf_helper::PixelFormat::Rgba8:
+          p[0] = r, p[1] = g, p[2] = b, p[3] = a;
+          break;
+        case ptf_helper::PixelFormat::Bgr8:
+          p[0] = b, p[1] = g, p[2] = r;
+          break;
+        case ptf_helper::PixelFormat::Rgb8:
+          p[0] = r, p[1] = g, p[2] = b;
+          break;
+      }
+    }
+  }
+  return image;
+}
+
+// Smooth gradients with a little sensor-like noise, like a photo: few exact
+// repeats, so both encoders fall back to their per-pixel paths.
+inline TestImage MakePhoto(uint32_t width, uint32_t height, ptf_helper::PixelFormat format,
+                           uint32_t seed = 1) {
+  TestImage image;
+  image.width = width;
+  image.height = height;
+  image.format = format;
+  const size_t bpp = ptf_helper::BytesPerPixel(format);
+  image.pixels.resize(image.Stride() * height);
+  Random random(seed);
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t* row = image.pixels.data() + y * image.Stride();
+    for (uint32_t x = 0; x < width; x++) {
+      const uint32_t noise = random.Below(7);
+      const uint8_t c0 = static_cast<uint8_t>((x * 255) / (width ? width : 1) / 2 + noise);
+      const uint8_t c1 = static_cast<uint8_t>((y * 255) / (height ? height : 1) / 2 + noise);
+      const uint8_t c2 = static_cast<uint8_t>(((x + y) * 127) / (width + height) + 64 + noise);
+      uint8_t* p = row + x * bpp;
+      p[0] = c0, p[1] = c1, p[2] = c2;
+      if (bpp == 4) p[3] = 0xFF;
+    }
+  }
+  return image;
+}
+
+// Every byte random: the worst case for the encoders.
+inline TestImage MakeNoise(uint32_t width, uint32_t height, ptf_helper::PixelFormat format,
+                           uint32_t seed = 1) {
+  TestImage image;
+  image.width = width;
+  image.height = height;
+  image.format = format;
+  image.pixels.resize(image.Stride() * height);
+  Random random(seed);
+  for (uint8_t& byte : image.pixels) byte = static_cast<uint8_t>(random.Next() >> 24);
+  return image;
+}
+
+// The pixels of `image` as 0xAARRGGBB, top row first.
+inline std::vector<uint32_t> ToArgb(const TestImage& image) {
+  const ptf_helper::PixelSource source = image.Source();
+  const size_t bpp = ptf_helper::BytesPerPixel(image.format);
+  std::vector<uint32_t> argb;
+  argb.reserve(static_cast<size_t>(image.width) * image.height);
+  for (uint32_t y = 0; y < image.height; y++) {
+    for (uint32_t x = 0; x < image.width; x++) {
+      argb.push_back(ptf_helper::PackArgb(source.Row(y) + x * bpp, image.format));
+    }
+  }
+  return argb;
+}
+
+inline uint32_t ReadBe32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+inline int Paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) return a;
+  return pb <= pc ? b : c;
+}
+
+// Decodes a non-interlaced PNG of any color type the encoder writes to
+// 0xAARRGGBB pixels. Independent of the encoder's own code except Inflate.
+inline bool DecodePng(const std::vector<uint8_t>& png, uint32_t* width, uint32_t* height,
+                      std::vector<uint32_t>* argb) {
+  static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  if (png.size() < 8 || std::memcmp(png.data(), kSignature, 8) != 0) return false;
+  uint32_t w = 0, h = 0;
+  int depth = 0, colorType = -1;
+  std::vector<uint32_t> palette;
+  std::vector<uint8_t> idat;
+  bool sawEnd = false;
+  for (size_t pos = 8; pos + 12 <= png.size() && !sawEnd;) {
+    const uint32_t length = ReadBe32(&png[pos]);
+    if (length > png.size() - pos - 12) return false;
+    const uint8_t* type = &png[pos + 4];
+    const uint8_t* data = &png[pos + 8];
+    if (std::memcmp(type, "IHDR", 4) == 0) {
+      if (length != 13 || data[10] != 0 || data[11] != 0 || data[12] != 0) return false;
+      w = ReadBe32(data);
+      h = ReadBe32(data + 4);
+      depth = data[8];
+      colorType = data[9];
+    } else if (std::memcmp(type, "PLTE", 4) == 0) {
+      for (uint32_t i = 0; i + 3 <= length; i += 3) {
+        palette.push_back(0xFF000000u | (data[i] << 16) | (data[i + 1] << 8) | data[i + 2]);
+      }
+    } else if (std::memcmp(type, "tRNS", 4) == 0) {
+      for (uint32_t i = 0; i < length && i < palette.size(); i++) {
+        palette[i] = (palette[i] & 0xFFFFFFu) | (static_cast<uint32_t>(data[i]) << 24);
+      }
+    } else if (std::memcmp(type, "IDAT", 4) == 0) {
+      idat.insert(idat.end(), data, data + length);
+    } else if (std::memcmp(type, "IEND", 4) == 0) {
+      sawEnd = true;
+    }
+    pos += 12 + length;
+  }
+  if (!sawEnd || w == 0 || h == 0) return false;
+
+  int channels = 0;
+  switch (colorType) {
+    case 0: channels = 1; break;
+    case 2: channels = 3; break;
+    case 3: channels = 1; break;
+    case 4: channels = 2; break;
+    case 6: channels = 4; break;
+    default: return false;
+  }
+  const size_t rowBits = static_cast<size_t>(w) * channels * depth;
+  const size_t rowBytes = (rowBits + 7) / 8;
+  const size_t bpp = depth < 8 ? 1 : static_cast<size_t>(channels) * depth / 8;
+  std::vector<uint8_t> raw;
+  if (!ptf_helper::ZlibDecompress(idat.data(), idat.size(), (rowBytes + 1) * h, &raw) ||
+      raw.size() != (rowBytes + 1) * h) {
+    return false;
+  }
+
+  std::vector<uint8_t> prev(rowBytes, 0), cur(rowBytes);
+  argb->clear();
+  argb->reserve(static_cast<size_t>(w) * h);
+  for (uint32_t y = 0; y < h; y++) {
+    const uint8_t* in = &raw[y * (rowBytes + 1)];
+    const uint8_t filter = in[0];
+    for (size_t i = 0; i < rowBytes; i++) {
+      const int a = i >= bpp ? cur[i - bpp] : 0;
+      const int b = prev[i];
+      const int c = i >= bpp ? prev[i - bpp] : 0;
+      int predictor = 0;
+      switch (filter) {
+        case 0: break;
+        case 1: predictor = a; break;
+        case 2: predictor = b; break;
+        case 3: predictor = (a + b) / 2; break;
+        case 4: predictor = Paeth(a, b, c); break;
+        default: return false;
+      }
+      cur[i] = static_cast<uint8_t>(in[1 + i] + predictor);
+    }
+    for (uint32_t x = 0; x < w; x++) {
+      const uint8_t* p = cur.data() + (colorType == 3 ? 0 : static_cast<size_t>(x) * bpp);
+      switch (colorType) {
+        case 0:
+          argb->push_back(0xFF000000u | (p[0] << 16) | (p[0] << 8) | p[0]);
+          break;
+        case 2:
+          argb->push_back(0xFF000000u | (p[0] << 16) | (p[1] << 8) | p[2]);
+          break;
+        case 4:
+          argb->push_back((static_cast<uint32_t>(p[1]) << 24) | (p[0] << 16) | (p[0] << 8) |
+                          p[0]);
+          break;
+        case 6:
+          argb->push_back((static_cast<uint32_t>(p[3]) << 24) | (p[0] << 16) | (p[1] << 8) |
+                          p[2]);
+          break;
+        case 3: {
+          const size_t bit = static_cast<size_t>(x) * depth;
+          const unsigned index =
+              (cur[bit / 8] >> (8 - depth - bit % 8)) & ((1u << depth) - 1);
+          if (index >= palette.size()) return false;
+          argb->push_back(palette[index]);
+          break;
+        }
+      }
+    }
+    prev.swap(cur);
+  }
+  *width = w;
+  *height = h;
+  return true;
+}
+
+} // namespace ptf_test
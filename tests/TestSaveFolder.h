@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ByteSink.h"
+#include "SaveFlow.h"
+
+// A SaveTarget on a real folder, for the save tests and benchmarks off
+// Windows: the steps FileSink takes with Win32 handles, done with stdio and
+// std::filesystem. Temp files are "~ptf-<n>.tmp"; final names "save.txt",
+// "save-1.txt", ... Faults can be injected into each step, and every call is
+// recorded.
+
+namespace ptf_test {
+
+class TestSaveFolder : public ptf_helper::SaveTarget {
+ public:
+  std::vector<std::string> calls;
+  std::wstring extension = L".txt";
+  size_t failWriteAfter = SIZE_MAX;  // bytes the temp file takes before writes fail
+  bool failFlush = false;
+  bool failCommit = false;  // as when no name is free
+
+  explicit TestSaveFolder(std::filesystem::path dir) : dir_(std::move(dir)), sink_(this) {
+    std::filesystem::create_directories(dir_);
+  }
+  ~TestSaveFolder() override { Close(); }
+  TestSaveFolder(const TestSaveFolder&) = delete;
+  TestSaveFolder& operator=(const TestSaveFolder&) = delete;
+
+  const std::filesystem::path& Dir() const { return dir_; }
+
+  // Names in the folder, sorted.
+  std::vector<std::string> Names() const {
+    std::vector<std::string> names;
+    for (const auto& entry : std::filesystem::directory_iterator(dir_)) {
+      names.push_back(entry.path().filename().string());
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+  }
+
+  std::string Read(const std::string& name) const {
+    std::string bytes;
+    FILE* f = std::fopen((dir_ / name).string().c_str(), "rb");
+    if (!f) return bytes;
+    char buffer[4096];
+    size_t n = 0;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), f)) > 0) bytes.append(buffer, n);
+    std::fclose(f);
+    return bytes;
+  }
+
+  ptf_helper::ByteSink* Temp() override {
+    calls.push_back("Temp");
+    for (int n = 0; n < 100 && !file_; n++) {
+      temp_ = dir_ / ("~ptf-" + std::to_string(next_++) + ".tmp");
+      if (!std::filesystem::exists(temp_)) file_ = std::fopen(temp_.string().c_str(), "wb");
+    }
+    written_ = 0;
+    return file_ ? &sink_ : nullptr;
+  }
+
+  bool FlushTemp() override {
+    calls.push_back("FlushTemp");
+    if (failFlush || std::fflush(file_) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file_)) == 0;
+#else
+    return fsync(fileno(file_)) == 0;
+#endif
+  }
+
+  // Portable code has no rename that refuses to replace; checking first is
+  // enough here, with nothing else writing to the folder.
+  bool Commit(std::wstring* path) override {
+    calls.push_back("Commit");
+    if (failCommit) return false;
+    Close();
+    const std::filesystem::path target = FreeName();
+    std::error_code error;
+    std::filesystem::rename(temp_, target, error);
+    if (error) return false;
+    *path = target.wstring();
+    return true;
+  }
+
+  bool Link(const std::wstring& existingPath, std::wstring* path) override {
+    calls.push_back("Link");
+    const std::filesystem::path target = FreeName();
+    std::error_code error;
+    std::filesystem::create_hard_link(existingPath, target, error);
+    if (error) return false;
+    *path = target.wstring();
+    return true;
+  }
+
+  void Discard() override {
+    calls.push_back("Discard");
+    Close();
+    std::error_code error;
+    std::filesystem::remove(temp_, error);
+  }
+
+  void FlushDirectory() override {
+    calls.push_back("FlushDirectory");
+#ifndef _WIN32
+    const int fd = open(dir_.string().c_str(), O_RDONLY);
+    if (fd >= 0) {
+      fsync(fd);
+      close(fd);
+    }
+#endif
+  }
+
+  bool FindSaved(uint64_t, uint64_t, std::wstring*) override { return false; }
+  void RecordSaved(uint64_t, const std::wstring&) override {}
+
+ private:
+  class FileWriter : public ptf_helper::ByteSink {
+   public:
+    explicit FileWriter(TestSaveFolder* folder) : folder_(folder) {}
+    bool Write(const uint8_t* data, size_t size) override {
+      TestSaveFolder& f = *folder_;
+      if (size > f.failWriteAfter - f.written_) {
+        // Part of it lands, as on a full disk.
+        std::fwrite(data, 1, f.failWriteAfter - f.written_, f.file_);
+        f.written_ = f.failWriteAfter;
+        return false;
+      }
+      f.written_ += size;
+      return std::fwrite(data, 1, size, f.file_) == size;
+    }
+
+   private:
+    TestSaveFolder* folder_;
+  };
+
+  void Close() {
+    if (file_) std::fclose(file_);
+    file_ = nullptr;
+  }
+
+  std::filesystem::path FreeName() const {
+    const std::string ext(extension.begin(), extension.end());
+    for (int n = 0;; n++) {
+      const std::string name = "save" + (n > 0 ? "-" + std::to_string(n) : "") + ext;
+      if (!std::filesystem::exists(dir_ / name)) return dir_ / name;
+    }
+  }
+
+  std::filesystem::path dir_;
+  std::filesystem::path temp_;
+  FILE* file_ = nullptr;
+  size_t written_ = 0;
+  unsigned next_ = 0;
+  FileWriter sink_;
+};
+
+} // namespace ptf_test
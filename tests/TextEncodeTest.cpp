@@ -0,0 +1,257 @@
+// EncodeUtf8Text and EncodeNarrowText: line breaks kept, made LF or made CRLF
+// (CRLF pairs, lone CRs and a CR as the last unit), a CRLF pair that falls on
+// the edge of a vector block, of a transcoder run or of an output chunk,
+// trailing blanks trimmed before every break and at the end of the text, and
+// the BOM, for wide text, UTF-8 and a single-byte code page. Output must not
+// depend on the chunk size, and no write may exceed it.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ByteSink.h"
+#include "Check.h"
+#include "CodePage.h"
+#include "TestImages.h"
+#include "TextEncode.h"
+#include "PasteToFileCommon/Utf.h"
+
+using namespace ptf_helper;
+using namespace ptf_test;
+
+namespace {
+
+const size_t kChunkSizes[] = {1, 4, 5, 7, 64, 1024 * 1024};
+
+// Keeps the bytes and checks every write against the chunk size (at least 4,
+// the longest UTF-8 sequence).
+class ChunkedSink : public ByteSink {
+ public:
+  explicit ChunkedSink(size_t chunkBytes) : limit_(chunkBytes < 4 ? 4 : chunkBytes) {}
+  bool Write(const uint8_t* data, size_t size) override {
+    if (size > limit_) oversized = true;
+    bytes.append(reinterpret_cast<const char*>(data), size);
+    return true;
+  }
+  std::string bytes;
+  bool oversized = false;
+
+ private:
+  size_t limit_;
+};
+
+TextEncodeOptions Options(EolMode eol, bool trim = false, bool bom = false) {
+  TextEncodeOptions options;
+  options.eol = eol;
+  options.trimTrailing = trim;
+  options.bom = bom;
+  return options;
+}
+
+// The rules spelled out one line at a time.
+std::string Reference(const std::wstring& text, const TextEncodeOptions& options) {
+  std::wstring out;
+  size_t pos = 0;
+  for (;;) {
+    const size_t lineEnd = text.find_first_of(L"\r\n", pos);
+    const size_t end = lineEnd == std::wstring::npos ? text.size() : lineEnd;
+    std::wstring line = text.substr(pos, end - pos);
+    if (options.trimTrailing) line.erase(line.find_last_not_of(L" \t") + 1);
+    out += line;
+    if (end == text.size()) break;
+    const bool crlf = text[end] == L'\r' && end + 1 < text.size() && text[end + 1] == L'\n';
+    const std::wstring original = crlf ? L"\r\n" : text.substr(end, 1);
+    out += options.eol == EolMode::Lf     ? L"\n"
+           : options.eol == EolMode::Crlf ? L"\r\n"
+                                          : original;
+    pos = end + original.size();
+  }
+  return (options.bom ? "\xEF\xBB\xBF" : "") + ptf::WideToUtf8(out);
+}
+
+std::string Show(const std::string& bytes) {
+  std::string shown;
+  for (char c : bytes) {
+    shown += c == '\r' ? "\\r" : c == '\n' ? "\\n" : c == '\t' ? "\\t" : std::string(1, c);
+  }
+  return shown.size() > 80 ? shown.substr(0, 80) + "..." : shown;
+}
+
+// Encodes `text` in every chunk size and checks each result against `expected`.
+bool EncodesWide(const std::wstring& text, const TextEncodeOptions& options,
+                 const std::string& expected) {
+  for (size_t chunkBytes : kChunkSizes) {
+    ChunkedSink sink(chunkBytes);
+    if (!CHECK(EncodeUtf8Text(text, options, &sink, chunkBytes))) return false;
+    if (sink.bytes != expected || sink.oversized) {
+      std::printf("  chunk %zu: gave \"%s\", expected \"%s\"%s\n", chunkBytes,
+                  Show(sink.bytes).c_str(), Show(expected).c_str(),
+                  sink.oversized ? " (oversized write)" : "");
+      return CHECK(false);
+    }
+  }
+  return true;
+}
+
+bool EncodesNarrow(const std::string& text, const uint16_t* table,
+                   const TextEncodeOptions& options, const std::string& expected) {
+  for (size_t chunkBytes : kChunkSizes) {
+    ChunkedSink sink(chunkBytes);
+    if (!CHECK(EncodeNarrowText(text, table, options, &sink, chunkBytes))) return false;
+    if (sink.bytes != expected || sink.oversized) {
+      std::printf("  chunk %zu: gave \"%s\", expected \"%s\"%s\n", chunkBytes,
+                  Show(sink.bytes).c_str(), Show(expected).c_str(),
+                  sink.oversized ? " (oversized write)" : "");
+      return CHECK(false);
+    }
+  }
+  return true;
+}
+
+// The same text as wide, as UTF-8 and, where it fits, as windows-1252.
+bool EncodesAll(const std::wstring& text, const TextEncodeOptions& options,
+                const std::string& expected) {
+  bool ok = EncodesWide(text, options, expected);
+  ok = EncodesNarrow(ptf::WideToUtf8(text), nullptr, options, expected) && ok;
+  std::string cp1252;
+  for (wchar_t c : text) {
+    if (c >= 0x80 && c != 0xE9) return ok;
+    cp1252 += static_cast<char>(c);
+  }
+  return EncodesNarrow(cp1252, SingleByteCodePage(1252), options, expected) && ok;
+}
+
+void TestEol() {
+  const std::wstring mixed = L"a\r\nb\nc\rd";
+  CHECK(EncodesAll(mixed, Options(EolMode::Keep), "a\r\nb\nc\rd"));
+  CHECK(EncodesAll(mixed, Options(EolMode::Lf), "a\nb\nc\nd"));
+  CHECK(EncodesAll(mixed, Options(EolMode::Crlf), "a\r\nb\r\nc\r\nd"));
+
+  // LF CR is two breaks; CR CR LF is a lone CR, then a pair.
+  CHECK(EncodesAll(L"a\n\rb", Options(EolMode::Crlf), "a\r\n\r\nb"));
+  CHECK(EncodesAll(L"a\r\r\nb", Options(EolMode::Lf), "a\n\nb"));
+  CHECK(EncodesAll(L"a\r\r\nb", Options(EolMode::Keep), "a\r\r\nb"));
+
+  // Breaks at the very start and end, and a CR as the last unit.
+  CHECK(EncodesAll(L"\r\na\r", Options(EolMode::Lf), "\na\n"));
+  CHECK(EncodesAll(L"\na\r", Options(EolMode::Crlf), "\r\na\r\n"));
+  CHECK(EncodesAll(L"a\r", Options(EolMode::Keep, true), "a\r"));
+  CHECK(EncodesAll(L"\r", Options(EolMode::Crlf), "\r\n"));
+  CHECK(EncodesAll(L"\r\n", Options(EolMode::Crlf), "\r\n"));
+  CHECK(EncodesAll(L"", Options(EolMode::Crlf, true), ""));
+
+  // Text already in the target form passes through.
+  CHECK(EncodesAll(L"a\r\nb\r\n", Options(EolMode::Crlf), "a\r\nb\r\n"));
+  CHECK(EncodesAll(L"a\nb\n", Options(EolMode::Lf), "a\nb\n"));
+}
+
+void TestTrim() {
+  CHECK(EncodesAll(L"a \t\r\nb\t\nc  \rd ", Options(EolMode::Keep, true), "a\r\nb\nc\rd"));
+  CHECK(EncodesAll(L"a \t\r\nb\t\nc  \rd ", Options(EolMode::Crlf, true), "a\r\nb\r\nc\r\nd"));
+  // The end of the text, with and without a break before it.
+  CHECK(EncodesAll(L"end   ", Options(EolMode::Keep, true), "end"));
+  CHECK(EncodesAll(L"end\n \t ", Options(EolMode::Lf, true), "end\n"));
+  CHECK(EncodesAll(L" \t", Options(EolMode::Keep, true), ""));
+  // Leading and inner blanks stay; other white space is not a blank.
+  CHECK(EncodesAll(L"  a  b  \n", Options(EolMode::Keep, true), "  a  b\n"));
+  CHECK(EncodesAll(L"a\f\v \n", Options(EolMode::Keep, true), "a\f\v\n"));
+  CHECK(EncodesAll(std::wstring(L"caf") + wchar_t(0xE9) + L" \n", Options(EolMode::Keep, true),
+                   "caf\xC3\xA9\n"));
+  // Off: kept.
+  CHECK(EncodesAll(L"a \nb ", Options(EolMode::Lf), "a \nb "));
+}
+
+// EF BB BF first, then the text, for every encoding and with or without the
+// clean-ups.
+void TestBom() {
+  const std::wstring text = std::wstring(L"caf") + wchar_t(0xE9) + L" \r\nx";
+  for (bool bom : {false, true}) {
+    const std::string prefix = bom ? "\xEF\xBB\xBF" : "";
+    CHECK(EncodesAll(text, Options(EolMode::Keep, false, bom), prefix + "caf\xC3\xA9 \r\nx"));
+    CHECK(EncodesAll(text, Options(EolMode::Lf, true, bom), prefix + "caf\xC3\xA9\nx"));
+    CHECK(EncodesAll(L"", Options(EolMode::Keep, false, bom), prefix));
+  }
+  // A UTF-8 BOM already in the text is text: kept, after ours.
+  CHECK(EncodesNarrow("\xEF\xBB\xBFx", nullptr, Options(EolMode::Keep, false, true),
+                      "\xEF\xBB\xBF\xEF\xBB\xBFx"));
+}
+
+// A CRLF pair whose CR ends a 16-unit vector block, the 8K transcoder run or
+// an output chunk, and whose LF starts the next.
+void TestCrlfOnBoundaries() {
+  for (size_t at : {size_t{15}, size_t{16}, size_t{31}, size_t{8191}, size_t{8192},
+                    size_t{16383}}) {
+    for (EolMode eol : {EolMode::Keep, EolMode::Lf, EolMode::Crlf}) {
+      for (bool trim : {false, true}) {
+        std::wstring text(at, L'x');
+        text[at - 1] = L' ';
+        text += L"\r\ny";
+        text += std::wstring(at, L'z') + L"\r";
+        const TextEncodeOptions options = Options(eol, trim);
+        if (!EncodesAll(text, options, Reference(text, options))) {
+          std::printf("  CR at %zu\n", at - 1);
+        }
+      }
+    }
+  }
+}
+
+// Long random text of breaks, blanks and letters (with non-ASCII in the wide
+// and UTF-8 forms) against the reference, in every mode.
+void TestAgainstReference() {
+  const wchar_t alphabet[] = {L'a', L'b', L' ', L'\t', L'\r', L'\n', wchar_t(0xE9), L'\r'};
+  Random random(3);
+  for (int round = 0; round < 20; round++) {
+    std::wstring text(random.Below(20000), L'a');
+    for (wchar_t& c : text) {
+      // Mostly letters, so runs are long enough to go to the transcoder whole.
+      c = random.Below(8) == 0 ? alphabet[random.Below(8)]
+                               : static_cast<wchar_t>(L'a' + random.Below(26));
+    }
+    if (round % 2 == 1) text += wchar_t(0x4E2D);
+    for (EolMode eol : {EolMode::Keep, EolMode::Lf, EolMode::Crlf}) {
+      for (bool trim : {false, true}) {
+        const TextEncodeOptions options = Options(eol, trim, round % 3 == 0);
+        if (!EncodesAll(text, options, Reference(text, options))) {
+          std::printf("  round %d\n", round);
+          return;
+        }
+      }
+    }
+  }
+}
+
+// Characters outside the BMP (a surrogate pair in UTF-16) split across no
+// chunk.
+void TestSupplementary() {
+  const std::string emoji = "\xF0\x9F\x98\x80";
+  const std::wstring wide = ptf::Utf8ToWide("a" + emoji + emoji + " \n" + emoji);
+  CHECK(EncodesAll(wide, Options(EolMode::Keep), "a" + emoji + emoji + " \n" + emoji));
+  CHECK(EncodesAll(wide, Options(EolMode::Crlf, true), "a" + emoji + emoji + "\r\n" + emoji));
+}
+
+// A sink that fails: the encoder stops and reports it.
+void TestSinkFailure() {
+  class FailingSink : public ByteSink {
+   public:
+    bool Write(const uint8_t*, size_t) override { return false; }
+  };
+  FailingSink sink;
+  CHECK(!EncodeUtf8Text(L"a\nb", Options(EolMode::Crlf), &sink, 4));
+  CHECK(!EncodeUtf8Text(L"ab", Options(EolMode::Keep), &sink, 4));
+  CHECK(!EncodeNarrowText("a\nb", SingleByteCodePage(1252), Options(EolMode::Lf), &sink, 4));
+}
+
+} // namespace
+
+int main() {
+  TestEol();
+  TestTrim();
+  TestBom();
+  TestCrlfOnBoundaries();
+  TestAgainstReference();
+  TestSupplementary();
+  TestSinkFailure();
+  return TestResult();
+}
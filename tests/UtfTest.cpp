@@ -0,0 +1,197 @@
+// UTF-8 <-> wide conversion against golden output from Python's decoders with
+// errors='replace' (data/utf_golden.txt, see gen_utf_golden.py). Each case is
+// also run behind ASCII prefixes of every length around the vector widths, and
+// streamed in random pieces through the chunked converters.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Check.h"
+#include "TestImages.h"
+
+#include "PasteToFileCommon/Utf.h"
+
+using namespace ptf_test;
+
+namespace {
+
+constexpr size_t kPrefixes[] = {0, 1, 2, 3, 7, 8, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65};
+
+struct GoldenCase {
+  bool utf16 = false;
+  std::string bytes;           // u8: input
+  std::vector<uint32_t> units;  // u16: input
+  std::string expected;        // UTF-8
+};
+
+bool ParseHex(const std::string& hex, std::string* out) {
+  out->clear();
+  if (hex == "-") return true;
+  if (hex.size() % 2) return false;
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    out->push_back(static_cast<char>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+  }
+  return true;
+}
+
+std::vector<GoldenCase> LoadGolden() {
+  std::vector<GoldenCase> cases;
+  std::ifstream in(PTF_TEST_DATA_DIR "/utf_golden.txt");
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    std::string kind, input, expected;
+    fields >> kind >> input >> expected;
+    GoldenCase c;
+    c.utf16 = kind == "u16";
+    bool ok = ParseHex(expected, &c.expected);
+    if (c.utf16) {
+      if (input != "-") {
+        for (size_t i = 0; i + 4 <= input.size(); i += 4) {
+          c.units.push_back(static_cast<uint32_t>(std::stoul(input.substr(i, 4), nullptr, 16)));
+        }
+      }
+    } else {
+      ok = ok && ParseHex(input, &c.bytes);
+    }
+    if (CHECK(ok && (kind == "u8" || kind == "u16"))) cases.push_back(std::move(c));
+  }
+  return cases;
+}
+
+// Strict decoder for the (well-formed) expected text.
+std::vector<uint32_t> CodePoints(const std::string& utf8) {
+  std::vector<uint32_t> out;
+  for (size_t i = 0; i < utf8.size();) {
+    const uint8_t b = static_cast<uint8_t>(utf8[i]);
+    const size_t n = b < 0x80 ? 1 : b < 0xE0 ? 2 : b < 0xF0 ? 3 : 4;
+    uint32_t cp = n == 1 ? b : b & (0x7F >> n);
+    for (size_t k = 1; k < n; k++) cp = (cp << 6) | (static_cast<uint8_t>(utf8[i + k]) & 0x3F);
+    out.push_back(cp);
+    i += n;
+  }
+  return out;
+}
+
+// Code points as wchar_t: UTF-16 with surrogate pairs, or UTF-32.
+std::wstring ToWide(const std::vector<uint32_t>& codePoints) {
+  std::wstring out;
+  for (uint32_t cp : codePoints) {
+    if (sizeof(wchar_t) == 2 && cp >= 0x10000) {
+      out.push_back(static_cast<wchar_t>(0xD800 | ((cp - 0x10000) >> 10)));
+      out.push_back(static_cast<wchar_t>(0xDC00 | ((cp - 0x10000) & 0x3FF)));
+    } else {
+      out.push_back(static_cast<wchar_t>(cp));
+    }
+  }
+  return out;
+}
+
+// UTF-16 units as wchar_t. With 4-byte wchar_t, valid pairs become one code
+// point and lone surrogates stay as they are, which is what a UTF-16 string
+// converted to UTF-32 would hold.
+std::wstring UnitsToWide(const std::vector<uint32_t>& units) {
+  if (sizeof(wchar_t) == 2) return std::wstring(units.begin(), units.end());
+  std::wstring out;
+  for (size_t i = 0; i < units.size(); i++) {
+    const uint32_t u = units[i];
+    if (u >= 0xD800 && u < 0xDC00 && i + 1 < units.size() && units[i + 1] >= 0xDC00 &&
+        units[i + 1] < 0xE000) {
+      out.push_back(static_cast<wchar_t>(0x10000 + ((u - 0xD800) << 10) + (units[++i] - 0xDC00)));
+    } else {
+      out.push_back(static_cast<wchar_t>(u));
+    }
+  }
+  return out;
+}
+
+// Feeds `input` in random pieces into the chunked converter with a random
+// output capacity, carrying unconsumed input over as a caller must.
+template <typename In, typename Out, typename Convert>
+std::basic_string<Out> Stream(const std::basic_string<In>& input, size_t minCapacity,
+                              Random* random, Convert convert) {
+  std::basic_string<Out> output;
+  std::basic_string<In> pending;
+  size_t pos = 0;
+  std::vector<Out> buffer(64);
+  for (int guard = 0; guard < 100000; guard++) {
+    const size_t piece = std::min<size_t>(input.size() - pos, random->Below(9));
+    pending.append(input, pos, piece);
+    pos += piece;
+    const bool final = pos == input.size();
+    const size_t capacity = minCapacity + random->Below(12);
+    const ptf::UtfChunkResult r =
+        convert(pending.data(), pending.size(), buffer.data(), capacity, final);
+    output.append(buffer.data(), r.written);
+    pending.erase(0, r.consumed);
+    if (final && pending.empty()) return output;
+  }
+  CHECK(!"chunked conversion made no progress");
+  return output;
+}
+
+void TestUtf8ToWide(const std::vector<GoldenCase>& cases) {
+  Random random(42);
+  int failures = 0;
+  for (const GoldenCase& c : cases) {
+    if (c.utf16) continue;
+    for (size_t prefix : kPrefixes) {
+      const std::string input = std::string(prefix, 'a') + c.bytes;
+      const std::string expected = std::string(prefix, 'a') + c.expected;
+      const std::wstring wide = ToWide(CodePoints(expected));
+      bool ok = ptf::Utf8ToWide(input) == wide;
+      ok = ok && ptf::IsWellFormedUtf8(input) == (input == expected);
+      ok = ok && ptf::WideToUtf8(ptf::Utf8ToWide(input)) == expected;
+      ok = ok && Stream<char, wchar_t>(input, 2, &random, ptf::Utf8ToWideChunk) == wide;
+      if (!CHECK(ok) && ++failures > 10) return;
+    }
+  }
+}
+
+void TestWideToUtf8(const std::vector<GoldenCase>& cases) {
+  Random random(43);
+  int failures = 0;
+  for (const GoldenCase& c : cases) {
+    if (!c.utf16) continue;
+    for (size_t prefix : kPrefixes) {
+      const std::wstring input = std::wstring(prefix, L'a') + UnitsToWide(c.units);
+      const std::string expected = std::string(prefix, 'a') + c.expected;
+      bool ok = ptf::WideToUtf8(input) == expected;
+      ok = ok && Stream<wchar_t, char>(input, 4, &random, ptf::WideToUtf8Chunk) == expected;
+      if (!CHECK(ok) && ++failures > 10) return;
+    }
+  }
+}
+
+// Cases the random ones may miss: every code point boundary and the wchar_t
+// values above U+10FFFF that only exist with 4-byte wchar_t.
+void TestBoundaries() {
+  for (uint32_t cp : {0x7Fu, 0x80u, 0x7FFu, 0x800u, 0xD7FFu, 0xE000u, 0xFFFDu, 0xFFFFu,
+                      0x10000u, 0x10FFFFu}) {
+    const std::wstring wide = ToWide({cp});
+    CHECK(ptf::Utf8ToWide(ptf::WideToUtf8(wide)) == wide);
+  }
+  if (sizeof(wchar_t) == 4) {
+    CHECK(ptf::WideToUtf8(std::wstring(1, static_cast<wchar_t>(0x110000))) == "\xEF\xBF\xBD");
+  }
+  CHECK(ptf::Utf8ToWide("") == L"");
+  CHECK(ptf::WideToUtf8(L"") == "");
+  CHECK(ptf::IsWellFormedUtf8(""));
+}
+
+} // namespace
+
+int main() {
+  const std::vector<GoldenCase> cases = LoadGolden();
+  std::printf("%zu golden cases\n", cases.size());
+  CHECK(cases.size() == 4000);
+  TestUtf8ToWide(cases);
+  TestWideToUtf8(cases);
+  TestBoundaries();
+  return TestResult();
+}
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Writes cf_text/: 8-bit clipboard text as apps put it in CF_TEXT/CF_OEMTEXT.
+
+Each sample is <name>.bin, the bytes of the 8-bit block, and <name>.txt, the
+text the helper must save, as UTF-8. samples.txt lists the cases: the sample,
+the code page CF_LOCALE (or the system) gives, the CF_UNICODETEXT on the
+clipboard and the NarrowTextEncoding ChooseNarrowTextEncoding must pick.
+CF_UNICODETEXT is "synthesized" (what Windows makes from the 8-bit block in that
+code page), "none", or a .txt file holding the text the app set itself.
+"""
+
+import os
+
+OUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "cf_text")
+
+
+def encoded(text, codec):
+    return (text.encode(codec), text)
+
+
+# name: (8-bit bytes, saved text)
+SAMPLES = {
+    "ascii": encoded("Hello, world\r\nsecond line\r\n", "ascii"),
+    "cp1252": encoded(
+        "Caf\u00e9 \u2013 na\u00efve \u201cquotes\u201d cost \u20ac5\r\n"
+        "\u0153uvre \u00a9 \u00bd\r\n", "cp1252"),
+    # Console (CF_OEMTEXT) output.
+    "cp437": encoded(
+        "C:\\> dir\r\n\u2502 Gr\u00f6\u00dfe \u2500\u2500\u2518 \u00bd \u00b1 \u03b1\u03a3\r\n",
+        "cp437"),
+    "cp850": encoded("\u00d1and\u00fa \u00bfs\u00ed? \u00a9 \u00d8 \u00c0\r\n", "cp850"),
+    "cp1251": encoded(
+        "\u041f\u0440\u0438\u0432\u0435\u0442, \u043c\u0438\u0440! \u2116 5\r\n", "cp1251"),
+    "utf8": encoded("caf\u00e9 \u65e5\u672c \U0001F600\r\n", "utf-8"),
+    "cp932": encoded("\u65e5\u672c\u8a9e\u306e\u30c6\u30ad\u30b9\u30c8\r\n", "cp932"),
+    # An app that writes '?' to CF_TEXT for what the code page lacks and the
+    # real text to CF_UNICODETEXT.
+    "question": (b"caf\xe9 ?? price: 5 ?\r\n", "caf\u00e9 \u65e5\u672c price: 5 \u20b9\r\n"),
+}
+
+CASES = [
+    ("ascii", 1252, "synthesized", "Utf8"),
+    ("ascii", 437, "none", "Utf8"),
+    ("cp1252", 1252, "synthesized", "SingleByte"),
+    ("cp1252", 1252, "none", "SingleByte"),
+    ("cp437", 437, "synthesized", "SingleByte"),
+    ("cp850", 850, "synthesized", "SingleByte"),
+    ("cp1251", 1251, "synthesized", "SingleByte"),
+    ("utf8", 1252, "synthesized", "Utf8"),
+    ("utf8", 1252, "utf8.txt", "Utf8"),
+    ("utf8", 932, "none", "Utf8"),
+    ("question", 1252, "question.txt", "System"),
+    ("cp1252", 1252, "question.txt", "System"),
+    ("cp932", 932, "cp932.txt", "System"),
+    ("cp932", 932, "none", "System"),
+]
+
+os.makedirs(OUT, exist_ok=True)
+for name, (data, text) in SAMPLES.items():
+    with open(os.path.join(OUT, name + ".bin"), "wb") as f:
+        f.write(data)
+    with open(os.path.join(OUT, name + ".txt"), "wb") as f:
+        f.write(text.encode("utf-8"))
+with open(os.path.join(OUT, "samples.txt"), "w", newline="\n") as f:
+    f.write("# sample code-page CF_UNICODETEXT encoding\n")
+    for case in CASES:
+        f.write("%s %d %s %s\n" % case)
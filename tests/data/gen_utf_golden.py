@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Writes utf_golden.txt: UTF-8 and UTF-16 inputs with the text Python decodes
+them to using errors='replace', which substitutes U+FFFD for each maximal
+ill-formed UTF-8 subpart and each lone surrogate, as Utf.cpp does.
+
+Each line is "u8 <input bytes>" or "u16 <input units, 4 hex digits each>",
+then the expected text as UTF-8; all hex, "-" when empty. The cases are
+random but seeded, so rerunning gives the same file. The test adds ASCII
+prefixes itself to move each case across the vector widths.
+"""
+
+import os
+import random
+import struct
+
+UTF8_CASES = 3000
+UTF16_CASES = 1000
+
+rng = random.Random(20260223)
+
+
+def valid_char():
+    kind = rng.random()
+    if kind < 0.4:
+        return chr(rng.randrange(0x20, 0x7F)).encode()
+    if kind < 0.6:
+        return chr(rng.randrange(0x80, 0x800)).encode()
+    if kind < 0.85:
+        cp = rng.randrange(0x800, 0x10000)
+        if 0xD800 <= cp < 0xE000:
+            cp = 0xFFFD
+        return chr(cp).encode()
+    return chr(rng.randrange(0x10000, 0x110000)).encode()
+
+
+def invalid_piece():
+    kind = rng.randrange(10)
+    if kind == 0:  # truncated multi-byte sequence
+        full = chr(rng.choice([rng.randrange(0x80, 0x800), rng.randrange(0x800, 0xD800),
+                               rng.randrange(0x10000, 0x110000)])).encode()
+        return full[:rng.randrange(1, len(full))]
+    if kind == 1:  # stray continuation bytes
+        return bytes(rng.randrange(0x80, 0xC0) for _ in range(rng.randrange(1, 4)))
+    if kind == 2:  # overlong forms
+        return rng.choice([b"\xc0\x80", b"\xc1\xbf", b"\xe0\x80\x80", b"\xe0\x9f\xbf",
+                           b"\xf0\x80\x80\x80", b"\xf0\x8f\xbf\xbf"])
+    if kind == 3:  # UTF-8-encoded surrogates
+        cp = rng.randrange(0xD800, 0xE000)
+        return bytes([0xED, 0x80 | ((cp >> 6) & 0x3F), 0x80 | (cp & 0x3F)])
+    if kind == 4:  # above U+10FFFF
+        return rng.choice([b"\xf4\x90\x80\x80", b"\xf5\x80\x80\x80", b"\xf7\xbf\xbf\xbf"])
+    if kind == 5:  # bytes that never occur
+        return bytes([rng.choice([0xC0, 0xC1, 0xF5, 0xF8, 0xFC, 0xFE, 0xFF])])
+    if kind == 6:  # lead byte followed by ASCII
+        return bytes([rng.randrange(0xC2, 0xF5)]) + chr(rng.randrange(0x20, 0x7F)).encode()
+    return bytes([rng.randrange(0x80, 0x100)])
+
+
+def utf8_case():
+    out = b""
+    for _ in range(rng.randrange(0, 12)):
+        out += invalid_piece() if rng.random() < 0.35 else valid_char()
+    return out
+
+
+def utf16_case():
+    units = []
+    for _ in range(rng.randrange(0, 12)):
+        kind = rng.randrange(6)
+        if kind == 0:
+            units.append(rng.randrange(0xD800, 0xDC00))  # lone high
+        elif kind == 1:
+            units.append(rng.randrange(0xDC00, 0xE000))  # lone low
+        elif kind == 2:
+            cp = rng.randrange(0x10000, 0x110000) - 0x10000
+            units += [0xD800 | (cp >> 10), 0xDC00 | (cp & 0x3FF)]
+        elif kind == 3:
+            units.append(rng.randrange(0x20, 0x80))
+        else:
+            cp = rng.randrange(0x80, 0x10000)
+            units.append(0xFFFD if 0xD800 <= cp < 0xE000 else cp)
+    return units
+
+
+def hex_or_dash(data):
+    return data.hex() if data else "-"
+
+
+def main():
+    lines = []
+    for _ in range(UTF8_CASES):
+        data = utf8_case()
+        expected = data.decode("utf-8", errors="replace").encode("utf-8")
+        lines.append("u8 %s %s" % (hex_or_dash(data), hex_or_dash(expected)))
+    for _ in range(UTF16_CASES):
+        units = utf16_case()
+        raw = b"".join(struct.pack("<H", u) for u in units)
+        expected = raw.decode("utf-16-le", errors="replace").encode("utf-8")
+        text = "".join("%04x" % u for u in units) or "-"
+        lines.append("u16 %s %s" % (text, hex_or_dash(expected)))
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "utf_golden.txt")
+    with open(path, "w", newline="\n") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()